@@ -0,0 +1,69 @@
+#ifndef AOV_HLSLI
+#define AOV_HLSLI
+
+// memory layouts of the path tracer outputs, the denoiser reads them in place.
+// the pack functions are shared with the cpu reference in aov_layout.cpp.
+#define AOV_LAYOUT_FLOAT3	(0)		// float3 color, albedo and normal in a buffer each.
+#define AOV_LAYOUT_HALF		(1)		// half3 color, albedo and normal packed in one buffer as half3 + half3.
+
+#ifndef AOV_LAYOUT
+#	define AOV_LAYOUT AOV_LAYOUT_FLOAT3
+#endif
+
+// byte strides per pixel. the half color is padded to 8 bytes, byte address stores need 4 byte alignment.
+#define AOV_FLOAT3_STRIDE		(12)
+#define AOV_HALF_COLOR_STRIDE	(8)
+#define AOV_HALF_AUX_STRIDE		(12)
+#define AOV_HALF_NORMAL_OFFSET	(6)
+
+inline uint PackHalf2(float lo, float hi)
+{
+	return f32tof16(lo) | (f32tof16(hi) << 16);
+}
+
+inline float UnpackHalfLo(uint v)
+{
+	return f16tof32(v & 0xffff);
+}
+
+inline float UnpackHalfHi(uint v)
+{
+	return f16tof32(v >> 16);
+}
+
+#ifndef USE_IN_CPP
+
+void StoreAovColor(RWByteAddressBuffer buffer, uint index, float3 color)
+{
+#if AOV_LAYOUT == AOV_LAYOUT_HALF
+	buffer.Store2(index * AOV_HALF_COLOR_STRIDE, uint2(PackHalf2(color.x, color.y), PackHalf2(color.z, 0)));
+#else
+	buffer.Store3(index * AOV_FLOAT3_STRIDE, asuint(color));
+#endif
+}
+
+float3 LoadAovColor(ByteAddressBuffer buffer, uint index)
+{
+#if AOV_LAYOUT == AOV_LAYOUT_HALF
+	uint2 v = buffer.Load2(index * AOV_HALF_COLOR_STRIDE);
+	return float3(UnpackHalfLo(v.x), UnpackHalfHi(v.x), UnpackHalfLo(v.y));
+#else
+	return asfloat(buffer.Load3(index * AOV_FLOAT3_STRIDE));
+#endif
+}
+
+// the half layout writes both into albedoBuffer.
+void StoreAovAux(RWByteAddressBuffer albedoBuffer, RWByteAddressBuffer normalBuffer, uint index, float3 albedo, float3 normal)
+{
+#if AOV_LAYOUT == AOV_LAYOUT_HALF
+	albedoBuffer.Store3(index * AOV_HALF_AUX_STRIDE, uint3(PackHalf2(albedo.x, albedo.y), PackHalf2(albedo.z, normal.x), PackHalf2(normal.y, normal.z)));
+#else
+	albedoBuffer.Store3(index * AOV_FLOAT3_STRIDE, asuint(albedo));
+	normalBuffer.Store3(index * AOV_FLOAT3_STRIDE, asuint(normal));
+#endif
+}
+
+#endif
+
+#endif // AOV_HLSLI
+//  EOF
@@ -41,6 +41,8 @@ struct PathTraceCB
 {
 	int			sampleCount;
 	int			depthMax;
+	uint		accumFrameIndex;	// frames in the running mean before this one, also offsets the sample sequence.
+	uint		accumEnable;		// 1 keeps the running mean in rtAccum and writes it to rtResult.
 };
 
 struct SubmeshOffsetCB
@@ -50,6 +52,8 @@ struct SubmeshOffsetCB
 	uint	tangent;
 	uint	texcoord;
 	uint	index;
+	uint	constBaseColor;		// rgba8 unorm, base color of a material without a base color texture.
+	uint	constORM;			// rgba8 unorm, orm of a material without an orm texture.
 };
 
 struct DebugCB
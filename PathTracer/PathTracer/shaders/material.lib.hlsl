@@ -28,6 +28,33 @@ ConstantBuffer<LocalIndex>	cbLocalIndices	: register(b1, space0);
 
 #endif
 
+// rgba8 unorm constants of SubmeshOffsetCB, same packing as PackMaterialConstant() in cpu_material_fold.cpp.
+float4 UnpackMaterialConstant(uint v)
+{
+	return float4(
+		(v >> 0) & 0xff,
+		(v >> 8) & 0xff,
+		(v >> 16) & 0xff,
+		(v >> 24) & 0xff) * (1.0 / 255.0);
+}
+
+// normals of the corners of a triangle.
+void GetTriangleNormals(ByteAddressBuffer Vertices, uint normalOffset, uint3 indices, out float3 ns[3])
+{
+	ns[0] = GetVertexNormal(Vertices, normalOffset, indices.x);
+	ns[1] = GetVertexNormal(Vertices, normalOffset, indices.y);
+	ns[2] = GetVertexNormal(Vertices, normalOffset, indices.z);
+}
+
+// normals and texcoords of the corners of a triangle.
+void GetTriangleAttributes(ByteAddressBuffer Vertices, uint normalOffset, uint texcoordOffset, uint3 indices, out float3 ns[3], out float2 uvs[3])
+{
+	GetTriangleNormals(Vertices, normalOffset, indices, ns);
+	uvs[0] = GetVertexTexcoord(Vertices, texcoordOffset, indices.x);
+	uvs[1] = GetVertexTexcoord(Vertices, texcoordOffset, indices.y);
+	uvs[2] = GetVertexTexcoord(Vertices, texcoordOffset, indices.z);
+}
+
 [shader("closesthit")]
 void MaterialCHS(inout MaterialPayload payload : SV_RayPayload, in BuiltInTriangleIntersectionAttributes attr : SV_IntersectionAttributes)
 {
@@ -43,11 +70,9 @@ void MaterialCHS(inout MaterialPayload payload : SV_RayPayload, in BuiltInTriang
 
 	uint3 indices = GetVertexIndices32(Indices, cbSubmesh.index, PrimitiveIndex());
 
-	float2 uvs[3] = {
-		GetVertexTexcoord(Vertices, cbSubmesh.texcoord, indices.x),
-		GetVertexTexcoord(Vertices, cbSubmesh.texcoord, indices.y),
-		GetVertexTexcoord(Vertices, cbSubmesh.texcoord, indices.z),
-	};
+	float3 ns[3];
+	float2 uvs[3];
+	GetTriangleAttributes(Vertices, cbSubmesh.normal, cbSubmesh.texcoord, indices, ns, uvs);
 	float2 uv = uvs[0] +
 		attr.barycentrics.x * (uvs[1] - uvs[0]) +
 		attr.barycentrics.y * (uvs[2] - uvs[0]);
@@ -62,11 +87,42 @@ void MaterialCHS(inout MaterialPayload payload : SV_RayPayload, in BuiltInTriang
 
 	param.emissive = 0.0;
 
-	float3 ns[3] = {
-		GetVertexNormal(Vertices, cbSubmesh.normal, indices.x),
-		GetVertexNormal(Vertices, cbSubmesh.normal, indices.y),
-		GetVertexNormal(Vertices, cbSubmesh.normal, indices.z),
-	};
+	param.normal = ns[0] +
+		attr.barycentrics.x * (ns[1] - ns[0]) +
+		attr.barycentrics.y * (ns[2] - ns[0]);
+
+	param.flag = 0;
+	param.flag |= (HitKind() == HIT_KIND_TRIANGLE_BACK_FACE) ? kFlagBackFaceHit : 0;
+
+	EncodeMaterialPayload(param, payload);
+}
+
+// closest hit of materials without textures.
+// base color and orm come from SubmeshOffsetCB, so the uv decode and the texture fetches are skipped.
+[shader("closesthit")]
+void MaterialConstantCHS(inout MaterialPayload payload : SV_RayPayload, in BuiltInTriangleIntersectionAttributes attr : SV_IntersectionAttributes)
+{
+#if ENABLE_DYNAMIC_RESOURCE
+	// get dynamic resources.
+	ConstantBuffer<SubmeshOffsetCB> cbSubmesh = ResourceDescriptorHeap[cbLocalIndices.cbSubmesh];
+	ByteAddressBuffer Indices = ResourceDescriptorHeap[cbLocalIndices.Indices];
+	ByteAddressBuffer Vertices = ResourceDescriptorHeap[cbLocalIndices.Vertices];
+#endif
+
+	uint3 indices = GetVertexIndices32(Indices, cbSubmesh.index, PrimitiveIndex());
+
+	MaterialParam param = (MaterialParam)0;
+	param.hitT = RayTCurrent();
+
+	param.baseColor = UnpackMaterialConstant(cbSubmesh.constBaseColor);
+	float4 orm = UnpackMaterialConstant(cbSubmesh.constORM);
+	param.roughness = max(0.01, orm.g);
+	param.metallic = orm.b;
+
+	param.emissive = 0.0;
+
+	float3 ns[3];
+	GetTriangleNormals(Vertices, cbSubmesh.normal, indices, ns);
 	param.normal = ns[0] +
 		attr.barycentrics.x * (ns[1] - ns[0]) +
 		attr.barycentrics.y * (ns[2] - ns[0]);
@@ -92,11 +148,9 @@ void MaterialAHS(inout MaterialPayload payload : SV_RayPayload, in BuiltInTriang
 
 	uint3 indices = GetVertexIndices32(Indices, cbSubmesh.index, PrimitiveIndex());
 
-	float2 uvs[3] = {
-		GetVertexTexcoord(Vertices, cbSubmesh.texcoord, indices.x),
-		GetVertexTexcoord(Vertices, cbSubmesh.texcoord, indices.y),
-		GetVertexTexcoord(Vertices, cbSubmesh.texcoord, indices.z),
-	};
+	float3 ns[3];
+	float2 uvs[3];
+	GetTriangleAttributes(Vertices, cbSubmesh.normal, cbSubmesh.texcoord, indices, ns, uvs);
 	float2 uv = uvs[0] +
 		attr.barycentrics.x * (uvs[1] - uvs[0]) +
 		attr.barycentrics.y * (uvs[2] - uvs[0]);
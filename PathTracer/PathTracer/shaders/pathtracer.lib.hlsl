@@ -1,10 +1,20 @@
 #include "math.hlsli"
 #include "payload.hlsli"
 #include "cbuffer.hlsli"
+#include "aov.hlsli"
+#include "progressive.hlsli"
 #include "pbr.hlsli"
 
 #define RayTMax			10000.0
 
+// permutations fix the loop counts at compile time, 0 reads them from cbPathTrace.
+#ifndef PT_SAMPLE_COUNT
+#define PT_SAMPLE_COUNT	0
+#endif
+#ifndef PT_DEPTH_MAX
+#define PT_DEPTH_MAX	0
+#endif
+
 #if !ENABLE_DYNAMIC_RESOURCE
 
 // global
@@ -17,6 +27,7 @@ RaytracingAccelerationStructure		TLAS			: register(t0, space0);
 RWByteAddressBuffer					rtResult		: register(u0, space0);
 RWByteAddressBuffer					rtAlbedo		: register(u1, space0);
 RWByteAddressBuffer					rtNormal		: register(u2, space0);
+RWByteAddressBuffer					rtAccum			: register(u3, space0);
 
 #else
 
@@ -28,6 +39,7 @@ struct GlobalIndex
 	uint rtResult;
 	uint rtAlbedo;
 	uint rtNormal;
+	uint rtAccum;
 };
 
 ConstantBuffer<GlobalIndex>			cbGlobalIndices	: register(b0, space0);
@@ -36,30 +48,6 @@ RaytracingAccelerationStructure		TLAS			: register(t0, space0);
 #endif
 
 
-uint Hash32(uint x)
-{
-	x ^= x >> 16;
-	x *= uint(0x7feb352d);
-	x ^= x >> 15;
-	x *= uint(0x846ca68b);
-	x ^= x >> 16;
-	return x;
-}
-float Hash32ToFloat(uint hash)
-{ 
-	return hash / 4294967296.0;
-}
-uint Hash32Combine(const uint seed, const uint value)
-{
-	return seed ^ (Hash32(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2));
-}
-float2 Noise(uint2 pixPos, uint temporalIndex)
-{
-	uint baseHash = Hash32(pixPos.x + (pixPos.y << 15));
-	baseHash = Hash32Combine(baseHash, temporalIndex);
-	return float2(Hash32ToFloat(baseHash), Hash32ToFloat(Hash32(baseHash)));
-}
-
 float3 HemisphereSampleUniform(float u, float v)
 {
 	float phi = v * 2.0 * PI;
@@ -147,6 +135,7 @@ void PathTracerRGS()
 	RWByteAddressBuffer rtResult = ResourceDescriptorHeap[cbGlobalIndices.rtResult];
 	RWByteAddressBuffer rtAlbedo = ResourceDescriptorHeap[cbGlobalIndices.rtAlbedo];
 	RWByteAddressBuffer rtNormal = ResourceDescriptorHeap[cbGlobalIndices.rtNormal];
+	RWByteAddressBuffer rtAccum = ResourceDescriptorHeap[cbGlobalIndices.rtAccum];
 #endif
 
 	uint2 PixelPos = DispatchRaysIndex().xy;
@@ -159,8 +148,16 @@ void PathTracerRGS()
 	float3 origin = cbScene.eyePosition.xyz;
 	float3 direction = normalize(worldPos.xyz - origin);
 
+#if PT_SAMPLE_COUNT > 0
+	const int kSampleCount = PT_SAMPLE_COUNT;
+#else
 	const int kSampleCount = cbPathTrace.sampleCount;
+#endif
+#if PT_DEPTH_MAX > 0
+	const int kDepth = PT_DEPTH_MAX;
+#else
 	const int kDepth = cbPathTrace.depthMax;
+#endif
 	const int N = kSampleCount * kDepth;
 
 	float3 color = 0;
@@ -193,12 +190,15 @@ void PathTracerRGS()
 				color += reflectivity * (matParam.emissive + directLight * cbLight.directionalColor * shadowMask);
 				reflectivity *= diffuse;
 
-				ray.Origin = hitP;
-				uint i = PixelPos.x + PixelPos.y * sample + depth;
-				float2 uv = Noise(PixelPos, sample * kDepth + depth);
-				float3 localDir = HemisphereSampleUniform(uv.x, uv.y);
-				float4 qRot = QuatFromTwoVector(float3(0, 0, 1), matParam.normal);
-				ray.Direction = QuatRotVector(localDir, qRot);
+				// the last bounce needs no next direction, a fixed depth drops this code.
+				if (depth + 1 < kDepth)
+				{
+					ray.Origin = hitP;
+					float2 uv = Noise(PixelPos, GetSampleSequenceIndex(cbPathTrace.accumFrameIndex, sample, depth, kSampleCount, kDepth));
+					float3 localDir = HemisphereSampleUniform(uv.x, uv.y);
+					float4 qRot = QuatFromTwoVector(float3(0, 0, 1), matParam.normal);
+					ray.Direction = QuatRotVector(localDir, qRot);
+				}
 
 				if (depth == 0)
 				{
@@ -216,10 +216,15 @@ void PathTracerRGS()
 	color *= (1.0 / (float)kSampleCount);
 
 	uint index = PixelPos.y * DispatchRaysDimensions().x + PixelPos.x;
-	uint address = index * 4/* sizeof(float) */ * 3;
-	rtResult.Store3(address, asuint(color));
-	rtAlbedo.Store3(address, asuint(albedo));
-	rtNormal.Store3(address, asuint(normal));
+	if (cbPathTrace.accumEnable)
+	{
+		// progressive mode, the mean of all frames since the last reset.
+		float3 mean = asfloat(rtAccum.Load3(index * ACCUM_STRIDE));
+		color = AccumulateMean(mean, color, cbPathTrace.accumFrameIndex + 1);
+		rtAccum.Store3(index * ACCUM_STRIDE, asuint(color));
+	}
+	StoreAovColor(rtResult, index, color);
+	StoreAovAux(rtAlbedo, rtNormal, index, albedo, normal);
 }
 
 [shader("miss")]
@@ -0,0 +1,62 @@
+#ifndef PROGRESSIVE_HLSLI
+#define PROGRESSIVE_HLSLI
+
+// sample sequence and running mean of the progressive mode.
+// shared with the cpu reference in cpu_path_tracer.cpp, both produce the same samples.
+#define ACCUM_STRIDE	(12)		// float3 running mean per pixel.
+
+inline uint Hash32(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+inline float Hash32ToFloat(uint hash)
+{
+	return (float)hash / 4294967296.0f;
+}
+
+inline uint Hash32Combine(uint seed, uint value)
+{
+	return seed ^ (Hash32(value) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+// hash of a pixel and a sequence index, Noise() turns it into two uniform numbers.
+inline uint NoiseHash(uint px, uint py, uint sequenceIndex)
+{
+	return Hash32Combine(Hash32(px + (py << 15)), sequenceIndex);
+}
+
+// sequence index of a bounce. frame 0 is the sequence of a single frame, every following frame
+// continues it, so k accumulated frames draw the same samples as one frame with k times the samples.
+inline uint GetSampleSequenceIndex(uint frameIndex, uint sample, uint depth, uint sampleCount, uint depthMax)
+{
+	return (frameIndex * sampleCount + sample) * depthMax + depth;
+}
+
+// running mean of frameCount frames, the first frame after a reset overwrites the mean.
+inline float AccumulateMean(float mean, float value, uint frameCount)
+{
+	return (frameCount <= 1) ? value : mean + (value - mean) / (float)frameCount;
+}
+
+#ifndef USE_IN_CPP
+
+float2 Noise(uint2 pixPos, uint sequenceIndex)
+{
+	uint hash = NoiseHash(pixPos.x, pixPos.y, sequenceIndex);
+	return float2(Hash32ToFloat(hash), Hash32ToFloat(Hash32(hash)));
+}
+
+float3 AccumulateMean(float3 mean, float3 value, uint frameCount)
+{
+	return float3(AccumulateMean(mean.x, value.x, frameCount), AccumulateMean(mean.y, value.y, frameCount), AccumulateMean(mean.z, value.z, frameCount));
+}
+
+#endif
+
+#endif // PROGRESSIVE_HLSLI
@@ -1,5 +1,6 @@
 #include "cbuffer.hlsli"
 #include "math.hlsli"
+#include "aov.hlsli"
 
 struct PSInput
 {
@@ -40,9 +41,8 @@ PSOutput main(PSInput In)
 
 	uint2 PixelPos = uint2(In.position.xy);
 	uint index = PixelPos.y * uint(cbScene.screenSize.x) + PixelPos.x;
-	uint address = index * 4 * 3;
 	
-	Out.color = float4(pow(asfloat(rRTResult.Load3(address)), 1/2.2), 1);
+	Out.color = float4(pow(LoadAovColor(rRTResult, index), 1/2.2), 1);
 
 	return Out;
 }
@@ -0,0 +1,191 @@
+#include "aov_layout.h"
+#include "cpu_types.h"
+
+#include <cstring>
+
+
+namespace
+{
+	// the hlsl intrinsics aov.hlsli uses.
+	uint32_t f32tof16(float value)
+	{
+		return F32ToF16(value);
+	}
+
+	float f16tof32(uint32_t value)
+	{
+		return F16ToF32(value);
+	}
+}
+
+#ifndef USE_IN_CPP
+#	define USE_IN_CPP
+#endif
+#include "../shaders/cbuffer.hlsli"
+#include "../shaders/aov.hlsli"
+
+static_assert((int)AovLayout::Float3 == AOV_LAYOUT_FLOAT3 && (int)AovLayout::Half == AOV_LAYOUT_HALF, "AovLayout does not match aov.hlsli.");
+
+
+const char* GetAovLayoutName(AovLayout layout)
+{
+	return layout == AovLayout::Half ? "half" : "float3";
+}
+
+AovImageDesc GetAovImageDesc(AovLayout layout, AovImage image)
+{
+	if (layout != AovLayout::Half)
+	{
+		return AovImageDesc{ false, 0, AOV_FLOAT3_STRIDE };
+	}
+	switch (image)
+	{
+	case AovImage::Color: return AovImageDesc{ true, 0, AOV_HALF_COLOR_STRIDE };
+	case AovImage::Albedo: return AovImageDesc{ true, 0, AOV_HALF_AUX_STRIDE };
+	default: return AovImageDesc{ true, AOV_HALF_NORMAL_OFFSET, AOV_HALF_AUX_STRIDE };
+	}
+}
+
+size_t GetAovBufferSize(AovLayout layout, AovImage image, uint32_t width, uint32_t height)
+{
+	if (layout == AovLayout::Half && image == AovImage::Normal)
+	{
+		return 0;
+	}
+	return (size_t)width * height * GetAovImageDesc(layout, image).pixelStride;
+}
+
+uint32_t F32ToF16(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t absBits = bits & 0x7fffffff;
+
+	// nan stays nan, everything from 65520 up rounds to inf.
+	if (absBits >= 0x7f800000)
+	{
+		return sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 : 0);
+	}
+	if (absBits >= 0x477ff000)
+	{
+		return sign | 0x7c00;
+	}
+
+	// below 2^-14 the half is denormal, below 2^-25 it is zero.
+	if (absBits < 0x38800000)
+	{
+		uint32_t exponent = absBits >> 23;
+		if (exponent < 102)
+		{
+			return sign;
+		}
+		uint32_t mantissa = (absBits & 0x7fffff) | 0x800000;
+		uint32_t shift = 126 - exponent;
+		uint32_t h = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		h += (rest > halfway || (rest == halfway && (h & 1))) ? 1 : 0;
+		return sign | h;
+	}
+
+	// rebias the exponent, a carry out of the mantissa increments it.
+	uint32_t h = (absBits - 0x38000000) >> 13;
+	uint32_t rest = absBits & 0x1fff;
+	h += (rest > 0x1000 || (rest == 0x1000 && (h & 1))) ? 1 : 0;
+	return sign | h;
+}
+
+float F16ToF32(uint32_t value)
+{
+	uint32_t sign = (value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+	if (exponent == 0)
+	{
+		float f = (float)mantissa * (1.0f / 16777216.0f);
+		return sign ? -f : f;
+	}
+	uint32_t bits = sign | (exponent == 31 ? 0x7f800000 : ((exponent + 112) << 23)) | (mantissa << 13);
+	float ret;
+	memcpy(&ret, &bits, sizeof(ret));
+	return ret;
+}
+
+void PackAov(AovLayout layout, size_t pixelCount, const float* color, const float* albedo, const float* normal, void* pColor, void* pAlbedo, void* pNormal)
+{
+	auto pC = static_cast<uint8_t*>(pColor);
+	auto pA = static_cast<uint8_t*>(pAlbedo);
+	auto pN = static_cast<uint8_t*>(pNormal);
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		const float* c = color + i * 3;
+		const float* a = albedo + i * 3;
+		const float* n = normal + i * 3;
+		if (layout == AovLayout::Half)
+		{
+			uint32_t colorBits[2] = { PackHalf2(c[0], c[1]), PackHalf2(c[2], 0.0f) };
+			uint32_t auxBits[3] = { PackHalf2(a[0], a[1]), PackHalf2(a[2], n[0]), PackHalf2(n[1], n[2]) };
+			memcpy(pC + i * AOV_HALF_COLOR_STRIDE, colorBits, sizeof(colorBits));
+			memcpy(pA + i * AOV_HALF_AUX_STRIDE, auxBits, sizeof(auxBits));
+		}
+		else
+		{
+			memcpy(pC + i * AOV_FLOAT3_STRIDE, c, sizeof(float) * 3);
+			memcpy(pA + i * AOV_FLOAT3_STRIDE, a, sizeof(float) * 3);
+			memcpy(pN + i * AOV_FLOAT3_STRIDE, n, sizeof(float) * 3);
+		}
+	}
+}
+
+void UnpackAov(AovLayout layout, size_t pixelCount, const void* pColor, const void* pAlbedo, const void* pNormal, float* color, float* albedo, float* normal)
+{
+	auto pC = static_cast<const uint8_t*>(pColor);
+	auto pA = static_cast<const uint8_t*>(pAlbedo);
+	auto pN = static_cast<const uint8_t*>(pNormal);
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		float* c = color + i * 3;
+		float* a = albedo + i * 3;
+		float* n = normal + i * 3;
+		if (layout == AovLayout::Half)
+		{
+			uint32_t colorBits[2], auxBits[3];
+			memcpy(colorBits, pC + i * AOV_HALF_COLOR_STRIDE, sizeof(colorBits));
+			memcpy(auxBits, pA + i * AOV_HALF_AUX_STRIDE, sizeof(auxBits));
+			c[0] = UnpackHalfLo(colorBits[0]); c[1] = UnpackHalfHi(colorBits[0]); c[2] = UnpackHalfLo(colorBits[1]);
+			a[0] = UnpackHalfLo(auxBits[0]); a[1] = UnpackHalfHi(auxBits[0]); a[2] = UnpackHalfLo(auxBits[1]);
+			n[0] = UnpackHalfHi(auxBits[1]); n[1] = UnpackHalfLo(auxBits[2]); n[2] = UnpackHalfHi(auxBits[2]);
+		}
+		else
+		{
+			memcpy(c, pC + i * AOV_FLOAT3_STRIDE, sizeof(float) * 3);
+			memcpy(a, pA + i * AOV_FLOAT3_STRIDE, sizeof(float) * 3);
+			memcpy(n, pN + i * AOV_FLOAT3_STRIDE, sizeof(float) * 3);
+		}
+	}
+}
+
+AovFrameTraffic GetAovFrameTraffic(AovLayout layout, uint32_t width, uint32_t height, bool bDenoise, bool bDirectWrite)
+{
+	uint64_t color = GetAovBufferSize(layout, AovImage::Color, width, height);
+	uint64_t aux = GetAovBufferSize(layout, AovImage::Albedo, width, height) + GetAovBufferSize(layout, AovImage::Normal, width, height);
+
+	// the tonemap reads the denoised image in the color layout, or the noisy one.
+	AovFrameTraffic ret;
+	ret.traceWrite = color + aux;
+	ret.tonemapRead = color;
+	if (bDenoise)
+	{
+		if (!bDirectWrite)
+		{
+			ret.copyRead = color + aux;
+			ret.copyWrite = color + aux;
+		}
+		ret.denoiseRead = color + aux;
+		ret.denoiseWrite = color;
+	}
+	return ret;
+}
+
+//	EOF
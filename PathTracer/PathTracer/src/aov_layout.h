@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+// same values as AOV_LAYOUT_xx in aov.hlsli.
+enum class AovLayout
+{
+	Float3 = 0,
+	Half = 1,
+};
+
+enum class AovImage
+{
+	Color,
+	Albedo,
+	Normal,
+};
+
+const char* GetAovLayoutName(AovLayout layout);
+
+// where an image lives in its buffer, the half layout keeps albedo and normal in the albedo buffer.
+struct AovImageDesc
+{
+	bool		bHalf;
+	uint32_t	byteOffset;
+	uint32_t	pixelStride;
+};
+
+AovImageDesc GetAovImageDesc(AovLayout layout, AovImage image);
+// 0 for an image that lives in the buffer of another one.
+size_t GetAovBufferSize(AovLayout layout, AovImage image, uint32_t width, uint32_t height);
+
+// same conversions as f32tof16/f16tof32 in hlsl, rounds to nearest even.
+uint32_t F32ToF16(float value);
+float F16ToF32(uint32_t value);
+
+// cpu reference of StoreAovColor/StoreAovAux/LoadAovColor in aov.hlsli.
+// color, albedo and normal are float3 images, pNormal is not used by the half layout.
+void PackAov(AovLayout layout, size_t pixelCount, const float* color, const float* albedo, const float* normal, void* pColor, void* pAlbedo, void* pNormal);
+void UnpackAov(AovLayout layout, size_t pixelCount, const void* pColor, const void* pAlbedo, const void* pNormal, float* color, float* albedo, float* normal);
+
+// bytes moved per frame from the path tracer to the tonemap.
+struct AovFrameTraffic
+{
+	uint64_t	traceWrite = 0;
+	uint64_t	copyRead = 0;		// CopyNoisyResource.
+	uint64_t	copyWrite = 0;
+	uint64_t	denoiseRead = 0;
+	uint64_t	denoiseWrite = 0;
+	uint64_t	tonemapRead = 0;
+
+	uint64_t GetTotal() const
+	{
+		return traceWrite + copyRead + copyWrite + denoiseRead + denoiseWrite + tonemapRead;
+	}
+};
+
+// bDirectWrite: the path tracer writes the buffers of the denoiser, nothing is copied.
+AovFrameTraffic GetAovFrameTraffic(AovLayout layout, uint32_t width, uint32_t height, bool bDenoise, bool bDirectWrite);
+
+//	EOF
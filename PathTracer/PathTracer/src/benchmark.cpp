@@ -0,0 +1,106 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+
+namespace
+{
+	static const char* kMeshDir = "resources/mesh";
+
+	struct BenchmarkEntry
+	{
+		const char*	name;
+		int			(*func)(const BenchmarkOptions&);
+	};
+	static const BenchmarkEntry kBenchmarks[] = {
+		{"bvh",		RunBvhBuildBenchmark},
+		{"widebvh",	RunWideBvhBenchmark},
+		{"lbvh",	RunLbvhBenchmark},
+		{"simd",	RunSimdTraversalBenchmark},
+		{"sceneupdate",	RunSceneUpdateBenchmark},
+		{"sbt",		RunShaderTableBenchmark},
+		{"sbtpatch",	RunShaderTablePatchBenchmark},
+		{"material",	RunMaterialRegistryBenchmark},
+		{"fold",	RunMaterialFoldBenchmark},
+		{"rmeshload",	RunRMeshLoadBenchmark},
+		{"rmeshv2",	RunRMeshV2Benchmark},
+		{"index16",	RunIndexFormatBenchmark},
+		{"reorder",	RunReorderBenchmark},
+		{"opacity",	RunOpacityBenchmark},
+		{"lod",	RunLodBenchmark},
+		{"task",	RunTaskBenchmark},
+		{"shadercache",	RunShaderCacheBenchmark},
+		{"permutation",	RunPermutationBenchmark},
+		{"denoise",	RunDenoiseBenchmark},
+		{"denoiseasync",	RunAsyncDenoiseBenchmark},
+		{"denoiseprefilter",	RunPrefilterDenoiseBenchmark},
+		{"aov",	RunAovBenchmark},
+		{"progressive",	RunProgressiveBenchmark},
+	};
+}
+
+int RunBenchmark(const std::string& name, const BenchmarkOptions& opt)
+{
+	for (auto&& entry : kBenchmarks)
+	{
+		if (name == entry.name)
+		{
+			return entry.func(opt);
+		}
+	}
+
+	printf("Error: unknown benchmark. (%s)\n", name.c_str());
+	printf("available:");
+	for (auto&& entry : kBenchmarks)
+	{
+		printf(" %s", entry.name);
+	}
+	printf("\n");
+	return -1;
+}
+
+std::vector<std::string> FindMeshFiles(const std::string& homeDir)
+{
+	std::vector<std::string> ret;
+	std::error_code ec;
+	std::filesystem::path dir = std::filesystem::path(homeDir) / kMeshDir;
+	for (auto&& entry : std::filesystem::recursive_directory_iterator(dir, ec))
+	{
+		if (entry.is_regular_file() && entry.path().extension() == ".rmesh")
+		{
+			ret.push_back(entry.path().string());
+		}
+	}
+	if (ec)
+	{
+		printf("Error: failed to enumerate mesh files. (%s)\n", dir.string().c_str());
+	}
+	std::sort(ret.begin(), ret.end());
+	return ret;
+}
+
+std::vector<uint32_t> GetThreadCountSweep(uint32_t maxThreads)
+{
+	if (maxThreads == 0)
+	{
+		maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	std::vector<uint32_t> ret;
+	for (uint32_t n = 1; n < maxThreads; n *= 2)
+	{
+		ret.push_back(n);
+	}
+	ret.push_back(maxThreads);
+	return ret;
+}
+
+std::string GetFileName(const std::string& filePath)
+{
+	auto pos = filePath.find_last_of("/\\");
+	return (pos == std::string::npos) ? filePath : filePath.substr(pos + 1);
+}
+
+//	EOF
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+struct BenchmarkOptions
+{
+	std::string	homeDir = "./";
+	uint32_t	threadCount = 0;		// max thread count of the sweep, 0 uses all hardware threads.
+	int			repeatCount = 3;		// the best time of the repeats is reported.
+};
+
+// runs a benchmark by name, returns the process exit code.
+int RunBenchmark(const std::string& name, const BenchmarkOptions& opt);
+
+// benchmarks.
+int RunBvhBuildBenchmark(const BenchmarkOptions& opt);
+int RunWideBvhBenchmark(const BenchmarkOptions& opt);
+int RunLbvhBenchmark(const BenchmarkOptions& opt);
+int RunSimdTraversalBenchmark(const BenchmarkOptions& opt);
+int RunSceneUpdateBenchmark(const BenchmarkOptions& opt);
+int RunShaderTableBenchmark(const BenchmarkOptions& opt);
+int RunShaderTablePatchBenchmark(const BenchmarkOptions& opt);
+int RunMaterialRegistryBenchmark(const BenchmarkOptions& opt);
+int RunMaterialFoldBenchmark(const BenchmarkOptions& opt);
+int RunRMeshLoadBenchmark(const BenchmarkOptions& opt);
+int RunRMeshV2Benchmark(const BenchmarkOptions& opt);
+int RunIndexFormatBenchmark(const BenchmarkOptions& opt);
+int RunReorderBenchmark(const BenchmarkOptions& opt);
+int RunOpacityBenchmark(const BenchmarkOptions& opt);
+int RunLodBenchmark(const BenchmarkOptions& opt);
+int RunTaskBenchmark(const BenchmarkOptions& opt);
+int RunShaderCacheBenchmark(const BenchmarkOptions& opt);
+int RunPermutationBenchmark(const BenchmarkOptions& opt);
+int RunDenoiseBenchmark(const BenchmarkOptions& opt);
+int RunAsyncDenoiseBenchmark(const BenchmarkOptions& opt);
+int RunPrefilterDenoiseBenchmark(const BenchmarkOptions& opt);
+int RunAovBenchmark(const BenchmarkOptions& opt);
+int RunProgressiveBenchmark(const BenchmarkOptions& opt);
+
+// .rmesh files under resources/mesh.
+std::vector<std::string> FindMeshFiles(const std::string& homeDir);
+// 1, 2, 4, ... up to maxThreads, maxThreads is always included.
+std::vector<uint32_t> GetThreadCountSweep(uint32_t maxThreads);
+std::string GetFileName(const std::string& filePath);
+
+//	EOF
@@ -0,0 +1,260 @@
+#include "benchmark.h"
+#include "aov_layout.h"
+#include "denoiser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock	Clock;
+
+	struct Resolution
+	{
+		uint32_t	width, height;
+	};
+	static const Resolution kResolutions[] = {
+		{ 1920, 1080 },
+		{ 2560, 1440 },
+	};
+
+	// values of f32tof16 in hlsl, ties round to even.
+	bool ValidateHalfConversion()
+	{
+		struct Case
+		{
+			float		value;
+			uint32_t	half;
+		};
+		const Case cases[] = {
+			{ 0.0f, 0x0000 },
+			{ -0.0f, 0x8000 },
+			{ 1.0f, 0x3c00 },
+			{ -2.0f, 0xc000 },
+			{ 0.1f, 0x2e66 },
+			{ 65504.0f, 0x7bff },
+			{ 65519.0f, 0x7bff },
+			{ 65520.0f, 0x7c00 },
+			{ 1e10f, 0x7c00 },
+			{ 6.103515625e-05f, 0x0400 },			// smallest normal.
+			{ 5.9604644775390625e-08f, 0x0001 },	// smallest denormal.
+			{ 2.98023223876953125e-08f, 0x0000 },	// half of it, ties to even.
+			{ 1.00048828125f, 0x3c00 },				// 1 + 2^-11, ties to even.
+			{ 1.00146484375f, 0x3c02 },				// 1 + 3 * 2^-11, ties to even.
+			{ INFINITY, 0x7c00 },
+		};
+		bool bValid = true;
+		for (auto&& c : cases)
+		{
+			bValid = bValid && F32ToF16(c.value) == c.half;
+		}
+		uint32_t nan = F32ToF16(NAN);
+		bValid = bValid && (nan & 0x7c00) == 0x7c00 && (nan & 0x3ff) != 0 && std::isnan(F16ToF32(nan));
+
+		// every finite half survives a round trip.
+		for (uint32_t h = 0; h < 0x10000; h++)
+		{
+			if ((h & 0x7c00) != 0x7c00)
+			{
+				bValid = bValid && F32ToF16(F16ToF32(h)) == h;
+			}
+		}
+		return bValid;
+	}
+
+	// hdr color, albedo in [0, 1] and unit normals.
+	void GenerateAov(size_t pixelCount, std::vector<float>* pColor, std::vector<float>* pAlbedo, std::vector<float>* pNormal)
+	{
+		std::mt19937 rnd(0);
+		std::exponential_distribution<float> radiance(0.5f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f), dir(-1.0f, 1.0f);
+		pColor->resize(pixelCount * 3);
+		pAlbedo->resize(pixelCount * 3);
+		pNormal->resize(pixelCount * 3);
+		for (size_t i = 0; i < pixelCount * 3; i += 3)
+		{
+			float n[3] = { dir(rnd), dir(rnd), dir(rnd) + 1.5f };
+			float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int c = 0; c < 3; c++)
+			{
+				(*pColor)[i + c] = radiance(rnd);
+				(*pAlbedo)[i + c] = unit(rnd);
+				(*pNormal)[i + c] = n[c] / len;
+			}
+		}
+	}
+
+	// half keeps 11 significant bits, a round to nearest is off by at most half an ulp.
+	bool WithinHalfPrecision(const std::vector<float>& expected, const std::vector<float>& actual)
+	{
+		for (size_t i = 0; i < expected.size(); i++)
+		{
+			if (std::fabs(expected[i] - actual[i]) > std::fabs(expected[i]) * (1.0f / 2048.0f) + 2.98e-8f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	double ToMB(uint64_t bytes)
+	{
+		return (double)bytes / (1024.0 * 1024.0);
+	}
+
+#if ENABLE_OIDN
+	double ElapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// packs the aov into new oidn buffers of the layout.
+	void CreateImages(oidn::DeviceRef& device, AovLayout layout, uint32_t width, uint32_t height,
+		const std::vector<float>& color, const std::vector<float>& albedo, const std::vector<float>& normal, DenoiseImages* pImages)
+	{
+		pImages->color = device.newBuffer(GetAovBufferSize(layout, AovImage::Color, width, height));
+		pImages->albedo = device.newBuffer(GetAovBufferSize(layout, AovImage::Albedo, width, height));
+		pImages->normal = (layout == AovLayout::Half) ? pImages->albedo : device.newBuffer(GetAovBufferSize(layout, AovImage::Normal, width, height));
+		pImages->output = device.newBuffer(GetAovBufferSize(layout, AovImage::Color, width, height));
+		PackAov(layout, (size_t)width * height, color.data(), albedo.data(), normal.data(),
+			pImages->color.getData(), pImages->albedo.getData(), pImages->normal.getData());
+	}
+
+	std::vector<float> UnpackColor(AovLayout layout, size_t pixelCount, const oidn::BufferRef& buffer)
+	{
+		std::vector<float> color(pixelCount * 3), aux(pixelCount * 3);
+		std::vector<uint8_t> auxBytes(GetAovBufferSize(layout, AovImage::Albedo, (uint32_t)pixelCount, 1));
+		UnpackAov(layout, pixelCount, buffer.getData(), auxBytes.data(), auxBytes.data(), color.data(), aux.data(), aux.data());
+		return color;
+	}
+#endif
+}
+
+
+int RunAovBenchmark(const BenchmarkOptions& opt)
+{
+	bool bValid = ValidateHalfConversion();
+	printf("f32tof16 reference rounds to nearest even, every half round trips: %s\n", bValid ? "yes" : "NO");
+
+	// the half layout stays within half precision, packing its own output again gives the same bits.
+	{
+		const Resolution& res = kResolutions[0];
+		size_t pixelCount = (size_t)res.width * res.height;
+		std::vector<float> color, albedo, normal;
+		GenerateAov(pixelCount, &color, &albedo, &normal);
+
+		bool bLayouts = true;
+		for (AovLayout layout : { AovLayout::Float3, AovLayout::Half })
+		{
+			std::vector<uint8_t> packedColor(GetAovBufferSize(layout, AovImage::Color, res.width, res.height));
+			std::vector<uint8_t> packedAlbedo(GetAovBufferSize(layout, AovImage::Albedo, res.width, res.height));
+			std::vector<uint8_t> packedNormal(GetAovBufferSize(layout, AovImage::Normal, res.width, res.height));
+			PackAov(layout, pixelCount, color.data(), albedo.data(), normal.data(), packedColor.data(), packedAlbedo.data(), packedNormal.data());
+
+			std::vector<float> c(pixelCount * 3), a(pixelCount * 3), n(pixelCount * 3);
+			UnpackAov(layout, pixelCount, packedColor.data(), packedAlbedo.data(), packedNormal.data(), c.data(), a.data(), n.data());
+			bool bPrecision = (layout == AovLayout::Half)
+				? WithinHalfPrecision(color, c) && WithinHalfPrecision(albedo, a) && WithinHalfPrecision(normal, n)
+				: c == color && a == albedo && n == normal;
+
+			std::vector<uint8_t> repackedColor(packedColor.size()), repackedAlbedo(packedAlbedo.size()), repackedNormal(packedNormal.size());
+			PackAov(layout, pixelCount, c.data(), a.data(), n.data(), repackedColor.data(), repackedAlbedo.data(), repackedNormal.data());
+			bool bRepack = repackedColor == packedColor && repackedAlbedo == packedAlbedo && repackedNormal == packedNormal;
+
+			// the normal of the half layout is a half3 at its byte offset, as oidn reads it.
+			bool bOffsets = true;
+			if (layout == AovLayout::Half)
+			{
+				auto desc = GetAovImageDesc(layout, AovImage::Normal);
+				for (size_t i = 0; i < pixelCount; i += 997)
+				{
+					uint16_t h[3];
+					memcpy(h, packedAlbedo.data() + i * desc.pixelStride + desc.byteOffset, sizeof(h));
+					bOffsets = bOffsets && h[0] == F32ToF16(normal[i * 3 + 0]) && h[1] == F32ToF16(normal[i * 3 + 1]) && h[2] == F32ToF16(normal[i * 3 + 2]);
+				}
+			}
+			bLayouts = bLayouts && bPrecision && bRepack && bOffsets;
+			printf("  %-6s %u bytes/pixel, unpack within precision: %s, repack identical: %s\n", GetAovLayoutName(layout),
+				(unsigned)((packedColor.size() + packedAlbedo.size() + packedNormal.size()) / pixelCount),
+				bPrecision ? "yes" : "NO", (bRepack && bOffsets) ? "yes" : "NO");
+		}
+		bValid = bValid && bLayouts;
+	}
+
+	// the shared buffers of a cuda device take the path tracer writes, the cpu device still reads back copies.
+	printf("bytes moved per frame, path tracer to tonemap with denoise\n");
+	printf("  %-10s %-6s %-8s %8s %8s %8s %8s %9s\n", "resolution", "layout", "path", "trace MB", "copy MB", "oidn MB", "tone MB", "total MB");
+	for (auto&& res : kResolutions)
+	{
+		uint64_t baseline = GetAovFrameTraffic(AovLayout::Float3, res.width, res.height, true, false).GetTotal();
+		for (AovLayout layout : { AovLayout::Float3, AovLayout::Half })
+		{
+			for (bool bDirect : { false, true })
+			{
+				auto t = GetAovFrameTraffic(layout, res.width, res.height, true, bDirect);
+				printf("  %4ux%-5u %-6s %-8s %8.1f %8.1f %8.1f %8.1f %9.1f (%.0f%%)\n", res.width, res.height, GetAovLayoutName(layout), bDirect ? "direct" : "copy",
+					ToMB(t.traceWrite), ToMB(t.copyRead + t.copyWrite), ToMB(t.denoiseRead + t.denoiseWrite), ToMB(t.tonemapRead), ToMB(t.GetTotal()),
+					100.0 * (double)t.GetTotal() / (double)baseline);
+			}
+		}
+	}
+
+#if !ENABLE_OIDN
+	(void)opt;
+	printf("half layout denoise skipped, built without OpenImageDenoise. (-DENABLE_OIDN=1 -lOpenImageDenoise)\n");
+#else
+	// oidn reads the half layout in place, the result matches the float3 one within half precision.
+	{
+		Denoiser denoiser;
+		if (!denoiser.Initialize(DenoiserDeviceType::CPU))
+		{
+			return -1;
+		}
+		const Resolution& res = kResolutions[0];
+		size_t pixelCount = (size_t)res.width * res.height;
+		std::vector<float> color, albedo, normal;
+		GenerateAov(pixelCount, &color, &albedo, &normal);
+
+		int frameCount = std::max(opt.repeatCount, 1);
+		printf("denoise %ux%u, device %s\n", res.width, res.height, GetDenoiserDeviceTypeName(denoiser.GetDeviceType()));
+		std::vector<float> outputs[2];
+		for (AovLayout layout : { AovLayout::Float3, AovLayout::Half })
+		{
+			DenoiseFilterKey key;
+			key.width = res.width;
+			key.height = res.height;
+			key.layout = layout;
+			DenoiseImages images;
+			CreateImages(denoiser.GetDevice(), layout, res.width, res.height, color, albedo, normal, &images);
+			bValid = denoiser.Execute(key, images) && bValid;
+			auto start = Clock::now();
+			for (int f = 0; f < frameCount; f++)
+			{
+				bValid = denoiser.Execute(key, images) && bValid;
+			}
+			double ms = ElapsedMs(start) / frameCount;
+			outputs[(int)layout] = UnpackColor(layout, pixelCount, images.output);
+			printf("  %-6s %8.2f ms\n", GetAovLayoutName(layout), ms);
+		}
+		float maxDiff = 0.0f;
+		for (size_t i = 0; i < outputs[0].size(); i++)
+		{
+			maxDiff = std::max(maxDiff, std::fabs(outputs[0][i] - outputs[1][i]) / std::max(std::fabs(outputs[0][i]), 1e-2f));
+		}
+		bool bClose = maxDiff <= 1e-2f;
+		bValid = bValid && bClose;
+		printf("  half output within 1%% of float3: %s (max relative diff %.2g)\n", bClose ? "yes" : "NO", maxDiff);
+	}
+#endif
+
+	printf("aov layouts match the reference: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+}
+
+//	EOF
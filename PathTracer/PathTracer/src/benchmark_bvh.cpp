@@ -0,0 +1,104 @@
+#include "benchmark.h"
+#include "cpu_scene.h"
+
+#include <chrono>
+#include <cstdio>
+
+
+namespace
+{
+	struct BuildResult
+	{
+		double		bestMs = 0.0;
+		float		sahCost = 0.0f;
+		size_t		nodeCount = 0;
+		size_t		refCount = 0;
+	};
+
+	template <typename BuildFunc>
+	BuildResult MeasureBuild(int repeatCount, BuildFunc&& func)
+	{
+		BuildResult ret;
+		ret.bestMs = 1e30;
+		for (int r = 0; r < std::max(repeatCount, 1); r++)
+		{
+			Bvh bvh;
+			auto start = std::chrono::high_resolution_clock::now();
+			func(bvh);
+			auto end = std::chrono::high_resolution_clock::now();
+			ret.bestMs = std::min(ret.bestMs, std::chrono::duration<double, std::milli>(end - start).count());
+			ret.sahCost = bvh.ComputeSahCost();
+			ret.nodeCount = bvh.GetNodes().size();
+			ret.refCount = bvh.GetPrimIndices().size();
+		}
+		return ret;
+	}
+
+	void PrintResult(const char* builder, uint32_t threads, const BuildResult& res, double singleThreadMs)
+	{
+		printf("  %-12s %7u %10.2f %8.2fx %10.2f %9zu %9zu\n",
+			builder, threads, res.bestMs, singleThreadMs / res.bestMs, res.sahCost, res.nodeCount, res.refCount);
+	}
+}
+
+int RunBvhBuildBenchmark(const BenchmarkOptions& opt)
+{
+	auto files = FindMeshFiles(opt.homeDir);
+	if (files.empty())
+	{
+		printf("Error: no mesh files found.\n");
+		return -1;
+	}
+	auto threadCounts = GetThreadCountSweep(opt.threadCount);
+
+	for (auto&& file : files)
+	{
+		CpuMesh mesh;
+		if (!mesh.Initialize(file))
+		{
+			continue;
+		}
+
+		// triangles decoded the same way as vertex_factory.hlsli.
+		auto&& triangles = mesh.GetTriangles();
+		std::vector<Aabb> primBounds(triangles.size());
+		std::vector<Vec3> triVertices(triangles.size() * 3);
+		for (size_t i = 0; i < triangles.size(); i++)
+		{
+			auto&& tri = triangles[i];
+			triVertices[i * 3 + 0] = tri.v0;
+			triVertices[i * 3 + 1] = tri.v0 + tri.e1;
+			triVertices[i * 3 + 2] = tri.v0 + tri.e2;
+			for (int v = 0; v < 3; v++)
+			{
+				primBounds[i].Grow(triVertices[i * 3 + v]);
+			}
+		}
+
+		printf("mesh: %s (%zu triangles)\n", GetFileName(file).c_str(), triangles.size());
+		printf("  %-12s %7s %10s %9s %10s %9s %9s\n", "builder", "threads", "build ms", "speedup", "sah cost", "nodes", "refs");
+
+		auto median = MeasureBuild(opt.repeatCount, [&](Bvh& bvh) { bvh.Build(primBounds); });
+		PrintResult("median", 1, median, median.bestMs);
+
+		for (int spatial = 0; spatial < 2; spatial++)
+		{
+			double singleThreadMs = 0.0;
+			for (auto threads : threadCounts)
+			{
+				BvhBuildSettings settings;
+				settings.threadCount = threads;
+				settings.bSpatialSplits = spatial != 0;
+				auto res = MeasureBuild(opt.repeatCount, [&](Bvh& bvh) { bvh.BuildSAH(primBounds, settings, &triVertices); });
+				if (threads == 1)
+				{
+					singleThreadMs = res.bestMs;
+				}
+				PrintResult(spatial ? "sah+spatial" : "sah", threads, res, singleThreadMs);
+			}
+		}
+	}
+	return 0;
+}
+
+//	EOF
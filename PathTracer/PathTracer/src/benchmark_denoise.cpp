@@ -0,0 +1,407 @@
+#include "benchmark.h"
+#include "denoiser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock	Clock;
+
+	struct Resolution
+	{
+		uint32_t	width, height;
+	};
+	static const Resolution kResolutions[] = {
+		{ 1920, 1080 },
+		{ 2560, 1440 },
+	};
+
+	// the preferred type wins, the cpu is the fallback, nothing else is.
+	bool ValidateDeviceSelection()
+	{
+		typedef DenoiserDeviceType T;
+		struct Case
+		{
+			std::vector<T>	devices;
+			T				preferred;
+			int				expected;
+		};
+		const Case cases[] = {
+			{ { T::CUDA, T::CPU }, T::CUDA, 0 },
+			{ { T::CPU, T::CUDA }, T::CUDA, 1 },
+			{ { T::SYCL, T::CPU }, T::CUDA, 1 },
+			{ { T::CPU }, T::CUDA, 0 },
+			{ { T::SYCL, T::HIP }, T::CUDA, -1 },
+			{ {}, T::CUDA, -1 },
+		};
+		bool bValid = true;
+		for (auto&& c : cases)
+		{
+			bValid = bValid && SelectDenoiserDevice(c.devices, c.preferred) == c.expected;
+		}
+		return bValid;
+	}
+
+#if ENABLE_OIDN
+	// a smooth image with per pixel noise, like a 1 spp frame.
+	void GenerateImages(oidn::DeviceRef& device, uint32_t width, uint32_t height, DenoiseImages* pImages)
+	{
+		size_t pixelCount = (size_t)width * height;
+		std::vector<float> color(pixelCount * 3), albedo(pixelCount * 3), normal(pixelCount * 3);
+		std::mt19937 rnd(0);
+		std::uniform_real_distribution<float> noise(0.0f, 2.0f);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				size_t i = ((size_t)y * width + x) * 3;
+				float u = (float)x / (float)width, v = (float)y / (float)height;
+				float a[3] = { 0.2f + 0.6f * u, 0.5f, 0.2f + 0.6f * v };
+				float n[3] = { std::sin(u * 6.0f), std::cos(v * 6.0f), 1.0f };
+				float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				for (int c = 0; c < 3; c++)
+				{
+					albedo[i + c] = a[c];
+					normal[i + c] = n[c] / len;
+					color[i + c] = a[c] * noise(rnd);
+				}
+			}
+		}
+		size_t size = pixelCount * sizeof(float) * 3;
+		pImages->color = device.newBuffer(size);
+		pImages->albedo = device.newBuffer(size);
+		pImages->normal = device.newBuffer(size);
+		pImages->output = device.newBuffer(size);
+		pImages->color.write(0, size, color.data());
+		pImages->albedo.write(0, size, albedo.data());
+		pImages->normal.write(0, size, normal.data());
+	}
+
+	// what ExecuteDenoise() did every frame.
+	bool DenoiseCold(oidn::DeviceRef& device, const DenoiseFilterKey& key, const DenoiseImages& images)
+	{
+		oidn::FilterRef filter = device.newFilter("RT");
+		filter.setImage("color", images.color, oidn::Format::Float3, key.width, key.height);
+		filter.setImage("albedo", images.albedo, oidn::Format::Float3, key.width, key.height);
+		filter.setImage("normal", images.normal, oidn::Format::Float3, key.width, key.height);
+		filter.setImage("output", images.output, oidn::Format::Float3, key.width, key.height);
+		filter.set("hdr", key.bHdr);
+		filter.set("cleanAux", key.bCleanAux);
+		filter.set("quality", (oidn::Quality)key.quality);
+		filter.commit();
+		filter.execute();
+		const char* errorMsg = nullptr;
+		return device.getError(errorMsg) == oidn::Error::None;
+	}
+
+	// prefilters albedo and normal into temporary images, then denoises with them.
+	bool DenoisePrefilteredCold(oidn::DeviceRef& device, const DenoiseFilterKey& key, const DenoiseImages& images)
+	{
+		DenoiseImages prefiltered = images;
+		prefiltered.albedo = device.newBuffer(images.albedo.getSize());
+		prefiltered.normal = device.newBuffer(images.normal.getSize());
+		const char* names[] = { "albedo", "normal" };
+		const oidn::BufferRef* srcs[] = { &images.albedo, &images.normal };
+		oidn::BufferRef* dsts[] = { &prefiltered.albedo, &prefiltered.normal };
+		for (int i = 0; i < 2; i++)
+		{
+			oidn::FilterRef filter = device.newFilter("RT");
+			filter.setImage(names[i], *srcs[i], oidn::Format::Float3, key.width, key.height);
+			filter.setImage("output", *dsts[i], oidn::Format::Float3, key.width, key.height);
+			filter.set("quality", (oidn::Quality)key.quality);
+			filter.commit();
+			filter.execute();
+		}
+		return DenoiseCold(device, key, prefiltered);
+	}
+
+	float MaxDifference(const oidn::BufferRef& a, const oidn::BufferRef& b)
+	{
+		auto pA = static_cast<const float*>(a.getData());
+		auto pB = static_cast<const float*>(b.getData());
+		float ret = 0.0f;
+		for (size_t i = 0; i < a.getSize() / sizeof(float); i++)
+		{
+			ret = std::max(ret, std::fabs(pA[i] - pB[i]));
+		}
+		return ret;
+	}
+
+	double ElapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// the gpu trace of a frame, it writes the color of the slot and leaves the cpu free.
+	void TraceFrame(const std::vector<float>& baseColor, uint64_t frameIndex, double traceMs, oidn::BufferRef& color)
+	{
+		auto start = Clock::now();
+		auto p = static_cast<float*>(color.getData());
+		float scale = 1.0f + 0.1f * (float)(frameIndex % 8);
+		for (size_t i = 0; i < baseColor.size(); i++)
+		{
+			p[i] = baseColor[i] * scale;
+		}
+		double rest = traceMs - ElapsedMs(start);
+		if (rest > 0.0)
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(rest));
+		}
+	}
+
+	std::vector<float> ReadImage(const oidn::BufferRef& buffer)
+	{
+		auto p = static_cast<const float*>(buffer.getData());
+		return std::vector<float>(p, p + buffer.getSize() / sizeof(float));
+	}
+#endif
+}
+
+
+int RunDenoiseBenchmark(const BenchmarkOptions& opt)
+{
+	bool bValid = ValidateDeviceSelection();
+	printf("device selection prefers the requested type, then the cpu: %s\n", bValid ? "yes" : "NO");
+
+#if !ENABLE_OIDN
+	(void)opt;
+	printf("denoise timing skipped, built without OpenImageDenoise. (-DENABLE_OIDN=1 -lOpenImageDenoise)\n");
+	return bValid ? 0 : -1;
+#else
+	Denoiser denoiser;
+	if (!denoiser.Initialize(DenoiserDeviceType::CPU))
+	{
+		return -1;
+	}
+	printf("device: %s\n", GetDenoiserDeviceTypeName(denoiser.GetDeviceType()));
+
+	// cold: a new filter every frame. cached: the first frame commits, the rest only execute.
+	int frameCount = std::max(opt.repeatCount, 1) + 1;
+	printf("  %-10s %6s %10s %12s %12s %9s %9s\n", "resolution", "frames", "cold ms", "cached 1st", "cached ms", "speedup", "max diff");
+	std::vector<DenoiseFilterKey> keys;
+	for (auto&& res : kResolutions)
+	{
+		DenoiseFilterKey key;
+		key.width = res.width;
+		key.height = res.height;
+		keys.push_back(key);
+
+		DenoiseImages cold, cached;
+		GenerateImages(denoiser.GetDevice(), res.width, res.height, &cold);
+		cached = cold;
+		cached.output = denoiser.GetDevice().newBuffer(cold.output.getSize());
+
+		double coldMs = 0.0, firstMs = 0.0, cachedMs = 0.0;
+		for (int f = 0; f < frameCount; f++)
+		{
+			auto start = Clock::now();
+			bValid = DenoiseCold(denoiser.GetDevice(), key, cold) && bValid;
+			coldMs += ElapsedMs(start);
+
+			start = Clock::now();
+			bValid = denoiser.Execute(key, cached) && bValid;
+			(f == 0 ? firstMs : cachedMs) += ElapsedMs(start);
+		}
+		coldMs /= frameCount;
+		cachedMs /= std::max(frameCount - 1, 1);
+		float diff = MaxDifference(cold.output, cached.output);
+		bValid = bValid && diff <= 1e-5f;
+		printf("  %4ux%-5u %6d %10.2f %12.2f %12.2f %8.2fx %9.2g\n",
+			res.width, res.height, frameCount, coldMs, firstMs, cachedMs, coldMs / cachedMs, diff);
+	}
+
+	// both resolutions stay cached, new images or a new key evict the least recently used filter.
+	auto stats = denoiser.GetStats();
+	bool bCache = stats.createCount == keys.size() && stats.evictCount == 0 && stats.executeCount == keys.size() * frameCount;
+	{
+		DenoiseImages images;
+		GenerateImages(denoiser.GetDevice(), keys[0].width, keys[0].height, &images);
+		bCache = bCache && denoiser.Execute(keys[0], images) && denoiser.GetStats().createCount == keys.size() + 1 && denoiser.GetStats().evictCount == 1;
+		auto key = keys[0];
+		key.quality = DenoiseQuality::High;
+		bCache = bCache && denoiser.Execute(key, images) && denoiser.GetStats().evictCount == 2 && denoiser.GetFilterCount() == Denoiser::kMaxFilterCount;
+	}
+	bValid = bValid && bCache;
+	printf("filters: %u created, %u evicted, %u executed\n",
+		denoiser.GetStats().createCount, denoiser.GetStats().evictCount, denoiser.GetStats().executeCount);
+	printf("cached filters match per frame filters and stay committed: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+#endif
+}
+
+int RunAsyncDenoiseBenchmark(const BenchmarkOptions& /*opt*/)
+{
+#if !ENABLE_OIDN
+	printf("async denoise skipped, built without OpenImageDenoise. (-DENABLE_OIDN=1 -lOpenImageDenoise)\n");
+	return 0;
+#else
+	static const uint32_t kWidth = 640;
+	static const uint32_t kHeight = 360;
+	static const uint64_t kFrameCount = 16;
+
+	Denoiser denoiser;
+	if (!denoiser.Initialize(DenoiserDeviceType::CPU))
+	{
+		return -1;
+	}
+	DenoiseFilterKey key;
+	key.width = kWidth;
+	key.height = kHeight;
+
+	// ping-pong images, the trace writes one slot while the other denoises.
+	DenoiseImages slots[AsyncDenoiser::kSlotCount];
+	for (auto&& images : slots)
+	{
+		GenerateImages(denoiser.GetDevice(), kWidth, kHeight, &images);
+	}
+	std::vector<float> baseColor = ReadImage(slots[0].color);
+
+	// the trace takes as long as a warm denoise, the case that gains the most.
+	bool bValid = denoiser.Execute(key, slots[0]) && denoiser.Execute(key, slots[1]);
+	auto start = Clock::now();
+	bValid = denoiser.Execute(key, slots[0]) && bValid;
+	double traceMs = ElapsedMs(start);
+
+	// sync: trace, then denoise on the same thread.
+	std::vector<std::vector<float>> syncOutputs(kFrameCount);
+	start = Clock::now();
+	for (uint64_t f = 0; f < kFrameCount; f++)
+	{
+		auto&& images = slots[f % AsyncDenoiser::kSlotCount];
+		TraceFrame(baseColor, f, traceMs, images.color);
+		bValid = denoiser.Execute(key, images) && bValid;
+		syncOutputs[f] = ReadImage(images.output);
+	}
+	double syncMs = ElapsedMs(start) / (double)kFrameCount;
+
+	// async: frame f waits for the denoise of f - 2 in its slot, traces, then queues its own denoise.
+	std::vector<std::vector<float>> asyncOutputs(kFrameCount);
+	AsyncDenoiser async;
+	async.Initialize(&denoiser);
+	uint64_t latencyFrames = 0;
+	double waitMs = 0.0;
+	start = Clock::now();
+	for (uint64_t f = 0; f < kFrameCount; f++)
+	{
+		uint32_t slot = (uint32_t)(f % AsyncDenoiser::kSlotCount);
+		bValid = async.Wait(slot, f) && bValid;
+		if (f >= AsyncDenoiser::kSlotCount)
+		{
+			asyncOutputs[f - AsyncDenoiser::kSlotCount] = ReadImage(slots[slot].output);
+			latencyFrames = async.GetStats().latencyFrames;
+			waitMs += async.GetStats().waitMs;
+		}
+		TraceFrame(baseColor, f, traceMs, slots[slot].color);
+		bValid = async.Submit(slot, key, slots[slot], f) && bValid;
+	}
+	double asyncMs = ElapsedMs(start) / (double)kFrameCount;
+	for (uint64_t f = kFrameCount; f < kFrameCount + AsyncDenoiser::kSlotCount; f++)
+	{
+		uint32_t slot = (uint32_t)(f % AsyncDenoiser::kSlotCount);
+		bValid = async.Wait(slot, f) && bValid;
+		asyncOutputs[f - AsyncDenoiser::kSlotCount] = ReadImage(slots[slot].output);
+	}
+	auto stats = async.GetStats();
+	async.Destroy();
+
+	bool bSame = asyncOutputs == syncOutputs;
+	bValid = bValid && bSame && stats.jobCount == kFrameCount && latencyFrames == AsyncDenoiser::kSlotCount;
+	printf("%ux%u, %llu frames, trace %.2f ms, denoise %.2f ms, device %s\n", kWidth, kHeight, (unsigned long long)kFrameCount,
+		traceMs, stats.denoiseMs, GetDenoiserDeviceTypeName(denoiser.GetDeviceType()));
+	printf("  %-6s %10s %10s %9s %14s\n", "mode", "frame ms", "speedup", "latency", "wait ms/frame");
+	printf("  %-6s %10.2f %9.2fx %9d %14s\n", "sync", syncMs, 1.0, 1, "-");
+	printf("  %-6s %10.2f %9.2fx %9llu %14.2f\n", "async", asyncMs, syncMs / asyncMs, (unsigned long long)latencyFrames,
+		waitMs / (double)(kFrameCount - AsyncDenoiser::kSlotCount));
+	printf("  filters: %zu, every frame denoised the same as sync: %s\n", stats.filterCount, bSame ? "yes" : "NO");
+	printf("async denoise overlaps the trace of the next frame: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+#endif
+}
+
+int RunPrefilterDenoiseBenchmark(const BenchmarkOptions& opt)
+{
+#if !ENABLE_OIDN
+	(void)opt;
+	printf("denoise prefilter skipped, built without OpenImageDenoise. (-DENABLE_OIDN=1 -lOpenImageDenoise)\n");
+	return 0;
+#else
+	Denoiser denoiser;
+	if (!denoiser.Initialize(DenoiserDeviceType::CPU))
+	{
+		return -1;
+	}
+	printf("device: %s\n", GetDenoiserDeviceTypeName(denoiser.GetDeviceType()));
+
+	// every frame: the aux version is unknown, so albedo and normal prefilter each frame.
+	// cached: the version stays, only the first frame prefilters.
+	int frameCount = std::max(opt.repeatCount, 1) + 1;
+	printf("  %-10s %6s %12s %10s %10s %12s %9s\n", "resolution", "frames", "every ms", "cached ms", "saved ms", "prefilter ms", "max diff");
+	bool bValid = true;
+	for (auto&& res : kResolutions)
+	{
+		denoiser.ClearFilters();
+		DenoiseFilterKey key;
+		key.width = res.width;
+		key.height = res.height;
+		key.bCleanAux = true;
+		key.bPrefilterAux = true;
+
+		DenoiseImages every, cached, reference;
+		GenerateImages(denoiser.GetDevice(), res.width, res.height, &every);
+		cached = reference = every;
+		cached.output = denoiser.GetDevice().newBuffer(every.output.getSize());
+		reference.output = denoiser.GetDevice().newBuffer(every.output.getSize());
+		every.auxVersion = 0;
+		cached.auxVersion = 1;
+
+		auto before = denoiser.GetStats();
+		double everyMs = 0.0, cachedMs = 0.0;
+		for (int f = 0; f < frameCount; f++)
+		{
+			auto start = Clock::now();
+			bValid = denoiser.Execute(key, every) && bValid;
+			everyMs += ElapsedMs(start);
+
+			start = Clock::now();
+			bValid = denoiser.Execute(key, cached) && bValid;
+			cachedMs += (f == 0) ? 0.0 : ElapsedMs(start);
+		}
+		everyMs /= frameCount;
+		cachedMs /= std::max(frameCount - 1, 1);
+		double prefilterMs = denoiser.GetStats().prefilterMs;
+		bValid = DenoisePrefilteredCold(denoiser.GetDevice(), key, reference) && bValid;
+		float diff = std::max(MaxDifference(reference.output, every.output), MaxDifference(reference.output, cached.output));
+
+		// each frame of every and the first cached frame prefilter, the rest reuse.
+		auto stats = denoiser.GetStats();
+		bool bCounts = stats.prefilterCount - before.prefilterCount == (uint32_t)frameCount + 1
+			&& stats.prefilterSkipCount - before.prefilterSkipCount == (uint32_t)frameCount - 1;
+
+		// a new version after the albedo changed prefilters again and matches a fresh denoise.
+		auto pAlbedo = static_cast<float*>(cached.albedo.getData());
+		for (size_t i = 0; i < cached.albedo.getSize() / sizeof(float); i++)
+		{
+			pAlbedo[i] = 1.0f - pAlbedo[i];
+		}
+		cached.auxVersion++;
+		bValid = denoiser.Execute(key, cached) && DenoisePrefilteredCold(denoiser.GetDevice(), key, reference) && bValid;
+		diff = std::max(diff, MaxDifference(reference.output, cached.output));
+		bCounts = bCounts && denoiser.GetStats().prefilterCount == stats.prefilterCount + 1;
+
+		bValid = bValid && bCounts && diff <= 1e-5f;
+		printf("  %4ux%-5u %6d %12.2f %10.2f %10.2f %12.2f %9.2g\n",
+			res.width, res.height, frameCount, everyMs, cachedMs, everyMs - cachedMs, prefilterMs, diff);
+	}
+	printf("prefilters: %u executed, %u reused\n", denoiser.GetStats().prefilterCount, denoiser.GetStats().prefilterSkipCount);
+	printf("prefiltered aux is reused until its version changes: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+#endif
+}
+
+//	EOF
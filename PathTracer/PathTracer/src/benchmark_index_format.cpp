@@ -0,0 +1,183 @@
+#include "benchmark.h"
+#include "mapped_file.h"
+#include "rmesh_reader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock	Clock;
+
+	// decoded streams with the 32 bit indices of the file.
+	bool LoadRMesh32(const std::string& filePath, RMesh* pOut)
+	{
+		MappedFile mf;
+		RMeshView view;
+		if (!mf.Open(filePath) || !ParseRMeshView(mf.GetData(), mf.GetSize(), &view))
+		{
+			return false;
+		}
+		std::vector<uint8_t>* streams[] = {
+			&pOut->position, &pOut->normal, &pOut->tangent, &pOut->texcoord,
+			&pOut->index, &pOut->meshletPackedPrimitive, &pOut->meshletVertexIndex,
+		};
+		uint8_t* pDst[kRMeshStreamMax];
+		for (int s = 0; s < kRMeshStreamMax; s++)
+		{
+			streams[s]->resize(view.streams[s].GetPackedSize());
+			pDst[s] = streams[s]->data();
+		}
+		DecodeRMeshStreams(view, pDst, 1);
+		pOut->materials = view.materials;
+		pOut->submeshes = view.submeshes;
+		pOut->positionScale = view.positionScale;
+		pOut->positionOffset = view.positionOffset;
+		return true;
+	}
+
+	// 16 bit ranges are padded to 4 bytes.
+	uint32_t AlignIndexBytes(uint32_t bytes)
+	{
+		return (bytes + 3) & ~3u;
+	}
+
+	// every triangle of the compacted mesh through GetVertexIndices() against GetVertexIndices32() of the source.
+	bool IsSameTriangles(const RMesh& source, const RMesh& compact)
+	{
+		if (source.submeshes.size() != compact.submeshes.size())
+		{
+			return false;
+		}
+		for (size_t s = 0; s < source.submeshes.size(); s++)
+		{
+			auto&& src = source.submeshes[s];
+			auto&& dst = compact.submeshes[s];
+			uint32_t stride = (dst.indexFormat == kRMeshIndex16) ? RMesh::kIndex16Stride : RMesh::kIndexStride;
+			if (dst.indexOffsetBytes % 4 != 0 || dst.indexOffsetBytes + (size_t)AlignIndexBytes(dst.indexCount * stride) > compact.index.size())
+			{
+				return false;
+			}
+			for (uint32_t t = 0; t < src.indexCount / 3; t++)
+			{
+				uint32_t a[3], b[3];
+				GetVertexIndices32(source.index.data(), src.indexOffsetBytes, t, a);
+				GetVertexIndices(compact.index.data(), dst.indexOffsetBytes, dst.indexFormat, t, b);
+				if (a[0] != b[0] || a[1] != b[1] || a[2] != b[2])
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// submeshes around the 16 bit limit, with odd and even triangle counts.
+	bool TestLimits()
+	{
+		RMesh mesh;
+		const uint32_t kVertexCounts[] = { 3, 0xffff, 0x10000, 7 };
+		const uint32_t kTriangleCounts[] = { 1, 5, 4, 3 };
+		uint32_t indexOffset = 0;
+		for (int s = 0; s < 4; s++)
+		{
+			RMeshSubmesh submesh = {};
+			submesh.vertexCount = kVertexCounts[s];
+			submesh.indexOffset = indexOffset;
+			submesh.indexCount = kTriangleCounts[s] * 3;
+			submesh.indexOffsetBytes = indexOffset * RMesh::kIndexStride;
+			submesh.indexFormat = kRMeshIndex32;
+			for (uint32_t i = 0; i < submesh.indexCount; i++)
+			{
+				// the largest index of the submesh comes first.
+				uint32_t v = (kVertexCounts[s] - 1 - i * 7919) % kVertexCounts[s];
+				mesh.index.insert(mesh.index.end(), (const uint8_t*)&v, (const uint8_t*)&v + sizeof(v));
+			}
+			indexOffset += submesh.indexCount;
+			mesh.submeshes.push_back(submesh);
+		}
+		RMesh source = mesh;
+		CompactRMeshIndices(&mesh);
+		return mesh.submeshes[0].indexFormat == kRMeshIndex16 && mesh.submeshes[1].indexFormat == kRMeshIndex16
+			&& mesh.submeshes[2].indexFormat == kRMeshIndex32 && mesh.submeshes[3].indexFormat == kRMeshIndex16
+			&& IsSameTriangles(source, mesh);
+	}
+
+	// fetches every triangle once, the index bytes read are what the hit shaders read.
+	double MeasureFetch(const RMesh& mesh, int repeatCount, uint64_t* pChecksum)
+	{
+		double bestMs = 1e30;
+		for (int r = 0; r < repeatCount; r++)
+		{
+			uint64_t sum = 0;
+			auto start = Clock::now();
+			for (auto&& submesh : mesh.submeshes)
+			{
+				for (uint32_t t = 0; t < submesh.indexCount / 3; t++)
+				{
+					uint32_t idx[3];
+					mesh.GetTriangle(submesh, t, idx);
+					sum += idx[0] + idx[1] * 3 + idx[2] * 7;
+				}
+			}
+			bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+			*pChecksum = sum;
+		}
+		return bestMs;
+	}
+}
+
+int RunIndexFormatBenchmark(const BenchmarkOptions& opt)
+{
+	auto files = FindMeshFiles(opt.homeDir);
+	if (files.empty())
+	{
+		printf("Error: no mesh found.\n");
+		return -1;
+	}
+	int repeatCount = std::max(opt.repeatCount, 1);
+
+	bool bValid = TestLimits();
+	printf("16 bit limit and alignment: %s\n\n", bValid ? "ok" : "FAILED");
+
+	printf("  %-20s %10s %10s %10s %10s %8s %10s %10s %6s\n",
+		"mesh", "submeshes", "16 bit", "u32 KB", "packed KB", "saved", "u32 ms", "packed ms", "same");
+	size_t totalSource = 0, totalCompact = 0;
+	for (auto&& file : files)
+	{
+		RMesh source, compact;
+		if (!LoadRMesh32(file, &source) || !LoadRMesh(file, &compact, 1))
+		{
+			bValid = false;
+			continue;
+		}
+		uint32_t count16 = 0;
+		for (auto&& submesh : compact.submeshes)
+		{
+			count16 += (submesh.indexFormat == kRMeshIndex16) ? 1 : 0;
+		}
+
+		uint64_t sourceSum = 0, compactSum = 0;
+		double sourceMs = MeasureFetch(source, repeatCount, &sourceSum);
+		double compactMs = MeasureFetch(compact, repeatCount, &compactSum);
+		bool bSame = IsSameTriangles(source, compact) && sourceSum == compactSum;
+		bValid = bValid && bSame;
+		totalSource += source.index.size();
+		totalCompact += compact.index.size();
+		printf("  %-20s %10u %10u %10.1f %10.1f %7.1f%% %10.3f %10.3f %6s\n",
+			GetFileName(file).c_str(), (uint32_t)compact.submeshes.size(), count16,
+			source.index.size() / 1024.0, compact.index.size() / 1024.0,
+			source.index.empty() ? 0.0 : 100.0 * (1.0 - (double)compact.index.size() / source.index.size()),
+			sourceMs, compactMs, bSame ? "yes" : "no");
+	}
+	printf("index memory: %.1f KB -> %.1f KB, %.1f KB saved\n",
+		totalSource / 1024.0, totalCompact / 1024.0, (totalSource - totalCompact) / 1024.0);
+	printf("the saving is on the cpu meshes only, the app uploads the 32 bit index stream through sl12.\n");
+
+	printf("16 bit indices decode to the same triangles: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+}
+
+//	EOF
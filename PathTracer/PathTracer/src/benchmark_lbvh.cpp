@@ -0,0 +1,143 @@
+#include "benchmark.h"
+#include "cpu_lbvh.h"
+#include "rmesh_reader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+
+namespace
+{
+	static const uint32_t kMinInstanceCount = 1 << 10;
+	static const uint32_t kMaxInstanceCount = 1 << 20;
+	// same spacing as the meshType 0 grid of SampleApplication.
+	static const float kMeshInter = 100.0f;
+
+	// world bounds of a square grid of randomly rotated instances,
+	// same transform and bounding box as SampleApplication::ComputeSceneAABB().
+	std::vector<Aabb> GenerateInstanceBounds(const Aabb& localBounds, uint32_t instanceCount)
+	{
+		uint32_t width = (uint32_t)std::ceil(std::sqrt((double)instanceCount));
+		float origin = -(float)(width - 1) * kMeshInter * 0.5f;
+		std::mt19937 rnd(0);
+		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+		std::vector<Aabb> ret(instanceCount);
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			Vec3 pos(origin + (i % width) * kMeshInter, dist(rnd) * 200.0f - 100.0f, origin + (i / width) * kMeshInter);
+			float pitch = (dist(rnd) * 2.0f - 1.0f) * kCpuPI;
+			float yaw = (dist(rnd) * 2.0f - 1.0f) * kCpuPI;
+			float roll = (dist(rnd) * 2.0f - 1.0f) * kCpuPI;
+			auto mat = MatrixMultiply(MatrixRotationRollPitchYaw(pitch, yaw, roll), MatrixTranslation(pos.x, pos.y, pos.z));
+			ret[i] = TransformAabb(localBounds, mat);
+		}
+		return ret;
+	}
+
+	// every primitive is referenced once and every inner node contains its children.
+	bool ValidateBvh(const Bvh& bvh, size_t primCount)
+	{
+		auto&& nodes = bvh.GetNodes();
+		auto&& primIndices = bvh.GetPrimIndices();
+		std::vector<uint8_t> referenced(primCount, 0);
+		for (auto&& prim : primIndices)
+		{
+			if (prim >= primCount || referenced[prim]++)
+			{
+				return false;
+			}
+		}
+		for (auto&& node : nodes)
+		{
+			if (node.IsLeaf())
+			{
+				continue;
+			}
+			for (uint32_t c = 0; c < 2; c++)
+			{
+				auto&& child = nodes[node.leftFirst + c];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					if (child.bmin[axis] < node.bmin[axis] || child.bmax[axis] > node.bmax[axis])
+					{
+						return false;
+					}
+				}
+			}
+		}
+		return primIndices.size() == primCount;
+	}
+}
+
+int RunLbvhBenchmark(const BenchmarkOptions& opt)
+{
+	// instances of hp_suzanne if it exists, same as meshType 0.
+	auto files = FindMeshFiles(opt.homeDir);
+	Aabb localBounds(Vec3(-1.0f), Vec3(1.0f));
+	std::string meshName = "unit box";
+	for (auto&& file : files)
+	{
+		RMesh mesh;
+		if (file.find("suzanne") != std::string::npos && LoadRMesh(file, &mesh))
+		{
+			localBounds = mesh.bounding.GetBox();
+			meshName = GetFileName(file);
+			break;
+		}
+	}
+	auto threadCounts = GetThreadCountSweep(opt.threadCount);
+
+	printf("instance: %s\n", meshName.c_str());
+	printf("  %-9s %-6s %7s %10s %9s %9s %8s %8s %8s %8s %8s %9s %6s\n",
+		"instances", "builder", "threads", "build ms", "Minst/s", "speedup",
+		"bounds", "morton", "sort", "emit", "refit", "sah cost", "valid");
+	for (uint32_t instanceCount = kMinInstanceCount; instanceCount <= kMaxInstanceCount; instanceCount *= 4)
+	{
+		auto instBounds = GenerateInstanceBounds(localBounds, instanceCount);
+
+		LbvhBuilder builder;
+		double singleThreadMs = 0.0;
+		for (auto threads : threadCounts)
+		{
+			Bvh bvh;
+			double bestMs = 1e30;
+			LbvhBuildTimings best;
+			for (int r = 0; r < std::max(opt.repeatCount, 1); r++)
+			{
+				builder.Build(instBounds, threads, &bvh);
+				if (builder.GetTimings().totalMs < bestMs)
+				{
+					bestMs = builder.GetTimings().totalMs;
+					best = builder.GetTimings();
+				}
+			}
+			if (threads == 1)
+			{
+				singleThreadMs = bestMs;
+			}
+			printf("  %-9u %-6s %7u %10.3f %9.2f %8.2fx %8.3f %8.3f %8.3f %8.3f %8.3f %9.2f %6s\n",
+				instanceCount, "lbvh", threads, bestMs, instanceCount / bestMs * 1e-3, singleThreadMs / bestMs,
+				best.boundsMs, best.mortonMs, best.sortMs, best.emitMs, best.refitMs,
+				bvh.ComputeSahCost(), ValidateBvh(bvh, instanceCount) ? "yes" : "no");
+		}
+
+		// binned sah with all threads as the quality and speed reference.
+		{
+			BvhBuildSettings settings;
+			settings.threadCount = threadCounts.back();
+			settings.maxLeafSize = 1;
+			Bvh bvh;
+			auto start = std::chrono::high_resolution_clock::now();
+			bvh.BuildSAH(instBounds, settings);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			printf("  %-9u %-6s %7u %10.3f %9.2f %9s %8s %8s %8s %8s %8s %9.2f %6s\n",
+				instanceCount, "sah", settings.threadCount, ms, instanceCount / ms * 1e-3, "-",
+				"-", "-", "-", "-", "-", bvh.ComputeSahCost(), ValidateBvh(bvh, instanceCount) ? "yes" : "no");
+		}
+	}
+	return 0;
+}
+
+//	EOF
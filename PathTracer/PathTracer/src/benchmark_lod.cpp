@@ -0,0 +1,307 @@
+#include "benchmark.h"
+#include "cpu_path_tracer.h"
+#include "headless.h"
+#include "rmesh_lod.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+#ifndef USE_IN_CPP
+#	define USE_IN_CPP
+#endif
+#include "../shaders/cbuffer.hlsli"
+
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock	Clock;
+
+	static const int kGridWidth = 12;
+	static const float kGridInter = 100.0f;
+	static const uint32_t kRayCount = 1 << 16;
+	static const uint32_t kWidth = 320;
+	static const uint32_t kHeight = 180;
+	static const int kSampleCount = 2;
+	static const int kDepth = 4;
+	static const uint32_t kErrorTile = 16;
+	// error budget of a lod depth against full detail, relative to the mean of the reference.
+	// pixel rmse is mostly the noise of decorrelated paths at this sample count, it is reported only.
+	static const double kTileRmseBudget = 0.05;
+	static const double kBiasBudget = 0.02;
+
+	// the mesh and the textures it names, so that the lod files can be written next to it.
+	bool CopyMesh(const std::filesystem::path& srcPath, const std::filesystem::path& dstDir, std::string* pDstPath)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(dstDir, ec);
+		RMesh mesh;
+		if (ec || !LoadRMesh(srcPath.string(), &mesh, 1))
+		{
+			return false;
+		}
+		for (auto&& mat : mesh.materials)
+		{
+			for (auto&& tex : mat.textureNames)
+			{
+				if (!tex.empty() && std::filesystem::exists(srcPath.parent_path() / tex, ec))
+				{
+					std::filesystem::copy_file(srcPath.parent_path() / tex, dstDir / tex, std::filesystem::copy_options::overwrite_existing, ec);
+				}
+			}
+		}
+		*pDstPath = (dstDir / srcPath.filename()).string();
+		std::filesystem::copy_file(srcPath, *pDstPath, std::filesystem::copy_options::overwrite_existing, ec);
+		return !ec;
+	}
+
+	// first bounce rays of the full detail scene, from the primary hits into the hemisphere of the normal.
+	void GenerateBounceRays(const CpuScene& scene, const SceneCB& cbScene, std::vector<CpuRay>* pRays)
+	{
+		std::mt19937 rnd(4);
+		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+		Vec3 eye(cbScene.eyePosition.x, cbScene.eyePosition.y, cbScene.eyePosition.z);
+		pRays->clear();
+		for (uint32_t i = 0; i < kRayCount * 4 && pRays->size() < kRayCount; i++)
+		{
+			Vec4 wp = Transform(Vec4(dist(rnd) * 2.0f - 1.0f, dist(rnd) * 2.0f - 1.0f, 1.0f, 1.0f), cbScene.mtxProjToWorld);
+			CpuRay ray;
+			ray.origin = eye;
+			ray.direction = Normalize(wp.xyz() * (1.0f / wp.w) - eye);
+			ray.tmin = 0.0f;
+			ray.tmax = FLT_MAX;
+			CpuHit hit;
+			if (!scene.TraceClosest(ray, &hit, GetLodRayMask(0, 0)))
+			{
+				continue;
+			}
+			auto&& inst = scene.GetInstances()[hit.instanceIndex];
+			auto&& mesh = *scene.GetMeshes()[inst.meshIndex];
+			Vec3 n = Normalize(TransformVector(mesh.GetNormal(hit.submeshIndex, hit.triIndex, hit.barycentrics), inst.mtxLocalToWorld));
+			n = (Dot(n, ray.direction) > 0.0f) ? n * -1.0f : n;
+
+			float z = dist(rnd) * 2.0f - 1.0f;
+			float phi = dist(rnd) * 2.0f * kCpuPI;
+			float s = std::sqrt(std::max(1.0f - z * z, 0.0f));
+			Vec3 d(std::cos(phi) * s, std::sin(phi) * s, z);
+			CpuRay bounce;
+			bounce.origin = ray.origin + ray.direction * hit.t + n * 1e-3f;
+			bounce.direction = (Dot(d, n) < 0.0f) ? d * -1.0f : d;
+			bounce.tmin = 0.0f;
+			bounce.tmax = 10000.0f;
+			pRays->push_back(bounce);
+		}
+	}
+
+	struct ImageError
+	{
+		double	pixelRmse = 0.0;
+		double	tileRmse = 0.0;
+		double	bias = 0.0;
+	};
+
+	// rgb difference to the reference, relative to its mean.
+	// paths that hit other points decorrelate from the reference, averages of kErrorTile pixels keep the bias and drop most of that noise.
+	ImageError CompareImages(const std::vector<float>& image, const std::vector<float>& reference)
+	{
+		uint32_t tilesX = kWidth / kErrorTile, tilesY = kHeight / kErrorTile;
+		std::vector<double> tileDiffs((size_t)tilesX * tilesY * 3, 0.0);
+		double sumSq = 0.0, sum = 0.0, sumRef = 0.0;
+		for (uint32_t y = 0; y < kHeight; y++)
+		{
+			for (uint32_t x = 0; x < kWidth; x++)
+			{
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					size_t i = ((size_t)y * kWidth + x) * 3 + c;
+					double d = (double)image[i] - (double)reference[i];
+					sumSq += d * d;
+					sum += image[i];
+					sumRef += reference[i];
+					if (x / kErrorTile < tilesX && y / kErrorTile < tilesY)
+					{
+						tileDiffs[((size_t)(y / kErrorTile) * tilesX + x / kErrorTile) * 3 + c] += d / (double)(kErrorTile * kErrorTile);
+					}
+				}
+			}
+		}
+		double tileSumSq = 0.0;
+		for (auto d : tileDiffs)
+		{
+			tileSumSq += d * d;
+		}
+		ImageError ret;
+		double meanRef = sumRef / (double)image.size();
+		if (meanRef > 0.0)
+		{
+			ret.pixelRmse = std::sqrt(sumSq / (double)image.size()) / meanRef;
+			ret.tileRmse = std::sqrt(tileSumSq / (double)tileDiffs.size()) / meanRef;
+			ret.bias = (sum - sumRef) / sumRef;
+		}
+		return ret;
+	}
+}
+
+int RunLodBenchmark(const BenchmarkOptions& opt)
+{
+	std::error_code ec;
+	std::filesystem::path tempDir = std::filesystem::temp_directory_path(ec) / "lod_bench";
+	std::filesystem::path srcPath = std::filesystem::path(opt.homeDir) / "resources/mesh/hp_suzanne/hp_suzanne.rmesh";
+	std::string meshPath;
+	if (ec || !CopyMesh(srcPath, tempDir, &meshPath))
+	{
+		printf("Error: cannot copy %s.\n", srcPath.string().c_str());
+		return -1;
+	}
+	int repeatCount = std::max(opt.repeatCount, 1);
+	bool bValid = true;
+
+	// lod chain, each level simplified from the source.
+	RMesh source;
+	if (!LoadRMesh(meshPath, &source, opt.threadCount))
+	{
+		return -1;
+	}
+	std::vector<RMesh> lods;
+	std::vector<RMeshLodStats> lodStats;
+	double buildMs = 1e30;
+	for (int r = 0; r < repeatCount; r++)
+	{
+		auto start = Clock::now();
+		bValid = BuildRMeshLods(source, RMeshLodSettings(), &lods, &lodStats) && bValid;
+		buildMs = std::min(buildMs, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+	float meshSize = Length(source.bounding.GetBox().Extent());
+	printf("  %s, %u triangles, lods built in %.2f ms\n", GetFileName(meshPath).c_str(), source.GetTotalTriangleCount(), buildMs);
+	printf("  %-5s %9s %9s %6s %12s\n", "lod", "tris", "vertices", "grid", "max error");
+	for (uint32_t level = 1; level <= (uint32_t)lods.size(); level++)
+	{
+		auto&& s = lodStats[level - 1];
+		printf("  %-5u %9u %9u %6u %11.2f%%\n", level, s.triangleCount, s.vertexCount, s.gridResolution, s.maxError / meshSize * 100.0);
+		bValid = WriteRMesh(GetRMeshLodPath(meshPath, level), lods[level - 1]) && bValid;
+	}
+
+	// a field of randomly rotated meshes, one instance per lod.
+	CpuScene scene;
+	auto chain = scene.AddMeshLods(meshPath, kLodLevelMax);
+	if (chain.size() != lods.size() + 1)
+	{
+		printf("Error: lod files do not load.\n");
+		return -1;
+	}
+	std::mt19937 rnd(0);
+	std::uniform_real_distribution<float> angle(-kCpuPI, kCpuPI);
+	for (int x = 0; x < kGridWidth; x++)
+	{
+		for (int y = 0; y < kGridWidth; y++)
+		{
+			float ox = ((float)x - (float)(kGridWidth - 1) * 0.5f) * kGridInter;
+			float oz = ((float)y - (float)(kGridWidth - 1) * 0.5f) * kGridInter;
+			auto mat = MatrixMultiply(MatrixRotationRollPitchYaw(angle(rnd), angle(rnd), angle(rnd)), MatrixTranslation(ox, 0.0f, oz));
+			scene.AddLodInstances(chain, mat);
+		}
+	}
+	BvhBuildSettings bvhSettings;
+	bvhSettings.threadCount = opt.threadCount;
+	scene.Build(bvhSettings);
+
+	SceneCB cbScene;
+	LightCB cbLight;
+	PathTraceCB cbPathTrace;
+	SetupBenchmarkConstants(scene.GetSceneAabb(), kWidth, kHeight, &cbScene, &cbLight, &cbPathTrace);
+	cbPathTrace.sampleCount = kSampleCount;
+	cbPathTrace.depthMax = kDepth;
+	CpuLodParams lod;
+	lod.rayTMin = scene.GetLodRayTMin();
+	printf("  lod ray tmin %.3f (%.2f%% of the mesh)\n", lod.rayTMin, lod.rayTMin / meshSize * 100.0f);
+
+	// traversal cost of first bounce rays against each lod, hits compared to full detail.
+	std::vector<CpuRay> rays;
+	GenerateBounceRays(scene, cbScene, &rays);
+	printf("\n  %u bounce rays, single thread\n", (uint32_t)rays.size());
+	printf("  %-5s %10s %10s %10s %10s %8s %10s\n", "lod", "nodes/ray", "prims/ray", "ns/ray", "hits", "speedup", "same hit");
+	std::vector<bool> fullHits;
+	double fullMs = 0.0;
+	for (uint32_t level = 0; level < (uint32_t)chain.size(); level++)
+	{
+		uint32_t rayMask = 1u << level;
+		float tmin = (level > 0) ? lod.rayTMin : 0.0f;
+		BvhTraversalStats stats;
+		std::vector<bool> hits(rays.size());
+		double ms = 1e30;
+		for (int r = 0; r < repeatCount; r++)
+		{
+			stats = BvhTraversalStats();
+			auto start = Clock::now();
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				CpuRay ray = rays[i];
+				ray.tmin = tmin;
+				CpuHit hit;
+				hits[i] = scene.TraceClosest(ray, &hit, rayMask, &stats);
+			}
+			ms = std::min(ms, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+		}
+		if (level == 0)
+		{
+			fullHits = hits;
+			fullMs = ms;
+		}
+		uint32_t hitCount = 0, sameCount = 0;
+		for (size_t i = 0; i < rays.size(); i++)
+		{
+			hitCount += hits[i] ? 1 : 0;
+			sameCount += (hits[i] == fullHits[i]) ? 1 : 0;
+		}
+		double n = (double)std::max<size_t>(rays.size(), 1);
+		printf("  %-5u %10.2f %10.2f %10.1f %10u %7.2fx %9.2f%%\n", level,
+			(double)stats.nodeVisits / n, (double)stats.primTests / n, ms * 1e6 / n,
+			hitCount, fullMs / ms, (double)sameCount / n * 100.0);
+	}
+
+	// PathTracerRGS with the lods from each depth, error against the full detail image of the same samples.
+	printf("\n  render %ux%u, spp %d, depth %d\n", kWidth, kHeight, kSampleCount, kDepth);
+	printf("  error budget: tile rmse %.1f%%, bias %.1f%%, asserted from lod depth %u on\n", kTileRmseBudget * 100.0, kBiasBudget * 100.0, kLodDepthMin);
+	printf("  %-9s %10s %10s %10s %8s %10s %10s %8s %7s\n", "lod depth", "ms", "rays", "Mrays/s", "speedup", "pixel rmse", "tile rmse", "bias", "budget");
+	size_t pixelCount = (size_t)kWidth * kHeight;
+	std::vector<float> reference;
+	double referenceMs = 0.0;
+	CpuPathTracer tracer;
+	for (uint32_t lodDepth = 0; lodDepth <= 2; lodDepth++)
+	{
+		lod.depth = lodDepth;
+		tracer.SetLod(lod);
+		std::vector<float> result(pixelCount * 3), albedo(pixelCount * 3), normal(pixelCount * 3);
+		CpuRenderStats best;
+		for (int r = 0; r < repeatCount; r++)
+		{
+			CpuRenderStats stats;
+			if (!tracer.Render(scene, cbScene, cbLight, cbPathTrace, kWidth, kHeight, result.data(), albedo.data(), normal.data(), opt.threadCount, &stats))
+			{
+				return -1;
+			}
+			best = (r == 0 || stats.elapsedMs < best.elapsedMs) ? stats : best;
+		}
+		if (lodDepth == 0)
+		{
+			reference = result;
+			referenceMs = best.elapsedMs;
+		}
+		ImageError err = CompareImages(result, reference);
+		bool bInBudget = std::isfinite(err.pixelRmse) && err.tileRmse <= kTileRmseBudget && std::fabs(err.bias) <= kBiasBudget;
+		bool bAsserted = (lodDepth == 0) || (lodDepth >= kLodDepthMin);
+		bValid = bValid && std::isfinite(err.pixelRmse) && (bInBudget || !bAsserted);
+		printf("  %-9u %10.2f %10llu %10.3f %7.2fx %9.2f%% %9.2f%% %7.2f%% %7s\n", lodDepth, best.elapsedMs, (unsigned long long)best.rayCount,
+			best.GetRaysPerSecond() * 1e-6, referenceMs / best.elapsedMs, err.pixelRmse * 100.0, err.tileRmse * 100.0, err.bias * 100.0,
+			bInBudget ? "ok" : (bAsserted ? "OVER" : "over"));
+	}
+
+	std::filesystem::remove_all(tempDir, ec);
+	printf("lod chain written, loaded and traced within the error budget: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+}
+
+//	EOF
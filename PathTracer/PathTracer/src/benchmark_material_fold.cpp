@@ -0,0 +1,160 @@
+#include "benchmark.h"
+#include "cpu_material_fold.h"
+#include "cpu_scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+
+namespace
+{
+	static const uint32_t kHitCount = 1 << 20;
+
+	struct ShadeHit
+	{
+		uint32_t	submeshIndex;
+		uint32_t	triIndex;
+		float		barycentrics[2];
+	};
+
+	struct ShadeResult
+	{
+		Vec4	baseColor;
+		Vec4	orm;
+	};
+
+	// material fetches of MaterialCHS, every texture is sampled.
+	ShadeResult ShadeTextured(const CpuMesh& mesh, const ShadeHit& hit)
+	{
+		auto&& material = mesh.GetMaterials()[mesh.GetResource().submeshes[hit.submeshIndex].materialIndex];
+		Vec2 uv = mesh.GetTexcoord(hit.submeshIndex, hit.triIndex, hit.barycentrics);
+		return { material.pBaseColor->SampleLevel(uv, 0), material.pORM->SampleLevel(uv, 0) };
+	}
+
+	// material fetches with the folded constants, same as the cpu MaterialCHS.
+	ShadeResult ShadeFolded(const CpuMesh& mesh, const ShadeHit& hit)
+	{
+		auto&& material = mesh.GetMaterials()[mesh.GetResource().submeshes[hit.submeshIndex].materialIndex];
+		auto&& fold = material.fold;
+		if (fold.type == MaterialFoldType::Constant)
+		{
+			return { fold.baseColor, fold.orm };
+		}
+		Vec2 uv = mesh.GetTexcoord(hit.submeshIndex, hit.triIndex, hit.barycentrics);
+		return {
+			fold.bConstBaseColor ? fold.baseColor : material.pBaseColor->SampleLevel(uv, 0),
+			fold.bConstORM ? fold.orm : material.pORM->SampleLevel(uv, 0) };
+	}
+
+	bool IsSame(const Vec4& a, const Vec4& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+	}
+
+	template <typename Func>
+	double MeasureShade(const CpuMesh& mesh, const std::vector<ShadeHit>& hits, int repeatCount, Func func, std::vector<ShadeResult>* pResults)
+	{
+		double bestMs = 1e30;
+		pResults->resize(hits.size());
+		for (int r = 0; r < std::max(repeatCount, 1); r++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0; i < hits.size(); i++)
+			{
+				(*pResults)[i] = func(mesh, hits[i]);
+			}
+			bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+		}
+		return bestMs;
+	}
+}
+
+int RunMaterialFoldBenchmark(const BenchmarkOptions& opt)
+{
+	bool bValid = true;
+
+	// the packing shared with UnpackMaterialConstant() in material.lib.hlsl.
+	for (uint32_t v = 0; v < 256; v++)
+	{
+		uint32_t packed = v | ((255 - v) << 8) | (((v * 7) & 0xff) << 16) | (((v * 13) & 0xff) << 24);
+		bValid = bValid && PackMaterialConstant(UnpackMaterialConstant(packed)) == packed;
+	}
+
+	// folded materials of each .rmesh.
+	printf("  %-20s %-20s %-10s %-10s %-5s %-5s %-9s %-8s\n", "mesh", "material", "opaque", "fold", "bc", "orm", "hitgroup", "anyhit");
+	CpuScene scene;
+	std::vector<int> meshIndices;
+	std::vector<std::string> meshNames;
+	for (auto&& file : FindMeshFiles(opt.homeDir))
+	{
+		int meshIndex = scene.AddMesh(file);
+		if (meshIndex < 0)
+		{
+			continue;
+		}
+		meshIndices.push_back(meshIndex);
+		meshNames.push_back(GetFileName(file));
+
+		auto&& mesh = *scene.GetMeshes()[meshIndex];
+		auto&& resource = mesh.GetResource();
+		uint32_t folded = 0;
+		for (size_t i = 0; i < resource.materials.size(); i++)
+		{
+			auto&& src = resource.materials[i];
+			auto&& fold = mesh.GetMaterials()[i].fold;
+			printf("  %-20s %-20s %-10s %-10s %-5s %-5s %-9s %-8s\n",
+				GetFileName(file).c_str(), src.name.c_str(), src.isOpaque ? "yes" : "no",
+				GetMaterialFoldName(fold.type), fold.bConstBaseColor ? "const" : "tex", fold.bConstORM ? "const" : "tex",
+				GetMaterialHitGroupName(GetMaterialHitGroup(fold, src.isOpaque)), (src.isOpaque || fold.bSkipAnyHit) ? "none" : "alpha");
+			folded += (fold.type == MaterialFoldType::Constant) ? 1 : 0;
+		}
+		printf("  %-20s %u / %u materials folded to constants\n", GetFileName(file).c_str(), folded, (uint32_t)resource.materials.size());
+	}
+	if (meshIndices.empty())
+	{
+		printf("Error: no mesh found.\n");
+		return -1;
+	}
+
+	// material fetch cost per hit, random hits on each mesh.
+	printf("\n  %-20s %9s %12s %12s %8s %6s\n", "mesh", "hits", "sampled ms", "folded ms", "speedup", "same");
+	for (size_t m = 0; m < meshIndices.size(); m++)
+	{
+		int meshIndex = meshIndices[m];
+		auto&& mesh = *scene.GetMeshes()[meshIndex];
+		std::mt19937 rnd(meshIndex);
+		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+		std::vector<ShadeHit> hits(kHitCount);
+		for (auto&& hit : hits)
+		{
+			auto&& tri = mesh.GetTriangles()[rnd() % mesh.GetTriangles().size()];
+			float u = dist(rnd), v = dist(rnd);
+			if (u + v > 1.0f)
+			{
+				u = 1.0f - u;
+				v = 1.0f - v;
+			}
+			hit = { tri.submeshIndex, tri.triIndex, { u, v } };
+		}
+
+		std::vector<ShadeResult> sampled, folded;
+		double sampledMs = MeasureShade(mesh, hits, opt.repeatCount, ShadeTextured, &sampled);
+		double foldedMs = MeasureShade(mesh, hits, opt.repeatCount, ShadeFolded, &folded);
+		bool bSame = true;
+		for (size_t i = 0; i < hits.size(); i++)
+		{
+			bSame = bSame && IsSame(sampled[i].baseColor, folded[i].baseColor) && IsSame(sampled[i].orm, folded[i].orm);
+		}
+		bValid = bValid && bSame;
+		printf("  %-20s %9u %12.3f %12.3f %7.2fx %6s\n",
+			meshNames[m].c_str(),
+			kHitCount, sampledMs, foldedMs, (foldedMs > 0.0) ? sampledMs / foldedMs : 0.0, bSame ? "yes" : "no");
+	}
+
+	printf("folded constants match the sampled dummy textures: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+}
+
+//	EOF
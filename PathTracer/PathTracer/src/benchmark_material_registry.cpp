@@ -0,0 +1,375 @@
+#include "benchmark.h"
+#include "cpu_material_registry.h"
+#include "rmesh_reader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+
+
+namespace
+{
+	// kRTDescriptorCountLocal of SampleApplication, 1 cbv + 4 srv, 1 sampler.
+	static const uint32_t kCbvPerRecord = 1;
+	static const uint32_t kSrvPerRecord = 4;
+	static const uint32_t kSamplerPerRecord = 1;
+	static const uint32_t kCopyCallsPerRecord = 3;
+	// typical descriptor sizes, only used to emulate the copies.
+	static const uint32_t kViewDescSize = 32;
+	static const uint32_t kSamplerDescSize = 32;
+
+	// source descriptor keys, the top byte separates the kinds.
+	enum KeyKind : uint64_t
+	{
+		kKeySubmeshCB = 1ull << 56,
+		kKeyIndexBuffer = 2ull << 56,
+		kKeyVertexBuffer = 3ull << 56,
+		kKeyTexture = 4ull << 56,
+		kKeyDummyTexture = 5ull << 56,
+		kKeySampler = 6ull << 56,
+	};
+	static const uint64_t kKeyValueMask = (1ull << 56) - 1;
+
+	struct SubmeshInfo
+	{
+		uint64_t	cb;
+		uint64_t	baseColor;
+		uint64_t	orm;
+		bool		isOpaque;
+	};
+
+	struct MeshInfo
+	{
+		std::string					name;
+		std::vector<SubmeshInfo>	submeshes;
+	};
+
+	struct SceneDesc
+	{
+		std::string				name;
+		std::vector<uint32_t>	instanceMeshes;
+	};
+
+	uint64_t GetTextureKey(const RMeshMaterial& material, int slot)
+	{
+		if ((int)material.textureNames.size() <= slot || material.textureNames[slot].empty())
+		{
+			return kKeyDummyTexture;
+		}
+		return kKeyTexture | (std::hash<std::string>()(material.textureNames[slot]) & kKeyValueMask);
+	}
+
+	// emulated cpu descriptor of a key.
+	void WriteSourceDescriptor(uint8_t* dst, uint64_t key, uint32_t size)
+	{
+		for (uint32_t i = 0; i < size; i += sizeof(key))
+		{
+			memcpy(dst + i, &key, sizeof(key));
+		}
+	}
+
+	struct LocalTable
+	{
+		uint32_t	cbv;
+		uint32_t	srv;
+		uint32_t	sampler;
+	};
+
+	struct SceneResult
+	{
+		uint64_t	records = 0;
+		uint32_t	views = 0;
+		uint32_t	samplers = 0;
+		uint64_t	copyCalls = 0;
+		double		ms = 0.0;
+		bool		bValid = true;
+	};
+
+	// descriptors of a record.
+	void GetRecordKeys(const SubmeshInfo& submesh, uint64_t* cbv, uint64_t* srv, uint64_t* sampler)
+	{
+		cbv[0] = submesh.cb;
+		srv[0] = kKeyIndexBuffer;
+		srv[1] = kKeyVertexBuffer;
+		srv[2] = submesh.baseColor;
+		srv[3] = submesh.orm;
+		sampler[0] = kKeySampler;
+	}
+
+	// every local table refers to its own source descriptors.
+	bool VerifyTable(const LocalTable& table, const SubmeshInfo& submesh, const std::vector<uint8_t>& viewHeap, const std::vector<uint8_t>& samplerHeap)
+	{
+		uint64_t cbv[kCbvPerRecord], srv[kSrvPerRecord], sampler[kSamplerPerRecord];
+		GetRecordKeys(submesh, cbv, srv, sampler);
+		uint8_t desc[64];
+		auto Check = [&](const std::vector<uint8_t>& heap, uint32_t first, const uint64_t* keys, uint32_t count, uint32_t descSize)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				size_t offset = (size_t)(first + i) * descSize;
+				WriteSourceDescriptor(desc, keys[i], descSize);
+				if (offset + descSize > heap.size() || memcmp(&heap[offset], desc, descSize) != 0)
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+		return Check(viewHeap, table.cbv, cbv, kCbvPerRecord, kViewDescSize)
+			&& Check(viewHeap, table.srv, srv, kSrvPerRecord, kViewDescSize)
+			&& Check(samplerHeap, table.sampler, sampler, kSamplerPerRecord, kSamplerDescSize);
+	}
+
+	// one descriptor copy per submesh of every instance.
+	SceneResult RunPerSubmesh(const SceneDesc& scene, const std::vector<MeshInfo>& meshes)
+	{
+		SceneResult ret;
+		std::vector<uint8_t> viewHeap, samplerHeap;
+		std::vector<LocalTable> tables;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (auto&& meshIndex : scene.instanceMeshes)
+		{
+			for (auto&& submesh : meshes[meshIndex].submeshes)
+			{
+				uint64_t cbv[kCbvPerRecord], srv[kSrvPerRecord], sampler[kSamplerPerRecord];
+				GetRecordKeys(submesh, cbv, srv, sampler);
+				LocalTable table;
+				auto Copy = [](std::vector<uint8_t>& heap, const uint64_t* keys, uint32_t count, uint32_t descSize)
+				{
+					uint32_t first = (uint32_t)(heap.size() / descSize);
+					heap.resize(heap.size() + (size_t)count * descSize);
+					for (uint32_t i = 0; i < count; i++)
+					{
+						WriteSourceDescriptor(&heap[(size_t)(first + i) * descSize], keys[i], descSize);
+					}
+					return first;
+				};
+				table.cbv = Copy(viewHeap, cbv, kCbvPerRecord, kViewDescSize);
+				table.srv = Copy(viewHeap, srv, kSrvPerRecord, kViewDescSize);
+				table.sampler = Copy(samplerHeap, sampler, kSamplerPerRecord, kSamplerDescSize);
+				tables.push_back(table);
+				ret.copyCalls += kCopyCallsPerRecord;
+			}
+		}
+		ret.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		ret.records = tables.size();
+		ret.views = (uint32_t)(viewHeap.size() / kViewDescSize);
+		ret.samplers = (uint32_t)(samplerHeap.size() / kSamplerDescSize);
+		return ret;
+	}
+
+	// shared ranges of the registry, only new ranges are copied.
+	SceneResult RunRegistry(const SceneDesc& scene, const std::vector<MeshInfo>& meshes)
+	{
+		SceneResult ret;
+		BindlessMaterialRegistry registry;
+		std::vector<uint8_t> viewHeap, samplerHeap;
+		std::vector<LocalTable> tables;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (auto&& meshIndex : scene.instanceMeshes)
+		{
+			for (auto&& submesh : meshes[meshIndex].submeshes)
+			{
+				uint64_t cbv[kCbvPerRecord], srv[kSrvPerRecord], sampler[kSamplerPerRecord];
+				GetRecordKeys(submesh, cbv, srv, sampler);
+				LocalTable table;
+				auto Copy = [&](MaterialDescriptorHeap type, std::vector<uint8_t>& heap, const uint64_t* keys, uint32_t count, uint32_t descSize)
+				{
+					bool bCreated;
+					uint32_t first = registry.RegisterRange(type, keys, count, &bCreated);
+					if (bCreated)
+					{
+						heap.resize((size_t)registry.GetDescriptorCount(type) * descSize);
+						for (uint32_t i = 0; i < count; i++)
+						{
+							WriteSourceDescriptor(&heap[(size_t)(first + i) * descSize], keys[i], descSize);
+						}
+						ret.copyCalls++;
+					}
+					return first;
+				};
+				table.cbv = Copy(MaterialDescriptorHeap::View, viewHeap, cbv, kCbvPerRecord, kViewDescSize);
+				table.srv = Copy(MaterialDescriptorHeap::View, viewHeap, srv, kSrvPerRecord, kViewDescSize);
+				table.sampler = Copy(MaterialDescriptorHeap::Sampler, samplerHeap, sampler, kSamplerPerRecord, kSamplerDescSize);
+				tables.push_back(table);
+			}
+		}
+		ret.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		ret.records = tables.size();
+		ret.views = registry.GetDescriptorCount(MaterialDescriptorHeap::View);
+		ret.samplers = registry.GetDescriptorCount(MaterialDescriptorHeap::Sampler);
+
+		size_t t = 0;
+		for (auto&& meshIndex : scene.instanceMeshes)
+		{
+			for (auto&& submesh : meshes[meshIndex].submeshes)
+			{
+				ret.bValid = ret.bValid && VerifyTable(tables[t++], submesh, viewHeap, samplerHeap);
+			}
+		}
+		return ret;
+	}
+
+	// bindless path, one index per unique descriptor and one record per unique index set.
+	// the descriptors already live in the bindless heap, nothing is copied.
+	SceneResult RunBindless(const SceneDesc& scene, const std::vector<MeshInfo>& meshes)
+	{
+		SceneResult ret;
+		BindlessMaterialRegistry registry;
+		std::vector<uint32_t> slotRecords;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (auto&& meshIndex : scene.instanceMeshes)
+		{
+			for (auto&& submesh : meshes[meshIndex].submeshes)
+			{
+				MaterialIndexRecord record;
+				record.cbSubmesh = registry.RegisterDescriptor(MaterialDescriptorHeap::View, submesh.cb);
+				record.indices = registry.RegisterDescriptor(MaterialDescriptorHeap::View, kKeyIndexBuffer);
+				record.vertices = registry.RegisterDescriptor(MaterialDescriptorHeap::View, kKeyVertexBuffer);
+				record.texBaseColor = registry.RegisterDescriptor(MaterialDescriptorHeap::View, submesh.baseColor);
+				record.texORM = registry.RegisterDescriptor(MaterialDescriptorHeap::View, submesh.orm);
+				record.texBaseColorSampler = registry.RegisterDescriptor(MaterialDescriptorHeap::Sampler, kKeySampler);
+				slotRecords.push_back(registry.RegisterMaterial(record, submesh.isOpaque ? 0 : 1));
+			}
+		}
+		ret.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		ret.records = registry.GetRecordCount();
+		ret.views = registry.GetDescriptorCount(MaterialDescriptorHeap::View);
+		ret.samplers = registry.GetDescriptorCount(MaterialDescriptorHeap::Sampler);
+
+		// the same key has to give the same index, and different keys different indices.
+		std::map<uint32_t, uint64_t> viewKeys;
+		size_t t = 0;
+		for (auto&& meshIndex : scene.instanceMeshes)
+		{
+			for (auto&& submesh : meshes[meshIndex].submeshes)
+			{
+				auto&& r = registry.GetRecord(slotRecords[t++]);
+				std::pair<uint32_t, uint64_t> pairs[] = {
+					{r.cbSubmesh, submesh.cb}, {r.indices, kKeyIndexBuffer}, {r.vertices, kKeyVertexBuffer},
+					{r.texBaseColor, submesh.baseColor}, {r.texORM, submesh.orm},
+				};
+				for (auto&& p : pairs)
+				{
+					auto it = viewKeys.insert(p).first;
+					ret.bValid = ret.bValid && it->second == p.second;
+				}
+				ret.bValid = ret.bValid && r.texBaseColorSampler == 0;
+			}
+		}
+		return ret;
+	}
+}
+
+int RunMaterialRegistryBenchmark(const BenchmarkOptions& opt)
+{
+	std::vector<MeshInfo> meshes;
+	int suzanne = -1;
+	bool bSponza = false;
+	for (auto&& file : FindMeshFiles(opt.homeDir))
+	{
+		RMesh mesh;
+		if (!LoadRMesh(file, &mesh))
+		{
+			continue;
+		}
+		MeshInfo info;
+		info.name = GetFileName(file);
+		for (size_t i = 0; i < mesh.submeshes.size(); i++)
+		{
+			auto&& material = mesh.materials[mesh.submeshes[i].materialIndex];
+			SubmeshInfo submesh;
+			submesh.cb = kKeySubmeshCB | ((uint64_t)meshes.size() << 32) | i;
+			submesh.baseColor = GetTextureKey(material, kRMeshTexBaseColor);
+			submesh.orm = GetTextureKey(material, kRMeshTexORM);
+			submesh.isOpaque = material.isOpaque;
+			info.submeshes.push_back(submesh);
+		}
+		if (suzanne < 0 && info.name.find("suzanne") != std::string::npos)
+		{
+			suzanne = (int)meshes.size();
+		}
+		bSponza = bSponza || info.name.find("sponza") != std::string::npos;
+		meshes.push_back(info);
+	}
+	if (meshes.empty())
+	{
+		printf("Error: no mesh found.\n");
+		return -1;
+	}
+	if (!bSponza)
+	{
+		printf("sponza.rmesh is not in resources/mesh, each loaded mesh is reported as a single instance scene instead.\n");
+	}
+
+	// suzanne grids of meshType 0 at two sizes, a mixed grid and every mesh once.
+	std::vector<SceneDesc> scenes;
+	uint32_t gridMesh = (suzanne >= 0) ? (uint32_t)suzanne : 0;
+	for (uint32_t width : { 32u, 128u })
+	{
+		SceneDesc scene;
+		scene.name = meshes[gridMesh].name + " " + std::to_string(width) + "x" + std::to_string(width);
+		scene.instanceMeshes.assign(width * width, gridMesh);
+		scenes.push_back(scene);
+	}
+	{
+		SceneDesc scene;
+		scene.name = "mixed 32x32";
+		for (uint32_t i = 0; i < 32 * 32; i++)
+		{
+			scene.instanceMeshes.push_back(i % (uint32_t)meshes.size());
+		}
+		scenes.push_back(scene);
+	}
+	for (uint32_t i = 0; i < (uint32_t)meshes.size(); i++)
+	{
+		SceneDesc scene;
+		scene.name = meshes[i].name;
+		scene.instanceMeshes.push_back(i);
+		scenes.push_back(scene);
+	}
+
+	printf("  %-22s %-11s %9s %9s %9s %11s %10s %6s\n", "scene", "path", "records", "views", "samplers", "copies", "build ms", "valid");
+	bool bAllValid = true;
+	for (auto&& scene : scenes)
+	{
+		struct PathEntry
+		{
+			const char*	name;
+			SceneResult	(*func)(const SceneDesc&, const std::vector<MeshInfo>&);
+		};
+		static const PathEntry kPaths[] = {
+			{"per submesh",	RunPerSubmesh},
+			{"ranges",		RunRegistry},
+			{"bindless",	RunBindless},
+		};
+		for (auto&& path : kPaths)
+		{
+			SceneResult best;
+			for (int r = 0; r < std::max(opt.repeatCount, 1); r++)
+			{
+				SceneResult result = path.func(scene, meshes);
+				if (r == 0 || result.ms < best.ms)
+				{
+					best = result;
+				}
+			}
+			bAllValid = bAllValid && best.bValid;
+			printf("  %-22s %-11s %9llu %9u %9u %11llu %10.3f %6s\n",
+				scene.name.c_str(), path.name, (unsigned long long)best.records, best.views, best.samplers,
+				(unsigned long long)best.copyCalls, best.ms, best.bValid ? "yes" : "no");
+		}
+	}
+
+	// the shared paths must not grow with the instance count.
+	SceneResult small = RunRegistry(scenes[0], meshes);
+	SceneResult large = RunRegistry(scenes[1], meshes);
+	bool bConstant = small.views == large.views && small.samplers == large.samplers;
+	printf("descriptor heap usage of %s vs %s: %s\n", scenes[0].name.c_str(), scenes[1].name.c_str(), bConstant ? "constant" : "GROWS");
+	return (bAllValid && bConstant) ? 0 : -1;
+}
+
+//	EOF
@@ -0,0 +1,322 @@
+#include "benchmark.h"
+#include "cpu_scene.h"
+#include "rmesh_opacity.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock	Clock;
+
+	static const uint32_t kGridSizes[] = { 32, 128 };
+	static const uint32_t kSamplesPerTriangle = 16;
+	static const uint32_t kRayCount = 1 << 16;
+
+	// texcoords of every vertex of every classified triangle, for textures without a mesh.
+	void MakeGridTriangles(uint32_t gridSize, std::vector<Vec2>* pUvs)
+	{
+		pUvs->clear();
+		float s = 1.0f / (float)gridSize;
+		for (uint32_t y = 0; y < gridSize; y++)
+		{
+			for (uint32_t x = 0; x < gridSize; x++)
+			{
+				Vec2 p00((float)x * s, (float)y * s), p10((float)(x + 1) * s, (float)y * s);
+				Vec2 p01((float)x * s, (float)(y + 1) * s), p11((float)(x + 1) * s, (float)(y + 1) * s);
+				pUvs->insert(pUvs->end(), { p00, p10, p11, p00, p11, p01 });
+			}
+		}
+	}
+
+	// MaterialAHS at random points of the triangle agrees with the class.
+	bool IsConservative(const CpuTexture& texture, const Vec2 uvs[3], RMeshTriangleOpacity opacity, std::mt19937& rnd)
+	{
+		if (opacity == kRMeshTriangleMixed)
+		{
+			return true;
+		}
+		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+		for (uint32_t i = 0; i < kSamplesPerTriangle; i++)
+		{
+			float u = dist(rnd), v = dist(rnd);
+			if (u + v > 1.0f)
+			{
+				u = 1.0f - u;
+				v = 1.0f - v;
+			}
+			Vec2 uv = uvs[0] * (1.0f - u - v) + uvs[1] * u + uvs[2] * v;
+			bool bPass = texture.SampleLevel(uv, 0.0f).w >= kMaterialOpacityThreshold;
+			if (bPass != (opacity == kRMeshTriangleOpaque))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// camera rays from outside the bounds, aimed at random points inside.
+	void GenerateRays(const Aabb& bounds, std::vector<CpuRay>* pRays)
+	{
+		std::mt19937 rnd(3);
+		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+		Vec3 center = bounds.Center();
+		float radius = Length(bounds.Extent()) * 0.5f;
+		pRays->resize(kRayCount);
+		for (auto&& ray : *pRays)
+		{
+			float z = dist(rnd) * 2.0f - 1.0f;
+			float phi = dist(rnd) * 2.0f * kCpuPI;
+			float s = std::sqrt(std::max(1.0f - z * z, 0.0f));
+			ray.origin = center + Vec3(std::cos(phi) * s, std::sin(phi) * s, z) * radius * 3.0f;
+			Vec3 target = bounds.bmin + bounds.Extent() * Vec3(dist(rnd), dist(rnd), dist(rnd));
+			ray.direction = Normalize(target - ray.origin);
+			ray.tmin = 0.0f;
+			ray.tmax = FLT_MAX;
+		}
+	}
+
+	double TraceClosest(const CpuScene& scene, const std::vector<CpuRay>& rays, int repeatCount, std::vector<float>* pHitT)
+	{
+		double ret = 1e30;
+		pHitT->resize(rays.size());
+		for (int r = 0; r < repeatCount; r++)
+		{
+			auto start = Clock::now();
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				CpuHit hit;
+				(*pHitT)[i] = scene.TraceClosest(rays[i], &hit) ? hit.t : -1.0f;
+			}
+			ret = std::min(ret, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+		}
+		return ret;
+	}
+
+	double TraceAny(const CpuScene& scene, const std::vector<CpuRay>& rays, int repeatCount, std::vector<bool>* pHit)
+	{
+		double ret = 1e30;
+		pHit->resize(rays.size());
+		for (int r = 0; r < repeatCount; r++)
+		{
+			auto start = Clock::now();
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				(*pHit)[i] = scene.TraceAny(rays[i]);
+			}
+			ret = std::min(ret, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+		}
+		return ret;
+	}
+
+	void PrintMaterialStats(const std::string& meshName, const RMesh& mesh, const std::vector<RMeshOpacityStats>& stats)
+	{
+		for (size_t m = 0; m < stats.size(); m++)
+		{
+			auto&& s = stats[m];
+			if (s.bMasked)
+			{
+				printf("  %-20s %-20s %9u %9u %12u %9u %7.1f%%\n", meshName.c_str(), mesh.materials[m].name.c_str(), s.GetTriangleCount(),
+					s.triangleCounts[kRMeshTriangleOpaque], s.triangleCounts[kRMeshTriangleTransparent],
+					s.triangleCounts[kRMeshTriangleMixed], s.GetAnyHitFraction() * 100.0);
+			}
+		}
+	}
+}
+
+int RunOpacityBenchmark(const BenchmarkOptions& opt)
+{
+	std::error_code ec;
+	std::filesystem::path tempDir = std::filesystem::temp_directory_path(ec);
+	if (ec)
+	{
+		printf("Error: no temporary directory.\n");
+		return -1;
+	}
+	int repeatCount = std::max(opt.repeatCount, 1);
+	bool bValid = true;
+
+	// masked materials of every mesh, triangles left on the any hit after the bake.
+	printf("  %-20s %-20s %9s %9s %12s %9s %8s\n", "mesh", "material", "tris", "opaque", "transparent", "mixed", "any hit");
+	bool bSponzaMesh = false;
+	for (auto&& file : FindMeshFiles(opt.homeDir))
+	{
+		RMesh mesh;
+		if (!LoadRMesh(file, &mesh, opt.threadCount))
+		{
+			continue;
+		}
+		bSponzaMesh = bSponzaMesh || GetFileName(file) == "sponza.rmesh";
+		std::vector<CpuTexture> textures;
+		std::vector<const CpuTexture*> baseColors;
+		LoadMaskedBaseColors(mesh, &textures, &baseColors);
+		RMeshOpacitySettings settings;
+		settings.threadCount = opt.threadCount;
+		std::vector<RMeshOpacityStats> stats;
+		RMesh baked = mesh;
+		bValid = BakeRMeshOpacity(&baked, baseColors, settings, &stats) && bValid;
+		PrintMaterialStats(GetFileName(file), baked, stats);
+	}
+
+	// without the sponza mesh each sponza base color is classified over a uv grid of the whole texture,
+	// the cells stand in for triangles of that size.
+	std::filesystem::path sponzaDir = std::filesystem::path(opt.homeDir) / "resources/mesh" / "sponza";
+	if (!bSponzaMesh && std::filesystem::is_directory(sponzaDir, ec))
+	{
+		std::vector<std::string> texturePaths;
+		for (auto&& entry : std::filesystem::directory_iterator(sponzaDir, ec))
+		{
+			std::string name = entry.path().filename().string();
+			if (name.size() > 7 && name.compare(name.size() - 7, 7, ".bc.dds") == 0)
+			{
+				texturePaths.push_back(entry.path().string());
+			}
+		}
+		std::sort(texturePaths.begin(), texturePaths.end());
+
+		printf("\n  sponza base colors over uv grids, any hit fraction and classify ms\n");
+		printf("  %-20s %11s", "material", "size");
+		for (auto gridSize : kGridSizes)
+		{
+			char label[32];
+			snprintf(label, sizeof(label), "%ux%u", gridSize, gridSize);
+			printf(" %9s %8s %6s", label, "ms", "valid");
+		}
+		printf("\n");
+		for (auto&& path : texturePaths)
+		{
+			CpuTexture texture;
+			if (!texture.LoadDDS(path))
+			{
+				bValid = false;
+				continue;
+			}
+			OpacityClassifier classifier;
+			classifier.Initialize(texture);
+			std::string name = GetFileName(path);
+			char size[32];
+			snprintf(size, sizeof(size), "%ux%u", classifier.GetWidth(), classifier.GetHeight());
+			printf("  %-20s %11s", name.substr(0, name.size() - 7).c_str(), size);
+			for (auto gridSize : kGridSizes)
+			{
+				std::vector<Vec2> uvs;
+				MakeGridTriangles(gridSize, &uvs);
+				size_t triCount = uvs.size() / 3;
+				std::vector<RMeshTriangleOpacity> classes(triCount);
+				double classifyMs = 1e30;
+				for (int r = 0; r < repeatCount; r++)
+				{
+					auto start = Clock::now();
+					for (size_t t = 0; t < triCount; t++)
+					{
+						classes[t] = classifier.Classify(&uvs[t * 3]);
+					}
+					classifyMs = std::min(classifyMs, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+				}
+				std::mt19937 rnd(gridSize);
+				uint32_t mixedCount = 0;
+				bool bConservative = true;
+				for (size_t t = 0; t < triCount; t++)
+				{
+					mixedCount += (classes[t] == kRMeshTriangleMixed) ? 1 : 0;
+					bConservative = bConservative && IsConservative(texture, &uvs[t * 3], classes[t], rnd);
+				}
+				bValid = bValid && bConservative;
+				printf(" %8.1f%% %8.3f %6s", (double)mixedCount / (double)triCount * 100.0, classifyMs, bConservative ? "yes" : "no");
+			}
+			printf("\n");
+		}
+	}
+
+	// end to end, a masked copy of the sphere traced before and after the bake.
+	std::string spherePath = (std::filesystem::path(opt.homeDir) / "resources/mesh" / "sphere" / "sphere.rmesh").string();
+	const char* kMaskTextures[] = { "leaf.bc.dds", "chain.bc.dds" };
+	printf("\n  %-20s %9s %9s %12s %12s %12s %12s %6s\n", "sphere mask", "tris", "any hit", "closest ms", "baked ms", "any ms", "baked ms", "same");
+	for (auto&& maskTexture : kMaskTextures)
+	{
+		RMesh mesh;
+		if (!LoadRMesh(spherePath, &mesh, opt.threadCount))
+		{
+			printf("Error: no sphere mesh.\n");
+			return -1;
+		}
+		std::filesystem::copy_file(sponzaDir / maskTexture, tempDir / maskTexture, std::filesystem::copy_options::overwrite_existing, ec);
+		for (auto&& mat : mesh.materials)
+		{
+			mat.isOpaque = false;
+			mat.textureNames.resize(std::max<size_t>(mat.textureNames.size(), kRMeshTexBaseColor + 1));
+			mat.textureNames[kRMeshTexBaseColor] = maskTexture;
+		}
+		std::string sourcePath = (tempDir / "opacity_source.rmesh").string();
+		std::string bakedPath = (tempDir / "opacity_baked.rmesh").string();
+		if (ec || !WriteRMesh(sourcePath, mesh))
+		{
+			printf("Error: cannot write %s.\n", sourcePath.c_str());
+			return -1;
+		}
+		mesh.filePath = sourcePath;
+
+		std::vector<CpuTexture> textures;
+		std::vector<const CpuTexture*> baseColors;
+		LoadMaskedBaseColors(mesh, &textures, &baseColors);
+		RMeshOpacitySettings settings;
+		settings.threadCount = opt.threadCount;
+		std::vector<RMeshOpacityStats> stats;
+		if (!BakeRMeshOpacity(&mesh, baseColors, settings, &stats) || !WriteRMesh(bakedPath, mesh))
+		{
+			printf("Error: cannot bake %s.\n", sourcePath.c_str());
+			return -1;
+		}
+		RMeshOpacityStats total;
+		for (auto&& s : stats)
+		{
+			for (int c = 0; c < kRMeshTriangleOpacityMax; c++)
+			{
+				total.triangleCounts[c] += s.triangleCounts[c];
+			}
+		}
+
+		CpuScene scenes[2];
+		std::string paths[2] = { sourcePath, bakedPath };
+		for (int i = 0; i < 2; i++)
+		{
+			int meshIndex = scenes[i].AddMesh(paths[i]);
+			if (meshIndex < 0)
+			{
+				return -1;
+			}
+			scenes[i].AddInstance(meshIndex, MatrixIdentity());
+			BvhBuildSettings bvhSettings;
+			bvhSettings.threadCount = opt.threadCount;
+			scenes[i].Build(bvhSettings);
+		}
+		std::vector<CpuRay> rays;
+		GenerateRays(scenes[0].GetSceneAabb(), &rays);
+
+		std::vector<float> hitT[2];
+		std::vector<bool> anyHit[2];
+		double closestMs[2], anyMs[2];
+		for (int i = 0; i < 2; i++)
+		{
+			closestMs[i] = TraceClosest(scenes[i], rays, repeatCount, &hitT[i]);
+			anyMs[i] = TraceAny(scenes[i], rays, repeatCount, &anyHit[i]);
+		}
+		bool bSame = hitT[0] == hitT[1] && anyHit[0] == anyHit[1];
+		bValid = bValid && bSame;
+		printf("  %-20s %9u %8.1f%% %12.3f %12.3f %12.3f %12.3f %6s\n", maskTexture, total.GetTriangleCount(), total.GetAnyHitFraction() * 100.0,
+			closestMs[0], closestMs[1], anyMs[0], anyMs[1], bSame ? "yes" : "no");
+
+		std::filesystem::remove(sourcePath, ec);
+		std::filesystem::remove(bakedPath, ec);
+		std::filesystem::remove(tempDir / maskTexture, ec);
+	}
+
+	printf("opacity classes are conservative and baked meshes trace the same hits: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+}
+
+//	EOF
@@ -0,0 +1,115 @@
+#include "benchmark.h"
+#include "cpu_path_tracer.h"
+#include "headless.h"
+#include "path_tracer_permutation.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifndef USE_IN_CPP
+#	define USE_IN_CPP
+#endif
+#include "../shaders/cbuffer.hlsli"
+
+
+namespace
+{
+	static const uint32_t kWidth = 160;
+	static const uint32_t kHeight = 90;
+
+	struct Image
+	{
+		std::vector<float>	result, albedo, normal;
+
+		Image()
+			: result(kWidth * kHeight * 3), albedo(kWidth * kHeight * 3), normal(kWidth * kHeight * 3)
+		{}
+
+		bool operator==(const Image& rhs) const
+		{
+			return memcmp(result.data(), rhs.result.data(), result.size() * sizeof(float)) == 0
+				&& memcmp(albedo.data(), rhs.albedo.data(), albedo.size() * sizeof(float)) == 0
+				&& memcmp(normal.data(), rhs.normal.data(), normal.size() * sizeof(float)) == 0;
+		}
+	};
+
+	// best of repeatCount renders.
+	bool Render(CpuPathTracer& tracer, const CpuScene& scene, const SceneCB& cbScene, const LightCB& cbLight, const PathTraceCB& cbPathTrace,
+		uint32_t threadCount, int repeatCount, Image* pImage, CpuRenderStats* pStats)
+	{
+		for (int r = 0; r < repeatCount; r++)
+		{
+			CpuRenderStats stats;
+			if (!tracer.Render(scene, cbScene, cbLight, cbPathTrace, kWidth, kHeight,
+				pImage->result.data(), pImage->albedo.data(), pImage->normal.data(), threadCount, &stats))
+			{
+				return false;
+			}
+			*pStats = (r == 0 || stats.elapsedMs < pStats->elapsedMs) ? stats : *pStats;
+		}
+		return true;
+	}
+}
+
+
+int RunPermutationBenchmark(const BenchmarkOptions& opt)
+{
+	std::string meshPath = opt.homeDir + "/resources/mesh/hp_suzanne/hp_suzanne.rmesh";
+	CpuScene scene;
+	if (!CreateBenchmarkScene(meshPath, &scene))
+	{
+		printf("Error: cannot load %s.\n", meshPath.c_str());
+		return -1;
+	}
+	SceneCB cbScene;
+	LightCB cbLight;
+	PathTraceCB cbPathTrace;
+	SetupBenchmarkConstants(scene.GetSceneAabb(), kWidth, kHeight, &cbScene, &cbLight, &cbPathTrace);
+	int repeatCount = std::max(opt.repeatCount, 1);
+
+	// every permutation renders the same pixels as the generic loops, bit for bit.
+	printf("render %ux%u, %d instances\n", kWidth, kHeight, (int)scene.GetInstances().size());
+	printf("  %-5s %-5s %11s %11s %9s %10s %6s\n", "spp", "depth", "generic ms", "fixed ms", "speedup", "rays", "same");
+	bool bValid = true;
+	CpuPathTracer generic, specialized;
+	generic.SetUsePermutations(false);
+	for (int i = 0; i < kPathTracerPermutationCount; i++)
+	{
+		cbPathTrace.sampleCount = kPathTracerPermutations[i].sampleCount;
+		cbPathTrace.depthMax = kPathTracerPermutations[i].depthMax;
+		Image genericImage, fixedImage;
+		CpuRenderStats genericStats, fixedStats;
+		if (!Render(generic, scene, cbScene, cbLight, cbPathTrace, opt.threadCount, repeatCount, &genericImage, &genericStats)
+			|| !Render(specialized, scene, cbScene, cbLight, cbPathTrace, opt.threadCount, repeatCount, &fixedImage, &fixedStats))
+		{
+			return -1;
+		}
+		bool bSame = genericImage == fixedImage && genericStats.rayCount == fixedStats.rayCount
+			&& genericStats.permutationIndex == -1 && fixedStats.permutationIndex == i;
+		bValid = bValid && bSame;
+		printf("  %-5d %-5d %11.2f %11.2f %8.2fx %10llu %6s\n", cbPathTrace.sampleCount, cbPathTrace.depthMax,
+			genericStats.elapsedMs, fixedStats.elapsedMs, genericStats.elapsedMs / fixedStats.elapsedMs,
+			(unsigned long long)fixedStats.rayCount, bSame ? "yes" : "NO");
+	}
+
+	// settings without a permutation run the generic loops.
+	{
+		cbPathTrace.sampleCount = 2;
+		cbPathTrace.depthMax = 3;
+		Image image;
+		CpuRenderStats stats;
+		if (!Render(specialized, scene, cbScene, cbLight, cbPathTrace, opt.threadCount, 1, &image, &stats))
+		{
+			return -1;
+		}
+		bool bFallback = stats.permutationIndex == -1 && FindPathTracerPermutation(2, 3) == -1;
+		bValid = bValid && bFallback;
+		printf("spp 2, depth 3 falls back to the generic loops: %s\n", bFallback ? "yes" : "NO");
+	}
+
+	printf("permutations match the generic path tracer: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+}
+
+//	EOF
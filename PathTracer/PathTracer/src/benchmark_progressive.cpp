@@ -0,0 +1,229 @@
+#include "benchmark.h"
+#include "cpu_path_tracer.h"
+#include "headless.h"
+#include "progressive_accumulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#ifndef USE_IN_CPP
+#	define USE_IN_CPP
+#endif
+#include "../shaders/cbuffer.hlsli"
+#include "../shaders/progressive.hlsli"
+
+
+namespace
+{
+	static const uint32_t kWidth = 160;
+	static const uint32_t kHeight = 90;
+	static const int kDepth = 4;
+	static const int kReferenceSampleCount = 128;
+	static const uint32_t kReferenceFrameIndex = 1000;		// far from the accumulated frames, so the reference shares none of their samples.
+
+	struct Image
+	{
+		std::vector<float>	result, albedo, normal;
+
+		Image()
+			: result(kWidth * kHeight * 3), albedo(kWidth * kHeight * 3), normal(kWidth * kHeight * 3)
+		{}
+	};
+
+	double ComputeRmse(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			double d = (double)a[i] - (double)b[i];
+			sum += d * d;
+		}
+		return std::sqrt(sum / (double)a.size());
+	}
+
+	float MaxRelativeDiff(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		float maxDiff = 0.0f;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			maxDiff = std::max(maxDiff, std::fabs(a[i] - b[i]) / std::max(std::fabs(a[i]), 1.0f));
+		}
+		return maxDiff;
+	}
+}
+
+
+int RunProgressiveBenchmark(const BenchmarkOptions& opt)
+{
+	std::string meshPath = opt.homeDir + "/resources/mesh/hp_suzanne/hp_suzanne.rmesh";
+	CpuScene scene;
+	if (!CreateBenchmarkScene(meshPath, &scene))
+	{
+		printf("Error: cannot load %s.\n", meshPath.c_str());
+		return -1;
+	}
+	SceneCB cbScene;
+	LightCB cbLight;
+	PathTraceCB cbPathTrace;
+	SetupBenchmarkConstants(scene.GetSceneAabb(), kWidth, kHeight, &cbScene, &cbLight, &cbPathTrace);
+	cbPathTrace.sampleCount = 1;
+	cbPathTrace.depthMax = kDepth;
+	CpuPathTracer tracer;
+	bool bValid = true;
+
+	// frame 0 keeps the sequence of the single frame renders, later frames draw new samples.
+	{
+		bool bSameSequence = true;
+		for (uint32_t s = 0; s < 16; s++)
+		{
+			for (uint32_t d = 0; d < 16; d++)
+			{
+				bSameSequence = bSameSequence && GetSampleSequenceIndex(0, s, d, 16, 16) == s * 16 + d;
+			}
+		}
+		Image frames[2];
+		for (uint32_t f = 0; f < 2; f++)
+		{
+			cbPathTrace.accumFrameIndex = f;
+			if (!tracer.Render(scene, cbScene, cbLight, cbPathTrace, kWidth, kHeight,
+				frames[f].result.data(), frames[f].albedo.data(), frames[f].normal.data(), opt.threadCount))
+			{
+				return -1;
+			}
+		}
+		cbPathTrace.accumFrameIndex = 0;
+		bool bDecorrelated = frames[0].result != frames[1].result && frames[0].albedo == frames[1].albedo;
+		bValid = bValid && bSameSequence && bDecorrelated;
+		printf("frame 0 keeps the single frame sequence: %s\n", bSameSequence ? "yes" : "NO");
+		printf("frame 1 draws new samples, same first hits: %s\n", bDecorrelated ? "yes" : "NO");
+	}
+
+	// a high sample count frame with samples of its own.
+	Image reference;
+	{
+		PathTraceCB cbReference = cbPathTrace;
+		cbReference.sampleCount = kReferenceSampleCount;
+		cbReference.accumFrameIndex = kReferenceFrameIndex;
+		CpuRenderStats stats;
+		if (!tracer.Render(scene, cbScene, cbLight, cbReference, kWidth, kHeight,
+			reference.result.data(), reference.albedo.data(), reference.normal.data(), opt.threadCount, &stats))
+		{
+			return -1;
+		}
+		printf("reference %ux%u, %d spp, depth %d, %.2f ms\n", kWidth, kHeight, kReferenceSampleCount, kDepth, stats.elapsedMs);
+	}
+
+	// every frame traces 1 spp, the running mean converges to the reference.
+	// the accumulation buffer starts with nan, the first frame must overwrite it.
+	printf("  %-6s %-5s %9s %9s %10s\n", "frames", "spp", "frame ms", "rmse", "rays");
+	std::vector<float> accum(kWidth * kHeight * 3, std::numeric_limits<float>::quiet_NaN());
+	ProgressiveAccumulator accumulator;
+	Image image;
+	double lastRmse = 0.0;
+	uint32_t nextReport = 1;
+	for (uint32_t f = 0; f < 64; f++)
+	{
+		accumulator.Update(cbScene, cbLight, &cbPathTrace, true);
+		CpuRenderStats stats;
+		if (!tracer.Render(scene, cbScene, cbLight, cbPathTrace, kWidth, kHeight,
+			image.result.data(), image.albedo.data(), image.normal.data(), opt.threadCount, &stats, accum.data()))
+		{
+			return -1;
+		}
+		if (accumulator.GetFrameCount() == nextReport)
+		{
+			double rmse = ComputeRmse(image.result, reference.result);
+			bool bConverging = (nextReport == 1) || (rmse < lastRmse);
+			bValid = bValid && bConverging;
+			printf("  %-6u %-5llu %9.2f %9.5f %10llu%s\n", accumulator.GetFrameCount(), (unsigned long long)accumulator.GetSampleCount(),
+				stats.elapsedMs, rmse, (unsigned long long)stats.rayCount, bConverging ? "" : "  NOT CONVERGING");
+			lastRmse = rmse;
+			nextReport *= 4;
+		}
+	}
+	bool bAccumSame = memcmp(accum.data(), image.result.data(), accum.size() * sizeof(float)) == 0;
+	bValid = bValid && bAccumSame && accumulator.GetResetCount() == 1;
+	printf("result is the accumulation buffer: %s\n", bAccumSame ? "yes" : "NO");
+
+	// 64 accumulated frames draw the samples of one 64 spp frame, the mean matches up to rounding.
+	{
+		PathTraceCB cbSingle = cbPathTrace;
+		cbSingle.sampleCount = 64;
+		cbSingle.accumFrameIndex = 0;
+		cbSingle.accumEnable = 0;
+		Image single;
+		if (!tracer.Render(scene, cbScene, cbLight, cbSingle, kWidth, kHeight,
+			single.result.data(), single.albedo.data(), single.normal.data(), opt.threadCount))
+		{
+			return -1;
+		}
+		float maxDiff = MaxRelativeDiff(single.result, image.result);
+		bool bMatch = maxDiff <= 1e-4f;
+		bValid = bValid && bMatch;
+		printf("64 frames match one 64 spp frame: %s (max relative diff %.2g)\n", bMatch ? "yes" : "NO", maxDiff);
+	}
+
+	// any input change restarts the mean, the previous frame matrices do not.
+	{
+		struct Step
+		{
+			const char*	name;
+			bool		bReset;
+		};
+		static const Step kSteps[] = {
+			{ "same inputs", false },
+			{ "previous frame matrices", false },
+			{ "camera", true },
+			{ "same camera", false },
+			{ "light", true },
+			{ "sample count", true },
+			{ "invalidate", true },
+			{ "disabled", true },
+			{ "enabled", true },
+		};
+		for (auto&& step : kSteps)
+		{
+			uint32_t prevCount = accumulator.GetFrameCount();
+			bool bEnable = true;
+			if (!strcmp(step.name, "previous frame matrices"))
+			{
+				cbScene.mtxProjToPrevProj.m[0][1] += 1.0f;
+				cbScene.mtxPrevViewToProj.m[2][3] += 1.0f;
+			}
+			else if (!strcmp(step.name, "camera"))
+			{
+				cbScene.eyePosition.x += 1.0f;
+			}
+			else if (!strcmp(step.name, "light"))
+			{
+				cbLight.directionalColor.x *= 0.5f;
+			}
+			else if (!strcmp(step.name, "sample count"))
+			{
+				cbPathTrace.sampleCount = 2;
+			}
+			else if (!strcmp(step.name, "invalidate"))
+			{
+				accumulator.Invalidate();
+			}
+			else if (!strcmp(step.name, "disabled"))
+			{
+				bEnable = false;
+			}
+			accumulator.Update(cbScene, cbLight, &cbPathTrace, bEnable);
+			uint32_t expected = step.bReset ? (bEnable ? 1 : 0) : prevCount + 1;
+			bool bOk = accumulator.GetFrameCount() == expected && cbPathTrace.accumFrameIndex == (expected > 0 ? expected - 1 : 0)
+				&& cbPathTrace.accumEnable == (bEnable ? 1u : 0u);
+			bValid = bValid && bOk;
+			printf("  %-24s frame %-3u %s\n", step.name, accumulator.GetFrameCount(), bOk ? "ok" : "NG");
+		}
+	}
+
+	printf("progressive accumulation matches the reference: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+}
+
+//	EOF
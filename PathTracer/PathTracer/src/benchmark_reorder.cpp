@@ -0,0 +1,223 @@
+#include "benchmark.h"
+#include "rmesh_reorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock	Clock;
+
+	bool IsSameElement(const std::vector<uint8_t>& a, uint32_t offsetA, const std::vector<uint8_t>& b, uint32_t offsetB, uint32_t stride)
+	{
+		return memcmp(a.data() + offsetA, b.data() + offsetB, stride) == 0;
+	}
+
+	bool IsSameCorner(const RMesh& a, const RMeshSubmesh& sa, uint32_t va, const RMesh& b, const RMeshSubmesh& sb, uint32_t vb)
+	{
+		return IsSameElement(a.position, sa.positionOffsetBytes + va * RMesh::kPositionStride, b.position, sb.positionOffsetBytes + vb * RMesh::kPositionStride, RMesh::kPositionStride)
+			&& IsSameElement(a.normal, sa.normalOffsetBytes + va * RMesh::kNormalStride, b.normal, sb.normalOffsetBytes + vb * RMesh::kNormalStride, RMesh::kNormalStride)
+			&& IsSameElement(a.tangent, sa.tangentOffsetBytes + va * RMesh::kTangentStride, b.tangent, sb.tangentOffsetBytes + vb * RMesh::kTangentStride, RMesh::kTangentStride)
+			&& IsSameElement(a.texcoord, sa.texcoordOffsetBytes + va * RMesh::kTexcoordStride, b.texcoord, sb.texcoordOffsetBytes + vb * RMesh::kTexcoordStride, RMesh::kTexcoordStride);
+	}
+
+	// each reordered triangle has the vertices of its source triangle, corners in the same order.
+	bool IsSameTriangles(const RMesh& source, const RMesh& reordered, const std::vector<uint32_t>& triangleOrder)
+	{
+		if (source.submeshes.size() != reordered.submeshes.size() || triangleOrder.size() != source.GetTotalTriangleCount())
+		{
+			return false;
+		}
+		std::vector<bool> used(triangleOrder.size(), false);
+		uint32_t triBase = 0;
+		for (size_t s = 0; s < source.submeshes.size(); s++)
+		{
+			auto&& ss = source.submeshes[s];
+			auto&& rs = reordered.submeshes[s];
+			uint32_t triCount = ss.indexCount / 3;
+			for (uint32_t t = 0; t < triCount; t++)
+			{
+				uint32_t sourceTri = triangleOrder[triBase + t];
+				if (sourceTri < triBase || sourceTri >= triBase + triCount || used[sourceTri])
+				{
+					return false;
+				}
+				used[sourceTri] = true;
+				uint32_t a[3], b[3];
+				source.GetTriangle(ss, sourceTri - triBase, a);
+				reordered.GetTriangle(rs, t, b);
+				for (int c = 0; c < 3; c++)
+				{
+					if (!IsSameCorner(source, ss, a[c], reordered, rs, b[c]))
+					{
+						return false;
+					}
+				}
+			}
+			triBase += triCount;
+		}
+		return true;
+	}
+
+	uint32_t LoadU32(const std::vector<uint8_t>& stream, size_t index)
+	{
+		uint32_t ret;
+		memcpy(&ret, stream.data() + index * sizeof(uint32_t), sizeof(ret));
+		return ret;
+	}
+
+	// every meshlet primitive resolves to the triangle at the same place in the index buffer.
+	bool IsMeshletConsistent(const RMesh& mesh)
+	{
+		for (auto&& submesh : mesh.submeshes)
+		{
+			for (auto&& meshlet : submesh.meshlets)
+			{
+				for (uint32_t p = 0; p < meshlet.primitiveCount; p++)
+				{
+					uint32_t packed = LoadU32(mesh.meshletPackedPrimitive, submesh.meshletPrimitiveOffset + meshlet.primitiveOffset + p);
+					uint32_t idx[3];
+					mesh.GetTriangle(submesh, meshlet.indexOffset / 3 + p, idx);
+					for (int c = 0; c < 3; c++)
+					{
+						uint32_t local = (packed >> (c * 10)) & 0x3ff;
+						if (local >= meshlet.vertexIndexCount
+							|| LoadU32(mesh.meshletVertexIndex, submesh.meshletVertexIndexOffset + meshlet.vertexIndexOffset + local) != idx[c])
+						{
+							return false;
+						}
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	// the written file loads back into the same mesh.
+	bool IsSameAfterRoundTrip(const RMesh& mesh, const std::string& filePath)
+	{
+		RMesh loaded;
+		if (!WriteRMesh(filePath, mesh) || !LoadRMesh(filePath, &loaded, 1))
+		{
+			return false;
+		}
+		if (loaded.submeshes.size() != mesh.submeshes.size())
+		{
+			return false;
+		}
+		for (size_t s = 0; s < mesh.submeshes.size(); s++)
+		{
+			auto&& a = mesh.submeshes[s];
+			auto&& b = loaded.submeshes[s];
+			if (a.indexOffsetBytes != b.indexOffsetBytes || a.indexFormat != b.indexFormat || a.meshlets.size() != b.meshlets.size()
+				|| (!a.meshlets.empty() && memcmp(a.meshlets.data(), b.meshlets.data(), a.meshlets.size() * sizeof(RMeshMeshlet)) != 0))
+			{
+				return false;
+			}
+		}
+		return loaded.position == mesh.position && loaded.normal == mesh.normal && loaded.tangent == mesh.tangent
+			&& loaded.texcoord == mesh.texcoord && loaded.index == mesh.index
+			&& loaded.meshletPackedPrimitive == mesh.meshletPackedPrimitive && loaded.meshletVertexIndex == mesh.meshletVertexIndex;
+	}
+
+	std::string FormatChange(double before, double after)
+	{
+		char ret[32];
+		snprintf(ret, sizeof(ret), "%.2f -> %.2f", before, after);
+		return ret;
+	}
+}
+
+int RunReorderBenchmark(const BenchmarkOptions& opt)
+{
+	auto files = FindMeshFiles(opt.homeDir);
+	if (files.empty())
+	{
+		printf("Error: no mesh found.\n");
+		return -1;
+	}
+	std::error_code ec;
+	std::filesystem::path tempDir = std::filesystem::temp_directory_path(ec);
+	if (ec)
+	{
+		printf("Error: no temporary directory.\n");
+		return -1;
+	}
+	int repeatCount = std::max(opt.repeatCount, 1);
+	BvhBuildSettings bvhSettings;
+	bvhSettings.threadCount = opt.threadCount;
+	bool bValid = true;
+
+	// cache lines per leaf of the sah bvh, before -> after the reorder, for each vertex numbering.
+	struct VertexOrderEntry
+	{
+		RMeshVertexOrder	order;
+		const char*			name;
+	};
+	const VertexOrderEntry kVertexOrders[] = {
+		{ kRMeshVertexOrderFirstUse,	"first-use" },
+		{ kRMeshVertexOrderSource,		"source" },
+	};
+	printf("  %-20s %9s %7s %10s %14s %14s %14s %14s %10s %6s %8s %6s\n",
+		"mesh", "tris", "leaves", "vertices", "index", "position", "normal+uv", "total", "reorder ms", "same", "meshlets", "file");
+	for (auto&& file : files)
+	{
+		RMesh source;
+		if (!LoadRMesh(file, &source))
+		{
+			bValid = false;
+			continue;
+		}
+		RMeshLocalityStats before = MeasureRMeshLocality(source, bvhSettings);
+		bool bSourceMeshlets = IsMeshletConsistent(source);
+
+		double totalLines[2] = {};
+		for (int o = 0; o < 2; o++)
+		{
+			auto&& vertexOrder = kVertexOrders[o];
+			RMeshReorderSettings settings;
+			settings.vertexOrder = vertexOrder.order;
+			RMesh reordered;
+			std::vector<uint32_t> triangleOrder;
+			double reorderMs = 1e30;
+			bool bReordered = true;
+			for (int r = 0; r < repeatCount; r++)
+			{
+				reordered = source;
+				auto start = Clock::now();
+				bReordered = bReordered && ReorderRMesh(&reordered, settings, &triangleOrder);
+				reorderMs = std::min(reorderMs, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+			}
+
+			RMeshLocalityStats after = MeasureRMeshLocality(reordered, bvhSettings);
+			bool bSame = bReordered && IsSameTriangles(source, reordered, triangleOrder);
+			bool bMeshlets = bReordered && (!bSourceMeshlets || IsMeshletConsistent(reordered));
+			std::string tempPath = (tempDir / (GetFileName(file) + ".reordered")).string();
+			bool bFile = bReordered && IsSameAfterRoundTrip(reordered, tempPath);
+			std::filesystem::remove(tempPath, ec);
+			bValid = bValid && bSame && bMeshlets && bFile;
+			totalLines[o] = after.GetTotalLines();
+
+			printf("  %-20s %9u %7u %10s %14s %14s %14s %14s %10.3f %6s %8s %6s\n",
+				GetFileName(file).c_str(), before.triangleCount, after.leafCount, vertexOrder.name,
+				FormatChange(before.indexLines, after.indexLines).c_str(),
+				FormatChange(before.positionLines, after.positionLines).c_str(),
+				FormatChange(before.attributeLines, after.attributeLines).c_str(),
+				FormatChange(before.GetTotalLines(), after.GetTotalLines()).c_str(),
+				reorderMs, bSame ? "yes" : "no", bMeshlets ? "yes" : "no", bFile ? "yes" : "no");
+		}
+		// -reorder writes the numbering with fewer lines, first-use only wins over an unoptimized source order.
+		bool bFirstUse = totalLines[0] <= totalLines[1];
+		printf("  %-20s -reorder keeps the %s vertex order, first-use %+.2f lines per leaf against source.\n",
+			"", bFirstUse ? "first-use" : "source", totalLines[0] - totalLines[1]);
+	}
+
+	printf("reordered meshes keep every triangle and meshlet: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+}
+
+//	EOF
@@ -0,0 +1,231 @@
+#include "benchmark.h"
+#include "cpu_parallel.h"
+#include "mapped_file.h"
+#include "rmesh_reader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock	Clock;
+
+	double GetMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	double GetMBps(size_t bytes, double ms)
+	{
+		return (ms > 0.0) ? (double)bytes / (1024.0 * 1024.0) / (ms * 0.001) : 0.0;
+	}
+
+	// the previous loader, the whole file is read into memory and decoded on one thread.
+	bool LoadCopied(const std::string& filePath, RMesh* pOut)
+	{
+		std::ifstream ifs(filePath, std::ios::in | std::ios::binary);
+		if (!ifs)
+		{
+			return false;
+		}
+		std::vector<uint8_t> data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+		return ReadRMesh(data.data(), data.size(), pOut, 1);
+	}
+
+	bool IsSameMesh(const RMesh& a, const RMesh& b)
+	{
+		return a.position == b.position && a.normal == b.normal && a.tangent == b.tangent
+			&& a.texcoord == b.texcoord && a.index == b.index
+			&& a.meshletPackedPrimitive == b.meshletPackedPrimitive && a.meshletVertexIndex == b.meshletVertexIndex
+			&& a.submeshes.size() == b.submeshes.size() && a.materials.size() == b.materials.size();
+	}
+
+	struct SetResult
+	{
+		double	firstReadyMs = 0.0;
+		double	totalMs = 0.0;
+	};
+
+	// every mesh one after another with the previous loader.
+	SetResult LoadSetCopied(const std::vector<std::string>& files, std::vector<RMesh>* pMeshes)
+	{
+		SetResult ret;
+		pMeshes->assign(files.size(), RMesh());
+		auto start = Clock::now();
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			LoadCopied(files[i], &(*pMeshes)[i]);
+			if (i == 0)
+			{
+				ret.firstReadyMs = GetMs(start);
+			}
+		}
+		ret.totalMs = GetMs(start);
+		return ret;
+	}
+
+	// every file is mapped and validated first, then the meshes are decoded one by one with all threads.
+	// bSmallestFirst decodes the smallest mesh first, so that one mesh becomes ready as early as possible.
+	SetResult LoadSetMapped(const std::vector<std::string>& files, uint32_t threadCount, bool bSmallestFirst, std::vector<RMesh>* pMeshes)
+	{
+		SetResult ret;
+		pMeshes->assign(files.size(), RMesh());
+		auto start = Clock::now();
+
+		std::vector<MappedFile> mapped(files.size());
+		std::vector<RMeshView> views(files.size());
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			if (!mapped[i].Open(files[i]) || !ParseRMeshView(mapped[i].GetData(), mapped[i].GetSize(), &views[i]))
+			{
+				return ret;
+			}
+		}
+
+		std::vector<size_t> order(files.size());
+		std::iota(order.begin(), order.end(), (size_t)0);
+		if (bSmallestFirst)
+		{
+			std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return views[a].GetPackedSize() < views[b].GetPackedSize(); });
+		}
+		for (size_t n = 0; n < order.size(); n++)
+		{
+			auto&& view = views[order[n]];
+			auto&& mesh = (*pMeshes)[order[n]];
+			std::vector<uint8_t>* streams[] = {
+				&mesh.position, &mesh.normal, &mesh.tangent, &mesh.texcoord,
+				&mesh.index, &mesh.meshletPackedPrimitive, &mesh.meshletVertexIndex,
+			};
+			uint8_t* pDst[kRMeshStreamMax];
+			for (int s = 0; s < kRMeshStreamMax; s++)
+			{
+				streams[s]->resize(view.streams[s].GetPackedSize());
+				pDst[s] = streams[s]->data();
+			}
+			DecodeRMeshStreams(view, pDst, threadCount);
+			mesh.materials = view.materials;
+			mesh.submeshes = view.submeshes;
+			CompactRMeshIndices(&mesh);
+			if (n == 0)
+			{
+				ret.firstReadyMs = GetMs(start);
+			}
+		}
+		ret.totalMs = GetMs(start);
+		return ret;
+	}
+}
+
+int RunRMeshLoadBenchmark(const BenchmarkOptions& opt)
+{
+	auto files = FindMeshFiles(opt.homeDir);
+	if (files.empty())
+	{
+		printf("Error: no mesh found.\n");
+		return -1;
+	}
+	uint32_t maxThreads = (opt.threadCount == 0) ? GetDefaultThreadCount() : opt.threadCount;
+	int repeatCount = std::max(opt.repeatCount, 1);
+	bool bValid = true;
+
+	// single files, the page cache is warm after the first repeat.
+	printf("per file, best of %d, warm page cache\n", repeatCount);
+	printf("  %-20s %10s %10s %10s %10s %10s %10s %10s %6s\n",
+		"mesh", "file KB", "packed KB", "copy ms", "copy MB/s", "parse ms", "map ms", "map MB/s", "same");
+	size_t totalFileBytes = 0;
+	for (auto&& file : files)
+	{
+		double copyMs = 1e30, parseMs = 1e30, mapMs = 1e30;
+		size_t fileBytes = 0, packedBytes = 0;
+		RMesh copied, mapped;
+		for (int r = 0; r < repeatCount; r++)
+		{
+			auto start = Clock::now();
+			copied = RMesh();
+			LoadCopied(file, &copied);
+			copyMs = std::min(copyMs, GetMs(start));
+
+			// validation of the tables only, no stream is touched.
+			start = Clock::now();
+			MappedFile mf;
+			RMeshView view;
+			if (!mf.Open(file) || !ParseRMeshView(mf.GetData(), mf.GetSize(), &view))
+			{
+				printf("Error: failed to parse mesh file. (%s)\n", file.c_str());
+				return -1;
+			}
+			parseMs = std::min(parseMs, GetMs(start));
+			fileBytes = mf.GetSize();
+			packedBytes = view.GetPackedSize();
+			mf.Close();
+
+			start = Clock::now();
+			mapped = RMesh();
+			LoadRMesh(file, &mapped, maxThreads);
+			mapMs = std::min(mapMs, GetMs(start));
+		}
+		bool bSame = IsSameMesh(copied, mapped);
+		bValid = bValid && bSame;
+		totalFileBytes += fileBytes;
+		printf("  %-20s %10.1f %10.1f %10.3f %10.1f %10.3f %10.3f %10.1f %6s\n",
+			GetFileName(file).c_str(), fileBytes / 1024.0, packedBytes / 1024.0,
+			copyMs, GetMBps(fileBytes, copyMs), parseMs, mapMs, GetMBps(fileBytes, mapMs), bSame ? "yes" : "no");
+	}
+
+	// the whole set, time until the first mesh can be used and until every mesh is loaded.
+	printf("\nall %u files, %.1f KB\n", (uint32_t)files.size(), totalFileBytes / 1024.0);
+	printf("  %-22s %8s %15s %10s %10s %6s\n", "loader", "threads", "first ready ms", "total ms", "MB/s", "same");
+	std::vector<RMesh> reference;
+	SetResult copiedBest;
+	copiedBest.firstReadyMs = copiedBest.totalMs = 1e30;
+	for (int r = 0; r < repeatCount; r++)
+	{
+		SetResult result = LoadSetCopied(files, &reference);
+		copiedBest.firstReadyMs = std::min(copiedBest.firstReadyMs, result.firstReadyMs);
+		copiedBest.totalMs = std::min(copiedBest.totalMs, result.totalMs);
+	}
+	printf("  %-22s %8u %15.3f %10.3f %10.1f %6s\n", "copy, file order", 1u,
+		copiedBest.firstReadyMs, copiedBest.totalMs, GetMBps(totalFileBytes, copiedBest.totalMs), "ref");
+
+	struct MappedRun
+	{
+		const char*	name;
+		uint32_t	threadCount;
+		bool		bSmallestFirst;
+	};
+	std::vector<MappedRun> runs;
+	runs.push_back({ "mmap, file order", maxThreads, false });
+	for (auto threadCount : GetThreadCountSweep(maxThreads))
+	{
+		runs.push_back({ "mmap, smallest first", threadCount, true });
+	}
+	for (auto&& run : runs)
+	{
+		SetResult best;
+		best.firstReadyMs = best.totalMs = 1e30;
+		std::vector<RMesh> meshes;
+		for (int r = 0; r < repeatCount; r++)
+		{
+			SetResult result = LoadSetMapped(files, run.threadCount, run.bSmallestFirst, &meshes);
+			best.firstReadyMs = std::min(best.firstReadyMs, result.firstReadyMs);
+			best.totalMs = std::min(best.totalMs, result.totalMs);
+		}
+		bool bSame = meshes.size() == reference.size();
+		for (size_t i = 0; bSame && i < meshes.size(); i++)
+		{
+			bSame = IsSameMesh(reference[i], meshes[i]);
+		}
+		bValid = bValid && bSame;
+		printf("  %-22s %8u %15.3f %10.3f %10.1f %6s\n", run.name, run.threadCount,
+			best.firstReadyMs, best.totalMs, GetMBps(totalFileBytes, best.totalMs), bSame ? "yes" : "no");
+	}
+
+	printf("mapped meshes match the copied ones: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+}
+
+//	EOF
@@ -0,0 +1,215 @@
+#include "benchmark.h"
+#include "cpu_scene.h"
+#include "mapped_file.h"
+#include "rmesh_v2.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock	Clock;
+
+	double GetMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	template <typename T>
+	bool IsSameBytes(const std::vector<T>& a, const std::vector<T>& b)
+	{
+		return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+	}
+
+	bool IsSameAabb(const Aabb& a, const Aabb& b)
+	{
+		return memcmp(&a, &b, sizeof(Aabb)) == 0;
+	}
+
+	bool IsSameMaterial(const RMeshMaterial& a, const RMeshMaterial& b)
+	{
+		return a.name == b.name && a.textureNames == b.textureNames
+			&& memcmp(a.baseColor, b.baseColor, sizeof(a.baseColor)) == 0
+			&& memcmp(a.emissiveColor, b.emissiveColor, sizeof(a.emissiveColor)) == 0
+			&& a.roughness == b.roughness && a.metallic == b.metallic && a.isOpaque == b.isOpaque;
+	}
+
+	bool IsSameSubmesh(const RMeshSubmesh& a, const RMeshSubmesh& b)
+	{
+		return a.materialIndex == b.materialIndex
+			&& a.vertexOffset == b.vertexOffset && a.vertexCount == b.vertexCount
+			&& a.indexOffset == b.indexOffset && a.indexCount == b.indexCount
+			&& a.meshletPrimitiveOffset == b.meshletPrimitiveOffset && a.meshletPrimitiveCount == b.meshletPrimitiveCount
+			&& a.meshletVertexIndexOffset == b.meshletVertexIndexOffset && a.meshletVertexIndexCount == b.meshletVertexIndexCount
+			&& IsSameBytes(a.meshlets, b.meshlets)
+			&& memcmp(&a.bounding, &b.bounding, sizeof(a.bounding)) == 0
+			&& a.positionOffsetBytes == b.positionOffsetBytes && a.normalOffsetBytes == b.normalOffsetBytes
+			&& a.tangentOffsetBytes == b.tangentOffsetBytes && a.texcoordOffsetBytes == b.texcoordOffsetBytes
+			&& a.indexOffsetBytes == b.indexOffsetBytes && a.indexFormat == b.indexFormat;
+	}
+
+	// every field of the v1 load survives the round trip.
+	bool IsSameMesh(const RMesh& a, const RMesh& b)
+	{
+		if (a.materials.size() != b.materials.size() || a.submeshes.size() != b.submeshes.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < a.materials.size(); i++)
+		{
+			if (!IsSameMaterial(a.materials[i], b.materials[i]))
+			{
+				return false;
+			}
+		}
+		for (size_t i = 0; i < a.submeshes.size(); i++)
+		{
+			if (!IsSameSubmesh(a.submeshes[i], b.submeshes[i]))
+			{
+				return false;
+			}
+		}
+		return memcmp(&a.bounding, &b.bounding, sizeof(a.bounding)) == 0
+			&& a.positionScale.x == b.positionScale.x && a.positionScale.y == b.positionScale.y && a.positionScale.z == b.positionScale.z
+			&& a.positionOffset.x == b.positionOffset.x && a.positionOffset.y == b.positionOffset.y && a.positionOffset.z == b.positionOffset.z
+			&& a.position == b.position && a.normal == b.normal && a.tangent == b.tangent
+			&& a.texcoord == b.texcoord && a.index == b.index
+			&& a.meshletPackedPrimitive == b.meshletPackedPrimitive && a.meshletVertexIndex == b.meshletVertexIndex;
+	}
+
+	// a submesh bvh references each triangle of the submesh at least once.
+	bool IsValidSubmeshBvh(const RMeshBvhData& bvh, const RMeshSubmesh& submesh)
+	{
+		if (bvh.header.triangleCount != submesh.indexCount / 3 || bvh.nodes.empty() != (bvh.header.triangleCount == 0))
+		{
+			return false;
+		}
+		std::vector<bool> referenced(bvh.header.triangleCount, false);
+		for (auto&& node : bvh.nodes)
+		{
+			for (uint32_t i = 0; node.IsLeaf() && i < node.primCount; i++)
+			{
+				referenced[bvh.primIndices[node.leftFirst + i]] = true;
+			}
+		}
+		return std::find(referenced.begin(), referenced.end(), false) == referenced.end();
+	}
+
+	bool IsSameCpuMesh(const CpuMesh& a, const CpuMesh& b)
+	{
+		auto&& ta = a.GetTriangles();
+		auto&& tb = b.GetTriangles();
+		return IsSameBytes(a.GetBvh().GetNodes(), b.GetBvh().GetNodes())
+			&& IsSameBytes(a.GetBvh().GetPrimIndices(), b.GetBvh().GetPrimIndices())
+			&& ta.size() == tb.size() && (ta.empty() || memcmp(ta.data(), tb.data(), ta.size() * sizeof(ta[0])) == 0)
+			&& IsSameAabb(a.GetBounds(), b.GetBounds());
+	}
+}
+
+int RunRMeshV2Benchmark(const BenchmarkOptions& opt)
+{
+	auto files = FindMeshFiles(opt.homeDir);
+	if (files.empty())
+	{
+		printf("Error: no mesh found.\n");
+		return -1;
+	}
+	int repeatCount = std::max(opt.repeatCount, 1);
+	std::error_code ec;
+	std::filesystem::path tempDir = std::filesystem::temp_directory_path(ec);
+	if (ec)
+	{
+		printf("Error: no temporary directory.\n");
+		return -1;
+	}
+	bool bValid = true;
+
+	// v1 startup is load + bvh build, v2 startup is the load of the cooked file.
+	printf("round trip through .rmesh v2, best of %d\n", repeatCount);
+	printf("  %-20s %10s %10s %7s %7s %12s %12s %8s %6s %6s %6s\n",
+		"mesh", "v1 KB", "v2 KB", "chunks", "bvhs", "v1 start ms", "v2 start ms", "speedup", "mesh", "bounds", "bvh");
+	for (auto&& file : files)
+	{
+		RMesh source;
+		if (!LoadRMesh(file, &source))
+		{
+			bValid = false;
+			continue;
+		}
+		RMeshV2Settings settings;
+		settings.bSubmeshBvh = true;
+		std::string cookedPath = (tempDir / (GetFileName(file) + ".v2")).string();
+		if (!WriteRMeshV2(cookedPath, source, settings))
+		{
+			bValid = false;
+			continue;
+		}
+
+		// streams, tables and stored bounds.
+		RMesh cooked;
+		RMeshAccel accel, reference;
+		bool bLoaded = LoadRMeshAny(cookedPath, &cooked, &accel);
+		ComputeRMeshBounds(source, &reference);
+		bool bSameMesh = bLoaded && IsSameMesh(source, cooked);
+		bool bSameBounds = bLoaded && IsSameAabb(accel.bounds, reference.bounds) && accel.submeshBounds.size() == reference.submeshBounds.size();
+		for (size_t s = 0; bSameBounds && s < reference.submeshBounds.size(); s++)
+		{
+			bSameBounds = IsSameAabb(accel.submeshBounds[s], reference.submeshBounds[s]);
+		}
+
+		// the prebuilt bvh is the one CpuMesh builds, submesh bvhs cover their triangles.
+		double v1Ms = 1e30, v2Ms = 1e30;
+		bool bSameBvh = bLoaded && accel.FindBvh(kRMeshV2WholeMesh) != nullptr;
+		for (size_t s = 0; bSameBvh && s < source.submeshes.size(); s++)
+		{
+			auto pBvh = accel.FindBvh((uint32_t)s);
+			bSameBvh = pBvh && IsValidSubmeshBvh(*pBvh, source.submeshes[s]);
+		}
+		for (int r = 0; r < repeatCount; r++)
+		{
+			CpuMesh rebuilt, prebuilt;
+			auto start = Clock::now();
+			rebuilt.Initialize(file);
+			rebuilt.BuildBvh();
+			v1Ms = std::min(v1Ms, GetMs(start));
+
+			start = Clock::now();
+			prebuilt.Initialize(cookedPath);
+			v2Ms = std::min(v2Ms, GetMs(start));
+			bSameBvh = bSameBvh && !prebuilt.GetBvh().IsEmpty() && IsSameCpuMesh(rebuilt, prebuilt);
+		}
+
+		MappedFile mapped;
+		RMeshV2File v2;
+		if (mapped.Open(cookedPath))
+		{
+			ParseRMeshV2(mapped.GetData(), mapped.GetSize(), &v2);
+		}
+		bValid = bValid && bSameMesh && bSameBounds && bSameBvh;
+		printf("  %-20s %10.1f %10.1f %7u %7u %12.3f %12.3f %7.2fx %6s %6s %6s\n",
+			GetFileName(file).c_str(),
+			std::filesystem::file_size(file, ec) / 1024.0, mapped.GetSize() / 1024.0,
+			(uint32_t)v2.chunks.size(), (uint32_t)accel.bvhs.size(),
+			v1Ms, v2Ms, (v2Ms > 0.0) ? v1Ms / v2Ms : 0.0,
+			bSameMesh ? "yes" : "no", bSameBounds ? "yes" : "no", bSameBvh ? "yes" : "no");
+		mapped.Close();
+		std::filesystem::remove(cookedPath, ec);
+	}
+
+	// v1 files still load, without acceleration data.
+	{
+		RMesh mesh;
+		RMeshAccel accel;
+		bool bV1 = LoadRMeshAny(files[0], &mesh, &accel) && accel.bvhs.empty();
+		bValid = bValid && bV1;
+	}
+
+	printf("v2 files match the v1 meshes and the rebuilt bvhs: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+}
+
+//	EOF
@@ -0,0 +1,216 @@
+#include "benchmark.h"
+#include "cpu_scene_update.h"
+#include "rmesh_reader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+
+namespace
+{
+	static const uint32_t kInstanceCounts[] = { 1 << 10, 1 << 14, 1 << 17 };
+	static const uint32_t kFrameCount = 60;
+	// same spacing as the meshType 0 grid of SampleApplication.
+	static const float kMeshInter = 100.0f;
+
+	struct InstanceState
+	{
+		Vec3	position;
+		Vec3	rotation;
+	};
+
+	// how the instances move in each frame.
+	enum class Motion
+	{
+		Static,			// the same transforms are set every frame, as SampleApplication does.
+		FewBobbing,		// 1% of the instances move up and down.
+		AllBobbing,		// every instance moves up and down a little.
+		AllScatter,		// every instance jumps to a random height.
+	};
+
+	struct Scenario
+	{
+		const char*	name;
+		Motion		motion;
+	};
+
+	static const Scenario kScenarios[] = {
+		{"static",		Motion::Static},
+		{"few bobbing",	Motion::FewBobbing},
+		{"all bobbing",	Motion::AllBobbing},
+		{"all scatter",	Motion::AllScatter},
+	};
+
+	std::vector<InstanceState> GenerateInstances(uint32_t instanceCount)
+	{
+		uint32_t width = (uint32_t)std::ceil(std::sqrt((double)instanceCount));
+		float origin = -(float)(width - 1) * kMeshInter * 0.5f;
+		std::mt19937 rnd(0);
+		std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+		std::vector<InstanceState> ret(instanceCount);
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			ret[i].position = Vec3(origin + (i % width) * kMeshInter, dist(rnd) * 100.0f, origin + (i / width) * kMeshInter);
+			ret[i].rotation = Vec3(dist(rnd) * kCpuPI, dist(rnd) * kCpuPI, dist(rnd) * kCpuPI);
+		}
+		return ret;
+	}
+
+	DirectX::XMFLOAT4X4 GetMatrix(const InstanceState& inst, const Vec3& offset)
+	{
+		Vec3 p = inst.position + offset;
+		return MatrixMultiply(MatrixRotationRollPitchYaw(inst.rotation.x, inst.rotation.y, inst.rotation.z), MatrixTranslation(p.x, p.y, p.z));
+	}
+
+	// every instance is contained by its leaf and every node by its parent.
+	bool ValidateTlas(const SceneUpdateTracker& tracker)
+	{
+		auto&& nodes = tracker.GetTlas().GetNodes();
+		auto&& primIndices = tracker.GetTlas().GetPrimIndices();
+		auto Contains = [](const BvhNode& node, const Aabb& b)
+		{
+			return node.bmin[0] <= b.bmin.x && node.bmin[1] <= b.bmin.y && node.bmin[2] <= b.bmin.z
+				&& node.bmax[0] >= b.bmax.x && node.bmax[1] >= b.bmax.y && node.bmax[2] >= b.bmax.z;
+		};
+		for (auto&& node : nodes)
+		{
+			if (node.IsLeaf())
+			{
+				for (uint32_t i = 0; i < node.primCount; i++)
+				{
+					if (!Contains(node, tracker.GetWorldBounds(primIndices[node.leftFirst + i])))
+					{
+						return false;
+					}
+				}
+				continue;
+			}
+			for (uint32_t c = 0; c < 2; c++)
+			{
+				if (!Contains(node, nodes[node.leftFirst + c].GetAabb()))
+				{
+					return false;
+				}
+			}
+		}
+		return primIndices.size() == tracker.GetInstanceCount();
+	}
+}
+
+int RunSceneUpdateBenchmark(const BenchmarkOptions& opt)
+{
+	// instances of hp_suzanne if it exists, same as meshType 0.
+	auto files = FindMeshFiles(opt.homeDir);
+	Aabb localBounds(Vec3(-1.0f), Vec3(1.0f));
+	std::string meshName = "unit box";
+	for (auto&& file : files)
+	{
+		RMesh mesh;
+		if (file.find("suzanne") != std::string::npos && LoadRMesh(file, &mesh))
+		{
+			localBounds = mesh.bounding.GetBox();
+			meshName = GetFileName(file);
+			break;
+		}
+	}
+
+	SceneUpdateSettings settings;
+	settings.bvh.threadCount = opt.threadCount;
+	settings.bvh.maxLeafSize = 1;
+
+	printf("instance: %s, %u frames per scenario\n", meshName.c_str(), kFrameCount);
+	printf("  %-9s %-12s %6s %6s %8s %9s %11s %11s %10s %11s %10s %6s\n",
+		"instances", "scenario", "no-op", "refit", "rebuild", "dirty/f", "nodes/f", "work/f",
+		"update ms", "rebuild ms", "area", "valid");
+	bool bStaticClean = true;
+	for (auto instanceCount : kInstanceCounts)
+	{
+		auto states = GenerateInstances(instanceCount);
+		std::mt19937 rnd(1);
+		std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+		// full rebuild every frame, the current behavior of SampleApplication::Execute().
+		double fullRebuildMs = 0.0;
+		{
+			SceneUpdateTracker tracker;
+			double bestMs = 1e30;
+			for (int r = 0; r < std::max(opt.repeatCount, 1); r++)
+			{
+				tracker.Clear();
+				for (auto&& inst : states)
+				{
+					tracker.AddInstance(localBounds, GetMatrix(inst, Vec3(0.0f)));
+				}
+				tracker.Update(settings);
+				bestMs = std::min(bestMs, tracker.GetLastFrameCounters().rebuildMs);
+			}
+			fullRebuildMs = bestMs;
+		}
+
+		for (auto&& scenario : kScenarios)
+		{
+			SceneUpdateTracker tracker;
+			for (auto&& inst : states)
+			{
+				tracker.AddInstance(localBounds, GetMatrix(inst, Vec3(0.0f)));
+			}
+			tracker.Update(settings);
+			tracker.ResetCounters();
+			uint64_t version = tracker.GetTlasVersion();
+
+			double totalMs = 0.0;
+			std::vector<DirectX::XMFLOAT4X4> matrices(instanceCount);
+			for (uint32_t frame = 1; frame <= kFrameCount; frame++)
+			{
+				for (uint32_t i = 0; i < instanceCount; i++)
+				{
+					Vec3 offset(0.0f);
+					switch (scenario.motion)
+					{
+					case Motion::FewBobbing:
+						offset.y = (i % 100 == 0) ? std::sin((float)frame * 0.1f + (float)i) * 10.0f : 0.0f;
+						break;
+					case Motion::AllBobbing:
+						offset.y = std::sin((float)frame * 0.1f + (float)i) * 10.0f;
+						break;
+					case Motion::AllScatter:
+						offset.y = dist(rnd) * 1000.0f;
+						break;
+					default:
+						break;
+					}
+					matrices[i] = GetMatrix(states[i], offset);
+				}
+
+				// dirty tracking and the tlas update.
+				auto start = std::chrono::high_resolution_clock::now();
+				for (uint32_t i = 0; i < instanceCount; i++)
+				{
+					tracker.SetMtxLocalToWorld(i, matrices[i]);
+				}
+				tracker.Update(settings);
+				totalMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			}
+
+			auto&& c = tracker.GetCounters();
+			if (scenario.motion == Motion::Static && (c.GetBuildWork() != 0 || tracker.GetTlasVersion() != version))
+			{
+				bStaticClean = false;
+			}
+			printf("  %-9u %-12s %6llu %6llu %8llu %9.1f %11.1f %11.1f %10.3f %11.3f %10.2f %6s\n",
+				instanceCount, scenario.name,
+				(unsigned long long)c.noopCount, (unsigned long long)c.refitCount, (unsigned long long)c.rebuildCount,
+				(double)c.dirtyInstances / kFrameCount, (double)c.refitNodes / kFrameCount, (double)c.GetBuildWork() / kFrameCount,
+				totalMs / kFrameCount, fullRebuildMs, tracker.GetAreaRatio(),
+				ValidateTlas(tracker) ? "yes" : "no");
+		}
+	}
+
+	// static frames must not touch the tlas.
+	printf("static frames build work: %s\n", bStaticClean ? "zero" : "NOT ZERO");
+	return bStaticClean ? 0 : -1;
+}
+
+//	EOF
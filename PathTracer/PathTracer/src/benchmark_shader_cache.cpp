@@ -0,0 +1,320 @@
+#include "benchmark.h"
+#include "cpu_task.h"
+#include "shader_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <set>
+
+
+namespace
+{
+	// same directories as SampleApplication.
+	static const char* kShaderDir = "PathTracer/shaders";
+	static const char* kShaderIncludeDir = "../SampleLib12/SampleLib12/shaders/include";
+	static const char* kShaderFiles[] = {
+		"fullscreen.vv.hlsl",
+		"tonemap.p.hlsl",
+		"material.lib.hlsl",
+		"pathtracer.lib.hlsl",
+	};
+	static const char* kStandInCompilerId = "stand-in";
+
+	bool WriteText(const std::filesystem::path& filePath, const std::string& text)
+	{
+		FILE* fp = fopen(filePath.string().c_str(), "wb");
+		if (!fp)
+		{
+			return false;
+		}
+		fwrite(text.data(), 1, text.size(), fp);
+		fclose(fp);
+		return true;
+	}
+
+	// SampleLib12 lives outside this tree. each of its headers that the shaders include becomes an empty stub in stubDir,
+	// so that every shader has a key. stubs have no includes of their own.
+	bool WriteIncludeStubs(const std::filesystem::path& shaderDir, const std::filesystem::path& stubDir, std::set<std::string>* pNames)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(stubDir, ec);
+		for (auto&& entry : std::filesystem::directory_iterator(shaderDir, ec))
+		{
+			std::ifstream ifs(entry.path());
+			std::string line;
+			while (std::getline(ifs, line))
+			{
+				size_t p = line.find_first_not_of(" \t");
+				if (p == std::string::npos || line[p] != '#')
+				{
+					continue;
+				}
+				p = line.find_first_not_of(" \t", p + 1);
+				if (p == std::string::npos || line.compare(p, 7, "include") != 0)
+				{
+					continue;
+				}
+				size_t begin = line.find_first_of("\"<", p + 7);
+				size_t end = (begin == std::string::npos) ? begin : line.find_first_of("\">", begin + 1);
+				if (end == std::string::npos)
+				{
+					continue;
+				}
+				std::string name = line.substr(begin + 1, end - begin - 1);
+				if (!std::filesystem::exists(shaderDir / name, ec) && pNames->insert(name).second
+					&& !WriteText(stubDir / name, "// empty stub of a SampleLib12 header.\n"))
+				{
+					return false;
+				}
+			}
+		}
+		return !ec;
+	}
+
+	// without dxc the "binary" is the source with its includes appended, which exercises the same cache paths.
+	bool CompileStandIn(const ShaderCompileDesc& desc, const std::vector<std::string>& includeDirs, std::vector<uint8_t>* pBinary)
+	{
+		ShaderCacheKey key;
+		if (!MakeShaderCacheKey(desc, includeDirs, kStandInCompilerId, &key))
+		{
+			return false;
+		}
+		pBinary->clear();
+		for (auto&& file : key.files)
+		{
+			FILE* fp = fopen(file.c_str(), "rb");
+			if (!fp)
+			{
+				return false;
+			}
+			char buffer[4096];
+			size_t size;
+			while ((size = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+			{
+				pBinary->insert(pBinary->end(), buffer, buffer + size);
+			}
+			fclose(fp);
+		}
+		return true;
+	}
+
+	// the key follows every input and ignores files nobody includes.
+	bool ValidateKeys(const std::filesystem::path& dir)
+	{
+		std::error_code ec;
+		auto srcDir = dir / "src";
+		auto incDir = dir / "inc";
+		std::filesystem::create_directories(srcDir, ec);
+		std::filesystem::create_directories(incDir, ec);
+		bool bWritten = WriteText(srcDir / "a.lib.hlsl", "#include \"b.hlsli\"\n  #  include <c.hlsli>\nvoid main() {}\n")
+			&& WriteText(srcDir / "b.hlsli", "#define B 1\n")
+			&& WriteText(incDir / "c.hlsli", "#include \"d.hlsli\"\n")
+			&& WriteText(incDir / "d.hlsli", "#define D 1\n");
+		if (!bWritten)
+		{
+			return false;
+		}
+
+		std::vector<std::string> includeDirs = { incDir.string() };
+		ShaderCompileDesc desc;
+		desc.filePath = (srcDir / "a.lib.hlsl").string();
+		desc.target = GetShaderTarget(desc.filePath);
+		desc.defines = { { "ENABLE_DYNAMIC_RESOURCE", "0" } };
+		auto Key = [&](const ShaderCompileDesc& d, const char* compilerId)
+		{
+			ShaderCacheKey key;
+			return MakeShaderCacheKey(d, includeDirs, compilerId, &key) ? key.ToString() : std::string();
+		};
+
+		std::string base = Key(desc, "x");
+		bool bValid = !base.empty() && base == Key(desc, "x") && desc.target == "lib_6_6";
+
+		struct Check
+		{
+			const char*	name;
+			bool		bPassed;
+		};
+		std::vector<Check> checks;
+		checks.push_back({ "4 files", [&]() { ShaderCacheKey k; return MakeShaderCacheKey(desc, includeDirs, "x", &k) && k.files.size() == 4; }() });
+		checks.push_back({ "compiler", Key(desc, "y") != base });
+		{
+			auto d = desc;
+			d.defines[0].second = "1";
+			checks.push_back({ "define", Key(d, "x") != base });
+		}
+		{
+			auto d = desc;
+			d.target = "lib_6_5";
+			checks.push_back({ "target", Key(d, "x") != base });
+		}
+		{
+			auto d = desc;
+			d.entryPoint = "main2";
+			checks.push_back({ "entry", Key(d, "x") != base });
+		}
+		WriteText(incDir / "d.hlsli", "#define D 2\n");
+		checks.push_back({ "nested include", Key(desc, "x") != base });
+		WriteText(incDir / "d.hlsli", "#define D 1\n");
+		checks.push_back({ "restored include", Key(desc, "x") == base });
+		WriteText(incDir / "e.hlsli", "#define E 1\n");
+		checks.push_back({ "unrelated file", Key(desc, "x") == base });
+		std::filesystem::remove(incDir / "d.hlsli", ec);
+		printf("  expected error of the missing include check:\n    ");
+		checks.push_back({ "missing include", Key(desc, "x").empty() });
+
+		printf("  key checks:");
+		for (auto&& c : checks)
+		{
+			printf(" %s %s,", c.name, c.bPassed ? "ok" : "NG");
+			bValid = bValid && c.bPassed;
+		}
+		printf("\n");
+		return bValid;
+	}
+}
+
+
+int RunShaderCacheBenchmark(const BenchmarkOptions& opt)
+{
+	std::error_code ec;
+	auto tempDir = std::filesystem::path(opt.homeDir) / "temp" / "shader_cache_bench";
+	std::filesystem::remove_all(tempDir, ec);
+
+	printf("keys:\n");
+	bool bValid = ValidateKeys(tempDir / "keys");
+
+	// a copy of the shaders, so that an include can be edited.
+	auto shaderDir = tempDir / "shaders";
+	std::filesystem::create_directories(shaderDir, ec);
+	std::filesystem::copy(std::filesystem::path(opt.homeDir) / kShaderDir, shaderDir, std::filesystem::copy_options::recursive, ec);
+	if (ec)
+	{
+		printf("Error: failed to copy shaders. (%s)\n", kShaderDir);
+		return -1;
+	}
+	auto includeDir = std::filesystem::path(opt.homeDir) / kShaderIncludeDir;
+	bool bStubs = !std::filesystem::exists(includeDir, ec);
+	if (bStubs)
+	{
+		includeDir = tempDir / "include";
+		std::set<std::string> stubNames;
+		if (!WriteIncludeStubs(shaderDir, includeDir, &stubNames))
+		{
+			printf("Error: failed to write include stubs.\n");
+			return -1;
+		}
+		printf("includes: %s not found, empty stubs of", kShaderIncludeDir);
+		for (auto&& name : stubNames)
+		{
+			printf(" %s", name.c_str());
+		}
+		printf("\n");
+	}
+	std::vector<std::string> includeDirs = { includeDir.string() };
+
+	// dxc can not compile against the stubs, the stand-in compiler hashes them like real headers.
+	std::string dxcPath = bStubs ? std::string() : FindDxc();
+	std::string compilerId = dxcPath.empty() ? std::string() : GetDxcCompilerId(dxcPath);
+	ShaderCompileFunc compile;
+	if (!compilerId.empty())
+	{
+		compile = [&](const ShaderCompileDesc& desc, std::vector<uint8_t>* pBinary) { return CompileShaderDxc(dxcPath, desc, includeDirs, pBinary); };
+	}
+	else
+	{
+		compilerId = kStandInCompilerId;
+		compile = [&](const ShaderCompileDesc& desc, std::vector<uint8_t>* pBinary) { return CompileStandIn(desc, includeDirs, pBinary); };
+	}
+	printf("compiler: %s%s\n", compilerId.c_str(), bStubs ? " (include stubs)" : (dxcPath.empty() ? " (dxc not found, set DXC or PATH)" : ""));
+
+	// both ENABLE_DYNAMIC_RESOURCE variants, as if both builds shared the cache.
+	// a shader without a key is reported, left out of the timings and fails the check.
+	printf("shaders:\n");
+	std::vector<ShaderCompileDesc> descs;
+	uint32_t skippedCount = 0;
+	for (auto file : kShaderFiles)
+	{
+		for (int dr = 0; dr < 2; dr++)
+		{
+			ShaderCompileDesc desc;
+			desc.filePath = (shaderDir / file).string();
+			desc.target = GetShaderTarget(file);
+			desc.defines = { { "ENABLE_DYNAMIC_RESOURCE", dr ? "1" : "0" } };
+			ShaderCacheKey key;
+			if (!MakeShaderCacheKey(desc, includeDirs, compilerId, &key))
+			{
+				printf("  %-20s dr %d skipped, an include is missing\n", file, dr);
+				skippedCount++;
+				continue;
+			}
+			printf("  %-20s dr %d %s %-8s %zu files\n", file, dr, key.ToString().c_str(), desc.target.c_str(), key.files.size());
+			descs.push_back(desc);
+		}
+	}
+	if (descs.empty())
+	{
+		printf("Error: no shader has a key.\n");
+		return -1;
+	}
+
+	bValid = bValid && skippedCount == 0;
+	printf("cold / warm: %zu shaders, %u skipped\n", descs.size(), skippedCount);
+	printf("  %-8s %10s %10s %10s %8s %6s\n", "threads", "cold ms", "warm ms", "edit ms", "speedup", "same");
+	ShaderCache cache;
+	for (auto threadCount : GetThreadCountSweep(opt.threadCount))
+	{
+		TaskScheduler scheduler;
+		scheduler.Initialize(threadCount);
+		double coldMs = 0.0, warmMs = 0.0, editMs = 0.0;
+		bool bSame = true;
+		for (int r = 0; r < std::max(opt.repeatCount, 1); r++)
+		{
+			// cold: empty cache, every shader compiles.
+			std::filesystem::remove_all(tempDir / "cache", ec);
+			if (!cache.Initialize((tempDir / "cache").string()))
+			{
+				return -1;
+			}
+			std::vector<std::vector<uint8_t>> cold, warm, edit;
+			ShaderCacheStats coldStats, warmStats, editStats;
+			bool bCompiled = CompileShadersCached(descs, includeDirs, compilerId, cache, compile, &scheduler, &cold, &coldStats);
+
+			// warm: every shader loads.
+			bCompiled = CompileShadersCached(descs, includeDirs, compilerId, cache, compile, &scheduler, &warm, &warmStats) && bCompiled;
+
+			// an edit of cbuffer.hlsli recompiles only the shaders including it.
+			std::string cbufferPath = (shaderDir / "cbuffer.hlsli").string();
+			FILE* fp = fopen(cbufferPath.c_str(), "ab");
+			if (fp)
+			{
+				fprintf(fp, "\n// edit %d\n", r);
+				fclose(fp);
+			}
+			uint32_t includerCount = 0;
+			for (auto&& desc : descs)
+			{
+				ShaderCacheKey key;
+				MakeShaderCacheKey(desc, includeDirs, compilerId, &key);
+				includerCount += std::find(key.files.begin(), key.files.end(), std::filesystem::path(cbufferPath).lexically_normal().string()) != key.files.end();
+			}
+			bCompiled = CompileShadersCached(descs, includeDirs, compilerId, cache, compile, &scheduler, &edit, &editStats) && bCompiled;
+
+			bSame = bSame && bCompiled && cold == warm
+				&& coldStats.missCount == descs.size() && warmStats.hitCount == descs.size()
+				&& editStats.missCount == includerCount && editStats.hitCount == descs.size() - includerCount;
+			coldMs = (r == 0) ? coldStats.elapsedMs : std::min(coldMs, coldStats.elapsedMs);
+			warmMs = (r == 0) ? warmStats.elapsedMs : std::min(warmMs, warmStats.elapsedMs);
+			editMs = (r == 0) ? editStats.elapsedMs : std::min(editMs, editStats.elapsedMs);
+		}
+		bValid = bValid && bSame;
+		printf("  %-8u %10.3f %10.3f %10.3f %7.2fx %6s\n", threadCount, coldMs, warmMs, editMs, coldMs / warmMs, bSame ? "yes" : "NO");
+	}
+
+	std::filesystem::remove_all(tempDir, ec);
+	printf("keys follow their inputs and warm starts load every shader: %s\n", bValid ? "yes" : "NO");
+	return bValid ? 0 : -1;
+}
+
+//	EOF
@@ -0,0 +1,375 @@
+#include "benchmark.h"
+#include "cpu_shader_table.h"
+#include "rmesh_reader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+
+namespace
+{
+	// same grid as meshType 0 of SampleApplication.
+	static const uint32_t kMeshWidth = 32;
+	// LocalTable of CreateRayTracingShaderTable(), cbv, srv and sampler tables.
+	static const uint32_t kLocalTableSize = kDescriptorHandleSize * 3;
+	static const uint32_t kRTMaterialTableCount = 1;
+	// CopyDescriptors calls and descriptors per record, 1 cbv + 4 srv, 1 sampler.
+	static const uint32_t kCopyCallsPerRecord = 3;
+	static const uint32_t kDescriptorsPerRecord = 6;
+
+	struct MeshInfo
+	{
+		std::string				name;
+		uint32_t				resourceId;
+		std::vector<uint32_t>	materials;		// per submesh.
+	};
+
+	struct SceneDesc
+	{
+		const char*				name;
+		std::vector<uint32_t>	instanceMeshes;
+	};
+
+	// every instance finds its own (resource, submesh, material) at its offset, and no record is duplicated.
+	bool VerifyLayout(const HitGroupTableLayout& layout, const std::vector<MeshInfo>& meshes, const std::vector<uint32_t>& instanceMeshes)
+	{
+		for (uint32_t inst = 0; inst < layout.GetInstanceCount(); inst++)
+		{
+			auto&& mesh = meshes[instanceMeshes[inst]];
+			uint32_t offset = layout.GetInstanceRecordOffset(inst);
+			if (layout.GetInstanceSubmeshCount(inst) != mesh.materials.size() || offset + mesh.materials.size() > layout.GetRecordCount())
+			{
+				return false;
+			}
+			for (uint32_t i = 0; i < (uint32_t)mesh.materials.size(); i++)
+			{
+				HitGroupRecordKey key = { mesh.resourceId, i, mesh.materials[i] };
+				if (!(layout.GetRecord(offset + i) == key))
+				{
+					return false;
+				}
+			}
+		}
+		for (uint32_t i = 0; i < layout.GetRecordCount(); i++)
+		{
+			for (uint32_t j = i + 1; j < layout.GetRecordCount(); j++)
+			{
+				if (layout.GetRecord(i) == layout.GetRecord(j))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool RunScene(const SceneDesc& scene, const std::vector<MeshInfo>& meshes, uint32_t recordSize)
+	{
+		HitGroupTableLayout layout;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (auto&& meshIndex : scene.instanceMeshes)
+		{
+			auto&& mesh = meshes[meshIndex];
+			layout.AddInstance(mesh.resourceId, mesh.materials.data(), (uint32_t)mesh.materials.size());
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		bool bValid = VerifyLayout(layout, meshes, scene.instanceMeshes);
+
+		uint32_t before = layout.GetPerInstanceRecordCount();
+		uint32_t after = layout.GetRecordCount();
+		// the bound table keeps one slot per instance submesh, see RunShaderTableBenchmark().
+		uint64_t tableBytes = HitGroupTableLayout::GetTableBytes(before, recordSize, kRTMaterialTableCount);
+		printf("  %-14s %9u %9u %9u %12llu %10u %10u %10u %10u %8.3f %6s\n",
+			scene.name, layout.GetInstanceCount(), before, after, (unsigned long long)tableBytes,
+			before * kDescriptorsPerRecord, after * kDescriptorsPerRecord,
+			before * kCopyCallsPerRecord, after * kCopyCallsPerRecord, ms, bValid ? "yes" : "no");
+		return bValid;
+	}
+
+	// streaming scenario of the patch benchmark.
+	static const uint32_t kStreamResourceCount = 64;
+	static const uint32_t kStreamFrameCount = 240;
+	static const uint32_t kStreamMaxSubmeshes = 8;
+
+	// LocalTable with gpu descriptor handles made up from the resource and submesh.
+	struct MockLocalTable
+	{
+		uint64_t	cbv;
+		uint64_t	srv;
+		uint64_t	sampler;
+	};
+
+	struct MockResource
+	{
+		uint32_t			submeshCount;
+		std::vector<bool>	opaque;
+	};
+
+	// shader identifiers of the opaque and masked hit groups, any distinct non zero bytes.
+	struct MockIdentifiers
+	{
+		uint8_t	ids[2][kShaderIdentifierSize];
+
+		MockIdentifiers()
+		{
+			for (uint32_t i = 0; i < kShaderIdentifierSize; i++)
+			{
+				ids[0][i] = (uint8_t)(0x10 + i);
+				ids[1][i] = (uint8_t)(0x80 + i);
+			}
+		}
+	};
+
+	MockLocalTable GetMockLocalTable(uint32_t resource, uint32_t submesh)
+	{
+		uint64_t base = ((uint64_t)resource << 16) | ((uint64_t)submesh << 4);
+		return { 0x100000000ull + base, 0x200000000ull + base, 0x300000000ull + base };
+	}
+
+	void WriteResourceRecords(ShaderTableManager& table, const MockIdentifiers& ids, const MockResource& res, uint32_t resource, uint32_t firstSlot)
+	{
+		for (uint32_t i = 0; i < res.submeshCount; i++)
+		{
+			MockLocalTable local = GetMockLocalTable(resource, i);
+			table.WriteRecord(firstSlot + i, ids.ids[res.opaque[i] ? 0 : 1], &local, sizeof(local));
+		}
+	}
+
+	// records of live resources match a fresh write, blocks do not overlap and other slots are cleared.
+	bool VerifyTable(const ShaderTableManager& table, const MockIdentifiers& ids, const std::vector<MockResource>& resources, const std::vector<uint32_t>& refCounts)
+	{
+		std::vector<uint8_t> owned(table.GetSlotCount(), 0);
+		ShaderTableManager expected;
+		expected.Initialize(sizeof(MockLocalTable), 1);
+		expected.Resize(kStreamMaxSubmeshes);
+		for (uint32_t r = 0; r < (uint32_t)resources.size(); r++)
+		{
+			uint32_t first;
+			bool bFound = table.FindBlock(r, &first);
+			if (bFound != (refCounts[r] > 0))
+			{
+				return false;
+			}
+			if (!bFound)
+			{
+				continue;
+			}
+			WriteResourceRecords(expected, ids, resources[r], r, 0);
+			for (uint32_t i = 0; i < resources[r].submeshCount; i++)
+			{
+				if (first + i >= table.GetSlotCount() || owned[first + i]++)
+				{
+					return false;
+				}
+				if (memcmp(table.GetRecord(first + i), expected.GetRecord(i), table.GetRecordSize()) != 0)
+				{
+					return false;
+				}
+			}
+		}
+		static const uint8_t kZero[256] = {};
+		for (uint32_t slot = 0; slot < table.GetSlotCount(); slot++)
+		{
+			if (!owned[slot] && memcmp(table.GetRecord(slot), kZero, table.GetRecordSize()) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int RunShaderTableBenchmark(const BenchmarkOptions& opt)
+{
+	std::vector<MeshInfo> meshes;
+	int suzanneIndex = -1;
+	for (auto&& file : FindMeshFiles(opt.homeDir))
+	{
+		RMesh mesh;
+		if (!LoadRMesh(file, &mesh))
+		{
+			continue;
+		}
+		MeshInfo info;
+		info.name = GetFileName(file);
+		info.resourceId = (uint32_t)meshes.size();
+		for (auto&& submesh : mesh.submeshes)
+		{
+			info.materials.push_back((uint32_t)submesh.materialIndex);
+		}
+		if (file.find("suzanne") != std::string::npos)
+		{
+			suzanneIndex = (int)meshes.size();
+		}
+		meshes.push_back(info);
+	}
+	if (suzanneIndex < 0)
+	{
+		printf("Error: hp_suzanne.rmesh not found.\n");
+		return -1;
+	}
+
+	// the same resource with different materials needs its own records.
+	MeshInfo variant = meshes[suzanneIndex];
+	for (auto&& m : variant.materials)
+	{
+		m++;
+	}
+	variant.name += " (material variant)";
+	meshes.push_back(variant);
+	uint32_t variantIndex = (uint32_t)meshes.size() - 1;
+
+	std::vector<SceneDesc> scenes;
+	{
+		SceneDesc grid = { "suzanne grid", std::vector<uint32_t>(kMeshWidth * kMeshWidth, (uint32_t)suzanneIndex) };
+		SceneDesc single = { "one each", {} };
+		SceneDesc mixed = { "grid + others", grid.instanceMeshes };
+		for (uint32_t i = 0; i < (uint32_t)meshes.size(); i++)
+		{
+			single.instanceMeshes.push_back(i);
+			mixed.instanceMeshes.push_back(i);
+			mixed.instanceMeshes.push_back((i % 2) ? (uint32_t)suzanneIndex : variantIndex);
+		}
+		scenes.push_back(grid);
+		scenes.push_back(single);
+		scenes.push_back(mixed);
+	}
+
+	uint32_t recordSize = GetShaderRecordSize(kLocalTableSize);
+	printf("meshes:");
+	for (auto&& mesh : meshes)
+	{
+		printf(" %s(%zu submeshes)", mesh.name.c_str(), mesh.materials.size());
+	}
+	printf("\nrecord size: %u bytes, %u descriptors per record\n", recordSize, kDescriptorsPerRecord);
+	printf("  %-14s %9s %9s %9s %12s %10s %10s %10s %10s %8s %6s\n",
+		"scene", "instances", "slots", "unique", "table bytes", "descs bef", "descs aft",
+		"copies bef", "copies aft", "ms", "valid");
+	bool bValid = true;
+	for (auto&& scene : scenes)
+	{
+		bValid &= RunScene(scene, meshes, recordSize);
+	}
+	// sl12's BvhManager sets InstanceContributionToHitGroupIndex itself, one slot per submesh of every instance.
+	printf("the bound table keeps one record per slot, deduplication shrinks the local descriptor range and its copies only.\n");
+	printf("verify: %s\n", bValid ? "ok" : "FAILED");
+	return bValid ? 0 : -1;
+}
+
+int RunShaderTablePatchBenchmark(const BenchmarkOptions& /*opt*/)
+{
+	MockIdentifiers ids;
+	std::mt19937 rnd(0);
+	std::vector<MockResource> resources(kStreamResourceCount);
+	for (auto&& res : resources)
+	{
+		res.submeshCount = 1 + rnd() % kStreamMaxSubmeshes;
+		for (uint32_t i = 0; i < res.submeshCount; i++)
+		{
+			res.opaque.push_back(rnd() % 4 != 0);
+		}
+	}
+
+	// instances of random resources stream in and out, a block lives while any instance of its resource does.
+	ShaderTableManager table;
+	table.Initialize(sizeof(MockLocalTable));
+	std::vector<uint32_t> refCounts(resources.size(), 0);
+	std::vector<uint32_t> liveInstances;
+	uint64_t uploadBytes = 0, rebuildBytes = 0;
+	uint32_t addCount = 0, removeCount = 0, maxSlots = 0;
+	bool bValid = true;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t frame = 0; frame < kStreamFrameCount; frame++)
+	{
+		uint32_t changes = rnd() % 8;
+		for (uint32_t c = 0; c < changes; c++)
+		{
+			if (liveInstances.empty() || rnd() % 100 < 55)
+			{
+				uint32_t r = rnd() % kStreamResourceCount;
+				bool bCreated;
+				uint32_t first = table.AcquireBlock(r, resources[r].submeshCount, &bCreated);
+				if (bCreated)
+				{
+					WriteResourceRecords(table, ids, resources[r], r, first);
+				}
+				refCounts[r]++;
+				liveInstances.push_back(r);
+				addCount++;
+			}
+			else
+			{
+				uint32_t index = rnd() % (uint32_t)liveInstances.size();
+				uint32_t r = liveInstances[index];
+				liveInstances[index] = liveInstances.back();
+				liveInstances.pop_back();
+				table.ReleaseBlock(r);
+				refCounts[r]--;
+				removeCount++;
+			}
+		}
+
+		// upload of the dirty range, or of the whole table after a reallocation.
+		uint32_t begin, end;
+		if (table.IsReallocated())
+		{
+			uploadBytes += table.GetTableBytes();
+		}
+		else if (table.GetDirtyRange(&begin, &end))
+		{
+			uploadBytes += (uint64_t)(end - begin) * table.GetRecordSize();
+		}
+		table.ClearDirty();
+
+		// a full rebuild writes one record per submesh of every live resource.
+		if (changes > 0)
+		{
+			for (uint32_t r = 0; r < kStreamResourceCount; r++)
+			{
+				rebuildBytes += (refCounts[r] > 0) ? (uint64_t)resources[r].submeshCount * table.GetRecordSize() : 0;
+			}
+		}
+		maxSlots = std::max(maxSlots, table.GetSlotCount());
+		bValid &= VerifyTable(table, ids, resources, refCounts);
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// command order table as used by SampleApplication, a frame without changes patches nothing.
+	bool bStaticClean;
+	{
+		ShaderTableManager ordered;
+		ordered.Initialize(sizeof(MockLocalTable));
+		auto WriteAll = [&]()
+		{
+			ordered.Resize((uint32_t)resources.size() * kStreamMaxSubmeshes);
+			for (uint32_t r = 0; r < (uint32_t)resources.size(); r++)
+			{
+				WriteResourceRecords(ordered, ids, resources[r], r, r * kStreamMaxSubmeshes);
+			}
+		};
+		WriteAll();
+		ordered.ClearDirty();
+		uint64_t patched = ordered.GetCounters().patchedRecords;
+		WriteAll();
+		uint32_t begin, end;
+		bStaticClean = ordered.GetCounters().patchedRecords == patched && !ordered.GetDirtyRange(&begin, &end) && !ordered.IsReallocated();
+	}
+
+	auto&& c = table.GetCounters();
+	printf("record size: %u bytes, desc offset: %u\n", table.GetRecordSize(), table.GetDescOffset());
+	printf("streaming: %u frames, %u resources, %u instances added, %u removed, %zu live\n",
+		kStreamFrameCount, kStreamResourceCount, addCount, removeCount, liveInstances.size());
+	printf("  blocks allocated: %llu (%llu from free list), freed: %llu, reallocations: %llu\n",
+		(unsigned long long)c.allocations, (unsigned long long)c.reusedAllocations, (unsigned long long)c.frees, (unsigned long long)c.reallocations);
+	printf("  records patched: %llu, skipped: %llu\n", (unsigned long long)c.patchedRecords, (unsigned long long)c.skippedRecords);
+	printf("  slots: %u (max %u), free: %u, capacity: %u\n", table.GetSlotCount(), maxSlots, table.GetFreeSlotCount(), table.GetCapacity());
+	printf("  upload bytes: %llu, full rebuild bytes: %llu (%.1fx)\n",
+		(unsigned long long)uploadBytes, (unsigned long long)rebuildBytes, (double)rebuildBytes / (double)std::max<uint64_t>(uploadBytes, 1));
+	printf("  time: %.3f ms including verification\n", ms);
+	printf("static frame in command order patches nothing: %s\n", bStaticClean ? "yes" : "no");
+	printf("verify: %s\n", (bValid && bStaticClean) ? "ok" : "FAILED");
+	return (bValid && bStaticClean) ? 0 : -1;
+}
+
+//	EOF
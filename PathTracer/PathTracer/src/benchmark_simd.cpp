@@ -0,0 +1,261 @@
+#include "benchmark.h"
+#include "cpu_simd_traversal.h"
+#include "rmesh_reader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+
+namespace
+{
+	// camera rays are traced in 4x2 pixel packets, 8 packets make an 8x8 tile for packet groups.
+	static const uint32_t kImageSize = 256;
+	static const uint32_t kTileSize = 8;
+	static const uint32_t kPacketWidth = 4;
+	static const uint32_t kPacketHeight = 2;
+
+	struct KernelResult
+	{
+		BvhTraversalStats	stats;
+		double				ms = 0.0;
+		uint32_t			hitCount = 0;
+		uint32_t			mismatch = 0;
+	};
+
+	// triangle vertices in submesh order, same decode as vertex_factory.hlsli.
+	std::vector<Vec3> GetTriangleVertices(const RMesh& mesh)
+	{
+		std::vector<Vec3> ret;
+		ret.reserve(mesh.GetTotalTriangleCount() * 3);
+		for (auto&& submesh : mesh.submeshes)
+		{
+			for (uint32_t t = 0; t < submesh.indexCount / 3; t++)
+			{
+				uint32_t idx[3];
+				mesh.GetTriangle(submesh, t, idx);
+				for (int v = 0; v < 3; v++)
+				{
+					ret.push_back(mesh.GetPosition(submesh, idx[v]));
+				}
+			}
+		}
+		return ret;
+	}
+
+	// pinhole camera outside of the bounds, rays are in tile and packet order.
+	std::vector<CpuRay> GenerateCameraRays(const Aabb& bounds)
+	{
+		Vec3 center = bounds.Center();
+		float radius = Length(bounds.Extent()) * 0.5f;
+		Vec3 eye = center + Normalize(Vec3(1.0f, 0.5f, 0.8f)) * radius * 1.5f;
+		Vec3 forward = Normalize(center - eye);
+		Vec3 right = Normalize(Cross(forward, Vec3(0.0f, 1.0f, 0.0f)));
+		Vec3 up = Cross(right, forward);
+
+		std::vector<CpuRay> ret;
+		ret.reserve(kImageSize * kImageSize);
+		for (uint32_t ty = 0; ty < kImageSize; ty += kTileSize)
+		{
+			for (uint32_t tx = 0; tx < kImageSize; tx += kTileSize)
+			{
+				for (uint32_t i = 0; i < kTileSize * kTileSize; i++)
+				{
+					uint32_t packet = i / (kPacketWidth * kPacketHeight);
+					uint32_t lane = i % (kPacketWidth * kPacketHeight);
+					uint32_t x = tx + (packet % (kTileSize / kPacketWidth)) * kPacketWidth + lane % kPacketWidth;
+					uint32_t y = ty + (packet / (kTileSize / kPacketWidth)) * kPacketHeight + lane / kPacketWidth;
+					float u = ((float)x + 0.5f) / (float)kImageSize * 2.0f - 1.0f;
+					float v = ((float)y + 0.5f) / (float)kImageSize * 2.0f - 1.0f;
+					CpuRay ray;
+					ray.origin = eye;
+					ray.direction = Normalize(forward + right * (u * 0.5f) + up * (v * 0.5f));
+					ray.tmin = 0.0f;
+					ray.tmax = FLT_MAX;
+					ret.push_back(ray);
+				}
+			}
+		}
+		return ret;
+	}
+
+	// one diffuse bounce from each camera hit, uniform hemisphere like PathTracerRGS.
+	std::vector<CpuRay> GenerateBounceRays(const SimdTriangleBvh& bvh, const std::vector<Vec3>& triVertices, const std::vector<CpuRay>& cameraRays, const Aabb& bounds)
+	{
+		std::mt19937 rnd(2);
+		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+		float offset = Length(bounds.Extent()) * 1e-5f;
+
+		std::vector<CpuRay> ret;
+		for (auto&& ray : cameraRays)
+		{
+			SimdHit hit;
+			if (!bvh.TraceSingle(ray, &hit))
+			{
+				continue;
+			}
+			const Vec3* v = &triVertices[bvh.GetTriangleIndex(hit.primIndex) * 3];
+			Vec3 n = Normalize(Cross(v[1] - v[0], v[2] - v[0]));
+			if (Dot(n, ray.direction) > 0.0f)
+			{
+				n = -n;
+			}
+			Vec3 t = Normalize(Cross(std::fabs(n.x) > 0.5f ? Vec3(0.0f, 1.0f, 0.0f) : Vec3(1.0f, 0.0f, 0.0f), n));
+			Vec3 b = Cross(n, t);
+			float phi = dist(rnd) * 2.0f * kCpuPI;
+			float cosTheta = 1.0f - dist(rnd);
+			float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+
+			CpuRay bounce;
+			bounce.origin = ray.origin + ray.direction * hit.t + n * offset;
+			bounce.direction = Normalize(t * (std::cos(phi) * sinTheta) + b * (std::sin(phi) * sinTheta) + n * cosTheta);
+			bounce.tmin = 0.0f;
+			bounce.tmax = FLT_MAX;
+			ret.push_back(bounce);
+		}
+		return ret;
+	}
+
+	template <typename KernelFunc>
+	KernelResult Measure(int repeatCount, const std::vector<SimdHit>& reference, KernelFunc&& func)
+	{
+		KernelResult ret;
+		ret.ms = 1e30;
+		std::vector<SimdHit> hits(reference.size());
+		for (int r = 0; r < std::max(repeatCount, 1); r++)
+		{
+			BvhTraversalStats stats;
+			auto start = std::chrono::high_resolution_clock::now();
+			func(hits.data(), &stats);
+			auto end = std::chrono::high_resolution_clock::now();
+			ret.ms = std::min(ret.ms, std::chrono::duration<double, std::milli>(end - start).count());
+			ret.stats = stats;
+		}
+		for (size_t i = 0; i < hits.size(); i++)
+		{
+			bool bHit = hits[i].primIndex != SimdTriangleBvh::kInvalidPrim;
+			bool bRefHit = reference[i].primIndex != SimdTriangleBvh::kInvalidPrim;
+			ret.hitCount += bHit ? 1 : 0;
+			// the packet kernels use fma, t may differ from the scalar reference in the last bits.
+			bool bSameHit = (bHit == bRefHit) && (!bHit || (hits[i].primIndex == reference[i].primIndex
+				&& std::fabs(hits[i].t - reference[i].t) <= 1e-5f * std::max(std::fabs(reference[i].t), 1.0f)));
+			ret.mismatch += bSameHit ? 0 : 1;
+		}
+		return ret;
+	}
+
+	void PrintResult(const char* kernel, const KernelResult& res, size_t rayCount)
+	{
+		double n = (double)rayCount;
+		printf("    %-16s %10.3f %10.2f %10.2f %10.2f %9u\n",
+			kernel,
+			n / res.ms * 1e-3,
+			(double)res.stats.nodeVisits / n,
+			(double)res.stats.primTests / n,
+			(double)res.stats.cacheLines / n,
+			res.mismatch);
+	}
+
+	void RunRaySet(const SimdTriangleBvh& bvh, const char* name, const std::vector<CpuRay>& rays, bool bCoherent, int repeatCount)
+	{
+		std::vector<SimdHit> reference(rays.size());
+		for (size_t i = 0; i < rays.size(); i++)
+		{
+			bvh.TraceSingle(rays[i], &reference[i]);
+		}
+
+		auto TracePackets = [&](uint32_t groupSize, SimdHit* pHits, BvhTraversalStats* pStats)
+		{
+			static const uint32_t kPacketSize = SimdTriangleBvh::kPacketSize;
+			RayPacket8 packets[SimdTriangleBvh::kMaxGroupPackets];
+			PacketHit8 packetHits[SimdTriangleBvh::kMaxGroupPackets];
+			uint32_t masks[SimdTriangleBvh::kMaxGroupPackets];
+			for (size_t base = 0; base < rays.size(); base += groupSize * kPacketSize)
+			{
+				uint32_t count = (uint32_t)std::min<size_t>(groupSize * kPacketSize, rays.size() - base);
+				uint32_t packetCount = (count + kPacketSize - 1) / kPacketSize;
+				for (uint32_t i = 0; i < packetCount * kPacketSize; i++)
+				{
+					packets[i / kPacketSize].SetRay(i % kPacketSize, rays[base + std::min(i, count - 1)]);
+				}
+				for (uint32_t p = 0; p < packetCount; p++)
+				{
+					uint32_t lanes = std::min(count - p * kPacketSize, kPacketSize);
+					masks[p] = (1u << lanes) - 1;
+				}
+				bvh.TracePacketGroup(packets, masks, packetCount, packetHits, pStats);
+				for (uint32_t i = 0; i < count; i++)
+				{
+					pHits[base + i] = packetHits[i / kPacketSize].GetHit(i % kPacketSize);
+				}
+			}
+		};
+
+		auto single = Measure(repeatCount, reference, [&](SimdHit* pHits, BvhTraversalStats* pStats)
+		{
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				bvh.TraceSingle(rays[i], &pHits[i], pStats);
+			}
+		});
+		auto packet = Measure(repeatCount, reference, [&](SimdHit* pHits, BvhTraversalStats* pStats) { TracePackets(1, pHits, pStats); });
+		auto stream = Measure(repeatCount, reference, [&](SimdHit* pHits, BvhTraversalStats* pStats) { bvh.TraceStream(rays.data(), rays.size(), pHits, pStats); });
+
+		printf("  %s rays: %zu, hits %u\n", name, rays.size(), single.hitCount);
+		printf("    %-16s %10s %10s %10s %10s %9s\n", "kernel", "Mrays/s", "nodes/ray", "prims/ray", "lines/ray", "mismatch");
+		PrintResult("single", single, rays.size());
+		PrintResult("packet8", packet, rays.size());
+		if (bCoherent)
+		{
+			// groups share node tests between the packets of a tile, only camera rays are coherent enough.
+			auto group = Measure(repeatCount, reference, [&](SimdHit* pHits, BvhTraversalStats* pStats) { TracePackets(SimdTriangleBvh::kMaxGroupPackets, pHits, pStats); });
+			PrintResult("group64", group, rays.size());
+		}
+		PrintResult("stream wide8", stream, rays.size());
+	}
+}
+
+int RunSimdTraversalBenchmark(const BenchmarkOptions& opt)
+{
+	auto files = FindMeshFiles(opt.homeDir);
+	if (files.empty())
+	{
+		printf("Error: no mesh files found.\n");
+		return -1;
+	}
+	printf("simd: %s\n", SimdTriangleBvh::IsSimdEnabled() ? "avx2" : "scalar fallback");
+
+	for (auto&& file : files)
+	{
+		RMesh mesh;
+		if (!LoadRMesh(file, &mesh))
+		{
+			continue;
+		}
+		auto triVertices = GetTriangleVertices(mesh);
+		Aabb bounds;
+		for (auto&& v : triVertices)
+		{
+			bounds.Grow(v);
+		}
+
+		BvhBuildSettings settings;
+		settings.threadCount = opt.threadCount;
+		SimdTriangleBvh bvh;
+		if (!bvh.Build(triVertices, settings))
+		{
+			continue;
+		}
+
+		auto cameraRays = GenerateCameraRays(bounds);
+		auto bounceRays = GenerateBounceRays(bvh, triVertices, cameraRays, bounds);
+		printf("mesh: %s (%zu triangles)\n", GetFileName(file).c_str(), triVertices.size() / 3);
+		RunRaySet(bvh, "camera", cameraRays, true, opt.repeatCount);
+		RunRaySet(bvh, "diffuse bounce", bounceRays, false, opt.repeatCount);
+	}
+	return 0;
+}
+
+//	EOF
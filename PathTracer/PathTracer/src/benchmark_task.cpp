@@ -0,0 +1,333 @@
+#include "benchmark.h"
+#include "cpu_scene.h"
+#include "cpu_task.h"
+#include "init_stages.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock	Clock;
+
+	static const uint32_t kLayerCount = 6;
+	static const uint32_t kLayerWidth = 48;
+	static const uint32_t kMaxDependencies = 3;
+	static const double kTaskUs = 200.0;
+	static const uint32_t kSceneInstanceCount = 256;
+	static const uint32_t kSceneRayCount = 1 << 14;
+
+	// rough share of each init stage on a cold shader cache, in ms.
+	static const double kInitStageMs[(int)InitStage::Count] = {
+		4.0,	// gui
+		1.0,	// timestamps
+		40.0,	// wait shaders
+		30.0,	// wait resources
+		1.0,	// scene transforms
+		5.0,	// tonemap pso
+		20.0,	// raytracing pipeline
+		10.0,	// scene meshes
+	};
+
+	struct SyntheticTask
+	{
+		double				us;
+		std::vector<TaskId>	dependencies;
+	};
+
+	// layers of tasks with random length, each depends on a few tasks of the layer before.
+	std::vector<SyntheticTask> GenerateGraph()
+	{
+		std::mt19937 rnd(0);
+		std::uniform_real_distribution<float> length(0.5f, 2.0f);
+		std::vector<SyntheticTask> ret;
+		for (uint32_t layer = 0; layer < kLayerCount; layer++)
+		{
+			for (uint32_t i = 0; i < kLayerWidth; i++)
+			{
+				SyntheticTask task;
+				task.us = kTaskUs * length(rnd);
+				if (layer > 0)
+				{
+					uint32_t depCount = 1 + rnd() % kMaxDependencies;
+					for (uint32_t d = 0; d < depCount; d++)
+					{
+						task.dependencies.push_back((layer - 1) * kLayerWidth + rnd() % kLayerWidth);
+					}
+				}
+				ret.push_back(task);
+			}
+		}
+		return ret;
+	}
+
+	void Spin(double us)
+	{
+		auto start = Clock::now();
+		while (std::chrono::duration<double, std::micro>(Clock::now() - start).count() < us)
+		{}
+	}
+
+	// every task ran once, on a valid thread and after all of its dependencies.
+	bool ValidateTrace(const TaskTrace& trace, const std::vector<uint32_t>& runCounts)
+	{
+		for (size_t i = 0; i < trace.events.size(); i++)
+		{
+			auto&& e = trace.events[i];
+			if (runCounts[i] != 1 || e.state != TaskState::Succeeded || e.workerIndex >= trace.workerCount)
+			{
+				return false;
+			}
+			for (auto dep : e.dependencies)
+			{
+				if (trace.events[dep].endMs > e.beginMs)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// a failed task skips everything after it, independent tasks still run and the scheduler stays usable.
+	bool ValidateFailure(TaskScheduler& scheduler)
+	{
+		bool bIndependentRan = false;
+		bool bSkippedRan = false;
+		TaskId a = scheduler.AddTask("a", []() { return true; });
+		TaskId b = scheduler.AddTask("b", []() { return false; }, { a });
+		TaskId c = scheduler.AddTask("c", [&]() { bSkippedRan = true; return true; }, { b });
+		scheduler.AddTask("d", [&]() { bSkippedRan = true; return true; }, { a, c });
+		scheduler.AddTask("e", [&]() { bIndependentRan = true; return true; });
+		if (scheduler.Run())
+		{
+			return false;
+		}
+		auto&& events = scheduler.GetTrace().events;
+		bool bStates = events[0].state == TaskState::Succeeded && events[1].state == TaskState::Failed
+			&& events[2].state == TaskState::Skipped && events[3].state == TaskState::Skipped && events[4].state == TaskState::Succeeded;
+		if (!bStates || bSkippedRan || !bIndependentRan)
+		{
+			return false;
+		}
+
+		bool bRan = false;
+		scheduler.AddTask("again", [&]() { bRan = true; return true; });
+		return scheduler.Run() && bRan;
+	}
+
+	bool IsOverlapped(const TaskTraceEvent& a, const TaskTraceEvent& b)
+	{
+		return a.beginMs < b.endMs && b.beginMs < a.endMs;
+	}
+
+	// the pipelines compile together and the scene meshes are built before the shaders are done.
+	bool ValidateInitOverlap(const TaskTrace& trace)
+	{
+		auto&& events = trace.events;
+		auto&& meshes = events[(int)InitStage::SceneMeshes];
+		return IsOverlapped(events[(int)InitStage::TonemapPso], events[(int)InitStage::RaytracingPipeline])
+			&& (IsOverlapped(meshes, events[(int)InitStage::WaitShaders]) || IsOverlapped(meshes, events[(int)InitStage::RaytracingPipeline]))
+			&& trace.wallMs < trace.GetBusyMs();
+	}
+
+	bool BuildScene(const std::vector<std::string>& meshFiles, uint32_t threadCount, TaskScheduler* pScheduler, CpuScene* pScene, double* pMs)
+	{
+		std::mt19937 rnd(0);
+		std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+		std::vector<int> meshes;
+		auto start = Clock::now();
+		for (auto&& file : meshFiles)
+		{
+			int index = pScene->AddMesh(file);
+			if (index < 0)
+			{
+				return false;
+			}
+			meshes.push_back(index);
+		}
+		for (uint32_t i = 0; i < kSceneInstanceCount; i++)
+		{
+			auto mat = MatrixMultiply(MatrixRotationRollPitchYaw(dist(rnd) * kCpuPI, dist(rnd) * kCpuPI, dist(rnd) * kCpuPI),
+				MatrixTranslation(dist(rnd) * 1000.0f, dist(rnd) * 1000.0f, dist(rnd) * 1000.0f));
+			pScene->AddInstance(meshes[i % meshes.size()], mat);
+		}
+		BvhBuildSettings settings;
+		settings.threadCount = threadCount;
+		pScene->Build(settings, pScheduler);
+		*pMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		return true;
+	}
+
+	// the parallel build traces the same hits as the sequential one.
+	bool CompareScenes(const CpuScene& a, const CpuScene& b)
+	{
+		Aabb bounds = a.GetSceneAabb();
+		Vec3 center = bounds.Center();
+		std::mt19937 rnd(1);
+		std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+		for (uint32_t i = 0; i < kSceneRayCount; i++)
+		{
+			CpuRay ray;
+			ray.origin = center + Vec3(dist(rnd), dist(rnd), dist(rnd)) * Length(bounds.Extent());
+			ray.direction = Normalize(center - ray.origin + Vec3(dist(rnd), dist(rnd), dist(rnd)) * 200.0f);
+			ray.tmin = 0.0f;
+			ray.tmax = FLT_MAX;
+			CpuHit hitA, hitB;
+			bool bHitA = a.TraceClosest(ray, &hitA);
+			bool bHitB = b.TraceClosest(ray, &hitB);
+			if (bHitA != bHitB)
+			{
+				return false;
+			}
+			if (bHitA && (hitA.instanceIndex != hitB.instanceIndex || hitA.triIndex != hitB.triIndex || hitA.t != hitB.t))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+
+int RunTaskBenchmark(const BenchmarkOptions& opt)
+{
+	bool bAllValid = true;
+	auto threadCounts = GetThreadCountSweep(opt.threadCount);
+
+	// synthetic graph.
+	auto graph = GenerateGraph();
+	double serialMs = 0.0;
+	for (auto&& t : graph)
+	{
+		serialMs += t.us * 1e-3;
+	}
+	printf("graph: %u layers x %u tasks, %.2f ms of work\n", kLayerCount, kLayerWidth, serialMs);
+	printf("  %-8s %9s %9s %9s %10s %7s %6s\n", "threads", "wall ms", "busy ms", "crit ms", "efficiency", "stolen", "valid");
+	for (auto threadCount : threadCounts)
+	{
+		TaskScheduler scheduler;
+		scheduler.Initialize(threadCount);
+		TaskTrace best;
+		bool bValid = true;
+		for (int r = 0; r < std::max(opt.repeatCount, 1); r++)
+		{
+			std::vector<uint32_t> runCounts(graph.size(), 0);
+			for (size_t i = 0; i < graph.size(); i++)
+			{
+				double us = graph[i].us;
+				uint32_t* pCount = &runCounts[i];
+				scheduler.AddTask("task " + std::to_string(i), [us, pCount]()
+				{
+					Spin(us);
+					(*pCount)++;
+					return true;
+				}, graph[i].dependencies);
+			}
+			bValid = scheduler.Run() && ValidateTrace(scheduler.GetTrace(), runCounts) && bValid;
+			if (r == 0 || scheduler.GetTrace().wallMs < best.wallMs)
+			{
+				best = scheduler.GetTrace();
+			}
+		}
+		bAllValid = bAllValid && bValid;
+		printf("  %-8u %9.2f %9.2f %9.2f %9.1f%% %7u %6s\n",
+			threadCount, best.wallMs, best.GetBusyMs(), best.GetCriticalPathMs(),
+			best.GetBusyMs() / (best.wallMs * threadCount) * 100.0, best.stolenCount, bValid ? "yes" : "NO");
+	}
+
+	{
+		TaskScheduler scheduler;
+		scheduler.Initialize(threadCounts.back());
+		bool bValid = ValidateFailure(scheduler);
+		bAllValid = bAllValid && bValid;
+		printf("failed task skips its dependents: %s\n", bValid ? "yes" : "NO");
+	}
+
+	// the init graph of the app, each stage spins for its usual share of the init time.
+	{
+		uint32_t threadCount = std::max(threadCounts.back(), 2u);
+		TaskScheduler scheduler;
+		scheduler.Initialize(threadCount);
+		std::vector<uint32_t> runCounts((int)InitStage::Count, 0);
+		std::function<bool()> stageFuncs[(int)InitStage::Count];
+		double serialInitMs = 0.0;
+		for (int i = 0; i < (int)InitStage::Count; i++)
+		{
+			double us = kInitStageMs[i] * 1e3;
+			uint32_t* pCount = &runCounts[i];
+			stageFuncs[i] = [us, pCount]()
+			{
+				Spin(us);
+				(*pCount)++;
+				return true;
+			};
+			serialInitMs += kInitStageMs[i];
+		}
+		AddInitStages(&scheduler, stageFuncs);
+		bool bValid = scheduler.Run() && ValidateTrace(scheduler.GetTrace(), runCounts);
+		auto&& trace = scheduler.GetTrace();
+		bool bOverlap = bValid && ValidateInitOverlap(trace);
+		bAllValid = bAllValid && bOverlap;
+		PrintTaskTrace(trace, "init trace");
+		printf("init graph: %u threads, %.2f ms serial, %.2f ms wall, %.2f ms critical path\n",
+			threadCount, serialInitMs, trace.wallMs, trace.GetCriticalPathMs());
+		printf("init overlaps the pipelines and builds the meshes while shaders compile: %s\n", bOverlap ? "yes" : "NO");
+	}
+
+	// scene build, bottom levels and lod distances as tasks.
+	auto meshFiles = FindMeshFiles(opt.homeDir);
+	if (meshFiles.empty())
+	{
+		printf("Error: no mesh files found.\n");
+		return -1;
+	}
+	printf("scene build: %zu meshes, %u instances\n", meshFiles.size(), kSceneInstanceCount);
+	printf("  %-8s %11s %11s %9s %9s %7s %6s\n", "threads", "serial ms", "tasks ms", "speedup", "crit ms", "stolen", "same");
+	CpuScene reference;
+	double referenceMs;
+	if (!BuildScene(meshFiles, 1, nullptr, &reference, &referenceMs))
+	{
+		return -1;
+	}
+	TaskTrace lastTrace;
+	for (auto threadCount : threadCounts)
+	{
+		double bestSerial = 0.0, bestTasks = 0.0;
+		bool bSame = true;
+		TaskTrace trace;
+		for (int r = 0; r < std::max(opt.repeatCount, 1); r++)
+		{
+			// the serial build runs the same tasks on one thread, each bvh build still uses threadCount.
+			CpuScene serialScene, taskScene;
+			double serialMs, taskMs;
+			TaskScheduler scheduler;
+			scheduler.Initialize(threadCount);
+			if (!BuildScene(meshFiles, threadCount, nullptr, &serialScene, &serialMs)
+				|| !BuildScene(meshFiles, threadCount, &scheduler, &taskScene, &taskMs))
+			{
+				return -1;
+			}
+			bSame = bSame && CompareScenes(reference, taskScene);
+			bestSerial = (r == 0) ? serialMs : std::min(bestSerial, serialMs);
+			if (r == 0 || taskMs < bestTasks)
+			{
+				bestTasks = taskMs;
+				trace = scheduler.GetTrace();
+			}
+		}
+		bAllValid = bAllValid && bSame;
+		printf("  %-8u %11.2f %11.2f %8.2fx %9.2f %7u %6s\n",
+			threadCount, bestSerial, bestTasks, bestSerial / bestTasks, trace.GetCriticalPathMs(), trace.stolenCount, bSame ? "yes" : "NO");
+		lastTrace = trace;
+	}
+	PrintTaskTrace(lastTrace, "build trace");
+
+	printf("tasks ran in dependency order and the scene builds match: %s\n", bAllValid ? "yes" : "NO");
+	return bAllValid ? 0 : -1;
+}
+
+//	EOF
@@ -0,0 +1,174 @@
+#include "benchmark.h"
+#include "cpu_scene.h"
+#include "cpu_wide_bvh.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+
+namespace
+{
+	static const uint32_t kRayCount = 1 << 16;
+
+	struct TraceResult
+	{
+		BvhTraversalStats	stats;
+		double				ms = 0.0;
+		uint32_t			hitCount = 0;
+	};
+
+	// camera rays toward the mesh and random rays from inside the bounds.
+	void GenerateRays(const Aabb& bounds, std::vector<CpuRay>* pCamera, std::vector<CpuRay>* pRandom)
+	{
+		Vec3 center = bounds.Center();
+		float radius = Length(bounds.Extent()) * 0.5f;
+		Vec3 eye = center + Normalize(Vec3(1.0f, 0.5f, 0.8f)) * radius * 2.0f;
+		Vec3 forward = Normalize(center - eye);
+		Vec3 right = Normalize(Cross(forward, Vec3(0.0f, 1.0f, 0.0f)));
+		Vec3 up = Cross(right, forward);
+
+		uint32_t side = (uint32_t)std::sqrt((float)kRayCount);
+		pCamera->resize(side * side);
+		for (uint32_t y = 0; y < side; y++)
+		{
+			for (uint32_t x = 0; x < side; x++)
+			{
+				float u = ((float)x + 0.5f) / (float)side * 2.0f - 1.0f;
+				float v = ((float)y + 0.5f) / (float)side * 2.0f - 1.0f;
+				CpuRay& ray = (*pCamera)[y * side + x];
+				ray.origin = eye;
+				ray.direction = Normalize(forward + right * (u * 0.6f) + up * (v * 0.6f));
+				ray.tmin = 0.0f;
+				ray.tmax = FLT_MAX;
+			}
+		}
+
+		std::mt19937 rnd(1);
+		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+		pRandom->resize(kRayCount);
+		for (auto&& ray : *pRandom)
+		{
+			Vec3 r(dist(rnd), dist(rnd), dist(rnd));
+			ray.origin = bounds.bmin + bounds.Extent() * r;
+			float z = dist(rnd) * 2.0f - 1.0f;
+			float phi = dist(rnd) * 2.0f * kCpuPI;
+			float s = std::sqrt(std::max(1.0f - z * z, 0.0f));
+			ray.direction = Vec3(std::cos(phi) * s, std::sin(phi) * s, z);
+			ray.tmin = 0.0f;
+			ray.tmax = FLT_MAX;
+		}
+	}
+
+	template <typename BvhType>
+	TraceResult TraceRays(const BvhType& bvh, const std::vector<CpuMesh::Triangle>& triangles, const std::vector<CpuRay>& rays, std::vector<float>* pHitT)
+	{
+		TraceResult ret;
+		pHitT->resize(rays.size());
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < rays.size(); i++)
+		{
+			CpuRay ray = rays[i];
+			bool bHit = false;
+			bvh.Traverse(ray, [&](uint32_t primIndex, CpuRay& r)
+			{
+				float t, u, v;
+				if (IntersectTriangle(r, triangles[primIndex], &t, &u, &v))
+				{
+					r.tmax = t;
+					bHit = true;
+				}
+				return true;
+			}, &ret.stats);
+			(*pHitT)[i] = bHit ? ray.tmax : -1.0f;
+			ret.hitCount += bHit ? 1 : 0;
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		ret.ms = std::chrono::duration<double, std::milli>(end - start).count();
+		return ret;
+	}
+
+	void PrintTrace(const char* layout, const TraceResult& res, size_t rayCount)
+	{
+		double n = (double)rayCount;
+		printf("    %-8s %10.2f %10.2f %10.2f %10.2f %10.3f\n",
+			layout,
+			(double)res.stats.nodeVisits / n,
+			(double)res.stats.cacheLines / n,
+			(double)res.stats.cacheLines * kCacheLineSize / n,
+			(double)res.stats.primTests / n,
+			n / res.ms * 1e-3);
+	}
+}
+
+int RunWideBvhBenchmark(const BenchmarkOptions& opt)
+{
+	auto files = FindMeshFiles(opt.homeDir);
+	if (files.empty())
+	{
+		printf("Error: no mesh files found.\n");
+		return -1;
+	}
+
+	for (auto&& file : files)
+	{
+		CpuMesh mesh;
+		if (!mesh.Initialize(file))
+		{
+			continue;
+		}
+
+		// binary bvh over all submesh triangles, leaves fit in a wide node slot.
+		auto&& triangles = mesh.GetTriangles();
+		std::vector<Aabb> primBounds(triangles.size());
+		for (size_t i = 0; i < triangles.size(); i++)
+		{
+			primBounds[i].Grow(triangles[i].v0);
+			primBounds[i].Grow(triangles[i].v0 + triangles[i].e1);
+			primBounds[i].Grow(triangles[i].v0 + triangles[i].e2);
+		}
+		BvhBuildSettings settings;
+		settings.threadCount = opt.threadCount;
+		settings.maxLeafSize = WideBvh::kMaxLeafSize;
+		Bvh binary;
+		binary.BuildSAH(primBounds, settings);
+
+		WideBvh wide;
+		auto start = std::chrono::high_resolution_clock::now();
+		wide.Build(binary, primBounds);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		size_t binaryBytes = binary.GetNodes().size() * sizeof(BvhNode);
+		size_t wideBytes = wide.GetNodes().size() * sizeof(WideBvhNode);
+		printf("mesh: %s (%zu triangles, collapse %.2f ms)\n", GetFileName(file).c_str(), triangles.size(),
+			std::chrono::duration<double, std::milli>(end - start).count());
+		printf("  %-8s %10s %10s %10s %12s\n", "layout", "node bytes", "nodes", "total KB", "bytes/tri");
+		printf("  %-8s %10zu %10zu %10.1f %12.2f\n", "binary", sizeof(BvhNode), binary.GetNodes().size(), binaryBytes / 1024.0, (double)binaryBytes / triangles.size());
+		printf("  %-8s %10zu %10zu %10.1f %12.2f\n", "wide8", sizeof(WideBvhNode), wide.GetNodes().size(), wideBytes / 1024.0, (double)wideBytes / triangles.size());
+
+		std::vector<CpuRay> cameraRays, randomRays;
+		GenerateRays(mesh.GetBounds(), &cameraRays, &randomRays);
+		const std::vector<CpuRay>* raySets[] = { &cameraRays, &randomRays };
+		const char* raySetNames[] = { "camera", "random" };
+		for (int s = 0; s < 2; s++)
+		{
+			std::vector<float> binaryT, wideT;
+			auto binaryRes = TraceRays(binary, triangles, *raySets[s], &binaryT);
+			auto wideRes = TraceRays(wide, triangles, *raySets[s], &wideT);
+
+			uint32_t mismatch = 0;
+			for (size_t i = 0; i < binaryT.size(); i++)
+			{
+				mismatch += (binaryT[i] != wideT[i]) ? 1 : 0;
+			}
+
+			printf("  %s rays: %zu, hits %u, mismatch %u\n", raySetNames[s], raySets[s]->size(), wideRes.hitCount, mismatch);
+			printf("    %-8s %10s %10s %10s %10s %10s\n", "layout", "nodes/ray", "lines/ray", "bytes/ray", "prims/ray", "Mrays/s");
+			PrintTrace("binary", binaryRes, raySets[s]->size());
+			PrintTrace("wide8", wideRes, raySets[s]->size());
+		}
+	}
+	return 0;
+}
+
+//	EOF
@@ -0,0 +1,642 @@
+#include "cpu_bvh.h"
+#include "cpu_parallel.h"
+
+#include <atomic>
+#include <future>
+#include <numeric>
+#include <thread>
+
+
+void Bvh::Build(const std::vector<Aabb>& primBounds)
+{
+	nodes_.clear();
+	primIndices_.resize(primBounds.size());
+	std::iota(primIndices_.begin(), primIndices_.end(), 0);
+	if (primBounds.empty())
+	{
+		return;
+	}
+
+	std::vector<Vec3> centroids(primBounds.size());
+	for (size_t i = 0; i < primBounds.size(); i++)
+	{
+		centroids[i] = primBounds[i].Center();
+	}
+
+	struct BuildItem
+	{
+		uint32_t	nodeIndex;
+		uint32_t	first;
+		uint32_t	count;
+	};
+	nodes_.reserve(primBounds.size() * 2);
+	nodes_.push_back(BvhNode());
+	std::vector<BuildItem> stack;
+	stack.push_back({0, 0, (uint32_t)primBounds.size()});
+	while (!stack.empty())
+	{
+		BuildItem item = stack.back();
+		stack.pop_back();
+
+		Aabb bounds, centBounds;
+		for (uint32_t i = item.first; i < item.first + item.count; i++)
+		{
+			bounds.Grow(primBounds[primIndices_[i]]);
+			centBounds.Grow(centroids[primIndices_[i]]);
+		}
+		nodes_[item.nodeIndex].SetAabb(bounds);
+
+		Vec3 ext = centBounds.Extent();
+		int axis = (ext.x > ext.y && ext.x > ext.z) ? 0 : (ext.y > ext.z ? 1 : 2);
+		if (item.count <= kMaxLeafSize || ext[axis] <= 0.0f)
+		{
+			nodes_[item.nodeIndex].leftFirst = item.first;
+			nodes_[item.nodeIndex].primCount = item.count;
+			continue;
+		}
+
+		uint32_t half = item.count / 2;
+		auto begin = primIndices_.begin() + item.first;
+		std::nth_element(begin, begin + half, begin + item.count,
+			[&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+		uint32_t left = (uint32_t)nodes_.size();
+		nodes_.push_back(BvhNode());
+		nodes_.push_back(BvhNode());
+		nodes_[item.nodeIndex].leftFirst = left;
+		nodes_[item.nodeIndex].primCount = 0;
+		stack.push_back({left, item.first, half});
+		stack.push_back({left + 1, item.first + half, item.count - half});
+	}
+}
+
+namespace
+{
+	// nodes with fewer references are built on the current thread.
+	static const size_t kParallelSubtreeThreshold = 4096;
+	// nodes with more references are binned by all threads.
+	static const size_t kParallelBinningThreshold = 1 << 16;
+	static const uint32_t kMaxBinCount = 64;
+
+	struct PrimRef
+	{
+		Aabb		bounds;
+		uint32_t	primIndex;
+	};
+
+	struct Subtree
+	{
+		std::vector<BvhNode>	nodes;
+		std::vector<uint32_t>	prims;
+	};
+
+	struct Bin
+	{
+		Aabb		bounds;
+		uint32_t	count = 0;		// object bins.
+		uint32_t	enter = 0;		// spatial bins.
+		uint32_t	exit = 0;
+	};
+
+	struct SplitResult
+	{
+		float	cost = FLT_MAX;
+		int		axis = -1;
+		int		bin = -1;
+		bool	bSpatial = false;
+		Aabb	leftBounds, rightBounds;
+		float	spatialPos = 0.0f;
+	};
+
+	inline Aabb Intersect(const Aabb& a, const Aabb& b)
+	{
+		return Aabb(Max(a.bmin, b.bmin), Min(a.bmax, b.bmax));
+	}
+
+	// split a triangle reference at an axis aligned plane.
+	void SplitReference(const PrimRef& ref, const Vec3* tri, int axis, float pos, Aabb* pLeft, Aabb* pRight)
+	{
+		Aabb left, right;
+		for (int i = 0; i < 3; i++)
+		{
+			const Vec3& v0 = tri[i];
+			const Vec3& v1 = tri[(i + 1) % 3];
+			float p0 = v0[axis], p1 = v1[axis];
+			if (p0 <= pos) left.Grow(v0);
+			if (p0 >= pos) right.Grow(v0);
+			if ((p0 < pos && p1 > pos) || (p0 > pos && p1 < pos))
+			{
+				Vec3 x = Lerp(v0, v1, Saturate((pos - p0) / (p1 - p0)));
+				x[axis] = pos;
+				left.Grow(x);
+				right.Grow(x);
+			}
+		}
+		left.bmax[axis] = std::min(left.bmax[axis], pos);
+		right.bmin[axis] = std::max(right.bmin[axis], pos);
+		*pLeft = Intersect(left, ref.bounds);
+		*pRight = Intersect(right, ref.bounds);
+	}
+
+	class SahBuilder
+	{
+	public:
+		SahBuilder(const BvhBuildSettings& settings, const std::vector<Vec3>* pTriVertices, size_t primCount)
+			: settings_(settings)
+			, pTriVertices_(pTriVertices)
+			, activeThreads_(1)
+			, splitBudget_((int64_t)((double)primCount * std::max(settings.maxDuplication, 0.0f)))
+		{
+			settings_.threadCount = (settings_.threadCount == 0) ? GetDefaultThreadCount() : settings_.threadCount;
+			settings_.binCount = std::min(std::max(settings_.binCount, 2u), kMaxBinCount);
+			settings_.maxLeafSize = std::max(settings_.maxLeafSize, 1u);
+			if (!pTriVertices_)
+			{
+				settings_.bSpatialSplits = false;
+			}
+		}
+
+		void Build(std::vector<PrimRef>&& refs, const Aabb& rootBounds, Subtree* pOut)
+		{
+			rootArea_ = rootBounds.SurfaceArea();
+			pOut->nodes.reserve(refs.size() * 2);
+			pOut->prims.reserve(refs.size());
+			pOut->nodes.push_back(BvhNode());
+			BuildNode(std::move(refs), rootBounds, 0, 0, *pOut);
+		}
+
+	private:
+		uint32_t GetBinningThreadCount(size_t refCount) const
+		{
+			if (refCount < kParallelBinningThreshold)
+			{
+				return 1;
+			}
+			return std::min(settings_.threadCount, (uint32_t)(refCount / (kParallelBinningThreshold / 4)));
+		}
+
+		void FindObjectSplit(const std::vector<PrimRef>& refs, const Aabb& centBounds, float parentArea, SplitResult* pResult) const
+		{
+			const uint32_t binCount = settings_.binCount;
+			Vec3 ext = centBounds.Extent();
+			Vec3 scale(
+				ext.x > 0.0f ? (float)binCount / ext.x : 0.0f,
+				ext.y > 0.0f ? (float)binCount / ext.y : 0.0f,
+				ext.z > 0.0f ? (float)binCount / ext.z : 0.0f);
+
+			uint32_t chunkCount = GetBinningThreadCount(refs.size());
+			std::vector<Bin> chunkBins((size_t)chunkCount * 3 * kMaxBinCount);
+			ParallelChunks(refs.size(), chunkCount, [&](size_t begin, size_t end, uint32_t chunk)
+			{
+				Bin* bins = &chunkBins[(size_t)chunk * 3 * kMaxBinCount];
+				for (size_t i = begin; i < end; i++)
+				{
+					Vec3 c = refs[i].bounds.Center();
+					for (int axis = 0; axis < 3; axis++)
+					{
+						uint32_t b = std::min(binCount - 1, (uint32_t)((c[axis] - centBounds.bmin[axis]) * scale[axis]));
+						Bin& bin = bins[axis * kMaxBinCount + b];
+						bin.bounds.Grow(refs[i].bounds);
+						bin.count++;
+					}
+				}
+			});
+			Bin* bins = chunkBins.data();
+			for (uint32_t chunk = 1; chunk < chunkCount; chunk++)
+			{
+				const Bin* src = &chunkBins[(size_t)chunk * 3 * kMaxBinCount];
+				for (uint32_t i = 0; i < 3 * kMaxBinCount; i++)
+				{
+					bins[i].bounds.Grow(src[i].bounds);
+					bins[i].count += src[i].count;
+				}
+			}
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (ext[axis] <= 0.0f)
+				{
+					continue;
+				}
+				const Bin* axisBins = bins + axis * kMaxBinCount;
+
+				// sweep from the right.
+				Aabb rightBounds[kMaxBinCount];
+				uint32_t rightCount[kMaxBinCount];
+				Aabb acc;
+				uint32_t count = 0;
+				for (uint32_t i = binCount - 1; i > 0; i--)
+				{
+					acc.Grow(axisBins[i].bounds);
+					count += axisBins[i].count;
+					rightBounds[i] = acc;
+					rightCount[i] = count;
+				}
+
+				// sweep from the left, split between bin i - 1 and i.
+				acc = Aabb();
+				count = 0;
+				for (uint32_t i = 1; i < binCount; i++)
+				{
+					acc.Grow(axisBins[i - 1].bounds);
+					count += axisBins[i - 1].count;
+					if (count == 0 || rightCount[i] == 0)
+					{
+						continue;
+					}
+					float cost = settings_.traversalCost + settings_.intersectionCost *
+						(acc.SurfaceArea() * (float)count + rightBounds[i].SurfaceArea() * (float)rightCount[i]) / parentArea;
+					if (cost < pResult->cost)
+					{
+						pResult->cost = cost;
+						pResult->axis = axis;
+						pResult->bin = (int)i;
+						pResult->bSpatial = false;
+						pResult->leftBounds = acc;
+						pResult->rightBounds = rightBounds[i];
+					}
+				}
+			}
+		}
+
+		void FindSpatialSplit(const std::vector<PrimRef>& refs, const Aabb& nodeBounds, float parentArea, SplitResult* pResult) const
+		{
+			const uint32_t binCount = settings_.binCount;
+			const Vec3* tris = pTriVertices_->data();
+			Vec3 ext = nodeBounds.Extent();
+
+			uint32_t chunkCount = GetBinningThreadCount(refs.size());
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (ext[axis] <= 0.0f)
+				{
+					continue;
+				}
+				float binWidth = ext[axis] / (float)binCount;
+				float invBinWidth = 1.0f / binWidth;
+				auto GetBin = [&](float p)
+				{
+					float b = (p - nodeBounds.bmin[axis]) * invBinWidth;
+					return std::min(binCount - 1, (uint32_t)std::max(b, 0.0f));
+				};
+
+				std::vector<Bin> chunkBins((size_t)chunkCount * kMaxBinCount);
+				ParallelChunks(refs.size(), chunkCount, [&](size_t begin, size_t end, uint32_t chunk)
+				{
+					Bin* bins = &chunkBins[(size_t)chunk * kMaxBinCount];
+					for (size_t i = begin; i < end; i++)
+					{
+						const PrimRef& ref = refs[i];
+						uint32_t first = GetBin(ref.bounds.bmin[axis]);
+						uint32_t last = GetBin(ref.bounds.bmax[axis]);
+						PrimRef cur = ref;
+						for (uint32_t b = first; b < last; b++)
+						{
+							Aabb l, r;
+							SplitReference(cur, tris + (size_t)ref.primIndex * 3, axis, nodeBounds.bmin[axis] + binWidth * (float)(b + 1), &l, &r);
+							bins[b].bounds.Grow(l);
+							cur.bounds = r;
+						}
+						bins[last].bounds.Grow(cur.bounds);
+						bins[first].enter++;
+						bins[last].exit++;
+					}
+				});
+				Bin* bins = chunkBins.data();
+				for (uint32_t chunk = 1; chunk < chunkCount; chunk++)
+				{
+					const Bin* src = &chunkBins[(size_t)chunk * kMaxBinCount];
+					for (uint32_t i = 0; i < kMaxBinCount; i++)
+					{
+						bins[i].bounds.Grow(src[i].bounds);
+						bins[i].enter += src[i].enter;
+						bins[i].exit += src[i].exit;
+					}
+				}
+
+				Aabb rightBounds[kMaxBinCount];
+				uint32_t rightCount[kMaxBinCount];
+				Aabb acc;
+				uint32_t count = 0;
+				for (uint32_t i = binCount - 1; i > 0; i--)
+				{
+					acc.Grow(bins[i].bounds);
+					count += bins[i].exit;
+					rightBounds[i] = acc;
+					rightCount[i] = count;
+				}
+
+				acc = Aabb();
+				count = 0;
+				for (uint32_t i = 1; i < binCount; i++)
+				{
+					acc.Grow(bins[i - 1].bounds);
+					count += bins[i - 1].enter;
+					if (count == 0 || rightCount[i] == 0)
+					{
+						continue;
+					}
+					float cost = settings_.traversalCost + settings_.intersectionCost *
+						(acc.SurfaceArea() * (float)count + rightBounds[i].SurfaceArea() * (float)rightCount[i]) / parentArea;
+					if (cost < pResult->cost)
+					{
+						pResult->cost = cost;
+						pResult->axis = axis;
+						pResult->bin = (int)i;
+						pResult->bSpatial = true;
+						pResult->leftBounds = acc;
+						pResult->rightBounds = rightBounds[i];
+						pResult->spatialPos = nodeBounds.bmin[axis] + binWidth * (float)i;
+					}
+				}
+			}
+		}
+
+		void PartitionObject(std::vector<PrimRef>& refs, const Aabb& centBounds, const SplitResult& split, std::vector<PrimRef>* pLeft, std::vector<PrimRef>* pRight) const
+		{
+			int axis = split.axis;
+			float scale = (float)settings_.binCount / centBounds.Extent()[axis];
+			auto mid = std::partition(refs.begin(), refs.end(), [&](const PrimRef& ref)
+			{
+				uint32_t b = std::min(settings_.binCount - 1, (uint32_t)((ref.bounds.Center()[axis] - centBounds.bmin[axis]) * scale));
+				return (int)b < split.bin;
+			});
+			pRight->assign(mid, refs.end());
+			refs.erase(mid, refs.end());
+			pLeft->swap(refs);
+		}
+
+		// returns false if the split would not make progress.
+		bool PartitionSpatial(std::vector<PrimRef>& refs, const SplitResult& split, std::vector<PrimRef>* pLeft, std::vector<PrimRef>* pRight)
+		{
+			int axis = split.axis;
+			float pos = split.spatialPos;
+			const Vec3* tris = pTriVertices_->data();
+
+			Aabb leftBounds = split.leftBounds, rightBounds = split.rightBounds;
+			std::vector<PrimRef> straddle;
+			pLeft->clear();
+			pRight->clear();
+			for (auto&& ref : refs)
+			{
+				if (ref.bounds.bmax[axis] <= pos)
+				{
+					pLeft->push_back(ref);
+				}
+				else if (ref.bounds.bmin[axis] >= pos)
+				{
+					pRight->push_back(ref);
+				}
+				else
+				{
+					straddle.push_back(ref);
+				}
+			}
+
+			size_t leftCount = pLeft->size() + straddle.size();
+			size_t rightCount = pRight->size() + straddle.size();
+			for (auto&& ref : straddle)
+			{
+				// reference unsplitting, keep the whole reference on one side if cheaper.
+				float splitCost = leftBounds.SurfaceArea() * (float)leftCount + rightBounds.SurfaceArea() * (float)rightCount;
+				Aabb l = leftBounds, r = rightBounds;
+				l.Grow(ref.bounds);
+				r.Grow(ref.bounds);
+				float leftOnlyCost = l.SurfaceArea() * (float)leftCount + rightBounds.SurfaceArea() * (float)(rightCount - 1);
+				float rightOnlyCost = leftBounds.SurfaceArea() * (float)(leftCount - 1) + r.SurfaceArea() * (float)rightCount;
+				if (leftOnlyCost < splitCost && leftOnlyCost <= rightOnlyCost)
+				{
+					pLeft->push_back(ref);
+					leftBounds = l;
+					rightCount--;
+					continue;
+				}
+				if (rightOnlyCost < splitCost)
+				{
+					pRight->push_back(ref);
+					rightBounds = r;
+					leftCount--;
+					continue;
+				}
+
+				PrimRef lref = ref, rref = ref;
+				SplitReference(ref, tris + (size_t)ref.primIndex * 3, axis, pos, &lref.bounds, &rref.bounds);
+				if (lref.bounds.IsValid()) pLeft->push_back(lref);
+				if (rref.bounds.IsValid()) pRight->push_back(rref);
+			}
+
+			if (pLeft->empty() || pRight->empty())
+			{
+				return false;
+			}
+			splitBudget_ -= (int64_t)(pLeft->size() + pRight->size() - refs.size());
+			return true;
+		}
+
+		void MakeLeaf(const std::vector<PrimRef>& refs, uint32_t nodeIndex, Subtree& st) const
+		{
+			BvhNode& node = st.nodes[nodeIndex];
+			node.leftFirst = (uint32_t)st.prims.size();
+			node.primCount = (uint32_t)refs.size();
+			for (auto&& ref : refs)
+			{
+				st.prims.push_back(ref.primIndex);
+			}
+		}
+
+		void BuildNode(std::vector<PrimRef>&& refs, const Aabb& bounds, uint32_t nodeIndex, uint32_t depth, Subtree& st)
+		{
+			st.nodes[nodeIndex].SetAabb(bounds);
+			size_t count = refs.size();
+			if (count <= 1 || depth >= Bvh::kMaxDepth)
+			{
+				MakeLeaf(refs, nodeIndex, st);
+				return;
+			}
+
+			Aabb centBounds;
+			for (auto&& ref : refs)
+			{
+				centBounds.Grow(ref.bounds.Center());
+			}
+
+			float parentArea = std::max(bounds.SurfaceArea(), FLT_MIN);
+			SplitResult split;
+			FindObjectSplit(refs, centBounds, parentArea, &split);
+			if (settings_.bSpatialSplits && split.axis >= 0 && splitBudget_ > 0)
+			{
+				Aabb overlap = Intersect(split.leftBounds, split.rightBounds);
+				if (overlap.IsValid() && overlap.SurfaceArea() > settings_.spatialSplitAlpha * rootArea_)
+				{
+					FindSpatialSplit(refs, bounds, parentArea, &split);
+				}
+			}
+
+			float leafCost = settings_.intersectionCost * (float)count;
+			if (count <= settings_.maxLeafSize && leafCost <= split.cost)
+			{
+				MakeLeaf(refs, nodeIndex, st);
+				return;
+			}
+
+			std::vector<PrimRef> left, right;
+			bool bSplit = false;
+			if (split.axis >= 0 && split.bSpatial)
+			{
+				bSplit = PartitionSpatial(refs, split, &left, &right);
+				if (!bSplit)
+				{
+					// retry with the object split only.
+					split = SplitResult();
+					FindObjectSplit(refs, centBounds, parentArea, &split);
+				}
+			}
+			if (!bSplit && split.axis >= 0)
+			{
+				PartitionObject(refs, centBounds, split, &left, &right);
+				bSplit = !left.empty() && !right.empty();
+			}
+			if (!bSplit)
+			{
+				if (refs.empty())
+				{
+					// undo the object partition.
+					refs.swap(left);
+					refs.insert(refs.end(), right.begin(), right.end());
+				}
+				if (count <= settings_.maxLeafSize)
+				{
+					MakeLeaf(refs, nodeIndex, st);
+					return;
+				}
+				// all centroids are at the same position, split in the middle of the list.
+				right.assign(refs.begin() + count / 2, refs.end());
+				refs.resize(count / 2);
+				left.swap(refs);
+			}
+			refs.clear();
+			refs.shrink_to_fit();
+
+			Aabb leftBounds, rightBounds;
+			for (auto&& ref : left) leftBounds.Grow(ref.bounds);
+			for (auto&& ref : right) rightBounds.Grow(ref.bounds);
+
+			uint32_t childIndex = (uint32_t)st.nodes.size();
+			st.nodes.push_back(BvhNode());
+			st.nodes.push_back(BvhNode());
+			st.nodes[nodeIndex].leftFirst = childIndex;
+			st.nodes[nodeIndex].primCount = 0;
+
+			// build the left child on another thread when it is large enough.
+			bool bAsync = false;
+			if (left.size() >= kParallelSubtreeThreshold && right.size() >= kParallelSubtreeThreshold)
+			{
+				int active = activeThreads_.fetch_add(1);
+				if (active < (int)settings_.threadCount)
+				{
+					bAsync = true;
+				}
+				else
+				{
+					activeThreads_--;
+				}
+			}
+			if (bAsync)
+			{
+				Subtree leftTree;
+				auto future = std::async(std::launch::async, [&]()
+				{
+					leftTree.nodes.reserve(left.size() * 2);
+					leftTree.prims.reserve(left.size());
+					leftTree.nodes.push_back(BvhNode());
+					BuildNode(std::move(left), leftBounds, 0, depth + 1, leftTree);
+					activeThreads_--;
+				});
+				BuildNode(std::move(right), rightBounds, childIndex + 1, depth + 1, st);
+				future.get();
+				MergeSubtree(leftTree, childIndex, st);
+			}
+			else
+			{
+				BuildNode(std::move(left), leftBounds, childIndex, depth + 1, st);
+				BuildNode(std::move(right), rightBounds, childIndex + 1, depth + 1, st);
+			}
+		}
+
+		// move src into dst, src root goes to dst.nodes[slot].
+		static void MergeSubtree(const Subtree& src, uint32_t slot, Subtree& dst)
+		{
+			uint32_t nodeBase = (uint32_t)dst.nodes.size() - 1;
+			uint32_t primBase = (uint32_t)dst.prims.size();
+			auto Remap = [&](BvhNode node)
+			{
+				node.leftFirst += node.IsLeaf() ? primBase : nodeBase;
+				return node;
+			};
+			dst.nodes[slot] = Remap(src.nodes[0]);
+			for (size_t i = 1; i < src.nodes.size(); i++)
+			{
+				dst.nodes.push_back(Remap(src.nodes[i]));
+			}
+			dst.prims.insert(dst.prims.end(), src.prims.begin(), src.prims.end());
+		}
+
+	private:
+		BvhBuildSettings				settings_;
+		const std::vector<Vec3>*		pTriVertices_;
+		float							rootArea_ = 0.0f;
+		std::atomic<int>				activeThreads_;
+		std::atomic<int64_t>			splitBudget_;
+	};	// class SahBuilder
+}
+
+void Bvh::BuildSAH(const std::vector<Aabb>& primBounds, const BvhBuildSettings& settings, const std::vector<Vec3>* pTriVertices)
+{
+	nodes_.clear();
+	primIndices_.clear();
+	if (primBounds.empty())
+	{
+		return;
+	}
+
+	std::vector<PrimRef> refs;
+	refs.reserve(primBounds.size());
+	Aabb rootBounds;
+	for (uint32_t i = 0; i < (uint32_t)primBounds.size(); i++)
+	{
+		if (!primBounds[i].IsValid())
+		{
+			continue;
+		}
+		refs.push_back({primBounds[i], i});
+		rootBounds.Grow(primBounds[i]);
+	}
+	if (refs.empty())
+	{
+		return;
+	}
+
+	Subtree tree;
+	SahBuilder builder(settings, pTriVertices, refs.size());
+	builder.Build(std::move(refs), rootBounds, &tree);
+	nodes_.swap(tree.nodes);
+	primIndices_.swap(tree.prims);
+}
+
+float Bvh::ComputeSahCost(float traversalCost, float intersectionCost) const
+{
+	if (nodes_.empty())
+	{
+		return 0.0f;
+	}
+	float rootArea = std::max(nodes_[0].GetAabb().SurfaceArea(), FLT_MIN);
+	double cost = 0.0;
+	for (auto&& node : nodes_)
+	{
+		float area = node.GetAabb().SurfaceArea() / rootArea;
+		cost += node.IsLeaf() ? (double)(intersectionCost * area * (float)node.primCount) : (double)(traversalCost * area);
+	}
+	return (float)cost;
+}
+
+//	EOF
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "cpu_math.h"
+
+#include <vector>
+
+
+struct CpuRay
+{
+	Vec3	origin;
+	float	tmin;
+	Vec3	direction;
+	float	tmax;
+};
+
+// precomputed reciprocal direction for slab tests.
+struct CpuRayInv
+{
+	Vec3	origin;
+	Vec3	invDir;
+
+	CpuRayInv(const CpuRay& ray)
+		: origin(ray.origin)
+		, invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z)
+	{}
+};
+
+static const uint32_t kCacheLineSize = 64;
+
+// number of cache lines covered by [offset, offset + size), the array is assumed to be cache line aligned.
+inline uint32_t CountCacheLines(size_t offset, size_t size)
+{
+	return (uint32_t)((offset + size - 1) / kCacheLineSize - offset / kCacheLineSize + 1);
+}
+
+// memory traffic of a traversal.
+struct BvhTraversalStats
+{
+	uint64_t	nodeVisits = 0;
+	uint64_t	cacheLines = 0;
+	uint64_t	primTests = 0;
+};
+
+// binary bvh node, 32 bytes.
+// inner node: children are nodes[leftFirst] and nodes[leftFirst + 1].
+// leaf node : primitives are primIndices[leftFirst, leftFirst + primCount).
+struct BvhNode
+{
+	float		bmin[3];
+	uint32_t	leftFirst;
+	float		bmax[3];
+	uint32_t	primCount;
+
+	bool IsLeaf() const { return primCount != 0; }
+	Aabb GetAabb() const { return Aabb(Vec3(bmin[0], bmin[1], bmin[2]), Vec3(bmax[0], bmax[1], bmax[2])); }
+	void SetAabb(const Aabb& b)
+	{
+		bmin[0] = b.bmin.x; bmin[1] = b.bmin.y; bmin[2] = b.bmin.z;
+		bmax[0] = b.bmax.x; bmax[1] = b.bmax.y; bmax[2] = b.bmax.z;
+	}
+};
+
+struct BvhBuildSettings
+{
+	uint32_t	threadCount = 0;			// 0 uses all hardware threads.
+	uint32_t	binCount = 16;
+	uint32_t	maxLeafSize = 4;
+	float		traversalCost = 1.0f;
+	float		intersectionCost = 1.0f;
+
+	// spatial splits (SBVH), needs triangle vertices.
+	bool		bSpatialSplits = false;
+	float		spatialSplitAlpha = 1e-5f;	// child overlap relative to the root area that enables spatial splits.
+	float		maxDuplication = 0.5f;		// extra references relative to the primitive count.
+};
+
+class Bvh
+{
+public:
+	static const uint32_t kMaxLeafSize = 4;
+	static const uint32_t kMaxDepth = 60;
+
+public:
+	// object median split on the largest centroid axis.
+	void Build(const std::vector<Aabb>& primBounds);
+	// binned sah split, subtrees are built in parallel.
+	// pTriVertices holds 3 vertices per primitive and is required for spatial splits.
+	// primitives split by spatial splits are referenced from more than one leaf.
+	void BuildSAH(const std::vector<Aabb>& primBounds, const BvhBuildSettings& settings, const std::vector<Vec3>* pTriVertices = nullptr);
+
+	// sah cost of the whole tree, normalized by the root surface area.
+	float ComputeSahCost(float traversalCost = 1.0f, float intersectionCost = 1.0f) const;
+
+	const std::vector<BvhNode>& GetNodes() const { return nodes_; }
+	const std::vector<uint32_t>& GetPrimIndices() const { return primIndices_; }
+	std::vector<BvhNode>& GetNodes() { return nodes_; }
+	std::vector<uint32_t>& GetPrimIndices() { return primIndices_; }
+	bool IsEmpty() const { return nodes_.empty(); }
+
+	// closest hit traversal.
+	// func(primIndex, ray) tests a primitive, shrinks ray.tmax on hit and returns false to end the traversal.
+	template <typename IntersectFunc>
+	void Traverse(CpuRay& ray, IntersectFunc&& func, BvhTraversalStats* pStats = nullptr) const;
+
+private:
+	std::vector<BvhNode>	nodes_;
+	std::vector<uint32_t>	primIndices_;
+};	// class Bvh
+
+inline bool IntersectAabb(const CpuRayInv& ray, const float bmin[3], const float bmax[3], float tmin, float tmax, float* pDist)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		float t0 = (bmin[i] - ray.origin[i]) * ray.invDir[i];
+		float t1 = (bmax[i] - ray.origin[i]) * ray.invDir[i];
+		if (t0 > t1) std::swap(t0, t1);
+		tmin = std::max(tmin, t0);
+		tmax = std::min(tmax, t1);
+	}
+	*pDist = tmin;
+	return tmin <= tmax;
+}
+
+template <typename IntersectFunc>
+void Bvh::Traverse(CpuRay& ray, IntersectFunc&& func, BvhTraversalStats* pStats) const
+{
+	if (nodes_.empty())
+	{
+		return;
+	}
+
+	CpuRayInv rayInv(ray);
+	uint32_t stack[64];
+	uint32_t stackTop = 0;
+	uint32_t nodeIndex = 0;
+	float dist;
+	if (pStats)
+	{
+		pStats->nodeVisits++;
+		pStats->cacheLines += CountCacheLines(0, sizeof(BvhNode));
+	}
+	if (!IntersectAabb(rayInv, nodes_[0].bmin, nodes_[0].bmax, ray.tmin, ray.tmax, &dist))
+	{
+		return;
+	}
+	while (true)
+	{
+		const BvhNode& node = nodes_[nodeIndex];
+		if (node.IsLeaf())
+		{
+			if (pStats)
+			{
+				pStats->primTests += node.primCount;
+			}
+			for (uint32_t i = 0; i < node.primCount; i++)
+			{
+				if (!func(primIndices_[node.leftFirst + i], ray))
+				{
+					// terminated by the callback.
+					return;
+				}
+			}
+		}
+		else
+		{
+			// both children are fetched together.
+			if (pStats)
+			{
+				pStats->nodeVisits++;
+				pStats->cacheLines += CountCacheLines(node.leftFirst * sizeof(BvhNode), sizeof(BvhNode) * 2);
+			}
+			const BvhNode& c0 = nodes_[node.leftFirst];
+			const BvhNode& c1 = nodes_[node.leftFirst + 1];
+			float d0, d1;
+			bool h0 = IntersectAabb(rayInv, c0.bmin, c0.bmax, ray.tmin, ray.tmax, &d0);
+			bool h1 = IntersectAabb(rayInv, c1.bmin, c1.bmax, ray.tmin, ray.tmax, &d1);
+			if (h0 && h1)
+			{
+				uint32_t nearIdx = node.leftFirst, farIdx = node.leftFirst + 1;
+				if (d1 < d0) std::swap(nearIdx, farIdx);
+				stack[stackTop++] = farIdx;
+				nodeIndex = nearIdx;
+				continue;
+			}
+			if (h0 || h1)
+			{
+				nodeIndex = h0 ? node.leftFirst : node.leftFirst + 1;
+				continue;
+			}
+		}
+		if (stackTop == 0)
+		{
+			break;
+		}
+		nodeIndex = stack[--stackTop];
+	}
+}
+
+//	EOF
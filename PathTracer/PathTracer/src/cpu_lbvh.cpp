@@ -0,0 +1,318 @@
+#include "cpu_lbvh.h"
+#include "cpu_parallel.h"
+
+#include <chrono>
+
+#if defined(_MSC_VER)
+#	include <intrin.h>
+#endif
+
+
+namespace
+{
+	static const uint32_t kRadixSize = 1 << LbvhBuilder::kRadixBits;
+	static const uint32_t kInvalidParent = 0xffffffff;
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double GetElapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	inline uint32_t CountLeadingZeros(uint32_t v)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		return _BitScanReverse(&index, v) ? 31 - (uint32_t)index : 32;
+#else
+		return v ? (uint32_t)__builtin_clz(v) : 32;
+#endif
+	}
+
+	// length of the common prefix of keys i and j, equal keys are distinguished by the index.
+	inline int CommonPrefix(const uint32_t* keys, int count, int i, int j)
+	{
+		if (j < 0 || j >= count)
+		{
+			return -1;
+		}
+		uint32_t ki = keys[i], kj = keys[j];
+		return (ki == kj)
+			? 32 + (int)CountLeadingZeros((uint32_t)i ^ (uint32_t)j)
+			: (int)CountLeadingZeros(ki ^ kj);
+	}
+}
+
+bool LbvhBuilder::Build(const std::vector<Aabb>& primBounds, uint32_t threadCount, Bvh* pOut)
+{
+	timings_ = LbvhBuildTimings();
+	auto&& nodes = pOut->GetNodes();
+	auto&& primIndices = pOut->GetPrimIndices();
+	nodes.clear();
+	primIndices.clear();
+	if (primBounds.empty())
+	{
+		return false;
+	}
+	threadCount = (threadCount == 0) ? GetDefaultThreadCount() : threadCount;
+
+	auto start = Clock::now();
+	ComputeMortonCodes(primBounds, threadCount);
+	SortMortonCodes(threadCount);
+	EmitNodes(primBounds, threadCount, pOut);
+	RefitNodes(threadCount, pOut);
+	timings_.totalMs = GetElapsedMs(start);
+	return true;
+}
+
+void LbvhBuilder::ComputeMortonCodes(const std::vector<Aabb>& primBounds, uint32_t threadCount)
+{
+	size_t count = primBounds.size();
+	uint32_t chunkCount = GetChunkCount(count, threadCount, kMinChunkSize);
+
+	// centroid bounds.
+	auto start = Clock::now();
+	std::vector<Aabb> chunkBounds(chunkCount);
+	ParallelChunks(count, chunkCount, [&](size_t begin, size_t end, uint32_t chunk)
+	{
+		Aabb b;
+		for (size_t i = begin; i < end; i++)
+		{
+			b.Grow(primBounds[i].Center());
+		}
+		chunkBounds[chunk] = b;
+	});
+	Aabb centroidBounds;
+	for (auto&& b : chunkBounds)
+	{
+		centroidBounds.Grow(b);
+	}
+	timings_.boundsMs = GetElapsedMs(start);
+
+	start = Clock::now();
+	// same scale on all axes, so that flat scenes do not split on the thin axis first.
+	Vec3 origin = centroidBounds.bmin;
+	Vec3 extent = centroidBounds.Extent();
+	float maxExtent = std::max(std::max(extent.x, extent.y), extent.z);
+	float invExtent = (maxExtent > 0.0f) ? 1.0f / maxExtent : 0.0f;
+	keys_.resize(count);
+	values_.resize(count);
+	ParallelChunks(count, chunkCount, [&](size_t begin, size_t end, uint32_t)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			keys_[i] = Morton3D((primBounds[i].Center() - origin) * invExtent);
+			values_[i] = (uint32_t)i;
+		}
+	});
+	timings_.mortonMs = GetElapsedMs(start);
+}
+
+void LbvhBuilder::SortMortonCodes(uint32_t threadCount)
+{
+	auto start = Clock::now();
+	size_t count = keys_.size();
+	uint32_t chunkCount = GetChunkCount(count, threadCount, kMinChunkSize);
+	keysTemp_.resize(count);
+	valuesTemp_.resize(count);
+	histograms_.resize(chunkCount * kRadixSize);
+
+	// lsd radix sort, each pass is stable.
+	for (uint32_t shift = 0; shift < kMortonBits * 3; shift += kRadixBits)
+	{
+		ParallelChunks(count, chunkCount, [&](size_t begin, size_t end, uint32_t chunk)
+		{
+			uint32_t* hist = &histograms_[chunk * kRadixSize];
+			std::fill(hist, hist + kRadixSize, 0u);
+			for (size_t i = begin; i < end; i++)
+			{
+				hist[(keys_[i] >> shift) & (kRadixSize - 1)]++;
+			}
+		});
+
+		// exclusive prefix sum in digit-major, chunk-minor order.
+		uint32_t sum = 0;
+		bool bSingleDigit = false;
+		for (uint32_t d = 0; d < kRadixSize; d++)
+		{
+			uint32_t digitSum = 0;
+			for (uint32_t c = 0; c < chunkCount; c++)
+			{
+				uint32_t n = histograms_[c * kRadixSize + d];
+				histograms_[c * kRadixSize + d] = sum;
+				sum += n;
+				digitSum += n;
+			}
+			bSingleDigit |= digitSum == (uint32_t)count;
+		}
+		if (bSingleDigit)
+		{
+			// all keys share this digit, the pass would not move anything.
+			continue;
+		}
+
+		ParallelChunks(count, chunkCount, [&](size_t begin, size_t end, uint32_t chunk)
+		{
+			uint32_t* offsets = &histograms_[chunk * kRadixSize];
+			for (size_t i = begin; i < end; i++)
+			{
+				uint32_t dst = offsets[(keys_[i] >> shift) & (kRadixSize - 1)]++;
+				keysTemp_[dst] = keys_[i];
+				valuesTemp_[dst] = values_[i];
+			}
+		});
+		keys_.swap(keysTemp_);
+		values_.swap(valuesTemp_);
+	}
+	timings_.sortMs = GetElapsedMs(start);
+}
+
+void LbvhBuilder::EmitNodes(const std::vector<Aabb>& primBounds, uint32_t threadCount, Bvh* pOut)
+{
+	auto start = Clock::now();
+	auto&& nodes = pOut->GetNodes();
+	auto&& primIndices = pOut->GetPrimIndices();
+	int leafCount = (int)keys_.size();
+	int innerCount = leafCount - 1;
+	nodes.resize(leafCount * 2 - 1);
+	primIndices = values_;
+	innerSlots_.resize(std::max(innerCount, 1));
+	innerParents_.resize(std::max(innerCount, 1));
+	leafParents_.resize(leafCount);
+
+	auto WriteLeaf = [&](uint32_t slot, uint32_t leaf)
+	{
+		BvhNode& node = nodes[slot];
+		node.SetAabb(primBounds[values_[leaf]]);
+		node.leftFirst = leaf;
+		node.primCount = 1;
+	};
+
+	if (innerCount == 0)
+	{
+		WriteLeaf(0, 0);
+		leafParents_[0] = kInvalidParent;
+		timings_.emitMs = GetElapsedMs(start);
+		return;
+	}
+	innerSlots_[0] = 0;
+	innerParents_[0] = kInvalidParent;
+
+	// each inner node finds its key range and split independently.
+	// inner node i owns the child slots 2i + 1 and 2i + 2, so no allocation is shared between threads.
+	const uint32_t* keys = keys_.data();
+	uint32_t chunkCount = GetChunkCount(innerCount, threadCount, kMinChunkSize);
+	ParallelChunks(innerCount, chunkCount, [&](size_t begin, size_t end, uint32_t)
+	{
+		for (int i = (int)begin; i < (int)end; i++)
+		{
+			// direction of the range.
+			int d = (CommonPrefix(keys, leafCount, i, i + 1) - CommonPrefix(keys, leafCount, i, i - 1)) >= 0 ? 1 : -1;
+			int minPrefix = CommonPrefix(keys, leafCount, i, i - d);
+
+			// upper bound of the range length, then binary search the other end.
+			int maxLength = 2;
+			while (CommonPrefix(keys, leafCount, i, i + maxLength * d) > minPrefix)
+			{
+				maxLength *= 2;
+			}
+			int length = 0;
+			for (int t = maxLength / 2; t >= 1; t /= 2)
+			{
+				if (CommonPrefix(keys, leafCount, i, i + (length + t) * d) > minPrefix)
+				{
+					length += t;
+				}
+			}
+			int j = i + length * d;
+
+			// binary search the split position.
+			int nodePrefix = CommonPrefix(keys, leafCount, i, j);
+			int split = 0;
+			int t = length;
+			do
+			{
+				t = (t + 1) / 2;
+				if (CommonPrefix(keys, leafCount, i, i + (split + t) * d) > nodePrefix)
+				{
+					split += t;
+				}
+			} while (t > 1);
+			int gamma = i + split * d + std::min(d, 0);
+
+			uint32_t childSlots[2] = { (uint32_t)(2 * i + 1), (uint32_t)(2 * i + 2) };
+			int children[2] = { gamma, gamma + 1 };
+			bool bLeaf[2] = { std::min(i, j) == gamma, std::max(i, j) == gamma + 1 };
+			for (int c = 0; c < 2; c++)
+			{
+				if (bLeaf[c])
+				{
+					WriteLeaf(childSlots[c], children[c]);
+					leafParents_[children[c]] = (uint32_t)i;
+				}
+				else
+				{
+					BvhNode& node = nodes[childSlots[c]];
+					node.leftFirst = 2 * children[c] + 1;
+					node.primCount = 0;
+					innerSlots_[children[c]] = childSlots[c];
+					innerParents_[children[c]] = (uint32_t)i;
+				}
+			}
+		}
+	});
+	nodes[0].leftFirst = 1;
+	nodes[0].primCount = 0;
+	timings_.emitMs = GetElapsedMs(start);
+}
+
+void LbvhBuilder::RefitNodes(uint32_t threadCount, Bvh* pOut)
+{
+	auto start = Clock::now();
+	auto&& nodes = pOut->GetNodes();
+	size_t leafCount = leafParents_.size();
+	size_t innerCount = leafCount - 1;
+	if (innerCount == 0)
+	{
+		timings_.refitMs = GetElapsedMs(start);
+		return;
+	}
+
+	if (visitCapacity_ < innerCount)
+	{
+		visitCapacity_ = innerCount;
+		visitCounts_.reset(new std::atomic<uint32_t>[visitCapacity_]);
+	}
+	uint32_t chunkCount = GetChunkCount(innerCount, threadCount, kMinChunkSize);
+	ParallelChunks(innerCount, chunkCount, [&](size_t begin, size_t end, uint32_t)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			visitCounts_[i].store(0, std::memory_order_relaxed);
+		}
+	});
+
+	// walk up from each leaf, the second child to arrive computes the parent bounds.
+	ParallelChunks(leafCount, chunkCount, [&](size_t begin, size_t end, uint32_t)
+	{
+		for (size_t leaf = begin; leaf < end; leaf++)
+		{
+			uint32_t inner = leafParents_[leaf];
+			while (inner != kInvalidParent)
+			{
+				if (visitCounts_[inner].fetch_add(1, std::memory_order_acq_rel) == 0)
+				{
+					break;
+				}
+				Aabb b = nodes[2 * inner + 1].GetAabb();
+				b.Grow(nodes[2 * inner + 2].GetAabb());
+				nodes[innerSlots_[inner]].SetAabb(b);
+				inner = innerParents_[inner];
+			}
+		}
+	});
+	timings_.refitMs = GetElapsedMs(start);
+}
+
+//	EOF
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "cpu_bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+
+// time of each build phase in milliseconds.
+struct LbvhBuildTimings
+{
+	double	boundsMs = 0.0;
+	double	mortonMs = 0.0;
+	double	sortMs = 0.0;
+	double	emitMs = 0.0;
+	double	refitMs = 0.0;
+	double	totalMs = 0.0;
+};
+
+// linear bvh builder for instance bounds (Karras 2012).
+// morton codes, parallel radix sort and parallel node emission.
+// the output uses the Bvh node layout with one primitive per leaf:
+// the children of the i-th inner node in morton order are nodes[2i + 1] and nodes[2i + 2].
+// work buffers are kept between builds, so that rebuilding every frame does not allocate.
+class LbvhBuilder
+{
+public:
+	static const uint32_t kMortonBits = 10;		// bits per axis.
+	static const uint32_t kRadixBits = 8;
+	static const size_t kMinChunkSize = 4096;	// smaller inputs run on fewer threads.
+
+public:
+	// threadCount 0 uses all hardware threads.
+	bool Build(const std::vector<Aabb>& primBounds, uint32_t threadCount, Bvh* pOut);
+
+	const LbvhBuildTimings& GetTimings() const { return timings_; }
+
+private:
+	void ComputeMortonCodes(const std::vector<Aabb>& primBounds, uint32_t threadCount);
+	void SortMortonCodes(uint32_t threadCount);
+	void EmitNodes(const std::vector<Aabb>& primBounds, uint32_t threadCount, Bvh* pOut);
+	void RefitNodes(uint32_t threadCount, Bvh* pOut);
+
+private:
+	LbvhBuildTimings		timings_;
+	std::vector<uint32_t>	keys_, keysTemp_;
+	std::vector<uint32_t>	values_, valuesTemp_;
+	std::vector<uint32_t>	histograms_;
+	std::vector<uint32_t>	innerSlots_;			// node index of each inner node.
+	std::vector<uint32_t>	innerParents_;
+	std::vector<uint32_t>	leafParents_;
+	std::unique_ptr<std::atomic<uint32_t>[]>	visitCounts_;
+	size_t					visitCapacity_ = 0;
+};	// class LbvhBuilder
+
+// insert 2 zero bits between each of the lower 10 bits.
+inline uint32_t ExpandBits(uint32_t v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+// 30 bit morton code of a point normalized to [0, 1].
+inline uint32_t Morton3D(const Vec3& p)
+{
+	const float kScale = (float)(1 << LbvhBuilder::kMortonBits);
+	uint32_t x = (uint32_t)std::min(std::max(p.x * kScale, 0.0f), kScale - 1.0f);
+	uint32_t y = (uint32_t)std::min(std::max(p.y * kScale, 0.0f), kScale - 1.0f);
+	uint32_t z = (uint32_t)std::min(std::max(p.z * kScale, 0.0f), kScale - 1.0f);
+	return (ExpandBits(x) << 2) | (ExpandBits(y) << 1) | ExpandBits(z);
+}
+
+//	EOF
@@ -0,0 +1,93 @@
+#include "cpu_material_fold.h"
+
+#include <algorithm>
+
+
+namespace
+{
+	// texel of DummyTex::White.
+	static const Vec4 kDummyWhite(1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+MaterialFold ClassifyMaterial(bool bHasBaseColorTex, bool bHasORMTex, bool isOpaque)
+{
+	MaterialFold ret;
+	ret.bConstBaseColor = !bHasBaseColorTex;
+	ret.bConstORM = !bHasORMTex;
+	if (ret.bConstBaseColor && ret.bConstORM)
+	{
+		ret.type = MaterialFoldType::Constant;
+	}
+	else if (ret.bConstBaseColor || ret.bConstORM)
+	{
+		ret.type = MaterialFoldType::Partial;
+	}
+	ret.baseColor = ret.bConstBaseColor ? kDummyWhite : Vec4(0.0f);
+	ret.orm = ret.bConstORM ? kDummyWhite : Vec4(0.0f);
+	ret.packedBaseColor = PackMaterialConstant(ret.baseColor);
+	ret.packedORM = PackMaterialConstant(ret.orm);
+
+	// opaque materials have no any hit, masked ones only read the base color alpha.
+	ret.bSkipAnyHit = isOpaque || (ret.bConstBaseColor && ret.baseColor.w >= kMaterialOpacityThreshold);
+	return ret;
+}
+
+MaterialFold ClassifyMaterial(const RMeshMaterial& material)
+{
+	auto HasTexture = [&](int slot)
+	{
+		return (int)material.textureNames.size() > slot && !material.textureNames[slot].empty();
+	};
+	return ClassifyMaterial(HasTexture(kRMeshTexBaseColor), HasTexture(kRMeshTexORM), material.isOpaque);
+}
+
+const char* GetMaterialFoldName(MaterialFoldType type)
+{
+	switch (type)
+	{
+	case MaterialFoldType::Textured:	return "textured";
+	case MaterialFoldType::Partial:		return "partial";
+	case MaterialFoldType::Constant:	return "constant";
+	}
+	return "unknown";
+}
+
+MaterialHitGroup GetMaterialHitGroup(const MaterialFold& fold, bool isOpaque)
+{
+	if (fold.type == MaterialFoldType::Constant && fold.bSkipAnyHit)
+	{
+		return kMaterialHitGroupConstant;
+	}
+	return (isOpaque || fold.bSkipAnyHit) ? kMaterialHitGroupOpaque : kMaterialHitGroupMasked;
+}
+
+const char* GetMaterialHitGroupName(MaterialHitGroup hitGroup)
+{
+	switch (hitGroup)
+	{
+	case kMaterialHitGroupOpaque:	return "opaque";
+	case kMaterialHitGroupMasked:	return "masked";
+	case kMaterialHitGroupConstant:	return "constant";
+	default:						return "unknown";
+	}
+}
+
+uint32_t PackMaterialConstant(const Vec4& v)
+{
+	auto ToUnorm = [](float f)
+	{
+		return (uint32_t)(std::min(std::max(f, 0.0f), 1.0f) * 255.0f + 0.5f);
+	};
+	return (ToUnorm(v.w) << 24) | (ToUnorm(v.z) << 16) | (ToUnorm(v.y) << 8) | (ToUnorm(v.x) << 0);
+}
+
+Vec4 UnpackMaterialConstant(uint32_t v)
+{
+	return Vec4(
+		(float)((v >> 0) & 0xff),
+		(float)((v >> 8) & 0xff),
+		(float)((v >> 16) & 0xff),
+		(float)((v >> 24) & 0xff)) * (1.0f / 255.0f);
+}
+
+//	EOF
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "cpu_math.h"
+#include "rmesh_reader.h"
+
+
+// how much of a material is known without texture fetches.
+enum class MaterialFoldType
+{
+	Textured,			// every texture is bound.
+	Partial,			// some textures are missing and bound as DummyTex::White.
+	Constant,			// no texture, the material does not depend on uv.
+};
+
+// result of the material specialization.
+// a missing texture is bound as DummyTex::White, so its fetch always returns the constant below.
+struct MaterialFold
+{
+	MaterialFoldType	type = MaterialFoldType::Textured;
+	bool				bConstBaseColor = false;
+	bool				bConstORM = false;
+	Vec4				baseColor;			// value of the base color fetch when bConstBaseColor.
+	Vec4				orm;				// value of the orm fetch when bConstORM.
+	// the any hit test of a masked material has a constant result and passes, so it is dropped.
+	bool				bSkipAnyHit = false;
+	uint32_t			packedBaseColor = 0;	// SubmeshOffsetCB::constBaseColor
+	uint32_t			packedORM = 0;			// SubmeshOffsetCB::constORM
+};
+
+// hit groups of the material table.
+enum MaterialHitGroup
+{
+	kMaterialHitGroupOpaque,		// MaterialOpacityHG
+	kMaterialHitGroupMasked,		// MaterialMaskedHG
+	kMaterialHitGroupConstant,		// MaterialConstantHG
+
+	kMaterialHitGroupMax
+};
+
+// same threshold as MaterialAHS.
+static const float kMaterialOpacityThreshold = 0.33f;
+
+MaterialFold ClassifyMaterial(bool bHasBaseColorTex, bool bHasORMTex, bool isOpaque);
+MaterialFold ClassifyMaterial(const RMeshMaterial& material);
+const char* GetMaterialFoldName(MaterialFoldType type);
+// constant materials use MaterialConstantHG, a masked material whose alpha test always passes drops the any hit.
+MaterialHitGroup GetMaterialHitGroup(const MaterialFold& fold, bool isOpaque);
+const char* GetMaterialHitGroupName(MaterialHitGroup hitGroup);
+
+// rgba8 unorm, same packing as UnpackMaterialConstant() in material.lib.hlsl.
+uint32_t PackMaterialConstant(const Vec4& v);
+Vec4 UnpackMaterialConstant(uint32_t v);
+
+//	EOF
@@ -0,0 +1,69 @@
+#include "cpu_material_registry.h"
+
+#include <cstring>
+
+
+void BindlessMaterialRegistry::Clear()
+{
+	for (int i = 0; i < (int)MaterialDescriptorHeap::Max; i++)
+	{
+		slotCounts_[i] = 0;
+		ranges_[i].clear();
+	}
+	records_.clear();
+	recordHitGroups_.clear();
+	recordIndices_.clear();
+	counters_ = MaterialRegistryCounters();
+}
+
+uint32_t BindlessMaterialRegistry::RegisterDescriptor(MaterialDescriptorHeap heap, uint64_t key, bool* pbCreated)
+{
+	return RegisterRange(heap, &key, 1, pbCreated);
+}
+
+uint32_t BindlessMaterialRegistry::RegisterRange(MaterialDescriptorHeap heap, const uint64_t* pKeys, uint32_t count, bool* pbCreated)
+{
+	int h = (int)heap;
+	counters_.requestedDescriptors[h] += count;
+
+	auto ret = ranges_[h].insert(std::make_pair(RangeKey(pKeys, pKeys + count), slotCounts_[h]));
+	if (ret.second)
+	{
+		slotCounts_[h] += count;
+		counters_.copiedDescriptors[h] += count;
+	}
+	if (pbCreated)
+	{
+		*pbCreated = ret.second;
+	}
+	return ret.first->second;
+}
+
+uint32_t BindlessMaterialRegistry::RegisterMaterial(const MaterialIndexRecord& record, uint32_t hitGroup, bool* pbCreated)
+{
+	static_assert(sizeof(MaterialIndexRecord) % sizeof(uint32_t) == 0, "MaterialIndexRecord must be made of uint32_t.");
+	counters_.requestedRecords++;
+
+	RecordKey key;
+	key.first.resize(sizeof(record) / sizeof(uint32_t));
+	memcpy(key.first.data(), &record, sizeof(record));
+	key.second = hitGroup;
+
+	auto ret = recordIndices_.insert(std::make_pair(std::move(key), (uint32_t)records_.size()));
+	if (ret.second)
+	{
+		records_.push_back(record);
+		recordHitGroups_.push_back(hitGroup);
+	}
+	else
+	{
+		counters_.sharedRecords++;
+	}
+	if (pbCreated)
+	{
+		*pbCreated = ret.second;
+	}
+	return ret.first->second;
+}
+
+//	EOF
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+
+// descriptor heaps of the local root tables.
+enum class MaterialDescriptorHeap
+{
+	View,			// cbv, srv and uav.
+	Sampler,
+
+	Max
+};
+
+// bindless indices of one material record, same layout as LocalIndex of SampleApplication::CreateRayTracingShaderTableDR().
+struct MaterialIndexRecord
+{
+	uint32_t	cbSubmesh;
+	uint32_t	indices;
+	uint32_t	vertices;
+	uint32_t	texBaseColor;
+	uint32_t	texORM;
+	uint32_t	texBaseColorSampler;
+};
+
+struct MaterialRegistryCounters
+{
+	uint64_t	requestedDescriptors[(int)MaterialDescriptorHeap::Max] = {};	// descriptors of every registered range, what a copy per record would use.
+	uint64_t	copiedDescriptors[(int)MaterialDescriptorHeap::Max] = {};		// descriptors of new ranges, the ones that have to be copied.
+	uint64_t	requestedRecords = 0;
+	uint64_t	sharedRecords = 0;		// records that were found by content.
+};
+
+// stable slots for descriptors and descriptor ranges of material tables.
+// a descriptor or a range is identified by the keys of its source descriptors, e.g. cpu handles,
+// and the same keys always return the same slot, so records that reference the same textures,
+// sampler and SubmeshOffsetCB share one copy in the heap.
+// material index records are deduplicated by content in the same way.
+// heap usage depends on unique content only, not on the instance count.
+class BindlessMaterialRegistry
+{
+public:
+	void Clear();
+
+	// slot of a single descriptor.
+	// pbCreated is set to true when the slot was allocated by this call and the descriptor has to be copied.
+	uint32_t RegisterDescriptor(MaterialDescriptorHeap heap, uint64_t key, bool* pbCreated = nullptr);
+	// first slot of count contiguous descriptors for a descriptor table.
+	uint32_t RegisterRange(MaterialDescriptorHeap heap, const uint64_t* pKeys, uint32_t count, bool* pbCreated = nullptr);
+	// index of the record, hitGroup separates records with the same indices but different hit groups.
+	uint32_t RegisterMaterial(const MaterialIndexRecord& record, uint32_t hitGroup = 0, bool* pbCreated = nullptr);
+
+	// slots allocated in a heap.
+	uint32_t GetDescriptorCount(MaterialDescriptorHeap heap) const { return slotCounts_[(int)heap]; }
+	uint32_t GetRangeCount(MaterialDescriptorHeap heap) const { return (uint32_t)ranges_[(int)heap].size(); }
+	uint32_t GetRecordCount() const { return (uint32_t)records_.size(); }
+	const MaterialIndexRecord& GetRecord(uint32_t index) const { return records_[index]; }
+	const std::vector<MaterialIndexRecord>& GetRecords() const { return records_; }
+	uint32_t GetRecordHitGroup(uint32_t index) const { return recordHitGroups_[index]; }
+
+	const MaterialRegistryCounters& GetCounters() const { return counters_; }
+
+private:
+	typedef std::vector<uint64_t>	RangeKey;
+	typedef std::pair<std::vector<uint32_t>, uint32_t>	RecordKey;
+
+	uint32_t							slotCounts_[(int)MaterialDescriptorHeap::Max] = {};
+	std::map<RangeKey, uint32_t>		ranges_[(int)MaterialDescriptorHeap::Max];
+	std::vector<MaterialIndexRecord>	records_;
+	std::vector<uint32_t>				recordHitGroups_;
+	std::map<RecordKey, uint32_t>		recordIndices_;
+	MaterialRegistryCounters			counters_;
+};	// class BindlessMaterialRegistry
+
+//	EOF
@@ -0,0 +1,116 @@
+#include "cpu_math.h"
+
+
+DirectX::XMFLOAT4X4 MatrixInverse(const DirectX::XMFLOAT4X4& mat)
+{
+	const float* m = &mat.m[0][0];
+	float inv[16];
+
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	float invDet = (det != 0.0f) ? 1.0f / det : 0.0f;
+
+	DirectX::XMFLOAT4X4 ret;
+	float* r = &ret.m[0][0];
+	for (int i = 0; i < 16; i++)
+	{
+		r[i] = inv[i] * invDet;
+	}
+	return ret;
+}
+
+DirectX::XMFLOAT4X4 MatrixTranslation(float x, float y, float z)
+{
+	auto r = MatrixIdentity();
+	r.m[3][0] = x;
+	r.m[3][1] = y;
+	r.m[3][2] = z;
+	return r;
+}
+
+DirectX::XMFLOAT4X4 MatrixScaling(float x, float y, float z)
+{
+	auto r = MatrixIdentity();
+	r.m[0][0] = x;
+	r.m[1][1] = y;
+	r.m[2][2] = z;
+	return r;
+}
+
+DirectX::XMFLOAT4X4 MatrixRotationX(float angle)
+{
+	float s = std::sin(angle), c = std::cos(angle);
+	auto r = MatrixIdentity();
+	r.m[1][1] = c; r.m[1][2] = s;
+	r.m[2][1] = -s; r.m[2][2] = c;
+	return r;
+}
+
+DirectX::XMFLOAT4X4 MatrixRotationZ(float angle)
+{
+	float s = std::sin(angle), c = std::cos(angle);
+	auto r = MatrixIdentity();
+	r.m[0][0] = c; r.m[0][1] = s;
+	r.m[1][0] = -s; r.m[1][1] = c;
+	return r;
+}
+
+DirectX::XMFLOAT4X4 MatrixRotationY(float angle)
+{
+	float s = std::sin(angle), c = std::cos(angle);
+	auto r = MatrixIdentity();
+	r.m[0][0] = c; r.m[0][2] = -s;
+	r.m[2][0] = s; r.m[2][2] = c;
+	return r;
+}
+
+DirectX::XMFLOAT4X4 MatrixRotationRollPitchYaw(float pitch, float yaw, float roll)
+{
+	// roll, then pitch, then yaw. same order as XMMatrixRotationRollPitchYaw.
+	return MatrixMultiply(MatrixMultiply(MatrixRotationZ(roll), MatrixRotationX(pitch)), MatrixRotationY(yaw));
+}
+
+DirectX::XMFLOAT4X4 MatrixLookAtRH(const Vec3& eye, const Vec3& focus, const Vec3& up)
+{
+	Vec3 r2 = Normalize(eye - focus);
+	Vec3 r0 = Normalize(Cross(up, r2));
+	Vec3 r1 = Cross(r2, r0);
+
+	DirectX::XMFLOAT4X4 m;
+	m.m[0][0] = r0.x; m.m[0][1] = r1.x; m.m[0][2] = r2.x; m.m[0][3] = 0.0f;
+	m.m[1][0] = r0.y; m.m[1][1] = r1.y; m.m[1][2] = r2.y; m.m[1][3] = 0.0f;
+	m.m[2][0] = r0.z; m.m[2][1] = r1.z; m.m[2][2] = r2.z; m.m[2][3] = 0.0f;
+	m.m[3][0] = -Dot(r0, eye); m.m[3][1] = -Dot(r1, eye); m.m[3][2] = -Dot(r2, eye); m.m[3][3] = 1.0f;
+	return m;
+}
+
+DirectX::XMFLOAT4X4 MatrixPerspectiveInfiniteInverseFovRH(float fovY, float aspect, float nearZ)
+{
+	float height = std::cos(fovY * 0.5f) / std::sin(fovY * 0.5f);
+	float width = height / aspect;
+
+	DirectX::XMFLOAT4X4 m{};
+	m.m[0][0] = width;
+	m.m[1][1] = height;
+	m.m[2][3] = -1.0f;
+	m.m[3][2] = nearZ;
+	return m;
+}
+
+//	EOF
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "cpu_types.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+
+static const float kCpuPI = 3.14159265358979f;
+
+struct Vec2
+{
+	float x, y;
+
+	Vec2() : x(0.0f), y(0.0f) {}
+	Vec2(float v) : x(v), y(v) {}
+	Vec2(float _x, float _y) : x(_x), y(_y) {}
+};
+
+struct Vec3
+{
+	float x, y, z;
+
+	Vec3() : x(0.0f), y(0.0f), z(0.0f) {}
+	Vec3(float v) : x(v), y(v), z(v) {}
+	Vec3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+
+	float& operator[](int i) { return (&x)[i]; }
+	float operator[](int i) const { return (&x)[i]; }
+};
+
+struct Vec4
+{
+	float x, y, z, w;
+
+	Vec4() : x(0.0f), y(0.0f), z(0.0f), w(0.0f) {}
+	Vec4(float v) : x(v), y(v), z(v), w(v) {}
+	Vec4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+	Vec4(const Vec3& v, float _w) : x(v.x), y(v.y), z(v.z), w(_w) {}
+
+	Vec3 xyz() const { return Vec3(x, y, z); }
+};
+
+inline Vec2 operator+(const Vec2& a, const Vec2& b) { return Vec2(a.x + b.x, a.y + b.y); }
+inline Vec2 operator-(const Vec2& a, const Vec2& b) { return Vec2(a.x - b.x, a.y - b.y); }
+inline Vec2 operator*(const Vec2& a, float s) { return Vec2(a.x * s, a.y * s); }
+
+inline Vec3 operator+(const Vec3& a, const Vec3& b) { return Vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Vec3 operator-(const Vec3& a, const Vec3& b) { return Vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Vec3 operator*(const Vec3& a, const Vec3& b) { return Vec3(a.x * b.x, a.y * b.y, a.z * b.z); }
+inline Vec3 operator/(const Vec3& a, const Vec3& b) { return Vec3(a.x / b.x, a.y / b.y, a.z / b.z); }
+inline Vec3 operator*(const Vec3& a, float s) { return Vec3(a.x * s, a.y * s, a.z * s); }
+inline Vec3 operator*(float s, const Vec3& a) { return Vec3(a.x * s, a.y * s, a.z * s); }
+inline Vec3 operator-(const Vec3& a) { return Vec3(-a.x, -a.y, -a.z); }
+inline Vec3& operator+=(Vec3& a, const Vec3& b) { a.x += b.x; a.y += b.y; a.z += b.z; return a; }
+inline Vec3& operator*=(Vec3& a, const Vec3& b) { a.x *= b.x; a.y *= b.y; a.z *= b.z; return a; }
+inline Vec3& operator*=(Vec3& a, float s) { a.x *= s; a.y *= s; a.z *= s; return a; }
+
+inline Vec4 operator+(const Vec4& a, const Vec4& b) { return Vec4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
+inline Vec4 operator*(const Vec4& a, float s) { return Vec4(a.x * s, a.y * s, a.z * s, a.w * s); }
+
+inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 Cross(const Vec3& a, const Vec3& b)
+{
+	return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline float Length(const Vec3& a) { return std::sqrt(Dot(a, a)); }
+inline Vec3 Normalize(const Vec3& a) { return a * (1.0f / Length(a)); }
+inline Vec3 Min(const Vec3& a, const Vec3& b) { return Vec3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)); }
+inline Vec3 Max(const Vec3& a, const Vec3& b) { return Vec3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)); }
+inline Vec3 Lerp(const Vec3& a, const Vec3& b, float t) { return a + (b - a) * t; }
+inline float Saturate(float v) { return std::min(std::max(v, 0.0f), 1.0f); }
+
+struct Aabb
+{
+	Vec3	bmin, bmax;
+
+	Aabb() : bmin(FLT_MAX), bmax(-FLT_MAX) {}
+	Aabb(const Vec3& mn, const Vec3& mx) : bmin(mn), bmax(mx) {}
+
+	void Grow(const Vec3& p) { bmin = Min(bmin, p); bmax = Max(bmax, p); }
+	void Grow(const Aabb& b) { bmin = Min(bmin, b.bmin); bmax = Max(bmax, b.bmax); }
+	bool IsValid() const { return bmin.x <= bmax.x; }
+	Vec3 Center() const { return (bmin + bmax) * 0.5f; }
+	Vec3 Extent() const { return bmax - bmin; }
+	float SurfaceArea() const
+	{
+		if (!IsValid()) return 0.0f;
+		Vec3 e = Extent();
+		return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+};
+
+// half float conversion, matches HLSL f32tof16/f16tof32.
+inline float HalfToFloat(uint16_t h)
+{
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t expo = (h >> 10) & 0x1f;
+	uint32_t mant = h & 0x3ff;
+	uint32_t bits;
+	if (expo == 0)
+	{
+		if (mant == 0)
+		{
+			bits = sign;
+		}
+		else
+		{
+			// denormal.
+			expo = 127 - 15 + 1;
+			while (!(mant & 0x400))
+			{
+				mant <<= 1;
+				expo--;
+			}
+			mant &= 0x3ff;
+			bits = sign | (expo << 23) | (mant << 13);
+		}
+	}
+	else if (expo == 0x1f)
+	{
+		bits = sign | 0x7f800000 | (mant << 13);
+	}
+	else
+	{
+		bits = sign | ((expo + 127 - 15) << 23) | (mant << 13);
+	}
+	float ret;
+	memcpy(&ret, &bits, sizeof(ret));
+	return ret;
+}
+
+inline uint16_t FloatToHalf(float f)
+{
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t expo = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mant = bits & 0x7fffff;
+	if (((bits >> 23) & 0xff) == 0xff)
+	{
+		return (uint16_t)(sign | 0x7c00 | (mant ? 0x200 : 0));
+	}
+	if (expo >= 0x1f)
+	{
+		return (uint16_t)(sign | 0x7c00);
+	}
+	if (expo <= 0)
+	{
+		if (expo < -10)
+		{
+			return (uint16_t)sign;
+		}
+		mant |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - expo);
+		uint32_t half = mant >> shift;
+		uint32_t rem = mant & ((1u << shift) - 1);
+		uint32_t mid = 1u << (shift - 1);
+		if (rem > mid || (rem == mid && (half & 1)))
+		{
+			half++;
+		}
+		return (uint16_t)(sign | half);
+	}
+	uint32_t half = sign | ((uint32_t)expo << 10) | (mant >> 13);
+	uint32_t rem = mant & 0x1fff;
+	if (rem > 0x1000 || (rem == 0x1000 && (half & 1)))
+	{
+		half++;
+	}
+	return (uint16_t)half;
+}
+
+// row vector convention, same as DirectXMath (v' = v * M).
+inline Vec4 Transform(const Vec4& v, const DirectX::XMFLOAT4X4& m)
+{
+	Vec4 r;
+	r.x = v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0] + v.w * m.m[3][0];
+	r.y = v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1] + v.w * m.m[3][1];
+	r.z = v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2] + v.w * m.m[3][2];
+	r.w = v.x * m.m[0][3] + v.y * m.m[1][3] + v.z * m.m[2][3] + v.w * m.m[3][3];
+	return r;
+}
+inline Vec3 TransformPoint(const Vec3& p, const DirectX::XMFLOAT4X4& m)
+{
+	return Transform(Vec4(p, 1.0f), m).xyz();
+}
+inline Vec3 TransformVector(const Vec3& v, const DirectX::XMFLOAT4X4& m)
+{
+	return Transform(Vec4(v, 0.0f), m).xyz();
+}
+// bounds of the 8 transformed corners, same as SampleApplication::ComputeSceneAABB().
+inline Aabb TransformAabb(const Aabb& b, const DirectX::XMFLOAT4X4& m)
+{
+	Aabb ret;
+	for (int c = 0; c < 8; c++)
+	{
+		Vec3 p((c & 1) ? b.bmax.x : b.bmin.x, (c & 2) ? b.bmax.y : b.bmin.y, (c & 4) ? b.bmax.z : b.bmin.z);
+		ret.Grow(TransformPoint(p, m));
+	}
+	return ret;
+}
+
+inline DirectX::XMFLOAT4X4 MatrixIdentity()
+{
+	DirectX::XMFLOAT4X4 r;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			r.m[i][j] = (i == j) ? 1.0f : 0.0f;
+	return r;
+}
+
+inline DirectX::XMFLOAT4X4 MatrixMultiply(const DirectX::XMFLOAT4X4& a, const DirectX::XMFLOAT4X4& b)
+{
+	DirectX::XMFLOAT4X4 r;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+		}
+	}
+	return r;
+}
+
+DirectX::XMFLOAT4X4 MatrixInverse(const DirectX::XMFLOAT4X4& m);
+DirectX::XMFLOAT4X4 MatrixTranslation(float x, float y, float z);
+DirectX::XMFLOAT4X4 MatrixScaling(float x, float y, float z);
+DirectX::XMFLOAT4X4 MatrixRotationRollPitchYaw(float pitch, float yaw, float roll);
+DirectX::XMFLOAT4X4 MatrixRotationX(float angle);
+DirectX::XMFLOAT4X4 MatrixRotationY(float angle);
+DirectX::XMFLOAT4X4 MatrixRotationZ(float angle);
+DirectX::XMFLOAT4X4 MatrixLookAtRH(const Vec3& eye, const Vec3& focus, const Vec3& up);
+// same projection as sl12::MatrixPerspectiveInfiniteInverseFovRH (reversed z, infinite far).
+DirectX::XMFLOAT4X4 MatrixPerspectiveInfiniteInverseFovRH(float fovY, float aspect, float nearZ);
+
+//	EOF
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+
+// thread count used when 0 is requested.
+inline uint32_t GetDefaultThreadCount()
+{
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// run func(begin, end, chunkIndex) over [0, count) with up to chunkCount threads.
+// the calling thread runs chunk 0.
+template <typename Func>
+void ParallelChunks(size_t count, uint32_t chunkCount, Func&& func)
+{
+	if (chunkCount <= 1)
+	{
+		func((size_t)0, count, 0u);
+		return;
+	}
+	std::vector<std::thread> threads;
+	threads.reserve(chunkCount - 1);
+	size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+	for (uint32_t c = 1; c < chunkCount; c++)
+	{
+		size_t begin = std::min(count, c * chunkSize);
+		size_t end = std::min(count, begin + chunkSize);
+		threads.emplace_back(func, begin, end, c);
+	}
+	func((size_t)0, std::min(count, chunkSize), 0u);
+	for (auto&& t : threads)
+	{
+		t.join();
+	}
+}
+
+// number of chunks for count items, each chunk has at least minChunkSize items.
+inline uint32_t GetChunkCount(size_t count, uint32_t threadCount, size_t minChunkSize)
+{
+	size_t chunks = std::max<size_t>(count / std::max<size_t>(minChunkSize, 1), 1);
+	return (uint32_t)std::min<size_t>(chunks, std::max(threadCount, 1u));
+}
+
+//	EOF
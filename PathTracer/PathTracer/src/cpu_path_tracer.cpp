@@ -0,0 +1,526 @@
+#include "cpu_path_tracer.h"
+#include "path_tracer_permutation.h"
+#include "rmesh_lod.h"
+
+#include <atomic>
+#include <cstdio>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#ifndef USE_IN_CPP
+#	define USE_IN_CPP
+#endif
+#include "../shaders/cbuffer.hlsli"
+#include "../shaders/progressive.hlsli"
+
+
+namespace
+{
+	// same as pathtracer.lib.hlsl.
+	static const float kRayTMax = 10000.0f;
+
+	// kFlagBackFaceHit in payload.hlsli.
+	static const uint32_t kFlagBackFaceHit = 0x01 << 0;
+
+	inline Vec3 ToVec3(const DirectX::XMFLOAT3& v) { return Vec3(v.x, v.y, v.z); }
+
+	//----
+	// payload.hlsli
+	struct MaterialPayload
+	{
+		Vec3		emissive;
+		uint32_t	normalRoughnessMetallic[2];
+		uint32_t	baseColorUnorm;
+		float		hitT;
+	};
+
+	struct MaterialParam
+	{
+		Vec3		emissive;
+		Vec3		normal;
+		float		roughness;
+		float		metallic;
+		Vec4		baseColor;
+		float		hitT;
+		uint32_t	flag;
+	};
+
+	// float to uint conversion clamps on the gpu.
+	inline uint32_t ToUint(float v, float maxV)
+	{
+		return (uint32_t)std::min(std::max(v, 0.0f), maxV);
+	}
+
+	void EncodeMaterialPayload(const MaterialParam& param, MaterialPayload& payload)
+	{
+		payload.emissive = param.emissive;
+		payload.hitT = param.hitT;
+
+		uint32_t nx = ToUint(param.normal.x * 32767.0f + 32767.0f, 65535.0f);
+		uint32_t ny = ToUint(param.normal.y * 32767.0f + 32767.0f, 65535.0f);
+		uint32_t nz = ToUint(param.normal.z * 32767.0f + 32767.0f, 65535.0f);
+		uint32_t rough = ToUint(param.roughness * 255.0f, 255.0f);
+		uint32_t metal = ToUint(param.metallic * 255.0f, 255.0f);
+		payload.normalRoughnessMetallic[0] = (nx << 16) | (ny << 0);
+		payload.normalRoughnessMetallic[1] = (nz << 16) | (rough << 8) | (metal << 0);
+
+		uint32_t r = ToUint(param.baseColor.x * 255.0f, 255.0f);
+		uint32_t g = ToUint(param.baseColor.y * 255.0f, 255.0f);
+		uint32_t b = ToUint(param.baseColor.z * 255.0f, 255.0f);
+		uint32_t a = param.flag & 0xff;
+		payload.baseColorUnorm = (a << 24) | (b << 16) | (g << 8) | (r << 0);
+	}
+
+	void DecodeMaterialPayload(const MaterialPayload& payload, MaterialParam& param)
+	{
+		param.emissive = payload.emissive;
+		param.hitT = payload.hitT;
+
+		param.normal = Vec3(
+			(float)(payload.normalRoughnessMetallic[0] >> 16),
+			(float)(payload.normalRoughnessMetallic[0] & 0xffff),
+			(float)(payload.normalRoughnessMetallic[1] >> 16));
+		param.normal = (param.normal - Vec3(32767.0f)) * (1.0f / 32767.0f);
+
+		param.roughness = Saturate((float)((payload.normalRoughnessMetallic[1] >> 8) & 0xff) / 255.0f);
+		param.metallic = Saturate((float)(payload.normalRoughnessMetallic[1] & 0xff) / 255.0f);
+
+		param.baseColor = Vec4(
+			(float)((payload.baseColorUnorm >> 0) & 0xff) / 255.0f,
+			(float)((payload.baseColorUnorm >> 8) & 0xff) / 255.0f,
+			(float)((payload.baseColorUnorm >> 16) & 0xff) / 255.0f,
+			1.0f);
+		param.flag = (payload.baseColorUnorm >> 24) & 0xff;
+	}
+
+	//----
+	// pathtracer.lib.hlsl
+	inline Vec2 Noise(uint32_t px, uint32_t py, uint32_t sequenceIndex)
+	{
+		uint32_t hash = NoiseHash(px, py, sequenceIndex);
+		return Vec2(Hash32ToFloat(hash), Hash32ToFloat(Hash32(hash)));
+	}
+
+	inline Vec3 HemisphereSampleUniform(float u, float v)
+	{
+		float phi = v * 2.0f * kCpuPI;
+		float cosTheta = 1.0f - u;
+		float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+		return Vec3(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+	}
+
+	inline Vec4 QuatMul(const Vec4& q1, const Vec4& q2)
+	{
+		Vec3 v1 = q1.xyz(), v2 = q2.xyz();
+		return Vec4(v2 * q1.w + v1 * q2.w + Cross(v1, v2), q1.w * q2.w - Dot(v1, v2));
+	}
+
+	inline Vec4 QuatFromAngleAxis(float angle, const Vec3& axis)
+	{
+		float sn = std::sin(angle * 0.5f);
+		float cs = std::cos(angle * 0.5f);
+		return Vec4(axis * sn, cs);
+	}
+
+	Vec4 QuatFromTwoVector(const Vec3& v1, const Vec3& v2)
+	{
+		float d = Dot(v1, v2);
+		if (d < -0.999999f)
+		{
+			Vec3 tmp = Cross(Vec3(1, 0, 0), v1);
+			if (Length(tmp) < 0.000001f)
+			{
+				tmp = Cross(Vec3(0, 1, 0), v1);
+			}
+			return QuatFromAngleAxis(kCpuPI, Normalize(tmp));
+		}
+		else if (d > 0.999999f)
+		{
+			return Vec4(0, 0, 0, 1);
+		}
+		Vec4 q(Cross(v1, v2), 1.0f + d);
+		float len = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+		return q * (1.0f / len);
+	}
+
+	inline Vec3 QuatRotVector(const Vec3& v, const Vec4& r)
+	{
+		Vec4 r_c(-r.x, -r.y, -r.z, r.w);
+		return QuatMul(r, QuatMul(Vec4(v, 0.0f), r_c)).xyz();
+	}
+
+	//----
+	// standard ggx specular + lambert diffuse, same terms as BrdfGGX in pbr.hlsli.
+	Vec3 BrdfGGX(const Vec3& diffuseColor, const Vec3& specularColor, float roughness, const Vec3& N, const Vec3& L, const Vec3& V)
+	{
+		float NoL = Saturate(Dot(N, L));
+		if (NoL <= 0.0f)
+		{
+			return Vec3(0.0f);
+		}
+		Vec3 H = Normalize(L + V);
+		float NoV = std::max(Saturate(Dot(N, V)), 1e-5f);
+		float NoH = Saturate(Dot(N, H));
+		float VoH = Saturate(Dot(V, H));
+
+		float a = roughness * roughness;
+		float a2 = a * a;
+		float d = (NoH * a2 - NoH) * NoH + 1.0f;
+		float D = a2 / (kCpuPI * d * d);
+
+		float visV = NoL * std::sqrt(NoV * (NoV - NoV * a2) + a2);
+		float visL = NoV * std::sqrt(NoL * (NoL - NoL * a2) + a2);
+		float Vis = 0.5f / (visV + visL);
+
+		float fc = std::pow(1.0f - VoH, 5.0f);
+		Vec3 F = specularColor * (1.0f - fc) + Vec3(fc);
+
+		return (diffuseColor * (1.0f / kCpuPI) + F * (D * Vis)) * NoL;
+	}
+
+	//----
+	// MaterialCHS
+	void MaterialCHS(const CpuScene& scene, const CpuRay& ray, const CpuHit& hit, MaterialPayload& payload)
+	{
+		auto&& inst = scene.GetInstances()[hit.instanceIndex];
+		auto&& mesh = *scene.GetMeshes()[inst.meshIndex];
+		auto&& submesh = mesh.GetResource().submeshes[hit.submeshIndex];
+		auto&& material = mesh.GetMaterials()[submesh.materialIndex];
+
+		MaterialParam param;
+		param.hitT = hit.t;
+
+		// MaterialConstantCHS skips the uv decode and the fetches of constant materials.
+		auto&& fold = material.fold;
+		Vec4 orm = fold.orm;
+		param.baseColor = fold.baseColor;
+		if (fold.type != MaterialFoldType::Constant)
+		{
+			Vec2 uv = mesh.GetTexcoord(hit.submeshIndex, hit.triIndex, hit.barycentrics);
+			param.baseColor = fold.bConstBaseColor ? fold.baseColor : material.pBaseColor->SampleLevel(uv, 0);
+			orm = fold.bConstORM ? fold.orm : material.pORM->SampleLevel(uv, 0);
+		}
+		param.roughness = std::max(0.01f, orm.y);
+		param.metallic = orm.z;
+
+		param.emissive = Vec3(0.0f);
+
+		// object space normal, not transformed or normalized in the shader.
+		param.normal = mesh.GetNormal(hit.submeshIndex, hit.triIndex, hit.barycentrics);
+
+		// HIT_KIND_TRIANGLE_BACK_FACE, clockwise front face in object space.
+		param.flag = 0;
+		{
+			uint32_t idx[3];
+			mesh.GetResource().GetTriangle(submesh, hit.triIndex, idx);
+			Vec3 p0 = mesh.GetResource().GetPosition(submesh, idx[0]);
+			Vec3 p1 = mesh.GetResource().GetPosition(submesh, idx[1]);
+			Vec3 p2 = mesh.GetResource().GetPosition(submesh, idx[2]);
+			Vec3 localDir = TransformVector(ray.direction, inst.mtxWorldToLocal);
+			if (Dot(Cross(p1 - p0, p2 - p0), localDir) < 0.0f)
+			{
+				param.flag |= kFlagBackFaceHit;
+			}
+		}
+
+		EncodeMaterialPayload(param, payload);
+	}
+
+	//----
+	// PathTracerRGS for a single pixel.
+	// like PT_SAMPLE_COUNT/PT_DEPTH_MAX of the shader, a count above 0 is fixed at compile time, 0 reads it from cbPathTrace.
+	template <int kFixedSampleCount, int kFixedDepth>
+	uint64_t PathTracerRGS(
+		const CpuScene& scene,
+		const SceneCB& cbScene,
+		const LightCB& cbLight,
+		const PathTraceCB& cbPathTrace,
+		const CpuLodParams& lod,
+		uint32_t px, uint32_t py,
+		uint32_t width, uint32_t height,
+		Vec3* pColor, Vec3* pAlbedo, Vec3* pNormal)
+	{
+		uint64_t rayCount = 0;
+
+		float clipX = ((float)px + 0.5f) / (float)width * 2.0f - 1.0f;
+		float clipY = ((float)py + 0.5f) / (float)height * -2.0f + 1.0f;
+		Vec4 worldPos = Transform(Vec4(clipX, clipY, 1.0f, 1.0f), cbScene.mtxProjToWorld);
+		Vec3 wp = worldPos.xyz() * (1.0f / worldPos.w);
+
+		Vec3 origin(cbScene.eyePosition.x, cbScene.eyePosition.y, cbScene.eyePosition.z);
+		Vec3 direction = Normalize(wp - origin);
+
+		Vec3 lightDir = ToVec3(cbLight.directionalVec);
+		Vec3 lightColor = ToVec3(cbLight.directionalColor);
+		Vec3 ambientSky = ToVec3(cbLight.ambientSky);
+		Vec3 ambientGround = ToVec3(cbLight.ambientGround);
+
+		const int kSampleCount = (kFixedSampleCount > 0) ? kFixedSampleCount : cbPathTrace.sampleCount;
+		const int kDepth = (kFixedDepth > 0) ? kFixedDepth : cbPathTrace.depthMax;
+
+		Vec3 color(0.0f);
+		Vec3 albedo(0.0f);
+		Vec3 normal(0.0f, 0.0f, 1.0f);
+		for (int sample = 0; sample < kSampleCount; sample++)
+		{
+			// primary ray.
+			CpuRay ray;
+			ray.origin = origin;
+			ray.tmin = 0.0f;
+			ray.direction = direction;
+			ray.tmax = kRayTMax;
+
+			Vec3 reflectivity(1.0f);
+			for (int depth = 0; depth < kDepth; depth++)
+			{
+				// secondary bounces trace the coarse lod instances.
+				uint32_t rayMask = GetLodRayMask((uint32_t)depth, lod.depth);
+				ray.tmin = GetLodRayTMin((uint32_t)depth, lod.depth, lod.rayTMin);
+				CpuHit hit;
+				rayCount++;
+				if (scene.TraceClosest(ray, &hit, rayMask))
+				{
+					MaterialPayload payload;
+					MaterialCHS(scene, ray, hit, payload);
+
+					MaterialParam matParam;
+					DecodeMaterialPayload(payload, matParam);
+
+					// shadow ray.
+					Vec3 hitP = ray.origin + ray.direction * payload.hitT + matParam.normal * 1e-3f;
+					CpuRay sray;
+					sray.origin = hitP;
+					sray.tmin = 0.0f;
+					sray.direction = lightDir;
+					sray.tmax = kRayTMax;
+					rayCount++;
+					float shadowMask = scene.TraceAny(sray, rayMask) ? 0.0f : 1.0f;
+
+					Vec3 baseColor = matParam.baseColor.xyz();
+					Vec3 diffuse = Lerp(baseColor, Vec3(0.0f), matParam.metallic);
+					Vec3 specular = Lerp(Vec3(0.04f), baseColor, matParam.metallic);
+					Vec3 directLight = BrdfGGX(diffuse, specular, matParam.roughness, matParam.normal, lightDir, -ray.direction);
+					color += reflectivity * (matParam.emissive + directLight * lightColor * shadowMask);
+					reflectivity *= diffuse;
+
+					// the last bounce needs no next direction.
+					if (depth + 1 < kDepth)
+					{
+						ray.origin = hitP;
+						Vec2 uv = Noise(px, py, GetSampleSequenceIndex(cbPathTrace.accumFrameIndex, sample, depth, kSampleCount, kDepth));
+						Vec3 localDir = HemisphereSampleUniform(uv.x, uv.y);
+						Vec4 qRot = QuatFromTwoVector(Vec3(0, 0, 1), matParam.normal);
+						ray.direction = QuatRotVector(localDir, qRot);
+						ray.tmax = kRayTMax;
+					}
+
+					if (depth == 0)
+					{
+						albedo = baseColor;
+						normal = matParam.normal;
+					}
+				}
+				else
+				{
+					// PathTracerMS, then SkyLight.
+					float t = ray.direction.y * 0.5f + 0.5f;
+					color += reflectivity * Lerp(ambientGround, ambientSky, t) * cbLight.ambientIntensity;
+					break;
+				}
+			}
+		}
+		color *= (1.0f / (float)kSampleCount);
+
+		*pColor = color;
+		*pAlbedo = albedo;
+		*pNormal = normal;
+		return rayCount;
+	}
+
+	typedef uint64_t (*PathTracerRGSFunc)(
+		const CpuScene&, const SceneCB&, const LightCB&, const PathTraceCB&, const CpuLodParams&,
+		uint32_t, uint32_t, uint32_t, uint32_t, Vec3*, Vec3*, Vec3*);
+
+	// same order as kPathTracerPermutations.
+	static const PathTracerRGSFunc kPermutationRGS[] = {
+		PathTracerRGS<kPathTracerPermutations[0].sampleCount, kPathTracerPermutations[0].depthMax>,
+		PathTracerRGS<kPathTracerPermutations[1].sampleCount, kPathTracerPermutations[1].depthMax>,
+		PathTracerRGS<kPathTracerPermutations[2].sampleCount, kPathTracerPermutations[2].depthMax>,
+		PathTracerRGS<kPathTracerPermutations[3].sampleCount, kPathTracerPermutations[3].depthMax>,
+		PathTracerRGS<kPathTracerPermutations[4].sampleCount, kPathTracerPermutations[4].depthMax>,
+		PathTracerRGS<kPathTracerPermutations[5].sampleCount, kPathTracerPermutations[5].depthMax>,
+	};
+	static_assert(sizeof(kPermutationRGS) / sizeof(kPermutationRGS[0]) == kPathTracerPermutationCount, "kPermutationRGS does not match kPathTracerPermutations.");
+
+	struct Tile
+	{
+		uint32_t	x, y;
+	};
+
+	// per worker tile queue. the owner pops from the front, thieves from the back.
+	struct TileQueue
+	{
+		std::mutex			mutex;
+		std::deque<Tile>	tiles;
+
+		bool Pop(Tile* pTile)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (tiles.empty())
+			{
+				return false;
+			}
+			*pTile = tiles.front();
+			tiles.pop_front();
+			return true;
+		}
+
+		bool Steal(Tile* pTile)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (tiles.empty())
+			{
+				return false;
+			}
+			*pTile = tiles.back();
+			tiles.pop_back();
+			return true;
+		}
+	};
+}
+
+bool CpuPathTracer::Render(
+	const CpuScene& scene,
+	const SceneCB& cbScene,
+	const LightCB& cbLight,
+	const PathTraceCB& cbPathTrace,
+	uint32_t width, uint32_t height,
+	float* rtResult, float* rtAlbedo, float* rtNormal,
+	uint32_t threadCount,
+	CpuRenderStats* pStats,
+	float* rtAccum)
+{
+	if (!rtResult || !rtAlbedo || !rtNormal || width == 0 || height == 0)
+	{
+		printf("Error: invalid render target.\n");
+		return false;
+	}
+	if (cbPathTrace.accumEnable && !rtAccum)
+	{
+		printf("Error: progressive mode without an accumulation buffer.\n");
+		return false;
+	}
+	if (cbPathTrace.sampleCount <= 0 || cbPathTrace.depthMax <= 0)
+	{
+		printf("Error: invalid path trace parameters. (spp: %d, depth: %d)\n", cbPathTrace.sampleCount, cbPathTrace.depthMax);
+		return false;
+	}
+
+	if (threadCount == 0)
+	{
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	// distribute tiles round robin, so every queue covers the whole screen.
+	uint32_t tilesX = (width + kTileSize - 1) / kTileSize;
+	uint32_t tilesY = (height + kTileSize - 1) / kTileSize;
+	std::vector<TileQueue> queues(threadCount);
+	uint32_t tileIndex = 0;
+	for (uint32_t ty = 0; ty < tilesY; ty++)
+	{
+		for (uint32_t tx = 0; tx < tilesX; tx++, tileIndex++)
+		{
+			queues[tileIndex % threadCount].tiles.push_back({ tx * kTileSize, ty * kTileSize });
+		}
+	}
+
+	int permutation = bUsePermutations_ ? FindPathTracerPermutation(cbPathTrace.sampleCount, cbPathTrace.depthMax) : -1;
+	PathTracerRGSFunc rgs = (permutation >= 0) ? kPermutationRGS[permutation] : PathTracerRGS<0, 0>;
+
+	std::atomic<uint64_t> totalRays(0);
+	std::atomic<uint32_t> stolenTiles(0);
+	auto RenderTile = [&](const Tile& tile)
+	{
+		uint64_t rays = 0;
+		uint32_t xEnd = std::min(tile.x + kTileSize, width);
+		uint32_t yEnd = std::min(tile.y + kTileSize, height);
+		for (uint32_t y = tile.y; y < yEnd; y++)
+		{
+			for (uint32_t x = tile.x; x < xEnd; x++)
+			{
+				Vec3 color, albedo, normal;
+				rays += rgs(scene, cbScene, cbLight, cbPathTrace, lod_, x, y, width, height, &color, &albedo, &normal);
+
+				// same layout as Store3 in PathTracerRGS.
+				size_t index = ((size_t)y * width + x) * 3;
+				if (cbPathTrace.accumEnable)
+				{
+					uint32_t frameCount = cbPathTrace.accumFrameIndex + 1;
+					color = Vec3(AccumulateMean(rtAccum[index + 0], color.x, frameCount),
+						AccumulateMean(rtAccum[index + 1], color.y, frameCount),
+						AccumulateMean(rtAccum[index + 2], color.z, frameCount));
+					memcpy(rtAccum + index, &color, sizeof(float) * 3);
+				}
+				memcpy(rtResult + index, &color, sizeof(float) * 3);
+				memcpy(rtAlbedo + index, &albedo, sizeof(float) * 3);
+				memcpy(rtNormal + index, &normal, sizeof(float) * 3);
+			}
+		}
+		totalRays += rays;
+	};
+	auto Worker = [&](uint32_t workerIndex)
+	{
+		Tile tile;
+		while (true)
+		{
+			if (queues[workerIndex].Pop(&tile))
+			{
+				RenderTile(tile);
+				continue;
+			}
+
+			bool bStolen = false;
+			for (uint32_t i = 1; i < threadCount && !bStolen; i++)
+			{
+				bStolen = queues[(workerIndex + i) % threadCount].Steal(&tile);
+			}
+			if (!bStolen)
+			{
+				// tiles are never added after start, so every queue is empty.
+				break;
+			}
+			stolenTiles++;
+			RenderTile(tile);
+		}
+	};
+
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount - 1);
+		for (uint32_t i = 1; i < threadCount; i++)
+		{
+			threads.emplace_back(Worker, i);
+		}
+		Worker(0);
+		for (auto&& t : threads)
+		{
+			t.join();
+		}
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	if (pStats)
+	{
+		pStats->rayCount = totalRays;
+		pStats->tileCount = tileIndex;
+		pStats->stolenTileCount = stolenTiles;
+		pStats->elapsedMs = std::chrono::duration<double, std::milli>(end - start).count();
+		pStats->permutationIndex = permutation;
+	}
+	return true;
+}
+
+//	EOF
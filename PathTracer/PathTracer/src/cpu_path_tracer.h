@@ -0,0 +1,59 @@
+#pragma once
+
+#include "cpu_scene.h"
+
+
+struct SceneCB;
+struct LightCB;
+struct PathTraceCB;
+
+struct CpuRenderStats
+{
+	uint64_t	rayCount = 0;
+	uint32_t	tileCount = 0;
+	uint32_t	stolenTileCount = 0;
+	double		elapsedMs = 0.0;
+	int			permutationIndex = -1;		// index into kPathTracerPermutations, -1 for the generic loops.
+
+	double GetRaysPerSecond() const { return (elapsedMs > 0.0) ? (double)rayCount * 1000.0 / elapsedMs : 0.0; }
+};
+
+// rays from depth on trace one lod coarser per bounce, see GetLodRayMask().
+struct CpuLodParams
+{
+	uint32_t	depth = 0;			// 0 keeps full detail.
+	float		rayTMin = 0.0f;		// distance between the surfaces of neighbouring lods, CpuScene::GetLodRayTMin().
+};
+
+// cpu implementation of PathTracerRGS/PathTracerMS and MaterialCHS/MaterialAHS.
+class CpuPathTracer
+{
+public:
+	static const uint32_t kTileSize = 16;
+
+public:
+	// renders the whole screen into float3 buffers laid out like rtResult/rtAlbedo/rtNormal.
+	// threadCount 0 uses all hardware threads.
+	// with cbPathTrace.accumEnable rtAccum keeps the running mean like rtAccum of the shader, rtResult gets a copy.
+	bool Render(
+		const CpuScene& scene,
+		const SceneCB& cbScene,
+		const LightCB& cbLight,
+		const PathTraceCB& cbPathTrace,
+		uint32_t width, uint32_t height,
+		float* rtResult, float* rtAlbedo, float* rtNormal,
+		uint32_t threadCount,
+		CpuRenderStats* pStats = nullptr,
+		float* rtAccum = nullptr);
+
+	// settings listed in kPathTracerPermutations run loops with fixed counts, the same pixels as the generic ones.
+	void SetUsePermutations(bool bUse) { bUsePermutations_ = bUse; }
+	// lod chains of the scene, the gpu path tracer has no counterpart.
+	void SetLod(const CpuLodParams& lod) { lod_ = lod; }
+
+private:
+	bool			bUsePermutations_ = true;
+	CpuLodParams	lod_;
+};	// class CpuPathTracer
+
+//	EOF
@@ -0,0 +1,501 @@
+#include "cpu_scene.h"
+#include "cpu_parallel.h"
+#include "cpu_task.h"
+#include "rmesh_lod.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+
+namespace
+{
+	// source triangles sampled for the lod distance.
+	static const size_t kLodDistanceSamples = 1 << 16;
+	static const float kLodDistancePercentile = 0.99f;
+
+	std::string GetDirectory(const std::string& filePath)
+	{
+		auto pos = filePath.find_last_of("/\\");
+		return (pos == std::string::npos) ? std::string() : filePath.substr(0, pos + 1);
+	}
+
+	std::string GetFileName(const std::string& filePath)
+	{
+		auto pos = filePath.find_last_of("/\\");
+		return (pos == std::string::npos) ? filePath : filePath.substr(pos + 1);
+	}
+
+	// distance from the centers of the finer triangles along both sides of their normal to the coarser surface.
+	// the percentile drops the parts the lod removed.
+	float MeasureLodDistance(const CpuMesh& finer, const CpuMesh& coarser, uint32_t threadCount)
+	{
+		auto&& sources = finer.GetTriangles();
+		auto&& targets = coarser.GetTriangles();
+		size_t step = std::max<size_t>(sources.size() / kLodDistanceSamples, 1);
+		size_t sampleCount = sources.size() / step;
+		std::vector<float> distances(sampleCount, FLT_MAX);
+		ParallelChunks(sampleCount, GetChunkCount(sampleCount, threadCount, 1024), [&](size_t begin, size_t end, uint32_t)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				auto&& tri = sources[i * step];
+				Vec3 n = Cross(tri.e1, tri.e2);
+				float len = Length(n);
+				if (len <= 0.0f)
+				{
+					continue;
+				}
+				for (int side = 0; side < 2; side++)
+				{
+					CpuRay ray;
+					ray.origin = tri.v0 + (tri.e1 + tri.e2) * (1.0f / 3.0f);
+					ray.direction = n * ((side == 0 ? 1.0f : -1.0f) / len);
+					ray.tmin = 0.0f;
+					ray.tmax = distances[i];
+					coarser.GetBvh().Traverse(ray, [&](uint32_t primIndex, CpuRay& r)
+					{
+						float t, u, v;
+						if (IntersectTriangle(r, targets[primIndex], &t, &u, &v))
+						{
+							r.tmax = t;
+						}
+						return true;
+					});
+					distances[i] = ray.tmax;
+				}
+			}
+		});
+		distances.erase(std::remove(distances.begin(), distances.end(), FLT_MAX), distances.end());
+		if (distances.empty())
+		{
+			return 0.0f;
+		}
+		auto nth = distances.begin() + (size_t)((float)(distances.size() - 1) * kLodDistancePercentile);
+		std::nth_element(distances.begin(), nth, distances.end());
+		return *nth;
+	}
+}
+
+
+bool CpuMesh::Initialize(const std::string& filePath)
+{
+	RMeshAccel accel;
+	if (!LoadRMeshAny(filePath, &resource_, &accel))
+	{
+		return false;
+	}
+
+	triangles_.clear();
+	triangles_.reserve(resource_.GetTotalTriangleCount());
+	bounds_ = Aabb();
+	for (uint32_t s = 0; s < (uint32_t)resource_.submeshes.size(); s++)
+	{
+		auto&& submesh = resource_.submeshes[s];
+		uint32_t triCount = submesh.indexCount / 3;
+		for (uint32_t t = 0; t < triCount; t++)
+		{
+			uint32_t idx[3];
+			resource_.GetTriangle(submesh, t, idx);
+			Vec3 p0 = resource_.GetPosition(submesh, idx[0]);
+			Vec3 p1 = resource_.GetPosition(submesh, idx[1]);
+			Vec3 p2 = resource_.GetPosition(submesh, idx[2]);
+
+			Triangle tri;
+			tri.v0 = p0;
+			tri.e1 = p1 - p0;
+			tri.e2 = p2 - p0;
+			tri.submeshIndex = s;
+			tri.triIndex = t;
+			triangles_.push_back(tri);
+
+			bounds_.Grow(p0);
+			bounds_.Grow(p1);
+			bounds_.Grow(p2);
+		}
+	}
+
+	// cooked files carry the bvh over every submesh, the build is skipped.
+	bvh_ = Bvh();
+	auto pPrebuilt = accel.FindBvh(kRMeshV2WholeMesh);
+	if (pPrebuilt && pPrebuilt->header.triangleCount == (uint32_t)triangles_.size())
+	{
+		bvh_.GetNodes() = pPrebuilt->nodes;
+		bvh_.GetPrimIndices() = pPrebuilt->primIndices;
+		SortTriangles();
+	}
+	return true;
+}
+
+void CpuMesh::BuildBvh(const BvhBuildSettings& settings)
+{
+	std::vector<Aabb> primBounds(triangles_.size());
+	std::vector<Vec3> triVertices;
+	if (settings.bSpatialSplits)
+	{
+		triVertices.resize(triangles_.size() * 3);
+	}
+	for (size_t i = 0; i < triangles_.size(); i++)
+	{
+		auto&& tri = triangles_[i];
+		Vec3 v[3] = { tri.v0, tri.v0 + tri.e1, tri.v0 + tri.e2 };
+		primBounds[i].Grow(v[0]);
+		primBounds[i].Grow(v[1]);
+		primBounds[i].Grow(v[2]);
+		if (!triVertices.empty())
+		{
+			std::copy(v, v + 3, triVertices.begin() + i * 3);
+		}
+	}
+	bvh_.BuildSAH(primBounds, settings, triVertices.empty() ? nullptr : &triVertices);
+	SortTriangles();
+}
+
+void CpuMesh::SortTriangles()
+{
+	// reorder triangles to the leaf order, spatial splits may duplicate triangles.
+	std::vector<Triangle> sorted(bvh_.GetPrimIndices().size());
+	auto&& primIndices = bvh_.GetPrimIndices();
+	for (size_t i = 0; i < primIndices.size(); i++)
+	{
+		sorted[i] = triangles_[primIndices[i]];
+		primIndices[i] = (uint32_t)i;
+	}
+	triangles_.swap(sorted);
+}
+
+Vec2 CpuMesh::GetTexcoord(uint32_t submeshIndex, uint32_t triIndex, const float barycentrics[2]) const
+{
+	auto&& submesh = resource_.submeshes[submeshIndex];
+	uint32_t idx[3];
+	resource_.GetTriangle(submesh, triIndex, idx);
+
+	const uint8_t* pVertices = resource_.texcoord.data();
+	Vec2 uv0 = GetVertexTexcoord(pVertices, submesh.texcoordOffsetBytes, idx[0]);
+	Vec2 uv1 = GetVertexTexcoord(pVertices, submesh.texcoordOffsetBytes, idx[1]);
+	Vec2 uv2 = GetVertexTexcoord(pVertices, submesh.texcoordOffsetBytes, idx[2]);
+	return uv0 + (uv1 - uv0) * barycentrics[0] + (uv2 - uv0) * barycentrics[1];
+}
+
+Vec3 CpuMesh::GetNormal(uint32_t submeshIndex, uint32_t triIndex, const float barycentrics[2]) const
+{
+	auto&& submesh = resource_.submeshes[submeshIndex];
+	uint32_t idx[3];
+	resource_.GetTriangle(submesh, triIndex, idx);
+
+	const uint8_t* pVertices = resource_.normal.data();
+	Vec3 n0 = GetVertexNormal(pVertices, submesh.normalOffsetBytes, idx[0]);
+	Vec3 n1 = GetVertexNormal(pVertices, submesh.normalOffsetBytes, idx[1]);
+	Vec3 n2 = GetVertexNormal(pVertices, submesh.normalOffsetBytes, idx[2]);
+	return n0 + (n1 - n0) * barycentrics[0] + (n2 - n0) * barycentrics[1];
+}
+
+CpuScene::CpuScene()
+{
+	dummyWhite_.InitializeConstant(255, 255, 255, 255);
+}
+
+const CpuTexture* CpuScene::LoadTexture(const std::string& filePath)
+{
+	auto it = textures_.find(filePath);
+	if (it != textures_.end())
+	{
+		return it->second.get();
+	}
+
+	std::unique_ptr<CpuTexture> tex(new CpuTexture());
+	if (!tex->LoadDDS(filePath))
+	{
+		// missing textures fall back to the dummy, same as the shader table.
+		tex.reset();
+	}
+	const CpuTexture* ret = tex ? tex.get() : &dummyWhite_;
+	textures_[filePath] = std::move(tex);
+	return ret;
+}
+
+int CpuScene::AddMesh(const std::string& filePath)
+{
+	std::unique_ptr<CpuMesh> mesh(new CpuMesh());
+	if (!mesh->Initialize(filePath))
+	{
+		return -1;
+	}
+
+	std::string dir = GetDirectory(filePath);
+	auto&& resource = mesh->GetResource();
+	auto&& materials = mesh->GetMaterials();
+	materials.resize(resource.materials.size());
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		auto&& src = resource.materials[i];
+		auto&& dst = materials[i];
+		dst.pBaseColor = &dummyWhite_;
+		dst.pORM = &dummyWhite_;
+		dst.isOpaque = src.isOpaque;
+		dst.fold = ClassifyMaterial(src);
+		if (src.textureNames.size() > kRMeshTexBaseColor && !src.textureNames[kRMeshTexBaseColor].empty())
+		{
+			dst.pBaseColor = LoadTexture(dir + src.textureNames[kRMeshTexBaseColor]);
+		}
+		if (src.textureNames.size() > kRMeshTexORM && !src.textureNames[kRMeshTexORM].empty())
+		{
+			dst.pORM = LoadTexture(dir + src.textureNames[kRMeshTexORM]);
+		}
+	}
+
+	meshes_.push_back(std::move(mesh));
+	return (int)meshes_.size() - 1;
+}
+
+std::vector<int> CpuScene::AddMeshLods(const std::string& filePath, uint32_t levelCount)
+{
+	std::vector<int> ret;
+	int meshIndex = AddMesh(filePath);
+	if (meshIndex < 0)
+	{
+		return ret;
+	}
+	ret.push_back(meshIndex);
+	std::error_code ec;
+	for (uint32_t level = 1; level < std::min<uint32_t>(levelCount, kLodLevelMax); level++)
+	{
+		std::string lodPath = GetRMeshLodPath(filePath, level);
+		if (!std::filesystem::exists(lodPath, ec) || (meshIndex = AddMesh(lodPath)) < 0)
+		{
+			break;
+		}
+		ret.push_back(meshIndex);
+	}
+	lodChains_.push_back(ret);
+	return ret;
+}
+
+void CpuScene::AddInstance(int meshIndex, const DirectX::XMFLOAT4X4& mtxLocalToWorld, uint32_t instanceMask)
+{
+	CpuInstance inst;
+	inst.meshIndex = (uint32_t)meshIndex;
+	inst.instanceMask = instanceMask;
+	inst.mtxLocalToWorld = mtxLocalToWorld;
+	inst.mtxWorldToLocal = MatrixInverse(mtxLocalToWorld);
+	instances_.push_back(inst);
+}
+
+void CpuScene::AddLodInstances(const std::vector<int>& lodMeshes, const DirectX::XMFLOAT4X4& mtxLocalToWorld)
+{
+	for (uint32_t level = 0; level < (uint32_t)lodMeshes.size(); level++)
+	{
+		AddInstance(lodMeshes[level], mtxLocalToWorld, GetLodInstanceMask(level, (uint32_t)lodMeshes.size()));
+	}
+}
+
+void CpuScene::Build(const BvhBuildSettings& settings, TaskScheduler* pScheduler)
+{
+	if (!pScheduler)
+	{
+		TaskScheduler scheduler;
+		scheduler.Initialize(1);
+		Build(settings, &scheduler);
+		return;
+	}
+
+	// bottom level bvh of each mesh are independent tasks.
+	std::vector<TaskId> blasTasks(meshes_.size());
+	for (size_t i = 0; i < meshes_.size(); i++)
+	{
+		CpuMesh* pMesh = meshes_[i].get();
+		blasTasks[i] = pScheduler->AddTask("blas " + GetFileName(pMesh->GetResource().filePath), [pMesh, settings]()
+		{
+			if (pMesh->GetBvh().IsEmpty())
+			{
+				pMesh->BuildBvh(settings);
+			}
+			return true;
+		});
+	}
+
+	// each lod against the next finer one, rays leaving that surface skip the gap.
+	uint32_t threadCount = (settings.threadCount == 0) ? GetDefaultThreadCount() : settings.threadCount;
+	lodDistances_.resize(meshes_.size(), -1.0f);
+	for (auto&& chain : lodChains_)
+	{
+		for (size_t level = 1; level < chain.size(); level++)
+		{
+			int finer = chain[level - 1];
+			int coarser = chain[level];
+			if (lodDistances_[coarser] >= 0.0f)
+			{
+				continue;
+			}
+			pScheduler->AddTask("lod distance " + GetFileName(meshes_[coarser]->GetResource().filePath), [this, finer, coarser, threadCount]()
+			{
+				lodDistances_[coarser] = MeasureLodDistance(*meshes_[finer], *meshes_[coarser], threadCount);
+				return true;
+			}, { blasTasks[finer], blasTasks[coarser] });
+		}
+	}
+
+	// the top level only needs the bounds of the meshes.
+	pScheduler->AddTask("tlas", [this, settings]()
+	{
+		// instances added since the last build change the topology of the top level bvh.
+		for (size_t i = trackedInstanceCount_; i < instances_.size(); i++)
+		{
+			auto&& inst = instances_[i];
+			sceneUpdate_.AddInstance(meshes_[inst.meshIndex]->GetBounds(), inst.mtxLocalToWorld);
+		}
+		trackedInstanceCount_ = instances_.size();
+
+		SceneUpdateSettings updateSettings;
+		updateSettings.bvh = settings;
+		UpdateScene(updateSettings);
+		return true;
+	}, blasTasks);
+
+	pScheduler->Run();
+}
+
+void CpuScene::SetInstanceTransform(uint32_t instanceIndex, const DirectX::XMFLOAT4X4& mtxLocalToWorld)
+{
+	auto&& inst = instances_[instanceIndex];
+	inst.mtxLocalToWorld = mtxLocalToWorld;
+	inst.mtxWorldToLocal = MatrixInverse(mtxLocalToWorld);
+	if (instanceIndex < trackedInstanceCount_)
+	{
+		sceneUpdate_.SetMtxLocalToWorld(instanceIndex, mtxLocalToWorld);
+	}
+}
+
+SceneUpdateType CpuScene::UpdateScene(const SceneUpdateSettings& settings)
+{
+	SceneUpdateType type = sceneUpdate_.Update(settings);
+	if (type != SceneUpdateType::None)
+	{
+		for (size_t i = 0; i < instances_.size(); i++)
+		{
+			instances_[i].worldBounds = sceneUpdate_.GetWorldBounds((uint32_t)i);
+		}
+	}
+	return type;
+}
+
+template <bool kAnyHit>
+bool CpuScene::TraceInternal(CpuRay& ray, CpuHit* pHit, uint32_t rayMask, BvhTraversalStats* pStats) const
+{
+	bool bHit = false;
+	sceneUpdate_.GetTlas().Traverse(ray, [&](uint32_t instanceIndex, CpuRay& worldRay)
+	{
+		auto&& inst = instances_[instanceIndex];
+		if ((inst.instanceMask & rayMask) == 0)
+		{
+			return true;
+		}
+		auto&& mesh = *meshes_[inst.meshIndex];
+		auto&& triangles = mesh.GetTriangles();
+		auto&& materials = mesh.GetMaterials();
+		auto&& resource = mesh.GetResource();
+
+		CpuRay localRay;
+		localRay.origin = TransformPoint(worldRay.origin, inst.mtxWorldToLocal);
+		localRay.direction = TransformVector(worldRay.direction, inst.mtxWorldToLocal);
+		localRay.tmin = worldRay.tmin;
+		localRay.tmax = worldRay.tmax;
+
+		bool bContinue = true;
+		mesh.GetBvh().Traverse(localRay, [&](uint32_t primIndex, CpuRay& r)
+		{
+			auto&& tri = triangles[primIndex];
+			float t, u, v;
+			if (!IntersectTriangle(r, tri, &t, &u, &v))
+			{
+				return true;
+			}
+
+			// any hit shader for masked materials.
+			auto&& mat = materials[resource.submeshes[tri.submeshIndex].materialIndex];
+			if (!mat.isOpaque && !mat.fold.bSkipAnyHit)
+			{
+				float bc[2] = { u, v };
+				Vec2 uv = mesh.GetTexcoord(tri.submeshIndex, tri.triIndex, bc);
+				if (mat.pBaseColor->SampleLevel(uv, 0).w < kMaterialOpacityThreshold)
+				{
+					return true;
+				}
+			}
+
+			r.tmax = t;
+			bHit = true;
+			if (pHit)
+			{
+				pHit->t = t;
+				pHit->barycentrics[0] = u;
+				pHit->barycentrics[1] = v;
+				pHit->instanceIndex = instanceIndex;
+				pHit->submeshIndex = tri.submeshIndex;
+				pHit->triIndex = tri.triIndex;
+			}
+			bContinue = !kAnyHit;
+			return bContinue;
+		}, pStats);
+
+		worldRay.tmax = localRay.tmax;
+		return bContinue;
+	}, pStats);
+	return bHit;
+}
+
+bool CpuScene::TraceClosest(const CpuRay& ray, CpuHit* pHit, uint32_t rayMask, BvhTraversalStats* pStats) const
+{
+	CpuRay r = ray;
+	return TraceInternal<false>(r, pHit, rayMask, pStats);
+}
+
+bool CpuScene::TraceAny(const CpuRay& ray, uint32_t rayMask) const
+{
+	CpuRay r = ray;
+	return TraceInternal<true>(r, nullptr, rayMask, nullptr);
+}
+
+Aabb CpuScene::GetSceneAabb() const
+{
+	Aabb ret;
+	for (auto&& inst : instances_)
+	{
+		// ComputeSceneAABB() uses the resource bounding box.
+		ret.Grow(TransformAabb(meshes_[inst.meshIndex]->GetResource().bounding.GetBox(), inst.mtxLocalToWorld));
+	}
+	return ret;
+}
+
+uint64_t CpuScene::GetTriangleCount() const
+{
+	// lod instances are not seen by primary rays.
+	uint64_t ret = 0;
+	for (auto&& inst : instances_)
+	{
+		if ((inst.instanceMask & GetLodRayMask(0, 0)) == 0)
+		{
+			continue;
+		}
+		ret += meshes_[inst.meshIndex]->GetResource().GetTotalTriangleCount();
+	}
+	return ret;
+}
+
+float CpuScene::GetLodRayTMin() const
+{
+	float ret = 0.0f;
+	for (auto&& inst : instances_)
+	{
+		if (inst.meshIndex < lodDistances_.size() && lodDistances_[inst.meshIndex] > 0.0f)
+		{
+			auto&& m = inst.mtxLocalToWorld;
+			float scale = std::max(Length(TransformVector(Vec3(1.0f, 0.0f, 0.0f), m)),
+				std::max(Length(TransformVector(Vec3(0.0f, 1.0f, 0.0f), m)), Length(TransformVector(Vec3(0.0f, 0.0f, 1.0f), m))));
+			ret = std::max(ret, lodDistances_[inst.meshIndex] * scale);
+		}
+	}
+	return ret;
+}
+
+//	EOF
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "cpu_material_fold.h"
+#include "cpu_scene_update.h"
+#include "dds_reader.h"
+#include "rmesh_reader.h"
+#include "rmesh_v2.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+struct CpuHit
+{
+	float		t;
+	float		barycentrics[2];
+	uint32_t	instanceIndex;
+	uint32_t	submeshIndex;
+	uint32_t	triIndex;
+};
+
+// material resources bound to a submesh, same as the local root table of MaterialCHS.
+struct CpuMaterial
+{
+	const CpuTexture*	pBaseColor;
+	const CpuTexture*	pORM;
+	bool				isOpaque;
+	MaterialFold		fold;		// constants of missing textures, same as MaterialConstantCHS.
+};
+
+// bottom level geometry of one .rmesh.
+class CpuMesh
+{
+public:
+	struct Triangle
+	{
+		Vec3		v0, e1, e2;
+		uint32_t	submeshIndex;
+		uint32_t	triIndex;
+	};
+
+public:
+	// v2 files with a prebuilt bvh are ready to trace after Initialize().
+	bool Initialize(const std::string& filePath);
+	void BuildBvh(const BvhBuildSettings& settings = BvhBuildSettings());
+
+	const RMesh& GetResource() const { return resource_; }
+	const std::vector<Triangle>& GetTriangles() const { return triangles_; }
+	const std::vector<CpuMaterial>& GetMaterials() const { return materials_; }
+	std::vector<CpuMaterial>& GetMaterials() { return materials_; }
+	const Bvh& GetBvh() const { return bvh_; }
+	const Aabb& GetBounds() const { return bounds_; }
+
+	// texcoord at a hit point, same as MaterialCHS/MaterialAHS.
+	Vec2 GetTexcoord(uint32_t submeshIndex, uint32_t triIndex, const float barycentrics[2]) const;
+	Vec3 GetNormal(uint32_t submeshIndex, uint32_t triIndex, const float barycentrics[2]) const;
+
+private:
+	void SortTriangles();
+
+private:
+	RMesh					resource_;
+	std::vector<Triangle>	triangles_;
+	std::vector<CpuMaterial>	materials_;
+	Bvh						bvh_;
+	Aabb					bounds_;
+};	// class CpuMesh
+
+// double sided ray triangle test, returns t and barycentrics in [ray.tmin, ray.tmax].
+inline bool IntersectTriangle(const CpuRay& ray, const CpuMesh::Triangle& tri, float* pT, float* pU, float* pV)
+{
+	Vec3 pvec = Cross(ray.direction, tri.e2);
+	float det = Dot(tri.e1, pvec);
+	if (std::fabs(det) < 1e-20f)
+	{
+		return false;
+	}
+	float invDet = 1.0f / det;
+	Vec3 tvec = ray.origin - tri.v0;
+	float u = Dot(tvec, pvec) * invDet;
+	if (u < 0.0f || u > 1.0f)
+	{
+		return false;
+	}
+	Vec3 qvec = Cross(tvec, tri.e1);
+	float v = Dot(ray.direction, qvec) * invDet;
+	if (v < 0.0f || u + v > 1.0f)
+	{
+		return false;
+	}
+	float t = Dot(tri.e2, qvec) * invDet;
+	if (t < ray.tmin || t > ray.tmax)
+	{
+		return false;
+	}
+	*pT = t;
+	*pU = u;
+	*pV = v;
+	return true;
+}
+
+struct CpuInstance
+{
+	uint32_t				meshIndex;
+	uint32_t				instanceMask;
+	DirectX::XMFLOAT4X4		mtxLocalToWorld;
+	DirectX::XMFLOAT4X4		mtxWorldToLocal;
+	Aabb					worldBounds;
+};
+
+class TaskScheduler;
+
+class CpuScene
+{
+public:
+	CpuScene();
+
+	// returns mesh index, or -1 on failure.
+	int AddMesh(const std::string& filePath);
+	// the mesh and up to levelCount - 1 lod files next to it, see GetRMeshLodPath().
+	// returns the mesh index of each level from lod 0, empty on failure.
+	std::vector<int> AddMeshLods(const std::string& filePath, uint32_t levelCount);
+	// instanceMask is InstanceMask of D3D12_RAYTRACING_INSTANCE_DESC, rays skip instances without a common bit.
+	void AddInstance(int meshIndex, const DirectX::XMFLOAT4X4& mtxLocalToWorld, uint32_t instanceMask = 0xff);
+	// one instance per level of a lod chain, masked by GetLodInstanceMask().
+	void AddLodInstances(const std::vector<int>& lodMeshes, const DirectX::XMFLOAT4X4& mtxLocalToWorld);
+	// build bottom level and top level bvh, and measure the lod distances.
+	// with pScheduler the meshes build in parallel and the top level starts without waiting for the lod distances.
+	void Build(const BvhBuildSettings& settings = BvhBuildSettings(), TaskScheduler* pScheduler = nullptr);
+	// moves an instance, the top level bvh is updated by UpdateScene().
+	void SetInstanceTransform(uint32_t instanceIndex, const DirectX::XMFLOAT4X4& mtxLocalToWorld);
+	// no-op, refit or rebuild of the top level bvh depending on the moved instances.
+	SceneUpdateType UpdateScene(const SceneUpdateSettings& settings = SceneUpdateSettings());
+
+	// RAY_FLAG_NONE, pStats adds the top and bottom level traversal work.
+	bool TraceClosest(const CpuRay& ray, CpuHit* pHit, uint32_t rayMask = 0xff, BvhTraversalStats* pStats = nullptr) const;
+	// RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH.
+	bool TraceAny(const CpuRay& ray, uint32_t rayMask = 0xff) const;
+
+	const std::vector<std::unique_ptr<CpuMesh>>& GetMeshes() const { return meshes_; }
+	const std::vector<CpuInstance>& GetInstances() const { return instances_; }
+	// same value as SampleApplication::ComputeSceneAABB().
+	Aabb GetSceneAabb() const;
+	uint64_t GetTriangleCount() const;
+	// CpuLodParams::rayTMin, the largest lod distance in world space.
+	float GetLodRayTMin() const;
+	const SceneUpdateTracker& GetSceneUpdate() const { return sceneUpdate_; }
+
+private:
+	const CpuTexture* LoadTexture(const std::string& filePath);
+	template <bool kAnyHit> bool TraceInternal(CpuRay& ray, CpuHit* pHit, uint32_t rayMask, BvhTraversalStats* pStats) const;
+
+private:
+	std::vector<std::unique_ptr<CpuMesh>>			meshes_;
+	std::vector<CpuInstance>						instances_;
+	std::vector<std::vector<int>>					lodChains_;
+	std::vector<float>								lodDistances_;		// per mesh, from the next finer lod, -1 until measured.
+	std::map<std::string, std::unique_ptr<CpuTexture>>	textures_;
+	CpuTexture										dummyWhite_;
+	SceneUpdateTracker								sceneUpdate_;
+	size_t											trackedInstanceCount_ = 0;
+};	// class CpuScene
+
+//	EOF
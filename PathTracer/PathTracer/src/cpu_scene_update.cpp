@@ -0,0 +1,263 @@
+#include "cpu_scene_update.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+
+namespace
+{
+	// dirty instances per instance count below which only the paths to the root are refit.
+	static const uint32_t kPartialRefitRatio = 16;
+	static const uint32_t kInvalidNode = 0xffffffff;
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double GetElapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool IsSameAabb(const BvhNode& node, const Aabb& b)
+	{
+		return node.bmin[0] == b.bmin.x && node.bmin[1] == b.bmin.y && node.bmin[2] == b.bmin.z
+			&& node.bmax[0] == b.bmax.x && node.bmax[1] == b.bmax.y && node.bmax[2] == b.bmax.z;
+	}
+
+	void AddCounters(const SceneUpdateCounters& src, SceneUpdateCounters* pDst)
+	{
+		pDst->frameCount += src.frameCount;
+		pDst->noopCount += src.noopCount;
+		pDst->refitCount += src.refitCount;
+		pDst->rebuildCount += src.rebuildCount;
+		pDst->dirtyInstances += src.dirtyInstances;
+		pDst->refitNodes += src.refitNodes;
+		pDst->rebuildPrims += src.rebuildPrims;
+		pDst->refitMs += src.refitMs;
+		pDst->rebuildMs += src.rebuildMs;
+	}
+}
+
+void SceneUpdateTracker::Clear()
+{
+	instances_.clear();
+	dirtyList_.clear();
+	dirtyFlags_.clear();
+	tlas_.GetNodes().clear();
+	tlas_.GetPrimIndices().clear();
+	nodeParents_.clear();
+	instanceLeaves_.clear();
+	refitOrder_.clear();
+	builtArea_ = currentArea_ = 0.0;
+	bTopologyDirty_ = true;
+	tlasVersion_++;
+}
+
+uint32_t SceneUpdateTracker::AddInstance(const Aabb& localBounds, const DirectX::XMFLOAT4X4& mtxLocalToWorld)
+{
+	Instance inst;
+	inst.mtxLocalToWorld = mtxLocalToWorld;
+	inst.localBounds = localBounds;
+	inst.worldBounds = TransformAabb(localBounds, mtxLocalToWorld);
+	instances_.push_back(inst);
+	dirtyFlags_.push_back(0);
+	bTopologyDirty_ = true;
+	return (uint32_t)instances_.size() - 1;
+}
+
+bool SceneUpdateTracker::SetMtxLocalToWorld(uint32_t index, const DirectX::XMFLOAT4X4& mtxLocalToWorld)
+{
+	auto&& inst = instances_[index];
+	if (memcmp(&inst.mtxLocalToWorld, &mtxLocalToWorld, sizeof(mtxLocalToWorld)) == 0)
+	{
+		return false;
+	}
+	inst.mtxLocalToWorld = mtxLocalToWorld;
+	if (!dirtyFlags_[index])
+	{
+		dirtyFlags_[index] = 1;
+		dirtyList_.push_back(index);
+	}
+	return true;
+}
+
+SceneUpdateType SceneUpdateTracker::Update(const SceneUpdateSettings& settings)
+{
+	lastFrame_ = SceneUpdateCounters();
+	lastFrame_.frameCount = 1;
+	if (!bTopologyDirty_ && dirtyList_.empty())
+	{
+		// nothing moved, keep the tlas and its version.
+		lastFrame_.noopCount = 1;
+		AddCounters(lastFrame_, &counters_);
+		return SceneUpdateType::None;
+	}
+
+	lastFrame_.dirtyInstances = dirtyList_.size();
+	for (auto&& index : dirtyList_)
+	{
+		auto&& inst = instances_[index];
+		inst.worldBounds = TransformAabb(inst.localBounds, inst.mtxLocalToWorld);
+	}
+
+	SceneUpdateType type = SceneUpdateType::Rebuild;
+	if (!bTopologyDirty_ && !tlas_.IsEmpty())
+	{
+		auto start = Clock::now();
+		if (Refit() && GetAreaRatio() <= settings.rebuildAreaRatio)
+		{
+			type = SceneUpdateType::Refit;
+		}
+		lastFrame_.refitMs = GetElapsedMs(start);
+	}
+	if (type == SceneUpdateType::Rebuild)
+	{
+		// topology changed, or refits degraded the tree too much.
+		Rebuild(settings);
+		lastFrame_.rebuildCount = 1;
+	}
+	else
+	{
+		lastFrame_.refitCount = 1;
+	}
+
+	for (auto&& index : dirtyList_)
+	{
+		dirtyFlags_[index] = 0;
+	}
+	dirtyList_.clear();
+	bTopologyDirty_ = false;
+	tlasVersion_++;
+	AddCounters(lastFrame_, &counters_);
+	return type;
+}
+
+void SceneUpdateTracker::Rebuild(const SceneUpdateSettings& settings)
+{
+	auto start = Clock::now();
+	rebuildBounds_.resize(instances_.size());
+	for (size_t i = 0; i < instances_.size(); i++)
+	{
+		rebuildBounds_[i] = instances_[i].worldBounds;
+	}
+	if (settings.bLbvh)
+	{
+		lbvh_.Build(rebuildBounds_, settings.bvh.threadCount, &tlas_);
+	}
+	else
+	{
+		BvhBuildSettings tlasSettings = settings.bvh;
+		tlasSettings.bSpatialSplits = false;
+		tlas_.BuildSAH(rebuildBounds_, tlasSettings);
+	}
+
+	// parents, leaf of each instance and a bottom up order for refits.
+	auto&& nodes = tlas_.GetNodes();
+	auto&& primIndices = tlas_.GetPrimIndices();
+	nodeParents_.assign(nodes.size(), kInvalidNode);
+	instanceLeaves_.assign(instances_.size(), kInvalidNode);
+	refitOrder_.clear();
+	refitOrder_.reserve(nodes.size());
+	builtArea_ = 0.0;
+	if (!nodes.empty())
+	{
+		std::vector<uint32_t> stack(1, 0);
+		while (!stack.empty())
+		{
+			uint32_t nodeIndex = stack.back();
+			stack.pop_back();
+			refitOrder_.push_back(nodeIndex);
+			auto&& node = nodes[nodeIndex];
+			builtArea_ += node.GetAabb().SurfaceArea();
+			if (node.IsLeaf())
+			{
+				for (uint32_t i = 0; i < node.primCount; i++)
+				{
+					instanceLeaves_[primIndices[node.leftFirst + i]] = nodeIndex;
+				}
+				continue;
+			}
+			for (uint32_t c = 0; c < 2; c++)
+			{
+				nodeParents_[node.leftFirst + c] = nodeIndex;
+				stack.push_back(node.leftFirst + c);
+			}
+		}
+		// pre-order reversed, children come before parents.
+		std::reverse(refitOrder_.begin(), refitOrder_.end());
+	}
+	currentArea_ = builtArea_;
+	lastFrame_.rebuildPrims = instances_.size();
+	lastFrame_.rebuildMs = GetElapsedMs(start);
+}
+
+bool SceneUpdateTracker::Refit()
+{
+	auto&& nodes = tlas_.GetNodes();
+	for (auto&& index : dirtyList_)
+	{
+		if (instanceLeaves_[index] == kInvalidNode && instances_[index].worldBounds.IsValid())
+		{
+			// skipped by the last build because of empty bounds.
+			return false;
+		}
+	}
+
+	if (dirtyList_.size() * kPartialRefitRatio < instances_.size())
+	{
+		// walk up from each moved instance until the bounds stop changing.
+		for (auto&& index : dirtyList_)
+		{
+			uint32_t nodeIndex = instanceLeaves_[index];
+			while (nodeIndex != kInvalidNode)
+			{
+				Aabb b = ComputeNodeAabb(nodeIndex);
+				lastFrame_.refitNodes++;
+				auto&& node = nodes[nodeIndex];
+				if (IsSameAabb(node, b))
+				{
+					break;
+				}
+				currentArea_ += (double)b.SurfaceArea() - (double)node.GetAabb().SurfaceArea();
+				node.SetAabb(b);
+				nodeIndex = nodeParents_[nodeIndex];
+			}
+		}
+	}
+	else
+	{
+		// most of the scene moved, one pass over all nodes is cheaper than many walks.
+		currentArea_ = 0.0;
+		for (auto&& nodeIndex : refitOrder_)
+		{
+			Aabb b = ComputeNodeAabb(nodeIndex);
+			nodes[nodeIndex].SetAabb(b);
+			currentArea_ += b.SurfaceArea();
+		}
+		lastFrame_.refitNodes += refitOrder_.size();
+	}
+	return true;
+}
+
+Aabb SceneUpdateTracker::ComputeNodeAabb(uint32_t nodeIndex) const
+{
+	auto&& nodes = tlas_.GetNodes();
+	auto&& node = nodes[nodeIndex];
+	Aabb ret;
+	if (node.IsLeaf())
+	{
+		auto&& primIndices = tlas_.GetPrimIndices();
+		for (uint32_t i = 0; i < node.primCount; i++)
+		{
+			ret.Grow(instances_[primIndices[node.leftFirst + i]].worldBounds);
+		}
+	}
+	else
+	{
+		ret.Grow(nodes[node.leftFirst].GetAabb());
+		ret.Grow(nodes[node.leftFirst + 1].GetAabb());
+	}
+	return ret;
+}
+
+//	EOF
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "cpu_lbvh.h"
+
+
+// work done by SceneUpdateTracker::Update().
+enum class SceneUpdateType
+{
+	None,			// nothing moved, the previous top level bvh is kept.
+	Refit,			// bounds of the moved instances and their ancestors are recomputed.
+	Rebuild,		// the top level bvh is built again.
+};
+
+struct SceneUpdateSettings
+{
+	BvhBuildSettings	bvh;
+	bool				bLbvh = false;				// rebuild with LbvhBuilder instead of binned sah.
+	float				rebuildAreaRatio = 1.5f;	// rebuild when refits grow the summed inner node area over this ratio of the last build.
+};
+
+struct SceneUpdateCounters
+{
+	uint64_t	frameCount = 0;
+	uint64_t	noopCount = 0;
+	uint64_t	refitCount = 0;
+	uint64_t	rebuildCount = 0;
+	uint64_t	dirtyInstances = 0;		// instances with a changed transform.
+	uint64_t	refitNodes = 0;			// nodes with recomputed bounds.
+	uint64_t	rebuildPrims = 0;		// instances passed to rebuilds.
+	double		refitMs = 0.0;
+	double		rebuildMs = 0.0;
+
+	// zero for a frame without build work.
+	uint64_t GetBuildWork() const { return refitNodes + rebuildPrims; }
+};
+
+// top level bvh that is updated from per-instance dirty flags instead of being rebuilt every frame.
+// instances are marked dirty only when SetMtxLocalToWorld() changes the transform,
+// Update() then picks the cheapest of no-op, refit and rebuild.
+// the tlas and its version are untouched by frames without dirty instances,
+// so a gpu side can keep its previous top level structure alive while the version stays the same.
+class SceneUpdateTracker
+{
+public:
+	void Clear();
+	// returns the instance index.
+	uint32_t AddInstance(const Aabb& localBounds, const DirectX::XMFLOAT4X4& mtxLocalToWorld);
+	// returns true when the transform has changed and the instance was marked dirty.
+	bool SetMtxLocalToWorld(uint32_t index, const DirectX::XMFLOAT4X4& mtxLocalToWorld);
+
+	SceneUpdateType Update(const SceneUpdateSettings& settings = SceneUpdateSettings());
+
+	const Bvh& GetTlas() const { return tlas_; }
+	// incremented by every refit and rebuild.
+	uint64_t GetTlasVersion() const { return tlasVersion_; }
+	uint32_t GetInstanceCount() const { return (uint32_t)instances_.size(); }
+	uint32_t GetDirtyCount() const { return (uint32_t)dirtyList_.size(); }
+	const Aabb& GetWorldBounds(uint32_t index) const { return instances_[index].worldBounds; }
+	const DirectX::XMFLOAT4X4& GetMtxLocalToWorld(uint32_t index) const { return instances_[index].mtxLocalToWorld; }
+
+	// summed inner node area relative to the last rebuild, 1.0 right after a rebuild.
+	float GetAreaRatio() const { return (builtArea_ > 0.0) ? (float)(currentArea_ / builtArea_) : 1.0f; }
+	const SceneUpdateCounters& GetCounters() const { return counters_; }
+	// counters of the last Update().
+	const SceneUpdateCounters& GetLastFrameCounters() const { return lastFrame_; }
+	void ResetCounters() { counters_ = SceneUpdateCounters(); }
+
+private:
+	struct Instance
+	{
+		DirectX::XMFLOAT4X4	mtxLocalToWorld;
+		Aabb				localBounds;
+		Aabb				worldBounds;
+	};
+
+	void Rebuild(const SceneUpdateSettings& settings);
+	// returns false when the tree has to be rebuilt instead.
+	bool Refit();
+	Aabb ComputeNodeAabb(uint32_t nodeIndex) const;
+
+private:
+	std::vector<Instance>	instances_;
+	std::vector<uint32_t>	dirtyList_;
+	std::vector<uint8_t>	dirtyFlags_;
+	bool					bTopologyDirty_ = false;
+
+	Bvh						tlas_;
+	LbvhBuilder				lbvh_;
+	uint64_t				tlasVersion_ = 0;
+	std::vector<uint32_t>	nodeParents_;
+	std::vector<uint32_t>	instanceLeaves_;	// leaf node of each instance.
+	std::vector<uint32_t>	refitOrder_;		// inner nodes, children before parents.
+	double					builtArea_ = 0.0;
+	double					currentArea_ = 0.0;
+
+	SceneUpdateCounters		counters_;
+	SceneUpdateCounters		lastFrame_;
+	std::vector<Aabb>		rebuildBounds_;
+};	// class SceneUpdateTracker
+
+//	EOF
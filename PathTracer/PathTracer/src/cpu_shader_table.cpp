@@ -0,0 +1,263 @@
+#include "cpu_shader_table.h"
+
+#include <algorithm>
+#include <iterator>
+
+
+void HitGroupTableLayout::Clear()
+{
+	records_.clear();
+	instanceOffsets_.clear();
+	instanceSubmeshCounts_.clear();
+	resourceOffsets_.clear();
+	perInstanceRecordCount_ = 0;
+}
+
+uint32_t HitGroupTableLayout::AddInstance(uint64_t resourceId, const uint32_t* pMaterialIndices, uint32_t submeshCount)
+{
+	// the same resource with the same materials reuses the records.
+	ResourceKey key(resourceId, std::vector<uint32_t>(pMaterialIndices, pMaterialIndices + submeshCount));
+	auto it = resourceOffsets_.find(key);
+	if (it == resourceOffsets_.end())
+	{
+		uint32_t offset = (uint32_t)records_.size();
+		for (uint32_t i = 0; i < submeshCount; i++)
+		{
+			records_.push_back({resourceId, i, pMaterialIndices[i]});
+		}
+		it = resourceOffsets_.insert(std::make_pair(std::move(key), offset)).first;
+	}
+
+	instanceOffsets_.push_back(it->second);
+	instanceSubmeshCounts_.push_back(submeshCount);
+	perInstanceRecordCount_ += submeshCount;
+	return (uint32_t)instanceOffsets_.size() - 1;
+}
+
+void ShaderTableManager::Initialize(uint32_t localRootSize, uint32_t initialCapacity)
+{
+	recordSize_ = GetShaderRecordSize(localRootSize);
+	capacity_ = std::max(initialCapacity, 1u);
+	slotCount_ = 0;
+	data_.assign((size_t)capacity_ * recordSize_, 0);
+	freeRanges_.clear();
+	blocks_.clear();
+	dirtyBegin_ = dirtyEnd_ = 0;
+	bReallocated_ = true;
+	counters_ = ShaderTableCounters();
+}
+
+uint32_t ShaderTableManager::Allocate(uint32_t count)
+{
+	counters_.allocations++;
+
+	// first fit from the free list.
+	for (auto it = freeRanges_.begin(); it != freeRanges_.end(); ++it)
+	{
+		if (it->second >= count)
+		{
+			uint32_t first = it->first;
+			uint32_t rest = it->second - count;
+			freeRanges_.erase(it);
+			if (rest > 0)
+			{
+				freeRanges_[first + count] = rest;
+			}
+			counters_.reusedAllocations++;
+			return first;
+		}
+	}
+
+	// append.
+	uint32_t first = slotCount_;
+	SetSlotCount(slotCount_ + count);
+	return first;
+}
+
+void ShaderTableManager::Free(uint32_t firstSlot, uint32_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	counters_.frees++;
+	ClearRecords(firstSlot, count);
+
+	// merge with the neighbors.
+	auto next = freeRanges_.lower_bound(firstSlot);
+	if (next != freeRanges_.end() && firstSlot + count == next->first)
+	{
+		count += next->second;
+		next = freeRanges_.erase(next);
+	}
+	if (next != freeRanges_.begin())
+	{
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == firstSlot)
+		{
+			firstSlot = prev->first;
+			count += prev->second;
+			freeRanges_.erase(prev);
+		}
+	}
+
+	// a free range at the end shrinks the table.
+	if (firstSlot + count == slotCount_)
+	{
+		slotCount_ = firstSlot;
+	}
+	else
+	{
+		freeRanges_[firstSlot] = count;
+	}
+}
+
+uint32_t ShaderTableManager::AcquireBlock(uint64_t key, uint32_t recordCount, bool* pbCreated)
+{
+	auto it = blocks_.find(key);
+	if (it != blocks_.end())
+	{
+		it->second.refCount++;
+		if (pbCreated)
+		{
+			*pbCreated = false;
+		}
+		return it->second.firstSlot;
+	}
+
+	Block block;
+	block.firstSlot = Allocate(recordCount);
+	block.count = recordCount;
+	block.refCount = 1;
+	blocks_[key] = block;
+	if (pbCreated)
+	{
+		*pbCreated = true;
+	}
+	return block.firstSlot;
+}
+
+bool ShaderTableManager::ReleaseBlock(uint64_t key)
+{
+	auto it = blocks_.find(key);
+	if (it == blocks_.end() || --it->second.refCount > 0)
+	{
+		return false;
+	}
+	Free(it->second.firstSlot, it->second.count);
+	blocks_.erase(it);
+	return true;
+}
+
+bool ShaderTableManager::FindBlock(uint64_t key, uint32_t* pFirstSlot) const
+{
+	auto it = blocks_.find(key);
+	if (it == blocks_.end())
+	{
+		return false;
+	}
+	*pFirstSlot = it->second.firstSlot;
+	return true;
+}
+
+void ShaderTableManager::WriteRecord(uint32_t slot, const void* pShaderIdentifier, const void* pLocalArgs, uint32_t localArgsSize)
+{
+	// build the record first, so that unchanged records are not marked dirty.
+	uint8_t record[256];
+	if (recordSize_ > sizeof(record) || GetDescOffset() + localArgsSize > recordSize_)
+	{
+		return;
+	}
+	memset(record, 0, recordSize_);
+	memcpy(record, pShaderIdentifier, kShaderIdentifierSize);
+	if (pLocalArgs)
+	{
+		memcpy(record + GetDescOffset(), pLocalArgs, localArgsSize);
+	}
+
+	uint8_t* dst = &data_[(size_t)slot * recordSize_];
+	if (memcmp(dst, record, recordSize_) == 0)
+	{
+		counters_.skippedRecords++;
+		return;
+	}
+	memcpy(dst, record, recordSize_);
+	counters_.patchedRecords++;
+	MarkDirty(slot, 1);
+}
+
+void ShaderTableManager::Resize(uint32_t count)
+{
+	if (count < slotCount_)
+	{
+		ClearRecords(count, slotCount_ - count);
+	}
+	freeRanges_.clear();
+	blocks_.clear();
+	SetSlotCount(count);
+}
+
+uint32_t ShaderTableManager::GetFreeSlotCount() const
+{
+	uint32_t ret = 0;
+	for (auto&& range : freeRanges_)
+	{
+		ret += range.second;
+	}
+	return ret;
+}
+
+bool ShaderTableManager::GetDirtyRange(uint32_t* pBeginSlot, uint32_t* pEndSlot) const
+{
+	if (dirtyBegin_ >= dirtyEnd_)
+	{
+		return false;
+	}
+	*pBeginSlot = dirtyBegin_;
+	*pEndSlot = std::min(dirtyEnd_, slotCount_);
+	return *pBeginSlot < *pEndSlot;
+}
+
+void ShaderTableManager::ClearDirty()
+{
+	dirtyBegin_ = dirtyEnd_ = 0;
+	bReallocated_ = false;
+}
+
+void ShaderTableManager::SetSlotCount(uint32_t slotCount)
+{
+	// the capacity is doubled when it runs out.
+	slotCount_ = slotCount;
+	if (slotCount_ > capacity_)
+	{
+		while (capacity_ < slotCount_)
+		{
+			capacity_ *= 2;
+		}
+		data_.resize((size_t)capacity_ * recordSize_, 0);
+		bReallocated_ = true;
+		counters_.reallocations++;
+	}
+}
+
+void ShaderTableManager::ClearRecords(uint32_t firstSlot, uint32_t count)
+{
+	memset(&data_[(size_t)firstSlot * recordSize_], 0, (size_t)count * recordSize_);
+	MarkDirty(firstSlot, count);
+}
+
+void ShaderTableManager::MarkDirty(uint32_t firstSlot, uint32_t count)
+{
+	if (dirtyBegin_ >= dirtyEnd_)
+	{
+		dirtyBegin_ = firstSlot;
+		dirtyEnd_ = firstSlot + count;
+	}
+	else
+	{
+		dirtyBegin_ = std::min(dirtyBegin_, firstSlot);
+		dirtyEnd_ = std::max(dirtyEnd_, firstSlot + count);
+	}
+}
+
+//	EOF
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+
+// shader record layout of SampleApplication::CreateRayTracingShaderTable().
+static const uint32_t kShaderIdentifierSize = 32;		// D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES
+static const uint32_t kShaderRecordAlignment = 32;		// D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT
+static const uint32_t kDescriptorHandleSize = 8;		// sizeof(D3D12_GPU_DESCRIPTOR_HANDLE)
+
+inline uint32_t AlignShaderTable(uint32_t size, uint32_t align)
+{
+	return ((size + align - 1) / align) * align;
+}
+// offset of the local root arguments in a record.
+inline uint32_t GetShaderRecordDescOffset()
+{
+	return AlignShaderTable(kShaderIdentifierSize, kDescriptorHandleSize);
+}
+inline uint32_t GetShaderRecordSize(uint32_t localRootSize)
+{
+	return AlignShaderTable(GetShaderRecordDescOffset() + localRootSize, kShaderRecordAlignment);
+}
+
+// one hit group record.
+struct HitGroupRecordKey
+{
+	uint64_t	resourceId;		// unique per mesh resource, e.g. the resource address.
+	uint32_t	submeshIndex;
+	uint32_t	materialIndex;
+
+	bool operator==(const HitGroupRecordKey& rhs) const
+	{
+		return resourceId == rhs.resourceId && submeshIndex == rhs.submeshIndex && materialIndex == rhs.materialIndex;
+	}
+};
+
+// hit group records of a scene, one per unique (resource, submesh, material).
+// records of one resource are contiguous, so instances of the same resource share one
+// InstanceContributionToHitGroupIndex and the geometry index selects the submesh.
+class HitGroupTableLayout
+{
+public:
+	void Clear();
+	// pMaterialIndices[i] is the material of submesh i, returns the instance index.
+	uint32_t AddInstance(uint64_t resourceId, const uint32_t* pMaterialIndices, uint32_t submeshCount);
+
+	uint32_t GetInstanceCount() const { return (uint32_t)instanceOffsets_.size(); }
+	uint32_t GetRecordCount() const { return (uint32_t)records_.size(); }
+	const HitGroupRecordKey& GetRecord(uint32_t index) const { return records_[index]; }
+	// index of the record of submesh 0, submesh i uses the record at offset + i.
+	uint32_t GetInstanceRecordOffset(uint32_t instance) const { return instanceOffsets_[instance]; }
+	uint32_t GetInstanceSubmeshCount(uint32_t instance) const { return instanceSubmeshCounts_[instance]; }
+	// InstanceContributionToHitGroupIndex with tableCountPerMaterial hit groups per record.
+	uint32_t GetInstanceContribution(uint32_t instance, uint32_t tableCountPerMaterial) const { return instanceOffsets_[instance] * tableCountPerMaterial; }
+	// record count of a table with one record per submesh of every instance.
+	uint32_t GetPerInstanceRecordCount() const { return perInstanceRecordCount_; }
+
+	static uint64_t GetTableBytes(uint32_t recordCount, uint32_t recordSize, uint32_t tableCountPerMaterial)
+	{
+		return (uint64_t)recordCount * recordSize * tableCountPerMaterial;
+	}
+
+private:
+	typedef std::pair<uint64_t, std::vector<uint32_t>>	ResourceKey;
+
+	std::vector<HitGroupRecordKey>		records_;
+	std::vector<uint32_t>				instanceOffsets_;
+	std::vector<uint32_t>				instanceSubmeshCounts_;
+	std::map<ResourceKey, uint32_t>		resourceOffsets_;
+	uint32_t							perInstanceRecordCount_ = 0;
+};	// class HitGroupTableLayout
+
+struct ShaderTableCounters
+{
+	uint64_t	allocations = 0;		// blocks allocated.
+	uint64_t	reusedAllocations = 0;	// blocks allocated from the free list.
+	uint64_t	frees = 0;				// blocks returned to the free list.
+	uint64_t	patchedRecords = 0;		// records whose bytes changed.
+	uint64_t	skippedRecords = 0;		// records written with the same bytes.
+	uint64_t	reallocations = 0;		// capacity grew, the gpu buffer has to be created again.
+};
+
+// cpu copy of a shader table that is patched in place.
+// slots are allocated in contiguous blocks, freed blocks go to a free list and are reused first.
+// blocks can be shared by key with reference counting, e.g. one block per mesh resource,
+// so that meshes that appear or disappear only touch their own records.
+// freed records are cleared, a zero shader identifier is a null hit group.
+// the record layout is the same as SampleApplication::CreateRayTracingShaderTable():
+// shader identifier, then the local root arguments at GetShaderRecordDescOffset().
+class ShaderTableManager
+{
+public:
+	void Initialize(uint32_t localRootSize, uint32_t initialCapacity = 64);
+
+	// returns the first slot of count contiguous slots.
+	uint32_t Allocate(uint32_t count);
+	void Free(uint32_t firstSlot, uint32_t count);
+
+	// block of recordCount slots shared by key, returns the first slot.
+	// pbCreated is set to true when the block was allocated by this call and its records have to be written.
+	uint32_t AcquireBlock(uint64_t key, uint32_t recordCount, bool* pbCreated = nullptr);
+	// returns true when the last reference was released and the block was freed.
+	bool ReleaseBlock(uint64_t key);
+	// returns false if the key has no block.
+	bool FindBlock(uint64_t key, uint32_t* pFirstSlot) const;
+
+	// writes a record in place, identical bytes are skipped and not marked dirty.
+	void WriteRecord(uint32_t slot, const void* pShaderIdentifier, const void* pLocalArgs, uint32_t localArgsSize);
+	// for tables whose slots are assigned outside of Allocate(), e.g. in command order.
+	// the table becomes [0, count), records above count are cleared.
+	void Resize(uint32_t count);
+
+	uint32_t GetRecordSize() const { return recordSize_; }
+	uint32_t GetDescOffset() const { return GetShaderRecordDescOffset(); }
+	// slots in [0, GetSlotCount()) make up the table, free slots are included.
+	uint32_t GetSlotCount() const { return slotCount_; }
+	uint32_t GetCapacity() const { return capacity_; }
+	uint32_t GetFreeSlotCount() const;
+	const uint8_t* GetData() const { return data_.data(); }
+	const uint8_t* GetRecord(uint32_t slot) const { return &data_[(size_t)slot * recordSize_]; }
+	uint64_t GetTableBytes() const { return (uint64_t)slotCount_ * recordSize_; }
+
+	// slots written since the last ClearDirty(), returns false if nothing changed.
+	bool GetDirtyRange(uint32_t* pBeginSlot, uint32_t* pEndSlot) const;
+	// true when the capacity grew since the last ClearDirty().
+	bool IsReallocated() const { return bReallocated_; }
+	void ClearDirty();
+
+	const ShaderTableCounters& GetCounters() const { return counters_; }
+
+private:
+	struct Block
+	{
+		uint32_t	firstSlot;
+		uint32_t	count;
+		uint32_t	refCount;
+	};
+
+	// sets the slot count and grows the capacity if needed.
+	void SetSlotCount(uint32_t slotCount);
+	void ClearRecords(uint32_t firstSlot, uint32_t count);
+	void MarkDirty(uint32_t firstSlot, uint32_t count);
+
+private:
+	std::vector<uint8_t>		data_;
+	uint32_t					recordSize_ = 0;
+	uint32_t					capacity_ = 0;
+	uint32_t					slotCount_ = 0;
+	std::map<uint32_t, uint32_t>	freeRanges_;		// first slot to slot count, adjacent ranges are merged.
+	std::map<uint64_t, Block>	blocks_;
+	uint32_t					dirtyBegin_ = 0;
+	uint32_t					dirtyEnd_ = 0;
+	bool						bReallocated_ = false;
+	ShaderTableCounters			counters_;
+};	// class ShaderTableManager
+
+//	EOF
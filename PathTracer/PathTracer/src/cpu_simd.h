@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// 8-wide float vector.
+// AVX2 when the translation unit is compiled for it (/arch:AVX2, -mavx2),
+// other builds fall back to scalar loops with the same results.
+// include this only from translation units that share the same instruction set flags.
+#if defined(__AVX2__)
+#	define CPU_SIMD_AVX2 1
+#	include <immintrin.h>
+#else
+#	define CPU_SIMD_AVX2 0
+#endif
+
+#if CPU_SIMD_AVX2
+
+struct Float8
+{
+	__m256	v;
+
+	Float8() {}
+	Float8(__m256 x) : v(x) {}
+	explicit Float8(float x) : v(_mm256_set1_ps(x)) {}
+
+	static Float8 Load(const float* p) { return _mm256_loadu_ps(p); }
+	// 8 bytes converted to float.
+	static Float8 LoadBytes(const uint8_t* p) { return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+	void Store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+// lane mask, all bits set for true lanes.
+struct Mask8
+{
+	__m256	v;
+
+	Mask8() {}
+	Mask8(__m256 x) : v(x) {}
+
+	static Mask8 FromBits(uint32_t bits)
+	{
+		const __m256i kLaneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		__m256i b = _mm256_and_si256(_mm256_set1_epi32((int)bits), kLaneBits);
+		return _mm256_castsi256_ps(_mm256_cmpeq_epi32(b, kLaneBits));
+	}
+	uint32_t GetBits() const { return (uint32_t)_mm256_movemask_ps(v); }
+};
+
+inline Float8 operator+(const Float8& a, const Float8& b) { return _mm256_add_ps(a.v, b.v); }
+inline Float8 operator-(const Float8& a, const Float8& b) { return _mm256_sub_ps(a.v, b.v); }
+inline Float8 operator*(const Float8& a, const Float8& b) { return _mm256_mul_ps(a.v, b.v); }
+inline Float8 operator/(const Float8& a, const Float8& b) { return _mm256_div_ps(a.v, b.v); }
+inline Float8 Min(const Float8& a, const Float8& b) { return _mm256_min_ps(a.v, b.v); }
+inline Float8 Max(const Float8& a, const Float8& b) { return _mm256_max_ps(a.v, b.v); }
+inline Float8 Abs(const Float8& a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+// a * b - c
+inline Float8 MulSub(const Float8& a, const Float8& b, const Float8& c) { return _mm256_sub_ps(_mm256_mul_ps(a.v, b.v), c.v); }
+
+inline Mask8 operator<(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline Mask8 operator<=(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline Mask8 operator>(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline Mask8 operator>=(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline Mask8 operator==(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+inline Mask8 operator&(const Mask8& a, const Mask8& b) { return _mm256_and_ps(a.v, b.v); }
+inline Mask8 operator|(const Mask8& a, const Mask8& b) { return _mm256_or_ps(a.v, b.v); }
+inline Mask8 AndNot(const Mask8& a, const Mask8& b) { return _mm256_andnot_ps(a.v, b.v); }	// !a & b
+// m ? a : b
+inline Float8 Select(const Mask8& m, const Float8& a, const Float8& b) { return _mm256_blendv_ps(b.v, a.v, m.v); }
+
+#else
+
+struct Float8
+{
+	float	v[8];
+
+	Float8() {}
+	explicit Float8(float x) { std::fill(v, v + 8, x); }
+
+	static Float8 Load(const float* p) { Float8 r; std::copy(p, p + 8, r.v); return r; }
+	static Float8 LoadBytes(const uint8_t* p) { Float8 r; for (int i = 0; i < 8; i++) { r.v[i] = (float)p[i]; } return r; }
+	void Store(float* p) const { std::copy(v, v + 8, p); }
+};
+
+struct Mask8
+{
+	uint32_t	bits;
+
+	static Mask8 FromBits(uint32_t b) { Mask8 r; r.bits = b & 0xff; return r; }
+	uint32_t GetBits() const { return bits; }
+};
+
+#define CPU_SIMD_FLOAT8_OP(expr) Float8 r; for (int i = 0; i < 8; i++) { r.v[i] = (expr); } return r;
+#define CPU_SIMD_MASK8_OP(expr) Mask8 r; r.bits = 0; for (int i = 0; i < 8; i++) { r.bits |= (expr) ? (1u << i) : 0u; } return r;
+
+inline Float8 operator+(const Float8& a, const Float8& b) { CPU_SIMD_FLOAT8_OP(a.v[i] + b.v[i]) }
+inline Float8 operator-(const Float8& a, const Float8& b) { CPU_SIMD_FLOAT8_OP(a.v[i] - b.v[i]) }
+inline Float8 operator*(const Float8& a, const Float8& b) { CPU_SIMD_FLOAT8_OP(a.v[i] * b.v[i]) }
+inline Float8 operator/(const Float8& a, const Float8& b) { CPU_SIMD_FLOAT8_OP(a.v[i] / b.v[i]) }
+// same operand order as minps/maxps, the second operand is returned for NaN.
+inline Float8 Min(const Float8& a, const Float8& b) { CPU_SIMD_FLOAT8_OP(a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+inline Float8 Max(const Float8& a, const Float8& b) { CPU_SIMD_FLOAT8_OP(a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+inline Float8 Abs(const Float8& a) { CPU_SIMD_FLOAT8_OP(std::fabs(a.v[i])) }
+inline Float8 MulSub(const Float8& a, const Float8& b, const Float8& c) { CPU_SIMD_FLOAT8_OP(a.v[i] * b.v[i] - c.v[i]) }
+
+inline Mask8 operator<(const Float8& a, const Float8& b) { CPU_SIMD_MASK8_OP(a.v[i] < b.v[i]) }
+inline Mask8 operator<=(const Float8& a, const Float8& b) { CPU_SIMD_MASK8_OP(a.v[i] <= b.v[i]) }
+inline Mask8 operator>(const Float8& a, const Float8& b) { CPU_SIMD_MASK8_OP(a.v[i] > b.v[i]) }
+inline Mask8 operator>=(const Float8& a, const Float8& b) { CPU_SIMD_MASK8_OP(a.v[i] >= b.v[i]) }
+inline Mask8 operator==(const Float8& a, const Float8& b) { CPU_SIMD_MASK8_OP(a.v[i] == b.v[i]) }
+inline Mask8 operator&(const Mask8& a, const Mask8& b) { return Mask8::FromBits(a.bits & b.bits); }
+inline Mask8 operator|(const Mask8& a, const Mask8& b) { return Mask8::FromBits(a.bits | b.bits); }
+inline Mask8 AndNot(const Mask8& a, const Mask8& b) { return Mask8::FromBits(~a.bits & b.bits); }
+inline Float8 Select(const Mask8& m, const Float8& a, const Float8& b) { CPU_SIMD_FLOAT8_OP((m.bits & (1u << i)) ? a.v[i] : b.v[i]) }
+
+#undef CPU_SIMD_FLOAT8_OP
+#undef CPU_SIMD_MASK8_OP
+
+#endif
+
+//	EOF
@@ -0,0 +1,547 @@
+#include "cpu_simd_traversal.h"
+#include "cpu_simd.h"
+
+#include <cstdio>
+
+
+namespace
+{
+	// per ray constants of the watertight test.
+	// the ray is sheared and scaled so that it points along +z of the (kx, ky, kz) frame.
+	struct WatertightRay
+	{
+		Vec3	origin;
+		int		kx, ky, kz;
+		float	sx, sy, sz;
+
+		WatertightRay(const Vec3& o, const Vec3& d)
+			: origin(o)
+		{
+			Vec3 a(std::fabs(d.x), std::fabs(d.y), std::fabs(d.z));
+			kz = (a.x > a.y) ? (a.x > a.z ? 0 : 2) : (a.y > a.z ? 1 : 2);
+			kx = (kz + 1) % 3;
+			ky = (kx + 1) % 3;
+			if (d[kz] < 0.0f)
+			{
+				// keep the winding.
+				std::swap(kx, ky);
+			}
+			sx = d[kx] / d[kz];
+			sy = d[ky] / d[kz];
+			sz = 1.0f / d[kz];
+		}
+	};
+
+	// scaled barycentrics in double precision, used when an edge test is exactly 0.
+	inline void ComputeEdgesDouble(float ax, float ay, float bx, float by, float cx, float cy, float* pU, float* pV, float* pW)
+	{
+		*pU = (float)((double)cx * (double)by - (double)cy * (double)bx);
+		*pV = (float)((double)ax * (double)cy - (double)ay * (double)cx);
+		*pW = (float)((double)bx * (double)ay - (double)by * (double)ax);
+	}
+
+	bool IntersectWatertight(const WatertightRay& ray, const Vec3& p0, const Vec3& p1, const Vec3& p2, float tmin, float tmax, float* pT, float* pU, float* pV)
+	{
+		Vec3 a = p0 - ray.origin;
+		Vec3 b = p1 - ray.origin;
+		Vec3 c = p2 - ray.origin;
+		float ax = a[ray.kx] - ray.sx * a[ray.kz];
+		float ay = a[ray.ky] - ray.sy * a[ray.kz];
+		float bx = b[ray.kx] - ray.sx * b[ray.kz];
+		float by = b[ray.ky] - ray.sy * b[ray.kz];
+		float cx = c[ray.kx] - ray.sx * c[ray.kz];
+		float cy = c[ray.ky] - ray.sy * c[ray.kz];
+
+		float u = cx * by - cy * bx;
+		float v = ax * cy - ay * cx;
+		float w = bx * ay - by * ax;
+		if (u == 0.0f || v == 0.0f || w == 0.0f)
+		{
+			ComputeEdgesDouble(ax, ay, bx, by, cx, cy, &u, &v, &w);
+		}
+		// double sided, all edges must have the same sign.
+		if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+		{
+			return false;
+		}
+		float det = u + v + w;
+		if (det == 0.0f)
+		{
+			return false;
+		}
+
+		float az = ray.sz * a[ray.kz];
+		float bz = ray.sz * b[ray.kz];
+		float cz = ray.sz * c[ray.kz];
+		float T = u * az + v * bz + w * cz;
+		float invDet = 1.0f / det;
+		float t = T * invDet;
+		if (!(t >= tmin && t <= tmax))
+		{
+			return false;
+		}
+		*pT = t;
+		*pU = v * invDet;
+		*pV = w * invDet;
+		return true;
+	}
+
+	// watertight constants of 8 rays.
+	struct WatertightPacket
+	{
+		Float8	sx, sy, sz;
+		Mask8	kx0, kx1, ky0, ky1, kz0, kz1;
+
+		static Float8 Permute(const Mask8& m0, const Mask8& m1, const Float8& x, const Float8& y, const Float8& z)
+		{
+			return Select(m0, x, Select(m1, y, z));
+		}
+	};
+
+	inline uint32_t CountBits(uint32_t v)
+	{
+		uint32_t ret = 0;
+		for (; v; v &= v - 1)
+		{
+			ret++;
+		}
+		return ret;
+	}
+}
+
+bool SimdTriangleBvh::IsSimdEnabled()
+{
+	return CPU_SIMD_AVX2 != 0;
+}
+
+bool SimdTriangleBvh::Build(const std::vector<Vec3>& triVertices, const BvhBuildSettings& settings)
+{
+	size_t triCount = triVertices.size() / 3;
+	if (triCount == 0)
+	{
+		printf("Error: no triangles for SimdTriangleBvh.\n");
+		return false;
+	}
+
+	std::vector<Aabb> primBounds(triCount);
+	for (size_t i = 0; i < triCount; i++)
+	{
+		primBounds[i].Grow(triVertices[i * 3 + 0]);
+		primBounds[i].Grow(triVertices[i * 3 + 1]);
+		primBounds[i].Grow(triVertices[i * 3 + 2]);
+	}
+
+	// wide leaves take up to 3 triangles, the binary bvh is built to match.
+	BvhBuildSettings binarySettings = settings;
+	binarySettings.maxLeafSize = WideBvh::kMaxLeafSize;
+	binary_.BuildSAH(primBounds, binarySettings, settings.bSpatialSplits ? &triVertices : nullptr);
+
+	// reorder triangles to the leaf order, references duplicated by spatial splits are copied.
+	auto&& primIndices = binary_.GetPrimIndices();
+	std::vector<Aabb> sortedBounds(primIndices.size());
+	vertices_.resize(primIndices.size() * 3);
+	triIndices_.resize(primIndices.size());
+	for (size_t i = 0; i < primIndices.size(); i++)
+	{
+		uint32_t tri = primIndices[i];
+		std::copy(triVertices.begin() + tri * 3, triVertices.begin() + tri * 3 + 3, vertices_.begin() + i * 3);
+		sortedBounds[i] = primBounds[tri];
+		triIndices_[i] = tri;
+		primIndices[i] = (uint32_t)i;
+	}
+	return wide_.Build(binary_, sortedBounds);
+}
+
+bool SimdTriangleBvh::TraceSingle(const CpuRay& ray, SimdHit* pHit, BvhTraversalStats* pStats) const
+{
+	WatertightRay wray(ray.origin, ray.direction);
+	CpuRay r = ray;
+	pHit->primIndex = kInvalidPrim;
+	binary_.Traverse(r, [&](uint32_t primIndex, CpuRay& cur)
+	{
+		const Vec3* p = &vertices_[primIndex * 3];
+		float t, u, v;
+		if (IntersectWatertight(wray, p[0], p[1], p[2], cur.tmin, cur.tmax, &t, &u, &v))
+		{
+			cur.tmax = t;
+			*pHit = { t, u, v, primIndex };
+		}
+		return true;
+	}, pStats);
+	return pHit->primIndex != kInvalidPrim;
+}
+
+void SimdTriangleBvh::TracePacket(const RayPacket8& packet, uint32_t activeMask, PacketHit8* pHit, BvhTraversalStats* pStats) const
+{
+	TracePacketGroup(&packet, &activeMask, 1, pHit, pStats);
+}
+
+void SimdTriangleBvh::TracePacketGroup(const RayPacket8* pPackets, const uint32_t* pActiveMasks, uint32_t packetCount, PacketHit8* pHits, BvhTraversalStats* pStats) const
+{
+	// lane bits of packet p are bits [8p, 8p + 8) of a group mask.
+	typedef uint64_t GroupMask;
+	struct PacketState
+	{
+		Float8				ox, oy, oz;
+		Float8				ix, iy, iz;
+		Float8				tmin, tmax;
+		Float8				hitU, hitV;
+		WatertightPacket	wp;
+	};
+
+	packetCount = std::min(packetCount, kMaxGroupPackets);
+	PacketState states[kMaxGroupPackets];
+	uint32_t masks[kMaxGroupPackets];
+	GroupMask activeMask = 0;
+	for (uint32_t p = 0; p < packetCount; p++)
+	{
+		auto&& packet = pPackets[p];
+		auto&& st = states[p];
+		PacketHit8* pHit = &pHits[p];
+		masks[p] = pActiveMasks[p] & 0xff;
+		activeMask |= (GroupMask)masks[p] << (p * kPacketSize);
+		for (uint32_t i = 0; i < kPacketSize; i++)
+		{
+			pHit->primIndex[i] = kInvalidPrim;
+			pHit->t[i] = packet.tmax[i];
+			pHit->u[i] = pHit->v[i] = 0.0f;
+		}
+
+		Float8 one(1.0f);
+		st.ox = Float8::Load(packet.ox); st.oy = Float8::Load(packet.oy); st.oz = Float8::Load(packet.oz);
+		st.ix = one / Float8::Load(packet.dx); st.iy = one / Float8::Load(packet.dy); st.iz = one / Float8::Load(packet.dz);
+		st.tmin = Float8::Load(packet.tmin);
+		st.tmax = Float8::Load(packet.tmax);
+		st.hitU = st.hitV = Float8(0.0f);
+
+		// watertight constants per lane.
+		alignas(32) float sx[8], sy[8], sz[8];
+		uint32_t kx0 = 0, kx1 = 0, ky0 = 0, ky1 = 0, kz0 = 0, kz1 = 0;
+		for (uint32_t i = 0; i < kPacketSize; i++)
+		{
+			WatertightRay wr(Vec3(packet.ox[i], packet.oy[i], packet.oz[i]), Vec3(packet.dx[i], packet.dy[i], packet.dz[i]));
+			sx[i] = wr.sx; sy[i] = wr.sy; sz[i] = wr.sz;
+			kx0 |= (wr.kx == 0) << i; kx1 |= (wr.kx == 1) << i;
+			ky0 |= (wr.ky == 0) << i; ky1 |= (wr.ky == 1) << i;
+			kz0 |= (wr.kz == 0) << i; kz1 |= (wr.kz == 1) << i;
+		}
+		st.wp.sx = Float8::Load(sx); st.wp.sy = Float8::Load(sy); st.wp.sz = Float8::Load(sz);
+		st.wp.kx0 = Mask8::FromBits(kx0); st.wp.kx1 = Mask8::FromBits(kx1);
+		st.wp.ky0 = Mask8::FromBits(ky0); st.wp.ky1 = Mask8::FromBits(ky1);
+		st.wp.kz0 = Mask8::FromBits(kz0); st.wp.kz1 = Mask8::FromBits(kz1);
+	}
+	if (binary_.IsEmpty() || !activeMask)
+	{
+		return;
+	}
+
+	auto&& nodes = binary_.GetNodes();
+	// group mask of the rays that hit the box, the entry distance of each packet goes to pDist.
+	auto IntersectBox = [&](const BvhNode& node, GroupMask mask, Float8* pDist)
+	{
+		GroupMask ret = 0;
+		for (uint32_t p = 0; p < packetCount; p++)
+		{
+			uint32_t laneMask = (uint32_t)(mask >> (p * kPacketSize)) & 0xff;
+			if (!laneMask)
+			{
+				continue;
+			}
+			auto&& st = states[p];
+			Float8 t0x = (Float8(node.bmin[0]) - st.ox) * st.ix, t1x = (Float8(node.bmax[0]) - st.ox) * st.ix;
+			Float8 t0y = (Float8(node.bmin[1]) - st.oy) * st.iy, t1y = (Float8(node.bmax[1]) - st.oy) * st.iy;
+			Float8 t0z = (Float8(node.bmin[2]) - st.oz) * st.iz, t1z = (Float8(node.bmax[2]) - st.oz) * st.iz;
+			Float8 tnear = Max(Max(Min(t0x, t1x), Min(t0y, t1y)), Max(Min(t0z, t1z), st.tmin));
+			Float8 tfar = Min(Min(Max(t0x, t1x), Max(t0y, t1y)), Min(Max(t0z, t1z), st.tmax));
+			pDist[p] = tnear;
+			ret |= (GroupMask)((tnear <= tfar).GetBits() & laneMask) << (p * kPacketSize);
+		}
+		return ret;
+	};
+
+	struct StackEntry
+	{
+		uint32_t	node;
+		GroupMask	mask;
+	};
+	// every level leaves at most one sibling on the stack, BuildSAH caps the depth, so the stack never overflows.
+	static_assert(kStackSize > Bvh::kMaxDepth + 1, "kStackSize does not cover the depth of the binary bvh.");
+	StackEntry stack[kStackSize];
+	uint32_t stackTop = 0;
+	Float8 d0[kMaxGroupPackets], d1[kMaxGroupPackets];
+	if (pStats)
+	{
+		pStats->nodeVisits++;
+		pStats->cacheLines += CountCacheLines(0, sizeof(BvhNode));
+	}
+	GroupMask rootMask = IntersectBox(nodes[0], activeMask, d0);
+	if (!rootMask)
+	{
+		return;
+	}
+	stack[stackTop++] = { 0, rootMask };
+
+	while (stackTop > 0)
+	{
+		StackEntry entry = stack[--stackTop];
+		const BvhNode& node = nodes[entry.node];
+		if (node.IsLeaf())
+		{
+			if (pStats)
+			{
+				pStats->primTests += node.primCount;
+			}
+			for (uint32_t p = 0; p < packetCount; p++)
+			{
+				uint32_t laneMask = (uint32_t)(entry.mask >> (p * kPacketSize)) & 0xff;
+				if (!laneMask)
+				{
+					continue;
+				}
+				auto&& st = states[p];
+				auto&& wp = st.wp;
+				Mask8 active = Mask8::FromBits(laneMask);
+				for (uint32_t prim = node.leftFirst; prim < node.leftFirst + node.primCount; prim++)
+				{
+					const Vec3* v = &vertices_[prim * 3];
+					Float8 ax = Float8(v[0].x) - st.ox, ay = Float8(v[0].y) - st.oy, az = Float8(v[0].z) - st.oz;
+					Float8 bx = Float8(v[1].x) - st.ox, by = Float8(v[1].y) - st.oy, bz = Float8(v[1].z) - st.oz;
+					Float8 cx = Float8(v[2].x) - st.ox, cy = Float8(v[2].y) - st.oy, cz = Float8(v[2].z) - st.oz;
+					Float8 akz = WatertightPacket::Permute(wp.kz0, wp.kz1, ax, ay, az);
+					Float8 bkz = WatertightPacket::Permute(wp.kz0, wp.kz1, bx, by, bz);
+					Float8 ckz = WatertightPacket::Permute(wp.kz0, wp.kz1, cx, cy, cz);
+					Float8 sax = WatertightPacket::Permute(wp.kx0, wp.kx1, ax, ay, az) - wp.sx * akz;
+					Float8 say = WatertightPacket::Permute(wp.ky0, wp.ky1, ax, ay, az) - wp.sy * akz;
+					Float8 sbx = WatertightPacket::Permute(wp.kx0, wp.kx1, bx, by, bz) - wp.sx * bkz;
+					Float8 sby = WatertightPacket::Permute(wp.ky0, wp.ky1, bx, by, bz) - wp.sy * bkz;
+					Float8 scx = WatertightPacket::Permute(wp.kx0, wp.kx1, cx, cy, cz) - wp.sx * ckz;
+					Float8 scy = WatertightPacket::Permute(wp.ky0, wp.ky1, cx, cy, cz) - wp.sy * ckz;
+
+					Float8 eu = MulSub(scx, sby, scy * sbx);
+					Float8 ev = MulSub(sax, scy, say * scx);
+					Float8 ew = MulSub(sbx, say, sby * sax);
+
+					// lanes with an edge exactly on the ray are recomputed in double.
+					Float8 zero(0.0f);
+					uint32_t fallback = ((eu == zero) | (ev == zero) | (ew == zero)).GetBits() & laneMask;
+					if (fallback)
+					{
+						alignas(32) float au[8], av[8], aw[8], sax8[8], say8[8], sbx8[8], sby8[8], scx8[8], scy8[8];
+						eu.Store(au); ev.Store(av); ew.Store(aw);
+						sax.Store(sax8); say.Store(say8); sbx.Store(sbx8); sby.Store(sby8); scx.Store(scx8); scy.Store(scy8);
+						for (uint32_t i = 0; i < kPacketSize; i++)
+						{
+							if (fallback & (1 << i))
+							{
+								ComputeEdgesDouble(sax8[i], say8[i], sbx8[i], sby8[i], scx8[i], scy8[i], &au[i], &av[i], &aw[i]);
+							}
+						}
+						eu = Float8::Load(au); ev = Float8::Load(av); ew = Float8::Load(aw);
+					}
+
+					Mask8 anyNeg = (eu < zero) | (ev < zero) | (ew < zero);
+					Mask8 anyPos = (eu > zero) | (ev > zero) | (ew > zero);
+					Float8 det = eu + ev + ew;
+					Mask8 hit = AndNot(anyNeg & anyPos, active);
+					hit = AndNot(det == zero, hit);
+					if (!hit.GetBits())
+					{
+						continue;
+					}
+
+					Float8 T = eu * (wp.sz * akz) + ev * (wp.sz * bkz) + ew * (wp.sz * ckz);
+					Float8 invDet = Float8(1.0f) / det;
+					Float8 t = T * invDet;
+					hit = hit & (t >= st.tmin) & (t <= st.tmax);
+					uint32_t hitBits = hit.GetBits();
+					if (!hitBits)
+					{
+						continue;
+					}
+					st.tmax = Select(hit, t, st.tmax);
+					st.hitU = Select(hit, ev * invDet, st.hitU);
+					st.hitV = Select(hit, ew * invDet, st.hitV);
+					for (uint32_t i = 0; i < kPacketSize; i++)
+					{
+						if (hitBits & (1 << i))
+						{
+							pHits[p].primIndex[i] = prim;
+						}
+					}
+				}
+			}
+			continue;
+		}
+
+		// both children are fetched together.
+		if (pStats)
+		{
+			pStats->nodeVisits++;
+			pStats->cacheLines += CountCacheLines(node.leftFirst * sizeof(BvhNode), sizeof(BvhNode) * 2);
+		}
+		const BvhNode& c0 = nodes[node.leftFirst];
+		const BvhNode& c1 = nodes[node.leftFirst + 1];
+
+		GroupMask m0 = IntersectBox(c0, entry.mask, d0);
+		GroupMask m1 = IntersectBox(c1, entry.mask, d1);
+		if (m0 && m1)
+		{
+			// the child that is nearer for more rays goes first.
+			uint32_t bothCount = 0, nearer0Count = 0;
+			for (uint32_t p = 0; p < packetCount; p++)
+			{
+				uint32_t both = (uint32_t)((m0 & m1) >> (p * kPacketSize)) & 0xff;
+				if (both)
+				{
+					bothCount += CountBits(both);
+					nearer0Count += CountBits((d0[p] <= d1[p]).GetBits() & both);
+				}
+			}
+			if (nearer0Count * 2 >= bothCount)
+			{
+				stack[stackTop++] = { node.leftFirst + 1, m1 };
+				stack[stackTop++] = { node.leftFirst, m0 };
+			}
+			else
+			{
+				stack[stackTop++] = { node.leftFirst, m0 };
+				stack[stackTop++] = { node.leftFirst + 1, m1 };
+			}
+		}
+		else if (m0 || m1)
+		{
+			stack[stackTop++] = { m0 ? node.leftFirst : node.leftFirst + 1, m0 ? m0 : m1 };
+		}
+	}
+
+	for (uint32_t p = 0; p < packetCount; p++)
+	{
+		states[p].tmax.Store(pHits[p].t);
+		states[p].hitU.Store(pHits[p].u);
+		states[p].hitV.Store(pHits[p].v);
+	}
+}
+
+void SimdTriangleBvh::TraceStream(const CpuRay* pRays, size_t rayCount, SimdHit* pHits, BvhTraversalStats* pStats) const
+{
+	// leaf entries: kLeafFlag | primStart << 2 | count, same as WideBvh::Traverse().
+	static const uint32_t kLeafFlag = 0x80000000;
+	struct StackEntry
+	{
+		uint32_t	item;
+		float		dist;
+	};
+
+	auto&& nodes = wide_.GetNodes();
+	auto&& primIndices = wide_.GetPrimIndices();
+	for (size_t r = 0; r < rayCount; r++)
+	{
+		const CpuRay& ray = pRays[r];
+		SimdHit& hit = pHits[r];
+		hit = { ray.tmax, 0.0f, 0.0f, kInvalidPrim };
+		if (nodes.empty())
+		{
+			continue;
+		}
+
+		WatertightRay wray(ray.origin, ray.direction);
+		Float8 ox(ray.origin.x), oy(ray.origin.y), oz(ray.origin.z);
+		Float8 ix(1.0f / ray.direction.x), iy(1.0f / ray.direction.y), iz(1.0f / ray.direction.z);
+		Float8 tmin(ray.tmin);
+		float tmax = ray.tmax;
+
+		StackEntry stack[WideBvh::kStackSize];
+		uint32_t stackTop = 0;
+		stack[stackTop++] = { 0, ray.tmin };
+		while (stackTop > 0)
+		{
+			StackEntry entry = stack[--stackTop];
+			if (entry.dist > tmax)
+			{
+				continue;
+			}
+
+			if (entry.item & kLeafFlag)
+			{
+				uint32_t start = (entry.item & ~kLeafFlag) >> 2;
+				uint32_t count = entry.item & 0x3;
+				if (pStats)
+				{
+					pStats->primTests += count;
+				}
+				for (uint32_t i = start; i < start + count; i++)
+				{
+					uint32_t prim = primIndices[i];
+					const Vec3* v = &vertices_[prim * 3];
+					float t, bu, bv;
+					if (IntersectWatertight(wray, v[0], v[1], v[2], ray.tmin, tmax, &t, &bu, &bv))
+					{
+						tmax = t;
+						hit = { t, bu, bv, prim };
+					}
+				}
+				continue;
+			}
+
+			const WideBvhNode& node = nodes[entry.item];
+			if (pStats)
+			{
+				pStats->nodeVisits++;
+				pStats->cacheLines += CountCacheLines(entry.item * sizeof(WideBvhNode), sizeof(WideBvhNode));
+			}
+
+			// all 8 child boxes at once.
+			Float8 sx(node.GetScale(0)), sy(node.GetScale(1)), sz(node.GetScale(2));
+			Float8 bx(node.origin[0]), by(node.origin[1]), bz(node.origin[2]);
+			Float8 t0x = (bx + Float8::LoadBytes(node.qlo[0]) * sx - ox) * ix, t1x = (bx + Float8::LoadBytes(node.qhi[0]) * sx - ox) * ix;
+			Float8 t0y = (by + Float8::LoadBytes(node.qlo[1]) * sy - oy) * iy, t1y = (by + Float8::LoadBytes(node.qhi[1]) * sy - oy) * iy;
+			Float8 t0z = (bz + Float8::LoadBytes(node.qlo[2]) * sz - oz) * iz, t1z = (bz + Float8::LoadBytes(node.qhi[2]) * sz - oz) * iz;
+			Float8 tnear = Max(Max(Min(t0x, t1x), Min(t0y, t1y)), Max(Min(t0z, t1z), tmin));
+			Float8 tfar = Min(Min(Max(t0x, t1x), Max(t0y, t1y)), Min(Max(t0z, t1z), Float8(tmax)));
+			uint32_t validMask = 0;
+			for (uint32_t c = 0; c < WideBvh::kWidth; c++)
+			{
+				validMask |= (node.meta[c] != 0) << c;
+			}
+			uint32_t hitMask = (tnear <= tfar).GetBits() & validMask;
+			if (!hitMask)
+			{
+				continue;
+			}
+
+			alignas(32) float dist[8];
+			tnear.Store(dist);
+			StackEntry hits[WideBvh::kWidth];
+			uint32_t hitCount = 0;
+			for (; hitMask; hitMask &= hitMask - 1)
+			{
+				uint32_t c = 0;
+				while (!(hitMask & (1 << c)))
+				{
+					c++;
+				}
+				uint32_t meta = node.meta[c];
+				StackEntry h;
+				h.dist = dist[c];
+				h.item = (meta & WideBvh::kMetaInner)
+					? node.childBaseIndex + (meta & ~WideBvh::kMetaInner)
+					: kLeafFlag | ((node.primBaseIndex + (meta & 0x1f)) << 2) | (meta >> 5);
+
+				// keep hits sorted far to near.
+				uint32_t pos = hitCount++;
+				while (pos > 0 && hits[pos - 1].dist < h.dist)
+				{
+					hits[pos] = hits[pos - 1];
+					pos--;
+				}
+				hits[pos] = h;
+			}
+			for (uint32_t i = 0; i < hitCount && stackTop < WideBvh::kStackSize; i++)
+			{
+				stack[stackTop++] = hits[i];
+			}
+		}
+	}
+}
+
+//	EOF
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "cpu_wide_bvh.h"
+
+
+// 8 rays in SoA layout.
+struct alignas(32) RayPacket8
+{
+	float	ox[8], oy[8], oz[8];
+	float	dx[8], dy[8], dz[8];
+	float	tmin[8], tmax[8];
+
+	void SetRay(uint32_t lane, const CpuRay& ray)
+	{
+		ox[lane] = ray.origin.x; oy[lane] = ray.origin.y; oz[lane] = ray.origin.z;
+		dx[lane] = ray.direction.x; dy[lane] = ray.direction.y; dz[lane] = ray.direction.z;
+		tmin[lane] = ray.tmin; tmax[lane] = ray.tmax;
+	}
+};
+
+struct SimdHit
+{
+	float		t;
+	float		u, v;			// barycentrics of vertex 1 and 2.
+	uint32_t	primIndex;		// kInvalidPrim on miss.
+};
+
+struct alignas(32) PacketHit8
+{
+	float		t[8];
+	float		u[8], v[8];
+	uint32_t	primIndex[8];
+
+	SimdHit GetHit(uint32_t lane) const { return { t[lane], u[lane], v[lane], primIndex[lane] }; }
+};
+
+// triangle bvh with traversal kernels for coherent and incoherent rays.
+//   TracePacket : 8 rays together through the binary bvh.
+//                 a packet group traverses up to 64 rays together, coherent rays share more node tests.
+//   TraceStream : one ray at a time through the 8-wide bvh, 8 child boxes are tested together.
+//   TraceSingle : scalar reference.
+// all kernels use the watertight ray triangle test (Woop et al. 2013), double sided.
+class SimdTriangleBvh
+{
+public:
+	static const uint32_t kPacketSize = 8;
+	static const uint32_t kMaxGroupPackets = 8;
+	static const uint32_t kInvalidPrim = 0xffffffff;
+	static const uint32_t kStackSize = 256;
+
+public:
+	// triVertices holds 3 vertices per triangle.
+	bool Build(const std::vector<Vec3>& triVertices, const BvhBuildSettings& settings);
+
+	bool TraceSingle(const CpuRay& ray, SimdHit* pHit, BvhTraversalStats* pStats = nullptr) const;
+	// only lanes in activeMask are traced, inactive lanes return kInvalidPrim.
+	void TracePacket(const RayPacket8& packet, uint32_t activeMask, PacketHit8* pHit, BvhTraversalStats* pStats = nullptr) const;
+	// up to kMaxGroupPackets packets share one traversal, e.g. an 8x8 pixel tile of camera rays.
+	void TracePacketGroup(const RayPacket8* pPackets, const uint32_t* pActiveMasks, uint32_t packetCount, PacketHit8* pHits, BvhTraversalStats* pStats = nullptr) const;
+	void TraceStream(const CpuRay* pRays, size_t rayCount, SimdHit* pHits, BvhTraversalStats* pStats = nullptr) const;
+
+	// primIndex of a hit is the index in leaf order, this returns the original triangle index.
+	uint32_t GetTriangleIndex(uint32_t primIndex) const { return triIndices_[primIndex]; }
+	const Bvh& GetBinaryBvh() const { return binary_; }
+	const WideBvh& GetWideBvh() const { return wide_; }
+	// true when the kernels were compiled with AVX2.
+	static bool IsSimdEnabled();
+
+private:
+	Bvh						binary_;
+	WideBvh					wide_;
+	std::vector<Vec3>		vertices_;			// 3 per triangle in leaf order.
+	std::vector<uint32_t>	triIndices_;
+};	// class SimdTriangleBvh
+
+//	EOF
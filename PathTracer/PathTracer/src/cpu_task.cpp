@@ -0,0 +1,368 @@
+#include "cpu_task.h"
+#include "cpu_parallel.h"
+
+#include <algorithm>
+#include <cstdio>
+
+
+double TaskTrace::GetBusyMs() const
+{
+	double ret = 0.0;
+	for (auto&& e : events)
+	{
+		ret += e.endMs - e.beginMs;
+	}
+	return ret;
+}
+
+double TaskTrace::GetCriticalPathMs() const
+{
+	// dependencies always have smaller ids.
+	std::vector<double> pathMs(events.size(), 0.0);
+	double ret = 0.0;
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		double start = 0.0;
+		for (auto dep : events[i].dependencies)
+		{
+			start = std::max(start, pathMs[dep]);
+		}
+		pathMs[i] = start + (events[i].endMs - events[i].beginMs);
+		ret = std::max(ret, pathMs[i]);
+	}
+	return ret;
+}
+
+
+TaskScheduler::TaskScheduler()
+{}
+
+TaskScheduler::~TaskScheduler()
+{
+	Destroy();
+}
+
+void TaskScheduler::Initialize(uint32_t threadCount)
+{
+	Destroy();
+
+	threadCount = (threadCount == 0) ? GetDefaultThreadCount() : threadCount;
+	queues_.resize(threadCount);
+	bQuit_ = false;
+	workers_.reserve(threadCount - 1);
+	for (uint32_t i = 1; i < threadCount; i++)
+	{
+		workers_.emplace_back(&TaskScheduler::WorkerMain, this, i);
+	}
+}
+
+void TaskScheduler::Destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		bQuit_ = true;
+	}
+	startCv_.notify_all();
+	for (auto&& t : workers_)
+	{
+		t.join();
+	}
+	workers_.clear();
+	queues_.clear();
+	tasks_.clear();
+	bInvalidGraph_ = false;
+}
+
+TaskId TaskScheduler::AddTask(const std::string& name, std::function<bool()> func, const std::vector<TaskId>& dependencies)
+{
+	TaskId id = (TaskId)tasks_.size();
+	tasks_.emplace_back();
+	auto&& task = tasks_.back();
+	task.name = name;
+	task.func = std::move(func);
+	for (auto dep : dependencies)
+	{
+		if (dep >= id)
+		{
+			printf("Error: task depends on a later task. (%s)\n", name.c_str());
+			bInvalidGraph_ = true;
+			continue;
+		}
+		task.dependencies.push_back(dep);
+		tasks_[dep].dependents.push_back(id);
+	}
+	task.waitCount = (uint32_t)task.dependencies.size();
+	return id;
+}
+
+TaskId TaskScheduler::AddParallelTask(const std::string& name, size_t count, size_t minChunkSize, std::function<void(size_t, size_t)> func, const std::vector<TaskId>& dependencies)
+{
+	// the chunks share func, so that each task only holds a pointer.
+	auto pFunc = std::make_shared<std::function<void(size_t, size_t)>>(std::move(func));
+	uint32_t chunkCount = GetChunkCount(count, std::max(GetThreadCount(), 1u), minChunkSize);
+	size_t chunkSize = (count + chunkCount - 1) / std::max(chunkCount, 1u);
+	std::vector<TaskId> chunks;
+	for (uint32_t c = 0; c < chunkCount; c++)
+	{
+		size_t begin = std::min(count, c * chunkSize);
+		size_t end = std::min(count, begin + chunkSize);
+		chunks.push_back(AddTask(name + "[" + std::to_string(c) + "]", [pFunc, begin, end]()
+		{
+			(*pFunc)(begin, end);
+			return true;
+		}, dependencies));
+	}
+	return AddTask(name, []() { return true; }, chunks);
+}
+
+bool TaskScheduler::Run()
+{
+	if (queues_.empty())
+	{
+		Initialize();
+	}
+
+	trace_ = TaskTrace();
+	trace_.workerCount = GetThreadCount();
+	trace_.events.resize(tasks_.size());
+	for (size_t i = 0; i < tasks_.size(); i++)
+	{
+		trace_.events[i].name = tasks_[i].name;
+		trace_.events[i].dependencies = tasks_[i].dependencies;
+	}
+	if (bInvalidGraph_ || tasks_.empty())
+	{
+		bool bValid = !bInvalidGraph_;
+		tasks_.clear();
+		bInvalidGraph_ = false;
+		return bValid;
+	}
+
+	queuedCount_ = 0;
+	remainingCount_ = (uint32_t)tasks_.size();
+	stolenCount_ = 0;
+	bFailed_ = false;
+	runStart_ = std::chrono::steady_clock::now();
+
+	// tasks without dependencies are dealt to all threads.
+	uint32_t next = 0;
+	for (TaskId id = 0; id < (TaskId)tasks_.size(); id++)
+	{
+		if (tasks_[id].waitCount == 0)
+		{
+			queues_[next].tasks.push_back(id);
+			queuedCount_++;
+			next = (next + 1) % GetThreadCount();
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		activeWorkers_ = (uint32_t)workers_.size();
+		generation_++;
+	}
+	startCv_.notify_all();
+
+	WorkLoop(0);
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		doneCv_.wait(lock, [this]() { return activeWorkers_ == 0; });
+	}
+
+	trace_.stolenCount = stolenCount_;
+	trace_.wallMs = GetElapsedMs();
+	tasks_.clear();
+	return !bFailed_;
+}
+
+void TaskScheduler::WorkerMain(uint32_t workerIndex)
+{
+	uint64_t generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			startCv_.wait(lock, [&]() { return bQuit_ || generation_ != generation; });
+			if (bQuit_)
+			{
+				return;
+			}
+			generation = generation_;
+		}
+
+		WorkLoop(workerIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			activeWorkers_--;
+		}
+		doneCv_.notify_all();
+	}
+}
+
+void TaskScheduler::WorkLoop(uint32_t workerIndex)
+{
+	while (true)
+	{
+		TaskId id;
+		if (Pop(workerIndex, &id) || Steal(workerIndex, &id))
+		{
+			Execute(workerIndex, id);
+			continue;
+		}
+
+		// queued and remaining counts change before the mutex is taken for the notify, so no wake up is lost.
+		std::unique_lock<std::mutex> lock(mutex_);
+		workCv_.wait(lock, [this]() { return remainingCount_ == 0 || queuedCount_ > 0; });
+		if (remainingCount_ == 0)
+		{
+			return;
+		}
+	}
+}
+
+void TaskScheduler::Push(uint32_t workerIndex, TaskId id)
+{
+	{
+		auto&& queue = queues_[workerIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_front(id);
+	}
+	queuedCount_++;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+	}
+	workCv_.notify_all();
+}
+
+bool TaskScheduler::Pop(uint32_t workerIndex, TaskId* pId)
+{
+	auto&& queue = queues_[workerIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty())
+	{
+		return false;
+	}
+	*pId = queue.tasks.front();
+	queue.tasks.pop_front();
+	queuedCount_--;
+	return true;
+}
+
+bool TaskScheduler::Steal(uint32_t workerIndex, TaskId* pId)
+{
+	uint32_t threadCount = GetThreadCount();
+	for (uint32_t i = 1; i < threadCount; i++)
+	{
+		auto&& queue = queues_[(workerIndex + i) % threadCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty())
+		{
+			*pId = queue.tasks.back();
+			queue.tasks.pop_back();
+			queuedCount_--;
+			stolenCount_++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void TaskScheduler::Execute(uint32_t workerIndex, TaskId id)
+{
+	auto&& task = tasks_[id];
+	auto&& event = trace_.events[id];
+	event.workerIndex = workerIndex;
+	event.beginMs = GetElapsedMs();
+	bool bSucceeded = false;
+	if (!task.bSkipped)
+	{
+		bSucceeded = task.func();
+		event.state = bSucceeded ? TaskState::Succeeded : TaskState::Failed;
+		if (!bSucceeded)
+		{
+			bFailed_ = true;
+		}
+	}
+	event.endMs = GetElapsedMs();
+
+	for (auto dep : task.dependents)
+	{
+		auto&& dependent = tasks_[dep];
+		if (!bSucceeded)
+		{
+			dependent.bSkipped = true;
+		}
+		if (--dependent.waitCount == 0)
+		{
+			Push(workerIndex, dep);
+		}
+	}
+
+	if (--remainingCount_ == 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+		}
+		workCv_.notify_all();
+	}
+}
+
+double TaskScheduler::GetElapsedMs() const
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - runStart_).count();
+}
+
+
+void PrintTaskTrace(const TaskTrace& trace, const char* title)
+{
+	static const char* kStateNames[] = { "", " (failed)", " (skipped)" };
+
+	std::vector<size_t> order(trace.events.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return trace.events[a].beginMs < trace.events[b].beginMs; });
+
+	printf("%s: %zu tasks, %u threads, wall %.2f ms, busy %.2f ms, critical path %.2f ms, stolen %u\n",
+		title, trace.events.size(), trace.workerCount, trace.wallMs, trace.GetBusyMs(), trace.GetCriticalPathMs(), trace.stolenCount);
+	for (auto i : order)
+	{
+		auto&& e = trace.events[i];
+		printf("  [%2u] %9.2f ms +%9.2f ms  %s%s\n", e.workerIndex, e.beginMs, e.endMs - e.beginMs, e.name.c_str(), kStateNames[(int)e.state]);
+	}
+}
+
+bool WriteTaskTraceJson(const TaskTrace& trace, const std::string& filePath)
+{
+	FILE* fp = fopen(filePath.c_str(), "wb");
+	if (!fp)
+	{
+		printf("Error: failed to open trace file. (%s)\n", filePath.c_str());
+		return false;
+	}
+
+	fprintf(fp, "{\"traceEvents\":[\n");
+	for (size_t i = 0; i < trace.events.size(); i++)
+	{
+		auto&& e = trace.events[i];
+		// names are task names from the code, only quotes and backslashes need escaping.
+		std::string name;
+		for (char c : e.name)
+		{
+			if (c == '"' || c == '\\')
+			{
+				name.push_back('\\');
+			}
+			name.push_back(c);
+		}
+		fprintf(fp, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+			name.c_str(), e.workerIndex, e.beginMs * 1000.0, (e.endMs - e.beginMs) * 1000.0, (i + 1 < trace.events.size()) ? "," : "");
+	}
+	fprintf(fp, "]}\n");
+	fclose(fp);
+	return true;
+}
+
+//	EOF
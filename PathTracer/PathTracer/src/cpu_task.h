@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+typedef uint32_t TaskId;
+
+enum class TaskState
+{
+	Succeeded,
+	Failed,
+	Skipped,		// a dependency failed, the task did not run.
+};
+
+struct TaskTraceEvent
+{
+	std::string				name;
+	std::vector<TaskId>		dependencies;
+	uint32_t				workerIndex = 0;
+	double					beginMs = 0.0;		// from the start of TaskScheduler::Run().
+	double					endMs = 0.0;
+	TaskState				state = TaskState::Skipped;
+};
+
+// timings of the last TaskScheduler::Run(), events are indexed by TaskId.
+struct TaskTrace
+{
+	std::vector<TaskTraceEvent>	events;
+	uint32_t	workerCount = 0;
+	uint32_t	stolenCount = 0;
+	double		wallMs = 0.0;
+
+	// sum of the task times.
+	double GetBusyMs() const;
+	// longest chain of task times through the dependencies, the lower bound of wallMs.
+	double GetCriticalPathMs() const;
+};
+
+// tasks with dependencies on a fixed pool of threads.
+//   tasks are added first, Run() executes all of them and clears the list.
+//   each thread pops ready tasks from the front of its own queue and steals from the back of the others.
+//   a finished task pushes the dependents it released to the queue of its thread.
+class TaskScheduler
+{
+public:
+	TaskScheduler();
+	~TaskScheduler();
+
+	// threadCount includes the thread calling Run(), 0 uses GetDefaultThreadCount().
+	void Initialize(uint32_t threadCount = 0);
+	void Destroy();
+
+	// func returns false on failure, the tasks depending on it are skipped.
+	// dependencies are tasks added before this one.
+	TaskId AddTask(const std::string& name, std::function<bool()> func, const std::vector<TaskId>& dependencies = {});
+	// one task per chunk of [0, count) with at least minChunkSize items, func(begin, end) for each.
+	// returns a task which finishes after all chunks.
+	TaskId AddParallelTask(const std::string& name, size_t count, size_t minChunkSize, std::function<void(size_t, size_t)> func, const std::vector<TaskId>& dependencies = {});
+
+	// runs the added tasks to the end, the calling thread is worker 0.
+	// returns false if a task failed.
+	bool Run();
+
+	uint32_t GetThreadCount() const { return (uint32_t)queues_.size(); }
+	const TaskTrace& GetTrace() const { return trace_; }
+
+private:
+	struct Task
+	{
+		std::string				name;
+		std::function<bool()>	func;
+		std::vector<TaskId>		dependencies;
+		std::vector<TaskId>		dependents;
+		std::atomic<uint32_t>	waitCount{ 0 };
+		std::atomic<bool>		bSkipped{ false };
+	};
+
+	struct TaskQueue
+	{
+		std::mutex			mutex;
+		std::deque<TaskId>	tasks;
+	};
+
+	void WorkerMain(uint32_t workerIndex);
+	void WorkLoop(uint32_t workerIndex);
+	void Push(uint32_t workerIndex, TaskId id);
+	bool Pop(uint32_t workerIndex, TaskId* pId);
+	bool Steal(uint32_t workerIndex, TaskId* pId);
+	void Execute(uint32_t workerIndex, TaskId id);
+	double GetElapsedMs() const;
+
+private:
+	std::deque<Task>			tasks_;
+	std::deque<TaskQueue>		queues_;
+	std::vector<std::thread>	workers_;
+	bool						bInvalidGraph_ = false;
+
+	std::mutex					mutex_;
+	std::condition_variable		startCv_;		// a new Run() or Destroy().
+	std::condition_variable		workCv_;		// a task was queued or the last one finished.
+	std::condition_variable		doneCv_;		// a worker left Run().
+	uint64_t					generation_ = 0;
+	uint32_t					activeWorkers_ = 0;
+	bool						bQuit_ = false;
+
+	std::atomic<uint32_t>		queuedCount_{ 0 };
+	std::atomic<uint32_t>		remainingCount_{ 0 };
+	std::atomic<uint32_t>		stolenCount_{ 0 };
+	std::atomic<bool>			bFailed_{ false };
+	std::chrono::steady_clock::time_point	runStart_;
+
+	TaskTrace					trace_;
+};	// class TaskScheduler
+
+// one line per task in start order, and the wall, busy and critical path times.
+void PrintTaskTrace(const TaskTrace& trace, const char* title);
+// chrome://tracing and Perfetto json, one row per worker.
+bool WriteTaskTraceJson(const TaskTrace& trace, const std::string& filePath);
+
+//	EOF
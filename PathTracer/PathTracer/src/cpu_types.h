@@ -0,0 +1,45 @@
+#pragma once
+
+// minimal type layer for the cpu side code.
+// on windows the real DirectXMath types are used, elsewhere layout compatible
+// stand-ins are declared so that "cbuffer.hlsli" can be shared with USE_IN_CPP.
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#	include <DirectXMath.h>
+#else
+typedef unsigned int	UINT;
+
+namespace DirectX
+{
+	struct XMFLOAT2
+	{
+		float x, y;
+		XMFLOAT2() = default;
+		constexpr XMFLOAT2(float _x, float _y) : x(_x), y(_y) {}
+	};
+	struct XMFLOAT3
+	{
+		float x, y, z;
+		XMFLOAT3() = default;
+		constexpr XMFLOAT3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+	};
+	struct XMFLOAT4
+	{
+		float x, y, z, w;
+		XMFLOAT4() = default;
+		constexpr XMFLOAT4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+	};
+	struct XMFLOAT4X4
+	{
+		float m[4][4];
+	};
+}	// namespace DirectX
+#endif
+
+//	EOF
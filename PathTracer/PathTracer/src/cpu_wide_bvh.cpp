@@ -0,0 +1,210 @@
+#include "cpu_wide_bvh.h"
+
+#include <deque>
+
+
+namespace
+{
+	static const uint32_t kInvalidNode = 0xffffffff;
+
+	// a subtree of the binary bvh, or a primitive range of an oversized binary leaf.
+	struct Cluster
+	{
+		Aabb		bounds;
+		uint32_t	node;			// kInvalidNode for a primitive range.
+		uint32_t	primBegin;
+		uint32_t	primCount;
+	};
+
+	struct PendingNode
+	{
+		uint32_t	wideIndex;
+		Cluster		cluster;
+	};
+
+	// smallest exponent that covers the extent with 255 steps.
+	int8_t ComputeExponent(float extent)
+	{
+		if (extent <= 0.0f)
+		{
+			return -126;
+		}
+		int e = (int)std::ceil(std::log2(extent / 255.0f));
+		e = std::min(std::max(e, -126), 127);
+		while (e < 127 && std::ldexp(255.0f, e) < extent)
+		{
+			e++;
+		}
+		return (int8_t)e;
+	}
+}
+
+bool WideBvh::Build(const Bvh& binary, const std::vector<Aabb>& primBounds)
+{
+	nodes_.clear();
+	primIndices_.clear();
+
+	auto&& bnodes = binary.GetNodes();
+	auto&& bprims = binary.GetPrimIndices();
+	if (bnodes.empty())
+	{
+		return false;
+	}
+
+	auto IsLeafCluster = [&](const Cluster& c)
+	{
+		if (c.node != kInvalidNode)
+		{
+			return bnodes[c.node].IsLeaf() && bnodes[c.node].primCount <= kMaxLeafSize;
+		}
+		return c.primCount <= kMaxLeafSize;
+	};
+	auto MakeNodeCluster = [&](uint32_t nodeIndex)
+	{
+		auto&& n = bnodes[nodeIndex];
+		Cluster c;
+		c.bounds = n.GetAabb();
+		c.node = nodeIndex;
+		c.primBegin = n.IsLeaf() ? n.leftFirst : 0;
+		c.primCount = n.IsLeaf() ? n.primCount : 0;
+		return c;
+	};
+	auto MakeRangeCluster = [&](uint32_t begin, uint32_t count)
+	{
+		Cluster c;
+		c.node = kInvalidNode;
+		c.primBegin = begin;
+		c.primCount = count;
+		for (uint32_t i = begin; i < begin + count; i++)
+		{
+			c.bounds.Grow(primBounds[bprims[i]]);
+		}
+		return c;
+	};
+	auto Expand = [&](const Cluster& c, Cluster* pOut)
+	{
+		if (c.node != kInvalidNode && !bnodes[c.node].IsLeaf())
+		{
+			pOut[0] = MakeNodeCluster(bnodes[c.node].leftFirst);
+			pOut[1] = MakeNodeCluster(bnodes[c.node].leftFirst + 1);
+		}
+		else
+		{
+			uint32_t half = c.primCount / 2;
+			pOut[0] = MakeRangeCluster(c.primBegin, half);
+			pOut[1] = MakeRangeCluster(c.primBegin + half, c.primCount - half);
+		}
+	};
+
+	nodes_.reserve(bnodes.size() / 4 + 1);
+	primIndices_.reserve(bprims.size());
+	nodes_.push_back(WideBvhNode());
+	std::deque<PendingNode> queue;
+	queue.push_back({ 0, MakeNodeCluster(0) });
+	while (!queue.empty())
+	{
+		PendingNode pending = queue.front();
+		queue.pop_front();
+
+		// open the largest children until the node is full.
+		std::vector<Cluster> children;
+		children.reserve(kWidth + 1);
+		if (IsLeafCluster(pending.cluster))
+		{
+			children.push_back(pending.cluster);
+		}
+		else
+		{
+			Cluster c[2];
+			Expand(pending.cluster, c);
+			children.push_back(c[0]);
+			children.push_back(c[1]);
+		}
+		while (children.size() < kWidth)
+		{
+			int best = -1;
+			float bestArea = -1.0f;
+			for (int i = 0; i < (int)children.size(); i++)
+			{
+				if (!IsLeafCluster(children[i]) && children[i].bounds.SurfaceArea() > bestArea)
+				{
+					best = i;
+					bestArea = children[i].bounds.SurfaceArea();
+				}
+			}
+			if (best < 0)
+			{
+				break;
+			}
+			Cluster c[2];
+			Expand(children[best], c);
+			children[best] = c[0];
+			children.push_back(c[1]);
+		}
+
+		// quantize children in the parent frame.
+		Aabb bounds;
+		for (auto&& child : children)
+		{
+			bounds.Grow(child.bounds);
+		}
+		WideBvhNode node;
+		memset(&node, 0, sizeof(node));
+		float scale[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			node.origin[axis] = bounds.bmin[axis];
+			node.exponent[axis] = ComputeExponent(bounds.bmax[axis] - bounds.bmin[axis]);
+			scale[axis] = node.GetScale(axis);
+		}
+		node.childBaseIndex = (uint32_t)nodes_.size();
+		node.primBaseIndex = (uint32_t)primIndices_.size();
+
+		uint32_t innerRank = 0;
+		for (uint32_t c = 0; c < (uint32_t)children.size(); c++)
+		{
+			auto&& child = children[c];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float lo = (child.bounds.bmin[axis] - node.origin[axis]) / scale[axis];
+				float hi = (child.bounds.bmax[axis] - node.origin[axis]) / scale[axis];
+				int qlo = std::min(std::max((int)std::floor(lo), 0), 255);
+				int qhi = std::min(std::max((int)std::ceil(hi), 0), 255);
+				// make sure the decoded box is conservative after rounding.
+				while (qlo > 0 && node.origin[axis] + (float)qlo * scale[axis] > child.bounds.bmin[axis])
+				{
+					qlo--;
+				}
+				while (qhi < 255 && node.origin[axis] + (float)qhi * scale[axis] < child.bounds.bmax[axis])
+				{
+					qhi++;
+				}
+				node.qlo[axis][c] = (uint8_t)qlo;
+				node.qhi[axis][c] = (uint8_t)qhi;
+			}
+
+			if (IsLeafCluster(child))
+			{
+				node.meta[c] = (uint8_t)((child.primCount << 5) | ((uint32_t)primIndices_.size() - node.primBaseIndex));
+				for (uint32_t i = child.primBegin; i < child.primBegin + child.primCount; i++)
+				{
+					primIndices_.push_back(bprims[i]);
+				}
+			}
+			else
+			{
+				node.meta[c] = (uint8_t)(kMetaInner | innerRank);
+				node.innerMask |= (uint8_t)(1 << c);
+				queue.push_back({ node.childBaseIndex + innerRank, child });
+				innerRank++;
+			}
+		}
+
+		// inner children are allocated contiguously.
+		nodes_.resize(nodes_.size() + innerRank);
+		nodes_[pending.wideIndex] = node;
+	}
+	return true;
+}
+
+//	EOF
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "cpu_bvh.h"
+
+
+// 8-wide compressed bvh node, 80 bytes.
+// child bounds are quantized to 8 bits in the frame of the parent:
+//   bmin = origin + qlo * 2^exponent, bmax = origin + qhi * 2^exponent.
+// meta per child:
+//   0            : empty slot.
+//   0x80 | rank  : inner node, nodes[childBaseIndex + rank].
+//   count << 5 | offset : leaf, primIndices[primBaseIndex + offset] x count (1-3).
+struct WideBvhNode
+{
+	float		origin[3];
+	int8_t		exponent[3];
+	uint8_t		innerMask;
+	uint32_t	childBaseIndex;
+	uint32_t	primBaseIndex;
+	uint8_t		meta[8];
+	uint8_t		qlo[3][8];
+	uint8_t		qhi[3][8];
+
+	bool IsInner(uint32_t child) const { return (innerMask & (1 << child)) != 0; }
+	float GetScale(int axis) const
+	{
+		uint32_t bits = (uint32_t)(exponent[axis] + 127) << 23;
+		float ret;
+		memcpy(&ret, &bits, sizeof(ret));
+		return ret;
+	}
+	Aabb GetChildAabb(uint32_t child) const
+	{
+		Aabb ret;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float scale = GetScale(axis);
+			ret.bmin[axis] = origin[axis] + (float)qlo[axis][child] * scale;
+			ret.bmax[axis] = origin[axis] + (float)qhi[axis][child] * scale;
+		}
+		return ret;
+	}
+};
+static_assert(sizeof(WideBvhNode) == 80, "WideBvhNode must be 80 bytes.");
+
+class WideBvh
+{
+public:
+	static const uint32_t kWidth = 8;
+	static const uint32_t kMaxLeafSize = 3;
+	static const uint32_t kMetaInner = 0x80;
+	static const uint32_t kStackSize = 1024;
+
+public:
+	// collapse a binary bvh. primBounds are the bounds used to build it,
+	// binary leaves with more than kMaxLeafSize primitives are split by them.
+	bool Build(const Bvh& binary, const std::vector<Aabb>& primBounds);
+
+	const std::vector<WideBvhNode>& GetNodes() const { return nodes_; }
+	const std::vector<uint32_t>& GetPrimIndices() const { return primIndices_; }
+	bool IsEmpty() const { return nodes_.empty(); }
+
+	// same interface as Bvh::Traverse().
+	template <typename IntersectFunc>
+	void Traverse(CpuRay& ray, IntersectFunc&& func, BvhTraversalStats* pStats = nullptr) const;
+
+private:
+	std::vector<WideBvhNode>	nodes_;
+	std::vector<uint32_t>		primIndices_;
+};	// class WideBvh
+
+template <typename IntersectFunc>
+void WideBvh::Traverse(CpuRay& ray, IntersectFunc&& func, BvhTraversalStats* pStats) const
+{
+	if (nodes_.empty())
+	{
+		return;
+	}
+
+	// leaf entries: kLeafFlag | primStart << 2 | count.
+	static const uint32_t kLeafFlag = 0x80000000;
+	struct StackEntry
+	{
+		uint32_t	item;
+		float		dist;
+	};
+
+	CpuRayInv rayInv(ray);
+	StackEntry stack[kStackSize];
+	uint32_t stackTop = 0;
+	stack[stackTop++] = { 0, ray.tmin };
+	while (stackTop > 0)
+	{
+		StackEntry entry = stack[--stackTop];
+		if (entry.dist > ray.tmax)
+		{
+			continue;
+		}
+
+		if (entry.item & kLeafFlag)
+		{
+			uint32_t start = (entry.item & ~kLeafFlag) >> 2;
+			uint32_t count = entry.item & 0x3;
+			if (pStats)
+			{
+				pStats->primTests += count;
+			}
+			for (uint32_t i = 0; i < count; i++)
+			{
+				if (!func(primIndices_[start + i], ray))
+				{
+					// terminated by the callback.
+					return;
+				}
+			}
+			continue;
+		}
+
+		const WideBvhNode& node = nodes_[entry.item];
+		if (pStats)
+		{
+			pStats->nodeVisits++;
+			pStats->cacheLines += CountCacheLines(entry.item * sizeof(WideBvhNode), sizeof(WideBvhNode));
+		}
+
+		float scale[3] = { node.GetScale(0), node.GetScale(1), node.GetScale(2) };
+		StackEntry hits[kWidth];
+		uint32_t hitCount = 0;
+		for (uint32_t c = 0; c < kWidth; c++)
+		{
+			uint32_t meta = node.meta[c];
+			if (!meta)
+			{
+				continue;
+			}
+			float bmin[3], bmax[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				bmin[axis] = node.origin[axis] + (float)node.qlo[axis][c] * scale[axis];
+				bmax[axis] = node.origin[axis] + (float)node.qhi[axis][c] * scale[axis];
+			}
+			float dist;
+			if (!IntersectAabb(rayInv, bmin, bmax, ray.tmin, ray.tmax, &dist))
+			{
+				continue;
+			}
+
+			StackEntry hit;
+			hit.dist = dist;
+			hit.item = (meta & kMetaInner)
+				? node.childBaseIndex + (meta & ~kMetaInner)
+				: kLeafFlag | ((node.primBaseIndex + (meta & 0x1f)) << 2) | (meta >> 5);
+
+			// keep hits sorted far to near.
+			uint32_t pos = hitCount++;
+			while (pos > 0 && hits[pos - 1].dist < dist)
+			{
+				hits[pos] = hits[pos - 1];
+				pos--;
+			}
+			hits[pos] = hit;
+		}
+
+		// nearest child is popped first.
+		for (uint32_t i = 0; i < hitCount && stackTop < kStackSize; i++)
+		{
+			stack[stackTop++] = hits[i];
+		}
+	}
+}
+
+//	EOF
@@ -0,0 +1,348 @@
+#include "dds_reader.h"
+
+#include <cstdio>
+#include <fstream>
+
+
+namespace
+{
+	static const uint32_t kDDSMagic = 0x20534444;		// "DDS "
+	static const uint32_t kFourCC_DXT1 = 0x31545844;	// "DXT1"
+	static const uint32_t kFourCC_DXT5 = 0x35545844;	// "DXT5"
+	static const uint32_t kFourCC_DX10 = 0x30315844;	// "DX10"
+	static const uint32_t kDDPF_FourCC = 0x4;
+	static const uint32_t kDDPF_RGB = 0x40;
+
+	// DXGI_FORMAT values.
+	static const uint32_t kDxgiR8G8B8A8Unorm = 28;
+	static const uint32_t kDxgiR8G8B8A8UnormSRGB = 29;
+	static const uint32_t kDxgiBC1Unorm = 71;
+	static const uint32_t kDxgiBC1UnormSRGB = 72;
+	static const uint32_t kDxgiBC3Unorm = 77;
+	static const uint32_t kDxgiBC3UnormSRGB = 78;
+
+	struct DDSPixelFormat
+	{
+		uint32_t	size;
+		uint32_t	flags;
+		uint32_t	fourCC;
+		uint32_t	rgbBitCount;
+		uint32_t	rBitMask, gBitMask, bBitMask, aBitMask;
+	};
+
+	struct DDSHeader
+	{
+		uint32_t		size;
+		uint32_t		flags;
+		uint32_t		height;
+		uint32_t		width;
+		uint32_t		pitchOrLinearSize;
+		uint32_t		depth;
+		uint32_t		mipMapCount;
+		uint32_t		reserved1[11];
+		DDSPixelFormat	ddspf;
+		uint32_t		caps, caps2, caps3, caps4;
+		uint32_t		reserved2;
+	};
+
+	struct DDSHeaderDX10
+	{
+		uint32_t	dxgiFormat;
+		uint32_t	resourceDimension;
+		uint32_t	miscFlag;
+		uint32_t	arraySize;
+		uint32_t	miscFlags2;
+	};
+
+	enum class Format
+	{
+		Unknown,
+		BC1,
+		BC3,
+		RGBA8,
+	};
+
+	void Decode565(uint16_t c, uint8_t out[3])
+	{
+		uint32_t r = (c >> 11) & 0x1f;
+		uint32_t g = (c >> 5) & 0x3f;
+		uint32_t b = c & 0x1f;
+		out[0] = (uint8_t)((r << 3) | (r >> 2));
+		out[1] = (uint8_t)((g << 2) | (g >> 4));
+		out[2] = (uint8_t)((b << 3) | (b >> 2));
+	}
+
+	// the color block of BC3 is always in 4 color mode.
+	void DecodeBC1Block(const uint8_t* pBlock, uint8_t outRGBA[16][4], bool bFourColor = false)
+	{
+		uint16_t c0 = (uint16_t)(pBlock[0] | (pBlock[1] << 8));
+		uint16_t c1 = (uint16_t)(pBlock[2] | (pBlock[3] << 8));
+		uint32_t bits = pBlock[4] | (pBlock[5] << 8) | (pBlock[6] << 16) | ((uint32_t)pBlock[7] << 24);
+
+		uint8_t palette[4][4];
+		Decode565(c0, palette[0]);
+		Decode565(c1, palette[1]);
+		palette[0][3] = palette[1][3] = 255;
+		if (c0 > c1 || bFourColor)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				palette[2][i] = (uint8_t)((2 * palette[0][i] + palette[1][i] + 1) / 3);
+				palette[3][i] = (uint8_t)((palette[0][i] + 2 * palette[1][i] + 1) / 3);
+			}
+			palette[2][3] = palette[3][3] = 255;
+		}
+		else
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				palette[2][i] = (uint8_t)((palette[0][i] + palette[1][i]) / 2);
+				palette[3][i] = 0;
+			}
+			palette[2][3] = 255;
+			palette[3][3] = 0;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			memcpy(outRGBA[i], palette[(bits >> (i * 2)) & 0x3], 4);
+		}
+	}
+
+	// BC1 color block after an interpolated alpha block.
+	void DecodeBC3Block(const uint8_t* pBlock, uint8_t outRGBA[16][4])
+	{
+		DecodeBC1Block(pBlock + 8, outRGBA, true);
+
+		uint32_t a0 = pBlock[0], a1 = pBlock[1];
+		uint8_t palette[8] = { (uint8_t)a0, (uint8_t)a1 };
+		if (a0 > a1)
+		{
+			for (uint32_t i = 1; i < 7; i++)
+			{
+				palette[i + 1] = (uint8_t)(((7 - i) * a0 + i * a1 + 3) / 7);
+			}
+		}
+		else
+		{
+			for (uint32_t i = 1; i < 5; i++)
+			{
+				palette[i + 1] = (uint8_t)(((5 - i) * a0 + i * a1 + 2) / 5);
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; i++)
+		{
+			bits |= (uint64_t)pBlock[2 + i] << (i * 8);
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			outRGBA[i][3] = palette[(bits >> (i * 3)) & 0x7];
+		}
+	}
+
+	float SRGBToLinear(uint8_t v)
+	{
+		float c = (float)v / 255.0f;
+		return (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	struct SRGBTable
+	{
+		float	values[256];
+
+		SRGBTable()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				values[i] = SRGBToLinear((uint8_t)i);
+			}
+		}
+	};
+	static const SRGBTable kSRGBTable;
+}
+
+bool CpuTexture::LoadDDS(const std::string& filePath)
+{
+	std::ifstream ifs(filePath, std::ios::in | std::ios::binary);
+	if (!ifs)
+	{
+		printf("Error: failed to open texture file. (%s)\n", filePath.c_str());
+		return false;
+	}
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+	size_t pos = 0;
+	uint32_t magic;
+	DDSHeader header;
+	if (data.size() < sizeof(magic) + sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&magic, data.data(), sizeof(magic));
+	memcpy(&header, data.data() + sizeof(magic), sizeof(header));
+	pos = sizeof(magic) + sizeof(header);
+	if (magic != kDDSMagic)
+	{
+		printf("Error: not a dds file. (%s)\n", filePath.c_str());
+		return false;
+	}
+
+	Format format = Format::Unknown;
+	bSRGB_ = false;
+	if (header.ddspf.flags & kDDPF_FourCC)
+	{
+		if (header.ddspf.fourCC == kFourCC_DX10)
+		{
+			DDSHeaderDX10 dx10;
+			if (data.size() < pos + sizeof(dx10))
+			{
+				return false;
+			}
+			memcpy(&dx10, data.data() + pos, sizeof(dx10));
+			pos += sizeof(dx10);
+
+			switch (dx10.dxgiFormat)
+			{
+			case kDxgiBC1UnormSRGB: bSRGB_ = true;	// fall through.
+			case kDxgiBC1Unorm: format = Format::BC1; break;
+			case kDxgiBC3UnormSRGB: bSRGB_ = true;	// fall through.
+			case kDxgiBC3Unorm: format = Format::BC3; break;
+			case kDxgiR8G8B8A8UnormSRGB: bSRGB_ = true;	// fall through.
+			case kDxgiR8G8B8A8Unorm: format = Format::RGBA8; break;
+			}
+		}
+		else if (header.ddspf.fourCC == kFourCC_DXT1)
+		{
+			format = Format::BC1;
+		}
+		else if (header.ddspf.fourCC == kFourCC_DXT5)
+		{
+			format = Format::BC3;
+		}
+	}
+	else if ((header.ddspf.flags & kDDPF_RGB) && header.ddspf.rgbBitCount == 32 && header.ddspf.rBitMask == 0x000000ff)
+	{
+		format = Format::RGBA8;
+	}
+	if (format == Format::Unknown)
+	{
+		printf("Error: unsupported dds format. (%s)\n", filePath.c_str());
+		return false;
+	}
+
+	uint32_t mipCount = std::max(header.mipMapCount, 1u);
+	mips_.clear();
+	mips_.reserve(mipCount);
+	uint32_t width = header.width, height = header.height;
+	for (uint32_t m = 0; m < mipCount; m++)
+	{
+		Mip mip;
+		mip.width = width;
+		mip.height = height;
+		mip.texels.resize((size_t)width * height * 4);
+
+		if (format == Format::BC1 || format == Format::BC3)
+		{
+			uint32_t blockSize = (format == Format::BC1) ? 8 : 16;
+			uint32_t bw = (width + 3) / 4, bh = (height + 3) / 4;
+			size_t size = (size_t)bw * bh * blockSize;
+			if (data.size() < pos + size)
+			{
+				break;
+			}
+			const uint8_t* pBlock = data.data() + pos;
+			for (uint32_t by = 0; by < bh; by++)
+			{
+				for (uint32_t bx = 0; bx < bw; bx++, pBlock += blockSize)
+				{
+					uint8_t rgba[16][4];
+					if (format == Format::BC1)
+					{
+						DecodeBC1Block(pBlock, rgba);
+					}
+					else
+					{
+						DecodeBC3Block(pBlock, rgba);
+					}
+					for (uint32_t i = 0; i < 16; i++)
+					{
+						uint32_t x = bx * 4 + (i & 3), y = by * 4 + (i >> 2);
+						if (x < width && y < height)
+						{
+							memcpy(&mip.texels[((size_t)y * width + x) * 4], rgba[i], 4);
+						}
+					}
+				}
+			}
+			pos += size;
+		}
+		else
+		{
+			size_t size = (size_t)width * height * 4;
+			if (data.size() < pos + size)
+			{
+				break;
+			}
+			memcpy(mip.texels.data(), data.data() + pos, size);
+			pos += size;
+		}
+
+		mips_.push_back(std::move(mip));
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+
+	return !mips_.empty();
+}
+
+void CpuTexture::InitializeConstant(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+	Mip mip;
+	mip.width = mip.height = 1;
+	mip.texels = { r, g, b, a };
+	mips_.clear();
+	mips_.push_back(mip);
+	bSRGB_ = false;
+}
+
+Vec4 CpuTexture::Load(uint32_t x, uint32_t y, uint32_t mip) const
+{
+	auto&& m = mips_[std::min(mip, (uint32_t)mips_.size() - 1)];
+	const uint8_t* t = &m.texels[((size_t)y * m.width + x) * 4];
+	if (bSRGB_)
+	{
+		return Vec4(kSRGBTable.values[t[0]], kSRGBTable.values[t[1]], kSRGBTable.values[t[2]], (float)t[3] / 255.0f);
+	}
+	return Vec4((float)t[0] / 255.0f, (float)t[1] / 255.0f, (float)t[2] / 255.0f, (float)t[3] / 255.0f);
+}
+
+Vec4 CpuTexture::SampleLevel(const Vec2& uv, uint32_t mip) const
+{
+	mip = std::min(mip, (uint32_t)mips_.size() - 1);
+	auto&& m = mips_[mip];
+
+	float fx = uv.x * (float)m.width - 0.5f;
+	float fy = uv.y * (float)m.height - 0.5f;
+	float flx = std::floor(fx), fly = std::floor(fy);
+	float tx = fx - flx, ty = fy - fly;
+
+	auto Wrap = [](int v, uint32_t size)
+	{
+		int r = v % (int)size;
+		return (uint32_t)(r < 0 ? r + (int)size : r);
+	};
+	uint32_t x0 = Wrap((int)flx, m.width), x1 = Wrap((int)flx + 1, m.width);
+	uint32_t y0 = Wrap((int)fly, m.height), y1 = Wrap((int)fly + 1, m.height);
+
+	Vec4 t00 = Load(x0, y0, mip), t10 = Load(x1, y0, mip);
+	Vec4 t01 = Load(x0, y1, mip), t11 = Load(x1, y1, mip);
+	Vec4 top = t00 * (1.0f - tx) + t10 * tx;
+	Vec4 bottom = t01 * (1.0f - tx) + t11 * tx;
+	return top * (1.0f - ty) + bottom * ty;
+}
+
+//	EOF
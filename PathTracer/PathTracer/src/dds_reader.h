@@ -0,0 +1,42 @@
+#pragma once
+
+#include "cpu_math.h"
+
+#include <string>
+#include <vector>
+
+
+// decoded rgba8 texture with its mip chain.
+// supports the formats used by the bundled assets (BC1/DXT1, BC3/DXT5 and RGBA8).
+class CpuTexture
+{
+public:
+	struct Mip
+	{
+		uint32_t				width;
+		uint32_t				height;
+		std::vector<uint8_t>	texels;		// rgba8
+	};
+
+public:
+	bool LoadDDS(const std::string& filePath);
+	// 1x1 texture with a constant color, like sl12::DummyTex.
+	void InitializeConstant(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+	uint32_t GetWidth() const { return mips_.empty() ? 0 : mips_[0].width; }
+	uint32_t GetHeight() const { return mips_.empty() ? 0 : mips_[0].height; }
+	bool IsSRGB() const { return bSRGB_; }
+	const std::vector<Mip>& GetMips() const { return mips_; }
+
+	// texel fetch in linear space.
+	Vec4 Load(uint32_t x, uint32_t y, uint32_t mip) const;
+	// bilinear filtered, wrap addressing.
+	// same result as Texture2D::SampleLevel() with a MIN_MAG_MIP_LINEAR sampler.
+	Vec4 SampleLevel(const Vec2& uv, uint32_t mip) const;
+
+private:
+	std::vector<Mip>	mips_;
+	bool				bSRGB_ = false;
+};	// class CpuTexture
+
+//	EOF
@@ -0,0 +1,333 @@
+#include "denoiser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+
+const char* GetDenoiserDeviceTypeName(DenoiserDeviceType type)
+{
+	switch (type)
+	{
+	case DenoiserDeviceType::CPU: return "cpu";
+	case DenoiserDeviceType::SYCL: return "sycl";
+	case DenoiserDeviceType::CUDA: return "cuda";
+	case DenoiserDeviceType::HIP: return "hip";
+	case DenoiserDeviceType::Metal: return "metal";
+	default: return "default";
+	}
+}
+
+const char* GetDenoiseQualityName(DenoiseQuality quality)
+{
+	switch (quality)
+	{
+	case DenoiseQuality::Balanced: return "balanced";
+	case DenoiseQuality::High: return "high";
+	default: return "default";
+	}
+}
+
+int SelectDenoiserDevice(const std::vector<DenoiserDeviceType>& physicalDevices, DenoiserDeviceType preferred)
+{
+	int cpu = -1;
+	for (size_t i = 0; i < physicalDevices.size(); i++)
+	{
+		if (physicalDevices[i] == preferred)
+		{
+			return (int)i;
+		}
+		if (physicalDevices[i] == DenoiserDeviceType::CPU && cpu < 0)
+		{
+			cpu = (int)i;
+		}
+	}
+	return cpu;
+}
+
+#if ENABLE_OIDN
+
+namespace
+{
+	void SetAovImage(oidn::FilterRef& filter, const char* name, const oidn::BufferRef& buffer, const DenoiseFilterKey& key, AovImage image)
+	{
+		auto desc = GetAovImageDesc(key.layout, image);
+		filter.setImage(name, buffer, desc.bHalf ? oidn::Format::Half3 : oidn::Format::Float3, key.width, key.height, desc.byteOffset, desc.pixelStride);
+	}
+}
+
+bool Denoiser::Initialize(DenoiserDeviceType preferred)
+{
+	Destroy();
+
+	std::vector<DenoiserDeviceType> types;
+	int count = oidn::getNumPhysicalDevices();
+	for (int i = 0; i < count; i++)
+	{
+		types.push_back((DenoiserDeviceType)oidn::PhysicalDeviceRef(i).get<oidn::DeviceType>("type"));
+	}
+	int index = SelectDenoiserDevice(types, preferred);
+	if (index < 0)
+	{
+		printf("Error: no oidn device. (%d physical devices)\n", count);
+		return false;
+	}
+
+	device_ = oidn::PhysicalDeviceRef(index).newDevice();
+	device_.commit();
+	if (!CheckError("device"))
+	{
+		device_ = oidn::DeviceRef();
+		return false;
+	}
+	deviceType_ = types[index];
+	return true;
+}
+
+void Denoiser::Destroy()
+{
+	ClearFilters();
+	device_ = oidn::DeviceRef();
+	deviceType_ = DenoiserDeviceType::Default;
+	stats_ = DenoiserStats();
+}
+
+bool Denoiser::Execute(const DenoiseFilterKey& key, const DenoiseImages& images)
+{
+	if (!device_)
+	{
+		return false;
+	}
+
+	OIDNBuffer handles[] = { images.color.getHandle(), images.albedo.getHandle(), images.normal.getHandle(), images.output.getHandle() };
+	auto it = std::find_if(filters_.begin(), filters_.end(), [&](const CachedFilter& f) { return f.key == key && std::equal(handles, handles + 4, f.images); });
+	if (it == filters_.end())
+	{
+		// the least recently used filter makes room.
+		if (filters_.size() >= kMaxFilterCount)
+		{
+			filters_.erase(std::min_element(filters_.begin(), filters_.end(), [](const CachedFilter& a, const CachedFilter& b) { return a.lastUse < b.lastUse; }));
+			stats_.evictCount++;
+		}
+		CachedFilter entry;
+		entry.key = key;
+		if (key.bPrefilterAux)
+		{
+			if (!CreatePrefilter(key, AovImage::Albedo, images.albedo, &entry.albedoFilter, &entry.albedo)
+				|| !CreatePrefilter(key, AovImage::Normal, images.normal, &entry.normalFilter, &entry.normal))
+			{
+				return false;
+			}
+		}
+		entry.filter = device_.newFilter("RT");
+		SetAovImage(entry.filter, "color", images.color, key, AovImage::Color);
+		if (key.bPrefilterAux)
+		{
+			// the prefiltered images are float3.
+			entry.filter.setImage("albedo", entry.albedo, oidn::Format::Float3, key.width, key.height);
+			entry.filter.setImage("normal", entry.normal, oidn::Format::Float3, key.width, key.height);
+		}
+		else
+		{
+			SetAovImage(entry.filter, "albedo", images.albedo, key, AovImage::Albedo);
+			SetAovImage(entry.filter, "normal", images.normal, key, AovImage::Normal);
+		}
+		SetAovImage(entry.filter, "output", images.output, key, AovImage::Color);
+		entry.filter.set("hdr", key.bHdr);
+		entry.filter.set("cleanAux", key.bCleanAux);
+		entry.filter.set("quality", (oidn::Quality)key.quality);
+		entry.filter.commit();
+		if (!CheckError("filter commit"))
+		{
+			return false;
+		}
+		std::copy(handles, handles + 4, entry.images);
+		filters_.push_back(entry);
+		it = filters_.end() - 1;
+		stats_.createCount++;
+	}
+	it->lastUse = ++useCount_;
+
+	// the aux images only change with the camera and the scene, their prefilters run once per change.
+	if (key.bPrefilterAux)
+	{
+		if (images.auxVersion == 0 || images.auxVersion != it->auxVersion)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			it->albedoFilter.execute();
+			it->normalFilter.execute();
+			if (!CheckError("prefilter execute"))
+			{
+				it->auxVersion = 0;
+				return false;
+			}
+			it->auxVersion = images.auxVersion;
+			stats_.prefilterCount++;
+			stats_.prefilterMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+		else
+		{
+			stats_.prefilterSkipCount++;
+		}
+	}
+
+	it->filter.execute();
+	stats_.executeCount++;
+	return CheckError("filter execute");
+}
+
+bool Denoiser::CreatePrefilter(const DenoiseFilterKey& key, AovImage image, const oidn::BufferRef& src, oidn::FilterRef* pFilter, oidn::BufferRef* pOutput)
+{
+	// an "RT" filter with only the aux image denoises that image.
+	*pOutput = device_.newBuffer((size_t)key.width * key.height * sizeof(float) * 3);
+	*pFilter = device_.newFilter("RT");
+	SetAovImage(*pFilter, image == AovImage::Albedo ? "albedo" : "normal", src, key, image);
+	pFilter->setImage("output", *pOutput, oidn::Format::Float3, key.width, key.height);
+	pFilter->set("quality", (oidn::Quality)key.quality);
+	pFilter->commit();
+	return CheckError("prefilter commit");
+}
+
+void Denoiser::ClearFilters()
+{
+	filters_.clear();
+}
+
+bool Denoiser::CheckError(const char* what)
+{
+	const char* errorMsg = nullptr;
+	if (device_.getError(errorMsg) != oidn::Error::None)
+	{
+		printf("Error: oidn %s failed. (%s)\n", what, errorMsg ? errorMsg : "");
+		return false;
+	}
+	return true;
+}
+
+
+AsyncDenoiser::AsyncDenoiser()
+{}
+
+AsyncDenoiser::~AsyncDenoiser()
+{
+	Destroy();
+}
+
+void AsyncDenoiser::Initialize(Denoiser* pDenoiser)
+{
+	Destroy();
+
+	pDenoiser_ = pDenoiser;
+	bQuit_ = false;
+	worker_ = std::thread(&AsyncDenoiser::WorkerMain, this);
+}
+
+void AsyncDenoiser::Destroy()
+{
+	if (!worker_.joinable())
+	{
+		return;
+	}
+
+	// queued jobs still run, their images may already be in use.
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		bQuit_ = true;
+	}
+	workCv_.notify_all();
+	worker_.join();
+	for (auto&& job : jobs_)
+	{
+		job = Job();
+	}
+	pDenoiser_ = nullptr;
+	stats_ = AsyncDenoiseStats();
+}
+
+bool AsyncDenoiser::Submit(uint32_t slot, const DenoiseFilterKey& key, const DenoiseImages& images, uint64_t frameIndex)
+{
+	if (!worker_.joinable() || slot >= kSlotCount)
+	{
+		return false;
+	}
+
+	bool bPrevious = Wait(slot, frameIndex);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto&& job = jobs_[slot];
+		job.key = key;
+		job.images = images;
+		job.frameIndex = frameIndex;
+		job.bQueued = true;
+		job.bSucceeded = true;
+		queue_.push_back(slot);
+	}
+	workCv_.notify_all();
+	return bPrevious;
+}
+
+bool AsyncDenoiser::Wait(uint32_t slot, uint64_t currentFrameIndex)
+{
+	if (slot >= kSlotCount)
+	{
+		return false;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::unique_lock<std::mutex> lock(mutex_);
+	auto&& job = jobs_[slot];
+	bool bPending = job.bQueued || job.bRunning;
+	doneCv_.wait(lock, [&]() { return !job.bQueued && !job.bRunning; });
+	if (bPending)
+	{
+		stats_.waitMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		stats_.latencyFrames = currentFrameIndex - job.frameIndex;
+	}
+	return job.bSucceeded;
+}
+
+AsyncDenoiseStats AsyncDenoiser::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
+
+void AsyncDenoiser::WorkerMain()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true)
+	{
+		workCv_.wait(lock, [this]() { return bQuit_ || !queue_.empty(); });
+		if (queue_.empty())
+		{
+			return;
+		}
+		uint32_t slot = queue_.front();
+		queue_.erase(queue_.begin());
+		auto&& job = jobs_[slot];
+		job.bQueued = false;
+		job.bRunning = true;
+		auto key = job.key;
+		auto images = job.images;
+
+		lock.unlock();
+		auto start = std::chrono::high_resolution_clock::now();
+		bool bSucceeded = pDenoiser_->Execute(key, images);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		lock.lock();
+
+		job.bRunning = false;
+		job.bSucceeded = bSucceeded;
+		stats_.jobCount++;
+		stats_.denoiseMs = ms;
+		stats_.filterCount = pDenoiser_->GetFilterCount();
+		stats_.prefilterCount = pDenoiser_->GetStats().prefilterCount;
+		stats_.prefilterSkipCount = pDenoiser_->GetStats().prefilterSkipCount;
+		stats_.prefilterMs = pDenoiser_->GetStats().prefilterMs;
+		doneCv_.notify_all();
+	}
+}
+
+#endif
+
+//	EOF
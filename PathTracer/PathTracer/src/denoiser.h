@@ -0,0 +1,203 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "aov_layout.h"
+
+// the windows build always links OpenImageDenoise, other builds opt in with -DENABLE_OIDN=1 -lOpenImageDenoise.
+#ifndef ENABLE_OIDN
+#	if defined(_WIN32)
+#		define ENABLE_OIDN 1
+#	else
+#		define ENABLE_OIDN 0
+#	endif
+#endif
+
+#if ENABLE_OIDN
+#	include "OpenImageDenoise/oidn.hpp"
+#endif
+
+
+// same values as oidn::DeviceType.
+enum class DenoiserDeviceType
+{
+	Default = 0,
+	CPU = 1,
+	SYCL = 2,
+	CUDA = 3,
+	HIP = 4,
+	Metal = 5,
+};
+
+// same values as oidn::Quality.
+enum class DenoiseQuality
+{
+	Default = 0,
+	Balanced = 5,
+	High = 6,
+};
+
+const char* GetDenoiserDeviceTypeName(DenoiserDeviceType type);
+const char* GetDenoiseQualityName(DenoiseQuality quality);
+
+// index of the physical device to use, the preferred type first, then the cpu.
+// returns -1 if neither is available.
+int SelectDenoiserDevice(const std::vector<DenoiserDeviceType>& physicalDevices, DenoiserDeviceType preferred);
+
+// everything a committed "RT" filter depends on besides its images.
+struct DenoiseFilterKey
+{
+	uint32_t		width = 0;
+	uint32_t		height = 0;
+	DenoiseQuality	quality = DenoiseQuality::Default;
+	bool			bHdr = true;
+	bool			bCleanAux = true;
+	bool			bPrefilterAux = false;		// albedo and normal go through their own filters first, see DenoiseImages::auxVersion.
+	AovLayout		layout = AovLayout::Float3;
+
+	bool operator==(const DenoiseFilterKey& rhs) const
+	{
+		return width == rhs.width && height == rhs.height && quality == rhs.quality && bHdr == rhs.bHdr && bCleanAux == rhs.bCleanAux
+			&& bPrefilterAux == rhs.bPrefilterAux && layout == rhs.layout;
+	}
+	bool operator!=(const DenoiseFilterKey& rhs) const { return !(*this == rhs); }
+};
+
+struct DenoiserStats
+{
+	uint32_t	createCount = 0;		// filters created and committed.
+	uint32_t	executeCount = 0;
+	uint32_t	evictCount = 0;
+	uint32_t	prefilterCount = 0;		// albedo and normal prefilters executed.
+	uint32_t	prefilterSkipCount = 0;	// frames that reused the prefiltered albedo and normal.
+	double		prefilterMs = 0.0;		// cost of the last prefilter, saved by every skipped one.
+};
+
+#if ENABLE_OIDN
+
+// images of one denoise in the layout of the key, the output may not alias the inputs.
+// the output has the color layout, the half layout keeps normal in the albedo buffer.
+struct DenoiseImages
+{
+	oidn::BufferRef		color;
+	oidn::BufferRef		albedo;
+	oidn::BufferRef		normal;
+	oidn::BufferRef		output;
+	// changes whenever albedo or normal may have changed. the prefiltered images of a filter
+	// are reused while it stays the same, 0 prefilters every frame.
+	uint64_t			auxVersion = 0;
+};
+
+// oidn device with committed "RT" filters kept per key and images.
+// a frame with a cached key and the same images only calls execute().
+class Denoiser
+{
+public:
+	static const size_t kMaxFilterCount = 2;		// each filter holds its own scratch memory, two cover ping-pong images.
+
+public:
+	// creates a device of the preferred type, the cpu device if there is none.
+	bool Initialize(DenoiserDeviceType preferred);
+	void Destroy();
+
+	bool Execute(const DenoiseFilterKey& key, const DenoiseImages& images);
+	void ClearFilters();
+
+	bool IsValid() const { return (bool)device_; }
+	DenoiserDeviceType GetDeviceType() const { return deviceType_; }
+	oidn::DeviceRef& GetDevice() { return device_; }
+	const DenoiserStats& GetStats() const { return stats_; }
+	size_t GetFilterCount() const { return filters_.size(); }
+
+private:
+	struct CachedFilter
+	{
+		DenoiseFilterKey	key;
+		oidn::FilterRef		filter;
+		OIDNBuffer			images[4] = { nullptr, nullptr, nullptr, nullptr };
+		uint64_t			lastUse = 0;
+
+		// bPrefilterAux only, the main filter reads the prefiltered albedo and normal.
+		oidn::FilterRef		albedoFilter, normalFilter;
+		oidn::BufferRef		albedo, normal;
+		uint64_t			auxVersion = 0;
+	};
+
+	bool CreatePrefilter(const DenoiseFilterKey& key, AovImage image, const oidn::BufferRef& src, oidn::FilterRef* pFilter, oidn::BufferRef* pOutput);
+
+	bool CheckError(const char* what);
+
+private:
+	oidn::DeviceRef				device_;
+	DenoiserDeviceType			deviceType_ = DenoiserDeviceType::Default;
+	std::vector<CachedFilter>	filters_;
+	uint64_t					useCount_ = 0;
+	DenoiserStats				stats_;
+};	// class Denoiser
+
+struct AsyncDenoiseStats
+{
+	uint64_t	jobCount = 0;
+	double		denoiseMs = 0.0;		// worker time of the last job.
+	double		waitMs = 0.0;			// time the last Wait() blocked the caller.
+	uint64_t	latencyFrames = 0;		// frames between the source of the last waited job and the frame that waited for it.
+	size_t		filterCount = 0;
+	uint32_t	prefilterCount = 0;		// copies of DenoiserStats, see there.
+	uint32_t	prefilterSkipCount = 0;
+	double		prefilterMs = 0.0;
+};
+
+// denoise jobs on a worker thread, one per slot, so that frame N traces while frame N-1 denoises.
+// a slot owns its images, Wait() on a slot before its images are written or its output is read.
+class AsyncDenoiser
+{
+public:
+	static const uint32_t kSlotCount = 2;
+
+public:
+	AsyncDenoiser();
+	~AsyncDenoiser();
+
+	// pDenoiser is only used on the worker thread until Destroy().
+	void Initialize(Denoiser* pDenoiser);
+	void Destroy();
+
+	// waits for the previous job of the slot, then queues this one.
+	bool Submit(uint32_t slot, const DenoiseFilterKey& key, const DenoiseImages& images, uint64_t frameIndex);
+	// returns false if the last job of the slot failed. a slot without a job returns at once.
+	bool Wait(uint32_t slot, uint64_t currentFrameIndex);
+
+	AsyncDenoiseStats GetStats() const;
+
+private:
+	struct Job
+	{
+		DenoiseFilterKey	key;
+		DenoiseImages		images;
+		uint64_t			frameIndex = 0;
+		bool				bQueued = false;
+		bool				bRunning = false;
+		bool				bSucceeded = true;
+	};
+
+	void WorkerMain();
+
+private:
+	Denoiser*					pDenoiser_ = nullptr;
+	std::thread					worker_;
+	mutable std::mutex			mutex_;
+	std::condition_variable		workCv_, doneCv_;
+	Job							jobs_[kSlotCount];
+	std::vector<uint32_t>		queue_;		// slots in submit order.
+	bool						bQuit_ = false;
+	AsyncDenoiseStats			stats_;
+};	// class AsyncDenoiser
+
+#endif
+
+//	EOF
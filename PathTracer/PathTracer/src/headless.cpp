@@ -0,0 +1,581 @@
+#include "headless.h"
+#include "benchmark.h"
+#include "cpu_path_tracer.h"
+#include "cpu_task.h"
+#include "rmesh_lod.h"
+#include "rmesh_opacity.h"
+#include "rmesh_reorder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <regex>
+
+#ifndef USE_IN_CPP
+#	define USE_IN_CPP
+#endif
+#include "../shaders/cbuffer.hlsli"
+
+
+namespace
+{
+	// same values as SampleApplication.
+	static const float kFovY = 90.0f;
+	static const float kNearZ = 0.1f;
+	static const char* kResourceDir = "resources";
+
+	struct HeadlessOptions
+	{
+		std::string	homeDir = "./";
+		int			meshType = 0;		// suzanne grid, the sponza scene (1) needs a mesh that is not in the tree.
+		uint32_t	width = 1280;
+		uint32_t	height = 720;
+		int			sampleCount = 1;
+		int			depthMax = 4;
+		uint32_t	threadCount = 0;
+		std::string	outputPath;
+		std::string	benchName;
+		int			repeatCount = 3;
+		std::string	convertPath;		// .rmesh to convert to v2, written to outputPath.
+		std::string	reorderPath;		// .rmesh to reorder for locality, written to outputPath.
+		std::string	opacityPath;		// .rmesh to bake triangle opacity for, written to outputPath.
+		std::string	lodPath;			// .rmesh to build the lod chain of, written next to it.
+		uint32_t	lodDepth = 0;		// CpuLodParams::depth, 0 traces full detail only.
+		std::string	tracePath;			// task trace json of the scene build.
+	};
+
+	bool ParseOptions(const std::vector<std::string>& args, HeadlessOptions* pOpt)
+	{
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			auto&& arg = args[i];
+			bool bHasValue = i + 1 < args.size();
+			if (arg == "-headless")
+			{
+				continue;
+			}
+			else if (arg == "-homedir" && bHasValue)
+			{
+				pOpt->homeDir = args[++i];
+			}
+			else if (arg == "-mesh" && bHasValue)
+			{
+				pOpt->meshType = std::stoi(args[++i]);
+			}
+			else if (arg == "-res" && bHasValue)
+			{
+				std::regex r("([0-9]+)x([0-9]+)");
+				std::smatch m;
+				if (!std::regex_match(args[++i], m, r))
+				{
+					printf("Error: invalid resolution. (%s)\n", args[i].c_str());
+					return false;
+				}
+				pOpt->width = (uint32_t)std::stoi(m[1].str());
+				pOpt->height = (uint32_t)std::stoi(m[2].str());
+			}
+			else if (arg == "-spp" && bHasValue)
+			{
+				pOpt->sampleCount = std::stoi(args[++i]);
+			}
+			else if (arg == "-depth" && bHasValue)
+			{
+				pOpt->depthMax = std::stoi(args[++i]);
+			}
+			else if (arg == "-threads" && bHasValue)
+			{
+				pOpt->threadCount = (uint32_t)std::stoi(args[++i]);
+			}
+			else if (arg == "-out" && bHasValue)
+			{
+				pOpt->outputPath = args[++i];
+			}
+			else if (arg == "-bench" && bHasValue)
+			{
+				pOpt->benchName = args[++i];
+			}
+			else if (arg == "-repeat" && bHasValue)
+			{
+				pOpt->repeatCount = std::stoi(args[++i]);
+			}
+			else if (arg == "-convert" && bHasValue)
+			{
+				pOpt->convertPath = args[++i];
+			}
+			else if (arg == "-reorder" && bHasValue)
+			{
+				pOpt->reorderPath = args[++i];
+			}
+			else if (arg == "-bakeopacity" && bHasValue)
+			{
+				pOpt->opacityPath = args[++i];
+			}
+			else if (arg == "-buildlod" && bHasValue)
+			{
+				pOpt->lodPath = args[++i];
+			}
+			else if (arg == "-lod" && bHasValue)
+			{
+				pOpt->lodDepth = (uint32_t)std::stoi(args[++i]);
+				if (pOpt->lodDepth > 0 && pOpt->lodDepth < kLodDepthMin)
+				{
+					printf("Error: lod depth %u is over the error budget, use 0 or %u and above.\n", pOpt->lodDepth, kLodDepthMin);
+					return false;
+				}
+			}
+			else if (arg == "-trace" && bHasValue)
+			{
+				pOpt->tracePath = args[++i];
+			}
+			else
+			{
+				printf("Error: unknown option. (%s)\n", arg.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::string JoinPath(const std::string& dir, const std::string& file)
+	{
+		if (dir.empty() || dir.back() == '/' || dir.back() == '\\')
+		{
+			return dir + file;
+		}
+		return dir + "/" + file;
+	}
+
+	// same scene as SampleApplication::Initialize().
+	bool CreateScene(const HeadlessOptions& opt, CpuScene* pScene, TaskScheduler* pScheduler)
+	{
+		std::string resDir = JoinPath(opt.homeDir, kResourceDir);
+		// lod files next to the meshes are loaded when rays may trace them.
+		uint32_t lodLevelCount = (opt.lodDepth > 0) ? kLodLevelMax : 1;
+		if (opt.meshType == 0)
+		{
+			auto suzanne = pScene->AddMeshLods(JoinPath(resDir, "mesh/hp_suzanne/hp_suzanne.rmesh"), lodLevelCount);
+			if (suzanne.empty())
+			{
+				return false;
+			}
+
+			static const int kMeshWidth = 32;
+			static const float kMeshInter = 100.0f;
+			static const float kMeshOrigin = -(kMeshWidth - 1) * kMeshInter * 0.5f;
+			// fixed seed, so that headless results are comparable between runs.
+			std::mt19937 rnd(0);
+			auto RandRange = [&rnd](float minV, float maxV)
+			{
+				uint32_t val = rnd();
+				float v0_1 = (float)val / (float)0xffffffff;
+				return minV + (maxV - minV) * v0_1;
+			};
+			for (int x = 0; x < kMeshWidth; x++)
+			{
+				for (int y = 0; y < kMeshWidth; y++)
+				{
+					Vec3 pos(kMeshOrigin + x * kMeshInter, RandRange(-100.0f, 100.0f), kMeshOrigin + y * kMeshInter);
+					float pitch = RandRange(-kCpuPI, kCpuPI);
+					float yaw = RandRange(-kCpuPI, kCpuPI);
+					float roll = RandRange(-kCpuPI, kCpuPI);
+					auto mat = MatrixMultiply(MatrixRotationRollPitchYaw(pitch, yaw, roll), MatrixTranslation(pos.x, pos.y, pos.z));
+					pScene->AddLodInstances(suzanne, mat);
+				}
+			}
+		}
+		else
+		{
+			auto sponza = pScene->AddMeshLods(JoinPath(resDir, "mesh/sponza/sponza.rmesh"), lodLevelCount);
+			auto title = pScene->AddMeshLods(JoinPath(resDir, "mesh/title/title.rmesh"), lodLevelCount);
+			if (sponza.empty() || title.empty())
+			{
+				return false;
+			}
+
+			// sponza
+			{
+				auto mat = MatrixMultiply(MatrixScaling(0.02f, 0.02f, 0.02f), MatrixTranslation(0.0f, -300.0f, 100.0f));
+				pScene->AddLodInstances(sponza, mat);
+			}
+			// title
+			{
+				auto mat = MatrixMultiply(MatrixMultiply(MatrixScaling(2.5f, 2.5f, 2.5f), MatrixRotationY(90.0f * kCpuPI / 180.0f)), MatrixTranslation(400.0f, 1000.0f, 40.0f));
+				pScene->AddLodInstances(title, mat);
+			}
+		}
+		pScene->Build(BvhBuildSettings(), pScheduler);
+		return true;
+	}
+
+	// initial light of SampleApplication.
+	void SetupLight(LightCB* pLight)
+	{
+		const float skyColor[3] = {0.565f, 0.843f, 0.925f};
+		const float groundColor[3] = {0.639f, 0.408f, 0.251f};
+		const float ambientIntensity = 0.1f;
+		const float directionalTheta = 30.0f;
+		const float directionalPhi = 45.0f;
+		const float directionalIntensity = 3.0f;
+
+		memset(pLight, 0, sizeof(*pLight));
+		pLight->ambientSky = DirectX::XMFLOAT3(skyColor[0], skyColor[1], skyColor[2]);
+		pLight->ambientGround = DirectX::XMFLOAT3(groundColor[0], groundColor[1], groundColor[2]);
+		pLight->ambientIntensity = ambientIntensity;
+
+		auto mtxRot = MatrixMultiply(MatrixRotationZ(directionalTheta * kCpuPI / 180.0f), MatrixRotationY(directionalPhi * kCpuPI / 180.0f));
+		Vec3 dir = Normalize(TransformVector(Vec3(0.0f, 1.0f, 0.0f), mtxRot));
+		pLight->directionalVec = DirectX::XMFLOAT3(dir.x, dir.y, dir.z);
+		pLight->directionalColor = DirectX::XMFLOAT3(directionalIntensity, directionalIntensity, directionalIntensity);
+	}
+
+	// same constants as SampleApplication::Execute() with the initial camera and light.
+	void SetupConstants(const HeadlessOptions& opt, SceneCB* pScene, LightCB* pLight, PathTraceCB* pPathTrace)
+	{
+		Vec3 cameraPos(1000.0f, 1000.0f, 0.0f);
+		Vec3 cameraDir(-1.0f, 0.0f, 0.0f);
+		Vec3 upVec(0.0f, 1.0f, 0.0f);
+		auto mtxWorldToView = MatrixLookAtRH(cameraPos, cameraPos + cameraDir, upVec);
+		auto mtxViewToClip = MatrixPerspectiveInfiniteInverseFovRH(kFovY * kCpuPI / 180.0f, (float)opt.width / (float)opt.height, kNearZ);
+		auto mtxWorldToClip = MatrixMultiply(mtxWorldToView, mtxViewToClip);
+
+		pScene->mtxWorldToProj = mtxWorldToClip;
+		pScene->mtxWorldToView = mtxWorldToView;
+		pScene->mtxViewToProj = mtxViewToClip;
+		pScene->mtxProjToWorld = MatrixInverse(mtxWorldToClip);
+		pScene->mtxViewToWorld = MatrixInverse(mtxWorldToView);
+		pScene->mtxProjToView = MatrixInverse(mtxViewToClip);
+		pScene->mtxProjToPrevProj = MatrixIdentity();
+		pScene->mtxPrevViewToProj = mtxViewToClip;
+		pScene->eyePosition = DirectX::XMFLOAT4(cameraPos.x, cameraPos.y, cameraPos.z, 0.0f);
+		pScene->screenSize = DirectX::XMFLOAT2((float)opt.width, (float)opt.height);
+		pScene->invScreenSize = DirectX::XMFLOAT2(1.0f / (float)opt.width, 1.0f / (float)opt.height);
+		pScene->nearFar = DirectX::XMFLOAT2(kNearZ, 0.0f);
+
+		SetupLight(pLight);
+
+		pPathTrace->sampleCount = opt.sampleCount;
+		pPathTrace->depthMax = opt.depthMax;
+	}
+
+	// cooks a .rmesh into the v2 container, the output defaults to the input with a .rmesh2 extension.
+	bool ConvertMesh(const HeadlessOptions& opt)
+	{
+		RMesh mesh;
+		if (!LoadRMesh(opt.convertPath, &mesh, opt.threadCount))
+		{
+			return false;
+		}
+		std::string outputPath = opt.outputPath;
+		if (outputPath.empty())
+		{
+			auto pos = opt.convertPath.find_last_of('.');
+			outputPath = opt.convertPath.substr(0, pos) + ".rmesh2";
+		}
+
+		RMeshV2Settings settings;
+		settings.bvh.threadCount = opt.threadCount;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!WriteRMeshV2(outputPath, mesh, settings))
+		{
+			return false;
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		printf("converted: %s -> %s, %.2f ms\n", opt.convertPath.c_str(), outputPath.c_str(),
+			std::chrono::duration<double, std::milli>(end - start).count());
+		return true;
+	}
+
+	// rewrites a .rmesh in locality order, the output defaults to the input with a .reordered.rmesh extension.
+	bool ReorderMesh(const HeadlessOptions& opt)
+	{
+		RMesh mesh;
+		if (!LoadRMesh(opt.reorderPath, &mesh, opt.threadCount))
+		{
+			return false;
+		}
+		std::string outputPath = opt.outputPath;
+		if (outputPath.empty())
+		{
+			auto pos = opt.reorderPath.find_last_of('.');
+			outputPath = opt.reorderPath.substr(0, pos) + ".reordered.rmesh";
+		}
+
+		BvhBuildSettings bvhSettings;
+		bvhSettings.threadCount = opt.threadCount;
+		RMeshLocalityStats before = MeasureRMeshLocality(mesh, bvhSettings);
+
+		// first-use numbering loses to meshes the exporter already optimized for vertex fetch, the better one is written.
+		RMesh candidates[2] = { mesh, mesh };
+		RMeshLocalityStats after[2];
+		const RMeshVertexOrder kVertexOrders[] = { kRMeshVertexOrderFirstUse, kRMeshVertexOrderSource };
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < 2; i++)
+		{
+			RMeshReorderSettings settings;
+			settings.vertexOrder = kVertexOrders[i];
+			if (!ReorderRMesh(&candidates[i], settings))
+			{
+				return false;
+			}
+			after[i] = MeasureRMeshLocality(candidates[i], bvhSettings);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		int best = (after[1].GetTotalLines() < after[0].GetTotalLines()) ? 1 : 0;
+		if (!WriteRMesh(outputPath, candidates[best]))
+		{
+			return false;
+		}
+		printf("reordered: %s -> %s, %s vertex order, %.2f ms\n", opt.reorderPath.c_str(), outputPath.c_str(),
+			(best == 0) ? "first-use" : "source", std::chrono::duration<double, std::milli>(end - start).count());
+		if (best == 1)
+		{
+			printf("first-use vertex order touches more cache lines per leaf than the source order (%.2f vs %.2f), the source order is kept.\n",
+				after[0].GetTotalLines(), after[1].GetTotalLines());
+		}
+		printf("cache lines per leaf: index %.2f -> %.2f, position %.2f -> %.2f, normal+uv %.2f -> %.2f, total %.2f -> %.2f (first-use %.2f, source %.2f)\n",
+			before.indexLines, after[best].indexLines, before.positionLines, after[best].positionLines,
+			before.attributeLines, after[best].attributeLines, before.GetTotalLines(), after[best].GetTotalLines(),
+			after[0].GetTotalLines(), after[1].GetTotalLines());
+		return true;
+	}
+
+	// splits masked submeshes by triangle opacity, the output defaults to the input with a .opacity.rmesh extension.
+	bool BakeOpacity(const HeadlessOptions& opt)
+	{
+		RMesh mesh;
+		if (!LoadRMesh(opt.opacityPath, &mesh, opt.threadCount))
+		{
+			return false;
+		}
+		std::string outputPath = opt.outputPath;
+		if (outputPath.empty())
+		{
+			auto pos = opt.opacityPath.find_last_of('.');
+			outputPath = opt.opacityPath.substr(0, pos) + ".opacity.rmesh";
+		}
+
+		std::vector<CpuTexture> textures;
+		std::vector<const CpuTexture*> baseColors;
+		LoadMaskedBaseColors(mesh, &textures, &baseColors);
+		RMeshOpacitySettings settings;
+		settings.threadCount = opt.threadCount;
+		std::vector<RMeshOpacityStats> stats;
+		uint32_t materialCount = (uint32_t)mesh.materials.size();
+		uint32_t submeshCount = (uint32_t)mesh.submeshes.size();
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!BakeRMeshOpacity(&mesh, baseColors, settings, &stats) || !WriteRMesh(outputPath, mesh))
+		{
+			return false;
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		printf("baked: %s -> %s, submeshes %u -> %u, %.2f ms\n", opt.opacityPath.c_str(), outputPath.c_str(),
+			submeshCount, (uint32_t)mesh.submeshes.size(), std::chrono::duration<double, std::milli>(end - start).count());
+		printf("  %-24s %9s %9s %12s %9s %8s\n", "material", "tris", "opaque", "transparent", "mixed", "any hit");
+		for (uint32_t m = 0; m < materialCount; m++)
+		{
+			auto&& s = stats[m];
+			if (s.bMasked)
+			{
+				printf("  %-24s %9u %9u %12u %9u %7.1f%%\n", mesh.materials[m].name.c_str(), s.GetTriangleCount(),
+					s.triangleCounts[kRMeshTriangleOpaque], s.triangleCounts[kRMeshTriangleTransparent],
+					s.triangleCounts[kRMeshTriangleMixed], s.GetAnyHitFraction() * 100.0);
+			}
+		}
+		return true;
+	}
+
+	// writes lod 1 and coarser of a .rmesh next to it, see GetRMeshLodPath().
+	bool BuildMeshLods(const HeadlessOptions& opt)
+	{
+		RMesh mesh;
+		if (!LoadRMesh(opt.lodPath, &mesh, opt.threadCount))
+		{
+			return false;
+		}
+		std::vector<RMesh> lods;
+		std::vector<RMeshLodStats> stats;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!BuildRMeshLods(mesh, RMeshLodSettings(), &lods, &stats))
+		{
+			return false;
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		printf("lods: %s, %u triangles, %.2f ms\n", opt.lodPath.c_str(), mesh.GetTotalTriangleCount(),
+			std::chrono::duration<double, std::milli>(end - start).count());
+		for (uint32_t level = 1; level <= (uint32_t)lods.size(); level++)
+		{
+			std::string lodPath = GetRMeshLodPath(opt.lodPath, level);
+			if (!WriteRMesh(lodPath, lods[level - 1]))
+			{
+				return false;
+			}
+			auto&& s = stats[level - 1];
+			printf("  lod %u: %s, %u triangles, %u vertices, grid %u, max error %g\n",
+				level, lodPath.c_str(), s.triangleCount, s.vertexCount, s.gridResolution, s.maxError);
+		}
+		return true;
+	}
+
+	// little endian rgb pfm, bottom row first.
+	bool WritePFM(const std::string& filePath, const float* pPixels, uint32_t width, uint32_t height)
+	{
+		FILE* fp = fopen(filePath.c_str(), "wb");
+		if (!fp)
+		{
+			printf("Error: failed to open output file. (%s)\n", filePath.c_str());
+			return false;
+		}
+		fprintf(fp, "PF\n%u %u\n-1.0\n", width, height);
+		for (uint32_t y = height; y > 0; y--)
+		{
+			fwrite(pPixels + (size_t)(y - 1) * width * 3, sizeof(float) * 3, width, fp);
+		}
+		fclose(fp);
+		return true;
+	}
+}
+
+bool CreateBenchmarkScene(const std::string& meshPath, CpuScene* pScene)
+{
+	static const int kGridWidth = 8;
+	static const float kGridInter = 100.0f;
+
+	int mesh = pScene->AddMesh(meshPath);
+	if (mesh < 0)
+	{
+		return false;
+	}
+	std::mt19937 rnd(0);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+	float origin = -(kGridWidth - 1) * kGridInter * 0.5f;
+	for (int x = 0; x < kGridWidth; x++)
+	{
+		for (int y = 0; y < kGridWidth; y++)
+		{
+			auto mat = MatrixMultiply(MatrixRotationRollPitchYaw(dist(rnd) * kCpuPI, dist(rnd) * kCpuPI, dist(rnd) * kCpuPI),
+				MatrixTranslation(origin + x * kGridInter, dist(rnd) * 50.0f, origin + y * kGridInter));
+			pScene->AddInstance(mesh, mat);
+		}
+	}
+	pScene->Build();
+	return true;
+}
+
+void SetupBenchmarkConstants(const Aabb& bounds, uint32_t width, uint32_t height, SceneCB* pScene, LightCB* pLight, PathTraceCB* pPathTrace)
+{
+	Vec3 center = bounds.Center();
+	float radius = Length(bounds.Extent()) * 0.5f;
+	Vec3 eye = center + Normalize(Vec3(1.0f, 0.8f, 1.0f)) * radius * 0.9f;
+	auto mtxWorldToView = MatrixLookAtRH(eye, center, Vec3(0.0f, 1.0f, 0.0f));
+	auto mtxViewToClip = MatrixPerspectiveInfiniteInverseFovRH(60.0f * kCpuPI / 180.0f, (float)width / (float)height, 0.1f);
+	memset(pScene, 0, sizeof(*pScene));
+	pScene->mtxProjToWorld = MatrixInverse(MatrixMultiply(mtxWorldToView, mtxViewToClip));
+	pScene->eyePosition = DirectX::XMFLOAT4(eye.x, eye.y, eye.z, 0.0f);
+
+	SetupLight(pLight);
+
+	memset(pPathTrace, 0, sizeof(*pPathTrace));
+}
+
+int RunHeadless(const std::vector<std::string>& args)
+{
+	HeadlessOptions opt;
+	if (!ParseOptions(args, &opt))
+	{
+		return -1;
+	}
+
+	if (!opt.benchName.empty())
+	{
+		BenchmarkOptions benchOpt;
+		benchOpt.homeDir = opt.homeDir;
+		benchOpt.threadCount = opt.threadCount;
+		benchOpt.repeatCount = opt.repeatCount;
+		return RunBenchmark(opt.benchName, benchOpt);
+	}
+
+	if (!opt.convertPath.empty())
+	{
+		return ConvertMesh(opt) ? 0 : -1;
+	}
+
+	if (!opt.reorderPath.empty())
+	{
+		return ReorderMesh(opt) ? 0 : -1;
+	}
+
+	if (!opt.opacityPath.empty())
+	{
+		return BakeOpacity(opt) ? 0 : -1;
+	}
+
+	if (!opt.lodPath.empty())
+	{
+		return BuildMeshLods(opt) ? 0 : -1;
+	}
+
+	// load meshes and build bvh.
+	CpuScene scene;
+	TaskScheduler scheduler;
+	scheduler.Initialize(opt.threadCount);
+	auto loadStart = std::chrono::high_resolution_clock::now();
+	if (!CreateScene(opt, &scene, &scheduler))
+	{
+		printf("Error: failed to create scene.%s\n", (opt.meshType != 0) ? " (-mesh 0 renders the bundled suzanne grid)" : "");
+		return -1;
+	}
+	auto loadEnd = std::chrono::high_resolution_clock::now();
+	printf("scene: %zu instances, %llu triangles, %.2f ms\n",
+		scene.GetInstances().size(),
+		(unsigned long long)scene.GetTriangleCount(),
+		std::chrono::duration<double, std::milli>(loadEnd - loadStart).count());
+	if (!opt.tracePath.empty())
+	{
+		PrintTaskTrace(scheduler.GetTrace(), "build");
+		if (!WriteTaskTraceJson(scheduler.GetTrace(), opt.tracePath))
+		{
+			return -1;
+		}
+	}
+
+	SceneCB cbScene;
+	LightCB cbLight;
+	PathTraceCB cbPathTrace;
+	SetupConstants(opt, &cbScene, &cbLight, &cbPathTrace);
+	CpuLodParams lod;
+	lod.depth = opt.lodDepth;
+	lod.rayTMin = scene.GetLodRayTMin();
+	if (opt.lodDepth > 0)
+	{
+		printf("lod: rays from depth %u, tmin %.3f\n", lod.depth, lod.rayTMin);
+	}
+
+	// same layout as the rtResult/rtAlbedo/rtNormal buffers.
+	size_t pixelCount = (size_t)opt.width * opt.height;
+	std::vector<float> rtResult(pixelCount * 3), rtAlbedo(pixelCount * 3), rtNormal(pixelCount * 3);
+
+	CpuPathTracer tracer;
+	tracer.SetLod(lod);
+	CpuRenderStats stats;
+	if (!tracer.Render(scene, cbScene, cbLight, cbPathTrace, opt.width, opt.height,
+		rtResult.data(), rtAlbedo.data(), rtNormal.data(), opt.threadCount, &stats))
+	{
+		return -1;
+	}
+	printf("render: %ux%u, spp %d, depth %d (%s loops), lod depth %u, %u tiles (%u stolen)\n",
+		opt.width, opt.height, opt.sampleCount, opt.depthMax, (stats.permutationIndex >= 0) ? "fixed" : "generic",
+		opt.lodDepth, stats.tileCount, stats.stolenTileCount);
+	printf("time: %.2f ms, rays: %llu, %.3f Mrays/s\n",
+		stats.elapsedMs, (unsigned long long)stats.rayCount, stats.GetRaysPerSecond() * 1e-6);
+
+	if (!opt.outputPath.empty())
+	{
+		if (!WritePFM(opt.outputPath, rtResult.data(), opt.width, opt.height))
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+//	EOF
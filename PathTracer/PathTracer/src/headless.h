@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+struct Aabb;
+class CpuScene;
+struct SceneCB;
+struct LightCB;
+struct PathTraceCB;
+
+// command line entry of the cpu backend, no window and no d3d12 device.
+// args are the command line arguments without the executable name.
+int RunHeadless(const std::vector<std::string>& args);
+
+// scene of the cpu benchmarks, randomly rotated instances of one mesh on an 8x8 grid.
+bool CreateBenchmarkScene(const std::string& meshPath, CpuScene* pScene);
+
+// camera looking at bounds from one corner and the light of the headless scene.
+// every constant is cleared first, the caller sets the path trace parameters.
+void SetupBenchmarkConstants(const Aabb& bounds, uint32_t width, uint32_t height, SceneCB* pScene, LightCB* pLight, PathTraceCB* pPathTrace);
+
+//	EOF
@@ -0,0 +1,54 @@
+#include "init_stages.h"
+
+
+namespace
+{
+	static const int kStageCount = (int)InitStage::Count;
+
+	static const char* kStageNames[kStageCount] = {
+		"gui and dummy textures",
+		"timestamps",
+		"wait shaders",
+		"wait resources",
+		"scene transforms",
+		"tonemap pso",
+		"raytracing pipeline",
+		"scene meshes",
+	};
+}
+
+const char* GetInitStageName(InitStage stage)
+{
+	return kStageNames[(int)stage];
+}
+
+const std::vector<InitStage>& GetInitStageDependencies(InitStage stage)
+{
+	static const std::vector<InitStage> kDependencies[kStageCount] = {
+		{},
+		{},
+		{},
+		{},
+		{},
+		{ InitStage::WaitShaders },
+		{ InitStage::WaitShaders },
+		{ InitStage::WaitResources, InitStage::SceneTransforms },
+	};
+	return kDependencies[(int)stage];
+}
+
+void AddInitStages(TaskScheduler* pScheduler, const std::function<bool()>* funcs)
+{
+	TaskId ids[kStageCount];
+	for (int i = 0; i < kStageCount; i++)
+	{
+		std::vector<TaskId> dependencies;
+		for (auto dep : GetInitStageDependencies((InitStage)i))
+		{
+			dependencies.push_back(ids[(int)dep]);
+		}
+		ids[i] = pScheduler->AddTask(kStageNames[i], funcs[i], dependencies);
+	}
+}
+
+//	EOF
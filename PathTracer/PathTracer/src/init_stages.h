@@ -0,0 +1,33 @@
+#pragma once
+
+#include "cpu_task.h"
+
+#include <functional>
+#include <vector>
+
+
+// stages of SampleApplication::Initialize(), in the order they are added to the scheduler.
+enum class InitStage
+{
+	Gui,				// gui font and dummy textures.
+	Timestamps,
+	WaitShaders,		// compile or load from the shader cache.
+	WaitResources,		// meshes and textures of the resource loader.
+	SceneTransforms,
+	TonemapPso,
+	RaytracingPipeline,	// material collection and path tracer pipelines.
+	SceneMeshes,
+
+	Count
+};
+
+const char* GetInitStageName(InitStage stage);
+// the stages whose results a stage reads, all of them come before it.
+//   the tonemap pso and the raytracing pipeline only need the shaders and compile together.
+//   the scene meshes are built while the shaders are still compiling.
+const std::vector<InitStage>& GetInitStageDependencies(InitStage stage);
+
+// adds one task per stage, funcs are indexed by InitStage.
+void AddInitStages(TaskScheduler* pScheduler, const std::function<bool()>* funcs);
+
+//	EOF
@@ -1,7 +1,11 @@
-﻿#include "sample_application.h"
-#include "sl12/string_util.h"
+﻿#include "headless.h"
 #include <regex>
 
+#if defined(_WIN32)
+#include "sample_application.h"
+#include "sl12/string_util.h"
+#include <cstdio>
+
 
 namespace
 {
@@ -14,8 +18,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 	auto ColorSpace = sl12::ColorSpaceType::Rec709;
 	std::string homeDir = ".\\";
 	int meshType = 1;
+	AovLayout aovLayout = AovLayout::Float3;
 	int screenWidth = kDisplayWidth;
 	int screenHeight = kDisplayHeight;
+	bool bHeadless = false;
+	std::vector<std::string> args;
 
 	LPWSTR *szArglist;
 	int nArgs;
@@ -23,9 +30,17 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 	szArglist = CommandLineToArgvW(GetCommandLineW(), &nArgs);
 	if (szArglist)
 	{
+		for (int i = 1; i < nArgs; i++)
+		{
+			args.push_back(sl12::WStringToString(szArglist[i]));
+		}
 		for (int i = 0; i < nArgs; i++)
 		{
-			if (!lstrcmpW(szArglist[i], L"-hdr"))
+			if (!lstrcmpW(szArglist[i], L"-headless"))
+			{
+				bHeadless = true;
+			}
+			else if (!lstrcmpW(szArglist[i], L"-hdr"))
 			{
 				ColorSpace = sl12::ColorSpaceType::Rec2020;
 			}
@@ -37,6 +52,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 			{
 				meshType = std::stoi(szArglist[++i]);
 			}
+			else if (!lstrcmpW(szArglist[i], L"-aov"))
+			{
+				aovLayout = !lstrcmpW(szArglist[++i], L"half") ? AovLayout::Half : AovLayout::Float3;
+			}
 			else if (!lstrcmpW(szArglist[i], L"-res"))
 			{
 				std::wstring str = szArglist[++i];
@@ -51,9 +70,30 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 		}
 	}
 
-	SampleApplication app(hInstance, nCmdShow, screenWidth, screenHeight, ColorSpace, homeDir, meshType);
+	if (bHeadless)
+	{
+		// print to the console that launched us.
+		if (AttachConsole(ATTACH_PARENT_PROCESS))
+		{
+			FILE* fp;
+			freopen_s(&fp, "CONOUT$", "w", stdout);
+		}
+		return RunHeadless(args);
+	}
+
+	SampleApplication app(hInstance, nCmdShow, screenWidth, screenHeight, ColorSpace, homeDir, meshType, aovLayout);
 
 	return app.Run();
 }
 
+#else
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> args(argv + 1, argv + argc);
+	return RunHeadless(args);
+}
+
+#endif
+
 //	EOF
@@ -0,0 +1,113 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+
+bool MappedFile::Open(const std::string& filePath)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE hFile = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(hFile, &size))
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	hFile_ = hFile;
+	size_ = (size_t)size.QuadPart;
+	if (size_ == 0)
+	{
+		bEmpty_ = true;
+		return true;
+	}
+	HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!hMapping)
+	{
+		Close();
+		return false;
+	}
+	hMapping_ = hMapping;
+	pData_ = (const uint8_t*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!pData_)
+	{
+		Close();
+		return false;
+	}
+#else
+	int fd = open(filePath.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return false;
+	}
+	size_ = (size_t)st.st_size;
+	if (size_ == 0)
+	{
+		close(fd);
+		bEmpty_ = true;
+		return true;
+	}
+	void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping stays valid after the descriptor is closed.
+	close(fd);
+	if (p == MAP_FAILED)
+	{
+		size_ = 0;
+		return false;
+	}
+	// start the read ahead while the header is parsed.
+	madvise(p, size_, MADV_WILLNEED);
+	pData_ = (const uint8_t*)p;
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+#if defined(_WIN32)
+	if (pData_)
+	{
+		UnmapViewOfFile(pData_);
+	}
+	if (hMapping_)
+	{
+		CloseHandle((HANDLE)hMapping_);
+	}
+	if (hFile_)
+	{
+		CloseHandle((HANDLE)hFile_);
+	}
+	hMapping_ = hFile_ = nullptr;
+#else
+	if (pData_)
+	{
+		munmap((void*)pData_, size_);
+	}
+#endif
+	pData_ = nullptr;
+	size_ = 0;
+	bEmpty_ = false;
+}
+
+//	EOF
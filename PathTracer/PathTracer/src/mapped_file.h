@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// read only memory mapped file.
+// the contents are paged in on first access, nothing is copied by Open().
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& filePath);
+	void Close();
+
+	bool IsOpen() const { return pData_ != nullptr || bEmpty_; }
+	const uint8_t* GetData() const { return pData_; }
+	size_t GetSize() const { return size_; }
+
+private:
+	const uint8_t*	pData_ = nullptr;
+	size_t			size_ = 0;
+	bool			bEmpty_ = false;		// empty files can not be mapped.
+#if defined(_WIN32)
+	void*			hFile_ = nullptr;
+	void*			hMapping_ = nullptr;
+#endif
+};	// class MappedFile
+
+//	EOF
@@ -0,0 +1,35 @@
+#pragma once
+
+
+// PathTracerRGS compiled with PT_SAMPLE_COUNT/PT_DEPTH_MAX, the loops of these settings have fixed counts.
+// other settings run the generic shader, which reads both from PathTraceCB.
+struct PathTracerPermutation
+{
+	int		sampleCount;
+	int		depthMax;
+};
+
+static constexpr PathTracerPermutation kPathTracerPermutations[] = {
+	{ 1, 1 },
+	{ 1, 2 },
+	{ 1, 4 },
+	{ 4, 1 },
+	{ 4, 2 },
+	{ 4, 4 },
+};
+static constexpr int kPathTracerPermutationCount = (int)(sizeof(kPathTracerPermutations) / sizeof(kPathTracerPermutations[0]));
+
+// index into kPathTracerPermutations, -1 for the generic shader.
+inline int FindPathTracerPermutation(int sampleCount, int depthMax)
+{
+	for (int i = 0; i < kPathTracerPermutationCount; i++)
+	{
+		if (kPathTracerPermutations[i].sampleCount == sampleCount && kPathTracerPermutations[i].depthMax == depthMax)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+//	EOF
@@ -0,0 +1,52 @@
+#include "progressive_accumulator.h"
+#include "cpu_types.h"
+
+#include <cstring>
+
+#ifndef USE_IN_CPP
+#	define USE_IN_CPP
+#endif
+#include "../shaders/cbuffer.hlsli"
+
+
+void ProgressiveAccumulator::Update(const SceneCB& cbScene, const LightCB& cbLight, PathTraceCB* pPathTrace, bool bEnable)
+{
+	// the previous frame matrices only follow the camera, which is compared on its own.
+	SceneCB scene = cbScene;
+	memset(&scene.mtxProjToPrevProj, 0, sizeof(scene.mtxProjToPrevProj));
+	memset(&scene.mtxPrevViewToProj, 0, sizeof(scene.mtxPrevViewToProj));
+	LightCB light = cbLight;
+	light.pad0 = light.pad1 = light.pad2 = 0;
+	PathTraceCB pathTrace = *pPathTrace;
+	pathTrace.accumFrameIndex = 0;
+	pathTrace.accumEnable = 0;
+
+	std::vector<uint8_t> inputs(sizeof(scene) + sizeof(light) + sizeof(pathTrace));
+	memcpy(inputs.data(), &scene, sizeof(scene));
+	memcpy(inputs.data() + sizeof(scene), &light, sizeof(light));
+	memcpy(inputs.data() + sizeof(scene) + sizeof(light), &pathTrace, sizeof(pathTrace));
+
+	if (!bEnable)
+	{
+		lastInputs_.clear();
+		frameCount_ = 0;
+		sampleCount_ = 0;
+	}
+	else if (inputs != lastInputs_)
+	{
+		lastInputs_.swap(inputs);
+		frameCount_ = 1;
+		sampleCount_ = (uint64_t)pathTrace.sampleCount;
+		resetCount_++;
+	}
+	else
+	{
+		frameCount_++;
+		sampleCount_ += (uint64_t)pathTrace.sampleCount;
+	}
+
+	pPathTrace->accumFrameIndex = (frameCount_ > 0) ? frameCount_ - 1 : 0;
+	pPathTrace->accumEnable = bEnable ? 1 : 0;
+}
+
+//	EOF
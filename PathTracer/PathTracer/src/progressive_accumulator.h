@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+struct SceneCB;
+struct LightCB;
+struct PathTraceCB;
+
+// frame counter of the progressive mode.
+// the running mean restarts whenever an input of the path tracer changes, so a still camera
+// keeps adding decorrelated frames and the effective sample count grows at a constant cost per frame.
+class ProgressiveAccumulator
+{
+public:
+	// sets accumFrameIndex and accumEnable of pPathTrace for this frame, the other members are compared
+	// with the previous frame. a disabled frame also resets, the mean is not kept while nothing writes it.
+	void Update(const SceneCB& cbScene, const LightCB& cbLight, PathTraceCB* pPathTrace, bool bEnable);
+	// restarts the mean on the next Update(), for changes outside the constant buffers like moved instances.
+	void Invalidate() { lastInputs_.clear(); }
+
+	// frames in the running mean including the last updated one, 0 while disabled.
+	uint32_t GetFrameCount() const { return frameCount_; }
+	uint64_t GetSampleCount() const { return sampleCount_; }
+	uint64_t GetResetCount() const { return resetCount_; }
+
+private:
+	std::vector<uint8_t>	lastInputs_;
+	uint32_t				frameCount_ = 0;
+	uint64_t				sampleCount_ = 0;		// samples per pixel in the running mean.
+	uint64_t				resetCount_ = 0;
+};	// class ProgressiveAccumulator
+
+//	EOF
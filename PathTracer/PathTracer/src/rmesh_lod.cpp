@@ -0,0 +1,402 @@
+#include "rmesh_lod.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+
+namespace
+{
+	static const uint32_t kInvalidIndex = 0xffffffff;
+
+	// sum of squared distances to weighted planes, symmetric 4x4 stored as xx xy xz xw yy yz yw zz zw ww.
+	struct Quadric
+	{
+		double	m[10] = {};
+
+		void AddPlane(const Vec3& n, double d, double w)
+		{
+			double p[4] = { n.x, n.y, n.z, d };
+			int k = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				for (int j = i; j < 4; j++)
+				{
+					m[k++] += p[i] * p[j] * w;
+				}
+			}
+		}
+
+		void Add(const Quadric& q)
+		{
+			for (int i = 0; i < 10; i++)
+			{
+				m[i] += q.m[i];
+			}
+		}
+
+		double Evaluate(const Vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			return m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+				+ m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+				+ m[7] * z * z + 2.0 * m[8] * z
+				+ m[9];
+		}
+	};
+
+	// a triangle of the lod in cell ids, rotated so that the smallest cell is first and the winding is kept.
+	struct CellTriangle
+	{
+		uint32_t	submesh;
+		uint32_t	cells[3];
+
+		bool operator==(const CellTriangle& o) const
+		{
+			return submesh == o.submesh && cells[0] == o.cells[0] && cells[1] == o.cells[1] && cells[2] == o.cells[2];
+		}
+	};
+
+	struct CellTriangleHash
+	{
+		size_t operator()(const CellTriangle& t) const
+		{
+			uint64_t h = t.submesh;
+			for (int i = 0; i < 3; i++)
+			{
+				h = (h ^ t.cells[i]) * 0x100000001b3ull;
+			}
+			return (size_t)(h ^ (h >> 29));
+		}
+	};
+
+	// every vertex of every submesh in one flat array, submesh s starts at vertexBases[s].
+	struct SourceGeometry
+	{
+		std::vector<Vec3>		positions;
+		std::vector<uint32_t>	vertexBases;
+		std::vector<uint32_t>	indices;		// flat vertex indices, 3 per triangle.
+		std::vector<uint32_t>	triSubmeshes;
+		Aabb					bounds;
+	};
+
+	void GatherGeometry(const RMesh& mesh, SourceGeometry* pOut)
+	{
+		uint32_t base = 0;
+		for (auto&& submesh : mesh.submeshes)
+		{
+			pOut->vertexBases.push_back(base);
+			for (uint32_t v = 0; v < submesh.vertexCount; v++)
+			{
+				Vec3 p = mesh.GetPosition(submesh, v);
+				pOut->positions.push_back(p);
+				pOut->bounds.Grow(p);
+			}
+			base += submesh.vertexCount;
+		}
+		for (uint32_t s = 0; s < (uint32_t)mesh.submeshes.size(); s++)
+		{
+			auto&& submesh = mesh.submeshes[s];
+			for (uint32_t t = 0; t < submesh.indexCount / 3; t++)
+			{
+				uint32_t idx[3];
+				mesh.GetTriangle(submesh, t, idx);
+				for (int c = 0; c < 3; c++)
+				{
+					pOut->indices.push_back(pOut->vertexBases[s] + std::min(idx[c], submesh.vertexCount - 1));
+				}
+				pOut->triSubmeshes.push_back(s);
+			}
+		}
+	}
+
+	// cell of every vertex on a grid of resolution cells along the longest axis, returns the cell count.
+	uint32_t AssignCells(const SourceGeometry& geom, uint32_t resolution, std::vector<uint32_t>* pVertexCells)
+	{
+		Vec3 extent = geom.bounds.Extent();
+		float longest = std::max(extent.x, std::max(extent.y, extent.z));
+		float invCellSize = (longest > 0.0f) ? (float)resolution / longest : 0.0f;
+		std::unordered_map<uint64_t, uint32_t> cellIds;
+		cellIds.reserve(geom.positions.size());
+		pVertexCells->resize(geom.positions.size());
+		for (size_t v = 0; v < geom.positions.size(); v++)
+		{
+			Vec3 p = (geom.positions[v] - geom.bounds.bmin) * invCellSize;
+			uint64_t x = (uint64_t)std::min(std::max(p.x, 0.0f), (float)(resolution - 1));
+			uint64_t y = (uint64_t)std::min(std::max(p.y, 0.0f), (float)(resolution - 1));
+			uint64_t z = (uint64_t)std::min(std::max(p.z, 0.0f), (float)(resolution - 1));
+			uint64_t key = x | (y << 21) | (z << 42);
+			auto it = cellIds.emplace(key, (uint32_t)cellIds.size()).first;
+			(*pVertexCells)[v] = it->second;
+		}
+		return (uint32_t)cellIds.size();
+	}
+
+	// triangles that keep three different cells, duplicates within a submesh are removed.
+	void CollapseTriangles(const SourceGeometry& geom, const std::vector<uint32_t>& vertexCells, std::vector<CellTriangle>* pOut)
+	{
+		std::unordered_set<CellTriangle, CellTriangleHash> unique;
+		unique.reserve(geom.triSubmeshes.size());
+		pOut->clear();
+		for (size_t t = 0; t < geom.triSubmeshes.size(); t++)
+		{
+			uint32_t c[3] = { vertexCells[geom.indices[t * 3 + 0]], vertexCells[geom.indices[t * 3 + 1]], vertexCells[geom.indices[t * 3 + 2]] };
+			if (c[0] == c[1] || c[1] == c[2] || c[2] == c[0])
+			{
+				continue;
+			}
+			int first = (c[0] < c[1]) ? ((c[0] < c[2]) ? 0 : 2) : ((c[1] < c[2]) ? 1 : 2);
+			CellTriangle tri;
+			tri.submesh = geom.triSubmeshes[t];
+			for (int i = 0; i < 3; i++)
+			{
+				tri.cells[i] = c[(first + i) % 3];
+			}
+			if (unique.insert(tri).second)
+			{
+				pOut->push_back(tri);
+			}
+		}
+	}
+
+	void AppendElement(std::vector<uint8_t>& dst, const std::vector<uint8_t>& src, uint32_t offsetBytes, uint32_t stride)
+	{
+		if (src.empty())
+		{
+			return;
+		}
+		size_t begin = dst.size();
+		dst.resize(begin + stride, 0);
+		if ((size_t)offsetBytes + stride <= src.size())
+		{
+			memcpy(dst.data() + begin, src.data() + offsetBytes, stride);
+		}
+	}
+}
+
+bool SimplifyRMesh(const RMesh& source, uint32_t targetTriangles, const RMeshLodSettings& settings, RMesh* pOut, RMeshLodStats* pStats)
+{
+	SourceGeometry geom;
+	GatherGeometry(source, &geom);
+	if (geom.triSubmeshes.empty())
+	{
+		printf("Error: mesh has no triangles.\n");
+		return false;
+	}
+
+	// largest grid that meets the target, the triangle count grows with the resolution.
+	std::vector<uint32_t> vertexCells;
+	std::vector<CellTriangle> triangles;
+	uint32_t lo = 1, hi = std::max(settings.maxGridResolution, 1u);
+	while (lo < hi)
+	{
+		uint32_t mid = lo + (hi - lo + 1) / 2;
+		AssignCells(geom, mid, &vertexCells);
+		CollapseTriangles(geom, vertexCells, &triangles);
+		if (triangles.size() <= targetTriangles)
+		{
+			lo = mid;
+		}
+		else
+		{
+			hi = mid - 1;
+		}
+	}
+	uint32_t resolution = lo;
+	uint32_t cellCount = AssignCells(geom, resolution, &vertexCells);
+	CollapseTriangles(geom, vertexCells, &triangles);
+
+	// area weighted plane quadrics, the cell moves to its member with the smallest error.
+	std::vector<Quadric> cellQuadrics(cellCount);
+	for (size_t t = 0; t < geom.triSubmeshes.size(); t++)
+	{
+		const Vec3& p0 = geom.positions[geom.indices[t * 3 + 0]];
+		Vec3 n = Cross(geom.positions[geom.indices[t * 3 + 1]] - p0, geom.positions[geom.indices[t * 3 + 2]] - p0);
+		float len = Length(n);
+		if (len <= 0.0f)
+		{
+			continue;
+		}
+		n = n * (1.0f / len);
+		for (int c = 0; c < 3; c++)
+		{
+			cellQuadrics[vertexCells[geom.indices[t * 3 + c]]].AddPlane(n, -Dot(n, p0), len * 0.5);
+		}
+	}
+	std::vector<uint32_t> cellVertices(cellCount, kInvalidIndex);
+	std::vector<double> cellErrors(cellCount, 0.0);
+	for (uint32_t v = 0; v < (uint32_t)geom.positions.size(); v++)
+	{
+		uint32_t cell = vertexCells[v];
+		double e = cellQuadrics[cell].Evaluate(geom.positions[v]);
+		if (cellVertices[cell] == kInvalidIndex || e < cellErrors[cell])
+		{
+			cellVertices[cell] = v;
+			cellErrors[cell] = e;
+		}
+	}
+
+	// the submesh of each flat vertex, to read its stream offsets.
+	auto GetSubmesh = [&](uint32_t v)
+	{
+		return (uint32_t)(std::upper_bound(geom.vertexBases.begin(), geom.vertexBases.end(), v) - geom.vertexBases.begin()) - 1;
+	};
+
+	RMesh& out = *pOut;
+	out = RMesh();
+	out.materials = source.materials;
+	out.bounding = source.bounding;
+	out.positionScale = source.positionScale;
+	out.positionOffset = source.positionOffset;
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> localVertices(cellCount, kInvalidIndex);
+	std::vector<uint32_t> attributeVertices(cellCount, kInvalidIndex);
+	std::vector<float> attributeDistances(cellCount, 0.0f);
+	std::vector<uint32_t> touched;
+	RMeshLodStats stats;
+	stats.gridResolution = resolution;
+	size_t triBegin = 0;
+	for (uint32_t s = 0; s < (uint32_t)source.submeshes.size(); s++)
+	{
+		auto&& src = source.submeshes[s];
+		size_t triEnd = triBegin;
+		while (triEnd < triangles.size() && triangles[triEnd].submesh == s)
+		{
+			triEnd++;
+		}
+
+		// attributes come from the vertex of this submesh closest to the cell position.
+		for (uint32_t v = geom.vertexBases[s]; v < geom.vertexBases[s] + src.vertexCount; v++)
+		{
+			uint32_t cell = vertexCells[v];
+			float d = Length(geom.positions[v] - geom.positions[cellVertices[cell]]);
+			stats.maxError = std::max(stats.maxError, (double)d);
+			if (attributeVertices[cell] == kInvalidIndex)
+			{
+				touched.push_back(cell);
+			}
+			if (attributeVertices[cell] == kInvalidIndex || d < attributeDistances[cell])
+			{
+				attributeVertices[cell] = v - geom.vertexBases[s];
+				attributeDistances[cell] = d;
+			}
+		}
+
+		RMeshSubmesh dst = src;
+		dst.vertexOffset = out.GetTotalVertexCount();
+		dst.vertexCount = 0;
+		dst.indexOffset = (uint32_t)indices.size();
+		dst.indexCount = (uint32_t)(triEnd - triBegin) * 3;
+		for (size_t t = triBegin; t < triEnd; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t cell = triangles[t].cells[c];
+				if (localVertices[cell] == kInvalidIndex)
+				{
+					uint32_t posVertex = cellVertices[cell];
+					auto&& posSubmesh = source.submeshes[GetSubmesh(posVertex)];
+					uint32_t attrVertex = attributeVertices[cell];
+					localVertices[cell] = dst.vertexCount++;
+					AppendElement(out.position, source.position, posSubmesh.positionOffsetBytes + (posVertex - geom.vertexBases[GetSubmesh(posVertex)]) * RMesh::kPositionStride, RMesh::kPositionStride);
+					AppendElement(out.normal, source.normal, src.normalOffsetBytes + attrVertex * RMesh::kNormalStride, RMesh::kNormalStride);
+					AppendElement(out.tangent, source.tangent, src.tangentOffsetBytes + attrVertex * RMesh::kTangentStride, RMesh::kTangentStride);
+					AppendElement(out.texcoord, source.texcoord, src.texcoordOffsetBytes + attrVertex * RMesh::kTexcoordStride, RMesh::kTexcoordStride);
+				}
+				indices.push_back(localVertices[cell]);
+			}
+		}
+		for (auto cell : touched)
+		{
+			localVertices[cell] = attributeVertices[cell] = kInvalidIndex;
+		}
+		touched.clear();
+		triBegin = triEnd;
+		if (dst.indexCount == 0)
+		{
+			continue;
+		}
+
+		dst.positionOffsetBytes = dst.vertexOffset * RMesh::kPositionStride;
+		dst.normalOffsetBytes = dst.vertexOffset * RMesh::kNormalStride;
+		dst.tangentOffsetBytes = dst.vertexOffset * RMesh::kTangentStride;
+		dst.texcoordOffsetBytes = dst.vertexOffset * RMesh::kTexcoordStride;
+		dst.indexOffsetBytes = dst.indexOffset * RMesh::kIndexStride;
+		dst.indexFormat = kRMeshIndex32;
+		dst.meshlets.clear();
+		dst.meshletPrimitiveOffset = dst.meshletPrimitiveCount = 0;
+		dst.meshletVertexIndexOffset = dst.meshletVertexIndexCount = 0;
+		out.submeshes.push_back(dst);
+		stats.vertexCount += dst.vertexCount;
+	}
+
+	out.index.resize(indices.size() * sizeof(uint32_t));
+	if (!indices.empty())
+	{
+		memcpy(out.index.data(), indices.data(), out.index.size());
+	}
+	CompactRMeshIndices(&out);
+	stats.triangleCount = (uint32_t)(indices.size() / 3);
+	if (pStats)
+	{
+		*pStats = stats;
+	}
+	return true;
+}
+
+bool BuildRMeshLods(const RMesh& source, const RMeshLodSettings& settings, std::vector<RMesh>* pLods, std::vector<RMeshLodStats>* pStats)
+{
+	pLods->clear();
+	if (pStats)
+	{
+		pStats->clear();
+	}
+	uint32_t prevTriangles = source.GetTotalTriangleCount();
+	double target = (double)prevTriangles;
+	for (uint32_t level = 1; level < settings.levelCount; level++)
+	{
+		target *= settings.triangleRatio;
+		if (target < (double)settings.minTriangles)
+		{
+			break;
+		}
+		RMesh lod;
+		RMeshLodStats stats;
+		if (!SimplifyRMesh(source, (uint32_t)target, settings, &lod, &stats))
+		{
+			return false;
+		}
+		// a grid that cannot get coarser ends the chain.
+		if (stats.triangleCount >= prevTriangles || stats.triangleCount == 0)
+		{
+			break;
+		}
+		prevTriangles = stats.triangleCount;
+		pLods->push_back(std::move(lod));
+		if (pStats)
+		{
+			pStats->push_back(stats);
+		}
+	}
+	return true;
+}
+
+std::string GetRMeshLodPath(const std::string& filePath, uint32_t level)
+{
+	if (level == 0)
+	{
+		return filePath;
+	}
+	auto slash = filePath.find_last_of("/\\");
+	auto dot = filePath.find_last_of('.');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+	{
+		dot = filePath.size();
+	}
+	return filePath.substr(0, dot) + ".lod" + std::to_string(level) + filePath.substr(dot);
+}
+
+//	EOF
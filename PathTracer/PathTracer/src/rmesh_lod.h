@@ -0,0 +1,65 @@
+#pragma once
+
+#include "rmesh_reader.h"
+
+#include <string>
+#include <vector>
+
+
+struct RMeshLodSettings
+{
+	uint32_t	levelCount = 3;				// lod 0 is the source mesh.
+	float		triangleRatio = 0.25f;		// triangles of each level relative to the previous one.
+	uint32_t	minTriangles = 256;			// the chain stops before a level gets smaller than this.
+	uint32_t	maxGridResolution = 1 << 12;	// cells along the longest axis of the mesh.
+};
+
+struct RMeshLodStats
+{
+	uint32_t	gridResolution = 0;
+	uint32_t	triangleCount = 0;
+	uint32_t	vertexCount = 0;
+	double		maxError = 0.0;			// largest distance from a source vertex to its cluster vertex, in object space.
+};
+
+// simplifies every submesh to about targetTriangles over the whole mesh by vertex clustering.
+//   one grid covers the mesh, so that neighbouring submeshes collapse to the same cell positions and stay closed.
+//   each cell moves to the source vertex with the smallest quadric error of the cell.
+//   each submesh takes normal, tangent and texcoord of its own vertex closest to that position.
+// vertex streams keep only the referenced vertices, meshlets are dropped and empty submeshes removed.
+bool SimplifyRMesh(const RMesh& source, uint32_t targetTriangles, const RMeshLodSettings& settings, RMesh* pOut, RMeshLodStats* pStats = nullptr);
+
+// levels 1 to levelCount - 1 of the lod chain, each simplified from the source.
+bool BuildRMeshLods(const RMesh& source, const RMeshLodSettings& settings, std::vector<RMesh>* pLods, std::vector<RMeshLodStats>* pStats = nullptr);
+
+// smallest CpuLodParams::depth that -bench lod accepts.
+// lod 1 on the first bounce darkens the contact lighting seen from the camera beyond the error budget.
+static const uint32_t kLodDepthMin = 2;
+
+// lod chains are traced by the cpu path tracer, the app builds no lod instances.
+// instance mask bit n selects lod n of a mesh, the coarsest lod of a chain also takes every bit above it.
+static const uint32_t kLodLevelMax = 8;
+static const uint32_t kLodInstanceMaskAll = 0xff;
+
+// rays from lodDepth on trace one lod coarser per bounce, lodDepth 0 keeps full detail.
+inline uint32_t GetLodRayMask(uint32_t depth, uint32_t lodDepth)
+{
+	uint32_t level = (lodDepth == 0 || depth < lodDepth) ? 0 : depth - lodDepth + 1;
+	return 1u << (level < kLodLevelMax ? level : kLodLevelMax - 1);
+}
+
+inline uint32_t GetLodInstanceMask(uint32_t level, uint32_t levelCount)
+{
+	return (level + 1 < levelCount) ? (1u << level) : ((kLodInstanceMaskAll << level) & kLodInstanceMaskAll);
+}
+
+// a ray that leaves a finer lod would hit the coarse copy of its own surface, it starts past the distance between them.
+inline float GetLodRayTMin(uint32_t depth, uint32_t lodDepth, float lodRayTMin)
+{
+	return (depth > 0 && GetLodRayMask(depth, lodDepth) != GetLodRayMask(depth - 1, lodDepth)) ? lodRayTMin : 0.0f;
+}
+
+// file of a lod level next to the source, "mesh.rmesh" -> "mesh.lod1.rmesh", level 0 is the source.
+std::string GetRMeshLodPath(const std::string& filePath, uint32_t level);
+
+//	EOF
@@ -0,0 +1,379 @@
+#include "rmesh_opacity.h"
+
+#include "cpu_parallel.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+
+namespace
+{
+	// triangles per classification chunk.
+	static const size_t kMinChunkTriangles = 1024;
+	// bounding boxes of at most this many cells per axis are read from the alpha range chain.
+	static const int kCoarseCells = 2;
+
+	inline int FloorDiv(int v, int d)
+	{
+		return (v >= 0) ? v / d : -((-v + d - 1) / d);
+	}
+
+	inline uint32_t Wrap(int v, uint32_t size)
+	{
+		int r = v % (int)size;
+		return (uint32_t)(r < 0 ? r + (int)size : r);
+	}
+
+	// wrapped texel intervals of an unwrapped range [v0, v1], one or two.
+	uint32_t GetWrappedIntervals(int v0, int v1, uint32_t size, uint32_t outIntervals[2][2])
+	{
+		if ((int64_t)v1 - v0 + 1 >= size)
+		{
+			outIntervals[0][0] = 0;
+			outIntervals[0][1] = size - 1;
+			return 1;
+		}
+		uint32_t a = Wrap(v0, size), b = Wrap(v1, size);
+		if (a <= b)
+		{
+			outIntervals[0][0] = a;
+			outIntervals[0][1] = b;
+			return 1;
+		}
+		outIntervals[0][0] = a;
+		outIntervals[0][1] = size - 1;
+		outIntervals[1][0] = 0;
+		outIntervals[1][1] = b;
+		return 2;
+	}
+
+	// separating axis test of a triangle against an axis aligned box, the box axes are tested by the caller.
+	bool OverlapsBox(const Vec2 p[3], float bx0, float bx1, float by0, float by1)
+	{
+		for (int e = 0; e < 3; e++)
+		{
+			const Vec2& a = p[e];
+			const Vec2& b = p[(e + 1) % 3];
+			const Vec2& c = p[(e + 2) % 3];
+			float nx = a.y - b.y, ny = b.x - a.x;
+			float inside = nx * (c.x - a.x) + ny * (c.y - a.y);
+			float cx0 = nx * (bx0 - a.x), cx1 = nx * (bx1 - a.x);
+			float cy0 = ny * (by0 - a.y), cy1 = ny * (by1 - a.y);
+			float boxMin = std::min(cx0, cx1) + std::min(cy0, cy1);
+			float boxMax = std::max(cx0, cx1) + std::max(cy0, cy1);
+			if ((inside >= 0.0f && boxMax < 0.0f) || (inside < 0.0f && boxMin > 0.0f))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+void OpacityClassifier::Initialize(const CpuTexture& baseColor, float threshold, uint32_t maxRasterTexels)
+{
+	// MaterialAHS ignores the hit when the sampled alpha is below the threshold.
+	passAlpha_ = 0;
+	while (passAlpha_ < 256 && (float)passAlpha_ / 255.0f < threshold)
+	{
+		passAlpha_++;
+	}
+	maxRasterTexels_ = maxRasterTexels;
+
+	levels_.clear();
+	if (baseColor.GetMips().empty())
+	{
+		return;
+	}
+	auto&& mip = baseColor.GetMips()[0];
+	Level level;
+	level.width = mip.width;
+	level.height = mip.height;
+	level.minAlpha.resize((size_t)mip.width * mip.height);
+	for (size_t i = 0; i < level.minAlpha.size(); i++)
+	{
+		level.minAlpha[i] = mip.texels[i * 4 + 3];
+	}
+	level.maxAlpha = level.minAlpha;
+	levels_.push_back(std::move(level));
+
+	// texel x of level 0 is in cell x >> n of level n.
+	while (levels_.back().width > 1 || levels_.back().height > 1)
+	{
+		auto&& src = levels_.back();
+		Level dst;
+		dst.width = (src.width + 1) / 2;
+		dst.height = (src.height + 1) / 2;
+		dst.minAlpha.resize((size_t)dst.width * dst.height);
+		dst.maxAlpha.resize((size_t)dst.width * dst.height);
+		for (uint32_t y = 0; y < dst.height; y++)
+		{
+			for (uint32_t x = 0; x < dst.width; x++)
+			{
+				uint32_t mn = 255, mx = 0;
+				for (uint32_t cy = y * 2; cy <= std::min(y * 2 + 1, src.height - 1); cy++)
+				{
+					for (uint32_t cx = x * 2; cx <= std::min(x * 2 + 1, src.width - 1); cx++)
+					{
+						size_t i = (size_t)cy * src.width + cx;
+						mn = std::min<uint32_t>(mn, src.minAlpha[i]);
+						mx = std::max<uint32_t>(mx, src.maxAlpha[i]);
+					}
+				}
+				dst.minAlpha[(size_t)y * dst.width + x] = (uint8_t)mn;
+				dst.maxAlpha[(size_t)y * dst.width + x] = (uint8_t)mx;
+			}
+		}
+		levels_.push_back(std::move(dst));
+	}
+}
+
+void OpacityClassifier::GetAlphaRange(uint32_t level, int x0, int x1, int y0, int y1, uint32_t* pMin, uint32_t* pMax) const
+{
+	uint32_t xs[2][2], ys[2][2];
+	uint32_t xCount = GetWrappedIntervals(x0, x1, levels_[0].width, xs);
+	uint32_t yCount = GetWrappedIntervals(y0, y1, levels_[0].height, ys);
+	auto&& l = levels_[level];
+	uint32_t mn = 255, mx = 0;
+	for (uint32_t iy = 0; iy < yCount; iy++)
+	{
+		for (uint32_t ix = 0; ix < xCount; ix++)
+		{
+			for (uint32_t y = ys[iy][0] >> level; y <= (ys[iy][1] >> level); y++)
+			{
+				for (uint32_t x = xs[ix][0] >> level; x <= (xs[ix][1] >> level); x++)
+				{
+					size_t i = (size_t)y * l.width + x;
+					mn = std::min<uint32_t>(mn, l.minAlpha[i]);
+					mx = std::max<uint32_t>(mx, l.maxAlpha[i]);
+				}
+			}
+		}
+	}
+	*pMin = mn;
+	*pMax = mx;
+}
+
+RMeshTriangleOpacity OpacityClassifier::Classify(const Vec2 uvs[3]) const
+{
+	if (levels_.empty())
+	{
+		return kRMeshTriangleMixed;
+	}
+
+	// sample positions in texel space, a sample at p reads texels floor(p) and floor(p) + 1.
+	const Level& l0 = levels_[0];
+	Vec2 p[3];
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	for (int i = 0; i < 3; i++)
+	{
+		p[i] = Vec2(uvs[i].x * (float)l0.width - 0.5f, uvs[i].y * (float)l0.height - 0.5f);
+		minX = std::min(minX, p[i].x);
+		maxX = std::max(maxX, p[i].x);
+		minY = std::min(minY, p[i].y);
+		maxY = std::max(maxY, p[i].y);
+	}
+	const float kMaxCoord = 1e8f;
+	if (!(minX > -kMaxCoord && maxX < kMaxCoord && minY > -kMaxCoord && maxY < kMaxCoord))
+	{
+		return kRMeshTriangleMixed;
+	}
+	int x0 = (int)std::floor(minX), x1 = (int)std::floor(maxX) + 1;
+	int y0 = (int)std::floor(minY), y1 = (int)std::floor(maxY) + 1;
+
+	// alpha range of the bounding box from the coarsest level that keeps it within a few cells.
+	uint32_t level = 0;
+	while (level + 1 < (uint32_t)levels_.size()
+		&& (FloorDiv(x1, 1 << level) - FloorDiv(x0, 1 << level) >= kCoarseCells || FloorDiv(y1, 1 << level) - FloorDiv(y0, 1 << level) >= kCoarseCells))
+	{
+		level++;
+	}
+	uint32_t mn, mx;
+	GetAlphaRange(level, x0, x1, y0, y1, &mn, &mx);
+	if (mn >= passAlpha_)
+	{
+		return kRMeshTriangleOpaque;
+	}
+	if (mx < passAlpha_)
+	{
+		return kRMeshTriangleTransparent;
+	}
+
+	// rasterize the footprint on level 0, texel (x, y) is read by samples in (x - 1, x + 1) x (y - 1, y + 1).
+	if ((uint64_t)(x1 - x0 + 1) * (uint64_t)(y1 - y0 + 1) > maxRasterTexels_)
+	{
+		return kRMeshTriangleMixed;
+	}
+	bool bPass = false, bFail = false;
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			if (!OverlapsBox(p, (float)(x - 1), (float)(x + 1), (float)(y - 1), (float)(y + 1)))
+			{
+				continue;
+			}
+			uint32_t alpha = l0.minAlpha[(size_t)Wrap(y, l0.height) * l0.width + Wrap(x, l0.width)];
+			bPass = bPass || alpha >= passAlpha_;
+			bFail = bFail || alpha < passAlpha_;
+			if (bPass && bFail)
+			{
+				return kRMeshTriangleMixed;
+			}
+		}
+	}
+	if (bPass != bFail)
+	{
+		return bPass ? kRMeshTriangleOpaque : kRMeshTriangleTransparent;
+	}
+	return kRMeshTriangleMixed;
+}
+
+bool BakeRMeshOpacity(RMesh* pMesh, const std::vector<const CpuTexture*>& baseColors, const RMeshOpacitySettings& settings, std::vector<RMeshOpacityStats>* pStats)
+{
+	size_t materialCount = pMesh->materials.size();
+	pStats->assign(materialCount, RMeshOpacityStats());
+	std::vector<OpacityClassifier> classifiers(materialCount);
+	std::vector<bool> bBake(materialCount, false);
+	for (size_t m = 0; m < materialCount; m++)
+	{
+		auto&& mat = pMesh->materials[m];
+		(*pStats)[m].bMasked = !mat.isOpaque && !ClassifyMaterial(mat).bSkipAnyHit;
+		if ((*pStats)[m].bMasked && m < baseColors.size() && baseColors[m])
+		{
+			classifiers[m].Initialize(*baseColors[m], settings.threshold, settings.maxRasterTexels);
+			bBake[m] = true;
+		}
+	}
+
+	// opaque copies of the masked materials, created on first use.
+	std::vector<int> opaqueMaterials(materialCount, -1);
+	std::vector<RMeshSubmesh> submeshes;
+	std::vector<uint32_t> indices;
+	auto AppendSubmesh = [&](const RMeshSubmesh& src, const std::vector<uint32_t>& srcIndices, const std::vector<uint32_t>& tris, int materialIndex, bool bSplit)
+	{
+		RMeshSubmesh dst = src;
+		dst.materialIndex = materialIndex;
+		dst.indexOffset = (uint32_t)indices.size();
+		dst.indexCount = (uint32_t)tris.size() * 3;
+		dst.indexOffsetBytes = dst.indexOffset * RMesh::kIndexStride;
+		dst.indexFormat = kRMeshIndex32;
+		for (auto t : tris)
+		{
+			indices.insert(indices.end(), srcIndices.begin() + t * 3, srcIndices.begin() + t * 3 + 3);
+		}
+		if (bSplit)
+		{
+			// meshlets span every class of the source submesh.
+			dst.meshlets.clear();
+			dst.meshletPrimitiveOffset = dst.meshletPrimitiveCount = 0;
+			dst.meshletVertexIndexOffset = dst.meshletVertexIndexCount = 0;
+		}
+		submeshes.push_back(dst);
+	};
+
+	uint32_t threadCount = (settings.threadCount == 0) ? GetDefaultThreadCount() : settings.threadCount;
+	for (auto&& submesh : pMesh->submeshes)
+	{
+		uint32_t triCount = submesh.indexCount / 3;
+		std::vector<uint32_t> srcIndices((size_t)triCount * 3);
+		for (uint32_t t = 0; t < triCount; t++)
+		{
+			pMesh->GetTriangle(submesh, t, &srcIndices[t * 3]);
+		}
+		auto&& stats = (*pStats)[submesh.materialIndex];
+		std::vector<uint32_t> all(triCount);
+		for (uint32_t t = 0; t < triCount; t++)
+		{
+			all[t] = t;
+		}
+		if (!bBake[submesh.materialIndex])
+		{
+			stats.triangleCounts[stats.bMasked ? kRMeshTriangleMixed : kRMeshTriangleOpaque] += triCount;
+			AppendSubmesh(submesh, srcIndices, all, submesh.materialIndex, false);
+			continue;
+		}
+
+		// uvs are decoded like GetTriangleAttributes(), MaterialAHS tests the same values.
+		auto&& classifier = classifiers[submesh.materialIndex];
+		std::vector<uint8_t> classes(triCount);
+		ParallelChunks(triCount, GetChunkCount(triCount, threadCount, kMinChunkTriangles), [&](size_t begin, size_t end, uint32_t)
+		{
+			for (size_t t = begin; t < end; t++)
+			{
+				Vec2 uvs[3];
+				for (int c = 0; c < 3; c++)
+				{
+					uvs[c] = GetVertexTexcoord(pMesh->texcoord.data(), submesh.texcoordOffsetBytes, srcIndices[t * 3 + c]);
+				}
+				classes[t] = (uint8_t)classifier.Classify(uvs);
+			}
+		});
+
+		std::vector<uint32_t> tris[kRMeshTriangleOpacityMax];
+		for (uint32_t t = 0; t < triCount; t++)
+		{
+			tris[classes[t]].push_back(t);
+		}
+		for (int c = 0; c < kRMeshTriangleOpacityMax; c++)
+		{
+			stats.triangleCounts[c] += (uint32_t)tris[c].size();
+		}
+		if (tris[kRMeshTriangleMixed].size() == triCount)
+		{
+			AppendSubmesh(submesh, srcIndices, all, submesh.materialIndex, false);
+			continue;
+		}
+		if (!tris[kRMeshTriangleMixed].empty())
+		{
+			AppendSubmesh(submesh, srcIndices, tris[kRMeshTriangleMixed], submesh.materialIndex, true);
+		}
+		if (!tris[kRMeshTriangleOpaque].empty())
+		{
+			int& opaque = opaqueMaterials[submesh.materialIndex];
+			if (opaque < 0)
+			{
+				RMeshMaterial mat = pMesh->materials[submesh.materialIndex];
+				mat.name += "_opaque";
+				mat.isOpaque = true;
+				opaque = (int)pMesh->materials.size();
+				pMesh->materials.push_back(mat);
+			}
+			AppendSubmesh(submesh, srcIndices, tris[kRMeshTriangleOpaque], opaque, true);
+		}
+	}
+
+	pMesh->submeshes.swap(submeshes);
+	pMesh->index.resize(indices.size() * sizeof(uint32_t));
+	if (!indices.empty())
+	{
+		memcpy(pMesh->index.data(), indices.data(), pMesh->index.size());
+	}
+	CompactRMeshIndices(pMesh);
+	return true;
+}
+
+void LoadMaskedBaseColors(const RMesh& mesh, std::vector<CpuTexture>* pTextures, std::vector<const CpuTexture*>* pBaseColors)
+{
+	auto pos = mesh.filePath.find_last_of("/\\");
+	std::string dir = (pos == std::string::npos) ? std::string() : mesh.filePath.substr(0, pos + 1);
+	pTextures->clear();
+	pTextures->resize(mesh.materials.size());
+	pBaseColors->assign(mesh.materials.size(), nullptr);
+	for (size_t m = 0; m < mesh.materials.size(); m++)
+	{
+		auto&& mat = mesh.materials[m];
+		if (mat.isOpaque || ClassifyMaterial(mat).bSkipAnyHit)
+		{
+			continue;
+		}
+		// a missing texture leaves the material on the any hit.
+		if ((*pTextures)[m].LoadDDS(dir + mat.textureNames[kRMeshTexBaseColor]))
+		{
+			(*pBaseColors)[m] = &(*pTextures)[m];
+		}
+	}
+}
+
+//	EOF
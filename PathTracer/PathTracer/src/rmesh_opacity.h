@@ -0,0 +1,82 @@
+#pragma once
+
+#include "cpu_material_fold.h"
+#include "dds_reader.h"
+#include "rmesh_reader.h"
+
+#include <vector>
+
+
+// result of the alpha test of MaterialAHS over a whole triangle.
+enum RMeshTriangleOpacity
+{
+	kRMeshTriangleOpaque,			// every hit passes, no any hit needed.
+	kRMeshTriangleTransparent,		// every hit is ignored, the triangle can be removed.
+	kRMeshTriangleMixed,			// keeps the any hit.
+
+	kRMeshTriangleOpacityMax
+};
+
+// conservative alpha ranges of a base color texture.
+// level 0 is the mip MaterialAHS samples, each coarser level holds the min and max of 2x2 cells.
+// the mips stored in the dds are averages and cannot bound the alpha test, so the chain is built here.
+class OpacityClassifier
+{
+public:
+	void Initialize(const CpuTexture& baseColor, float threshold = kMaterialOpacityThreshold, uint32_t maxRasterTexels = 1 << 18);
+
+	// every point of the triangle sampled like MaterialAHS, bilinear with wrap addressing.
+	// triangles whose footprint is too large to rasterize are mixed.
+	RMeshTriangleOpacity Classify(const Vec2 uvs[3]) const;
+
+	uint32_t GetWidth() const { return levels_.empty() ? 0 : levels_[0].width; }
+	uint32_t GetHeight() const { return levels_.empty() ? 0 : levels_[0].height; }
+
+private:
+	struct Level
+	{
+		uint32_t				width;
+		uint32_t				height;
+		std::vector<uint8_t>	minAlpha;
+		std::vector<uint8_t>	maxAlpha;
+	};
+
+	void GetAlphaRange(uint32_t level, int x0, int x1, int y0, int y1, uint32_t* pMin, uint32_t* pMax) const;
+
+private:
+	std::vector<Level>	levels_;
+	uint32_t			passAlpha_ = 0;		// smallest 8 bit alpha that passes the test.
+	uint32_t			maxRasterTexels_ = 0;
+};	// class OpacityClassifier
+
+struct RMeshOpacitySettings
+{
+	float		threshold = kMaterialOpacityThreshold;
+	uint32_t	maxRasterTexels = 1 << 18;		// level 0 texels per triangle before it is left mixed.
+	uint32_t	threadCount = 0;				// 0 uses all hardware threads.
+};
+
+// triangles of one material by class.
+struct RMeshOpacityStats
+{
+	bool		bMasked = false;				// the material runs MaterialAHS.
+	uint32_t	triangleCounts[kRMeshTriangleOpacityMax] = {};
+
+	uint32_t GetTriangleCount() const { return triangleCounts[0] + triangleCounts[1] + triangleCounts[2]; }
+	// triangles that still run the any hit, all of them for a masked material without the bake.
+	double GetAnyHitFraction() const { return GetTriangleCount() ? (double)triangleCounts[kRMeshTriangleMixed] / GetTriangleCount() : 0.0; }
+};
+
+// classifies the triangles of every masked material and splits their submeshes.
+//   opaque triangles move to a submesh with an opaque copy of the material, so they use the opaque hit group.
+//   transparent triangles are removed, MaterialAHS ignores every hit on them.
+//   mixed triangles stay on the masked material.
+// baseColors[materialIndex] is the base color texture, null for materials that are not baked.
+// split submeshes share the vertex range of the source and drop their meshlets.
+bool BakeRMeshOpacity(RMesh* pMesh, const std::vector<const CpuTexture*>& baseColors, const RMeshOpacitySettings& settings, std::vector<RMeshOpacityStats>* pStats);
+
+// base color textures of the masked materials, from the directory of mesh.filePath.
+// pTextures owns the textures, pBaseColors points into it and is null for the other materials.
+void LoadMaskedBaseColors(const RMesh& mesh, std::vector<CpuTexture>* pTextures, std::vector<const CpuTexture*>* pBaseColors);
+
+//	EOF
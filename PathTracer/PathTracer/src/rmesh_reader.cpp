@@ -0,0 +1,694 @@
+#include "rmesh_reader.h"
+
+#include "cpu_parallel.h"
+#include "mapped_file.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+
+namespace
+{
+	// cereal binary archive reader.
+	class ArchiveReader
+	{
+	public:
+		ArchiveReader(const uint8_t* pData, size_t size)
+			: pData_(pData), size_(size), pos_(0), bError_(false)
+		{}
+
+		bool IsError() const { return bError_; }
+		size_t GetPosition() const { return pos_; }
+
+		void Read(void* pDst, size_t size)
+		{
+			if (bError_ || pos_ + size > size_)
+			{
+				bError_ = true;
+				memset(pDst, 0, size);
+				return;
+			}
+			memcpy(pDst, pData_ + pos_, size);
+			pos_ += size;
+		}
+
+		template <typename T>
+		T Read()
+		{
+			T ret;
+			Read(&ret, sizeof(ret));
+			return ret;
+		}
+
+		uint64_t ReadSize()
+		{
+			uint64_t ret = Read<uint64_t>();
+			// sanity check, no element is smaller than 1 byte.
+			if (ret > size_ - pos_)
+			{
+				bError_ = true;
+				return 0;
+			}
+			return ret;
+		}
+
+		std::string ReadString()
+		{
+			uint64_t len = ReadSize();
+			std::string ret;
+			if (!bError_)
+			{
+				ret.assign((const char*)pData_ + pos_, (size_t)len);
+				pos_ += (size_t)len;
+			}
+			return ret;
+		}
+
+		// returns the range of a byte array without copying it.
+		void SkipBytes(const uint8_t** ppData, size_t* pSize)
+		{
+			uint64_t len = ReadSize();
+			*ppData = pData_ + pos_;
+			*pSize = bError_ ? 0 : (size_t)len;
+			pos_ += *pSize;
+		}
+
+	private:
+		const uint8_t*	pData_;
+		size_t			size_;
+		size_t			pos_;
+		bool			bError_;
+	};	// class ArchiveReader
+
+	void ReadBounding(ArchiveReader& ar, RMeshBounding& b)
+	{
+		ar.Read(b.sphereCenter, sizeof(b.sphereCenter));
+		b.sphereRadius = ar.Read<float>();
+		ar.Read(b.boxMin, sizeof(b.boxMin));
+		ar.Read(b.boxMax, sizeof(b.boxMax));
+	}
+
+	// cereal binary archive writer, the counterpart of ArchiveReader.
+	class ArchiveWriter
+	{
+	public:
+		ArchiveWriter(std::vector<uint8_t>* pOut)
+			: pOut_(pOut)
+		{}
+
+		void Write(const void* pSrc, size_t size)
+		{
+			pOut_->insert(pOut_->end(), (const uint8_t*)pSrc, (const uint8_t*)pSrc + size);
+		}
+
+		template <typename T>
+		void Write(const T& v)
+		{
+			Write(&v, sizeof(v));
+		}
+
+		void WriteSize(size_t size)
+		{
+			Write<uint64_t>(size);
+		}
+
+		void WriteString(const std::string& s)
+		{
+			WriteSize(s.size());
+			Write(s.data(), s.size());
+		}
+
+		void WriteBytes(const void* pSrc, size_t size)
+		{
+			WriteSize(size);
+			Write(pSrc, size);
+		}
+
+	private:
+		std::vector<uint8_t>*	pOut_;
+	};	// class ArchiveWriter
+
+	void WriteBounding(ArchiveWriter& ar, const RMeshBounding& b)
+	{
+		ar.Write(b.sphereCenter, sizeof(b.sphereCenter));
+		ar.Write(b.sphereRadius);
+		ar.Write(b.boxMin, sizeof(b.boxMin));
+		ar.Write(b.boxMax, sizeof(b.boxMax));
+	}
+
+	int16_t QuantizeSNorm16(float v)
+	{
+		v = std::min(std::max(v, -1.0f), 1.0f);
+		return (int16_t)std::lround(v * 32767.0f);
+	}
+
+	int8_t QuantizeSNorm8(float v)
+	{
+		v = std::min(std::max(v, -1.0f), 1.0f);
+		return (int8_t)std::lround(v * 127.0f);
+	}
+
+	// elements per decode chunk.
+	static const size_t kDecodeChunkVertices = 1 << 16;
+	static const size_t kDecodeChunkBytes = 1 << 20;
+
+	// float streams are converted to the packed layout.
+	// hp_suzanne is exported with raw float3 position/normal, float4 tangent and float2 texcoord.
+	void DecodeRange(const RMeshView& view, int stream, uint8_t* pDst, size_t begin, size_t end)
+	{
+		auto&& sv = view.streams[stream];
+		if (!sv.IsConverted())
+		{
+			memcpy(pDst + begin, sv.pData + begin, end - begin);
+			return;
+		}
+
+		// unaligned float reads, the streams are not aligned in the archive.
+		auto LoadFloat = [](const uint8_t* p, size_t index)
+		{
+			float ret;
+			memcpy(&ret, p + index * sizeof(float), sizeof(ret));
+			return ret;
+		};
+		switch (stream)
+		{
+		case kRMeshStreamPosition:
+		{
+			const Vec3 invScale(1.0f / view.positionScale.x, 1.0f / view.positionScale.y, 1.0f / view.positionScale.z);
+			for (size_t i = begin; i < end; i++)
+			{
+				const uint8_t* src = sv.pData + i * sv.srcStride;
+				Vec3 p = (Vec3(LoadFloat(src, 0), LoadFloat(src, 1), LoadFloat(src, 2)) - view.positionOffset) * invScale;
+				int16_t dst[4] = { QuantizeSNorm16(p.x), QuantizeSNorm16(p.y), QuantizeSNorm16(p.z), 32767 };
+				memcpy(pDst + i * RMesh::kPositionStride, dst, sizeof(dst));
+			}
+			break;
+		}
+		case kRMeshStreamNormal:
+		case kRMeshStreamTangent:
+		{
+			size_t floatCount = sv.srcStride / sizeof(float);
+			for (size_t i = begin; i < end; i++)
+			{
+				const uint8_t* src = sv.pData + i * sv.srcStride;
+				int8_t* dst = (int8_t*)pDst + i * 4;
+				for (size_t c = 0; c < 4; c++)
+				{
+					dst[c] = (c < floatCount) ? QuantizeSNorm8(LoadFloat(src, c)) : 0;
+				}
+			}
+			break;
+		}
+		case kRMeshStreamTexcoord:
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				const uint8_t* src = sv.pData + i * sv.srcStride;
+				uint16_t dst[2] = { FloatToHalf(LoadFloat(src, 0)), FloatToHalf(LoadFloat(src, 1)) };
+				memcpy(pDst + i * RMesh::kTexcoordStride, dst, sizeof(dst));
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	std::vector<uint8_t>* GetStream(RMesh* pMesh, int stream)
+	{
+		std::vector<uint8_t>* streams[] = {
+			&pMesh->position, &pMesh->normal, &pMesh->tangent, &pMesh->texcoord,
+			&pMesh->index, &pMesh->meshletPackedPrimitive, &pMesh->meshletVertexIndex,
+		};
+		static_assert(sizeof(streams) / sizeof(streams[0]) == kRMeshStreamMax, "stream count mismatch.");
+		return streams[stream];
+	}
+
+	float SNormToFloat(int v, float scale)
+	{
+		float scaledV = (float)v * scale;
+		return std::max(scaledV, -1.0f);
+	}
+
+	uint32_t LoadU32(const uint8_t* pBuffer, uint32_t address)
+	{
+		uint32_t ret;
+		memcpy(&ret, pBuffer + address, sizeof(ret));
+		return ret;
+	}
+}
+
+size_t RMeshView::GetPackedSize() const
+{
+	size_t ret = 0;
+	for (auto&& sv : streams)
+	{
+		ret += sv.GetPackedSize();
+	}
+	return ret;
+}
+
+bool ParseRMeshView(const uint8_t* pData, size_t size, RMeshView* pOut)
+{
+	ArchiveReader ar(pData, size);
+
+	// materials.
+	uint64_t materialCount = ar.ReadSize();
+	pOut->materials.resize((size_t)materialCount);
+	for (auto&& mat : pOut->materials)
+	{
+		mat.name = ar.ReadString();
+		uint64_t texCount = ar.ReadSize();
+		mat.textureNames.resize((size_t)texCount);
+		for (auto&& tex : mat.textureNames)
+		{
+			tex = ar.ReadString();
+		}
+		ar.Read(mat.baseColor, sizeof(mat.baseColor));
+		ar.Read(mat.emissiveColor, sizeof(mat.emissiveColor));
+		mat.roughness = ar.Read<float>();
+		mat.metallic = ar.Read<float>();
+		mat.isOpaque = ar.Read<uint8_t>() != 0;
+		if (ar.IsError())
+		{
+			return false;
+		}
+	}
+
+	// submeshes.
+	uint64_t submeshCount = ar.ReadSize();
+	pOut->submeshes.resize((size_t)submeshCount);
+	for (auto&& submesh : pOut->submeshes)
+	{
+		submesh.materialIndex = ar.Read<int32_t>();
+		submesh.vertexOffset = ar.Read<uint32_t>();
+		submesh.vertexCount = ar.Read<uint32_t>();
+		submesh.indexOffset = ar.Read<uint32_t>();
+		submesh.indexCount = ar.Read<uint32_t>();
+		submesh.meshletPrimitiveOffset = ar.Read<uint32_t>();
+		submesh.meshletPrimitiveCount = ar.Read<uint32_t>();
+		submesh.meshletVertexIndexOffset = ar.Read<uint32_t>();
+		submesh.meshletVertexIndexCount = ar.Read<uint32_t>();
+
+		uint64_t meshletCount = ar.ReadSize();
+		submesh.meshlets.resize((size_t)meshletCount);
+		for (auto&& meshlet : submesh.meshlets)
+		{
+			// 6 x u32 + 17 x float, all 4 byte.
+			ar.Read(&meshlet, sizeof(meshlet));
+		}
+		ReadBounding(ar, submesh.bounding);
+		if (ar.IsError())
+		{
+			return false;
+		}
+	}
+	ReadBounding(ar, pOut->bounding);
+
+	// streams, only their ranges are recorded.
+	for (auto&& sv : pOut->streams)
+	{
+		sv = RMeshStreamView();
+		ar.SkipBytes(&sv.pData, &sv.size);
+	}
+	if (ar.IsError())
+	{
+		return false;
+	}
+
+	// positions are quantized into the mesh bounding box.
+	const RMeshBounding& b = pOut->bounding;
+	pOut->positionOffset = Vec3(b.boxMax[0] + b.boxMin[0], b.boxMax[1] + b.boxMin[1], b.boxMax[2] + b.boxMin[2]) * 0.5f;
+	pOut->positionScale = Vec3(b.boxMax[0] - b.boxMin[0], b.boxMax[1] - b.boxMin[1], b.boxMax[2] - b.boxMin[2]);
+	for (int i = 0; i < 3; i++)
+	{
+		if (pOut->positionScale[i] <= 0.0f)
+		{
+			pOut->positionScale[i] = 1.0f;
+		}
+	}
+
+	pOut->vertexCount = 0;
+	for (auto&& submesh : pOut->submeshes)
+	{
+		pOut->vertexCount = std::max(pOut->vertexCount, submesh.vertexOffset + submesh.vertexCount);
+	}
+
+	// vertex streams are either packed or raw floats.
+	if (pOut->vertexCount > 0)
+	{
+		struct StreamFormat
+		{
+			int			stream;
+			uint32_t	packedStride;
+			uint32_t	floatStride;
+		};
+		static const StreamFormat kFormats[] = {
+			{ kRMeshStreamPosition,	RMesh::kPositionStride,	sizeof(float) * 3 },
+			{ kRMeshStreamNormal,	RMesh::kNormalStride,	sizeof(float) * 3 },
+			{ kRMeshStreamTangent,	RMesh::kTangentStride,	sizeof(float) * 4 },
+			{ kRMeshStreamTexcoord,	RMesh::kTexcoordStride,	sizeof(float) * 2 },
+		};
+		for (auto&& f : kFormats)
+		{
+			auto&& sv = pOut->streams[f.stream];
+			size_t stride = sv.size / pOut->vertexCount;
+			if (stride != f.packedStride && stride != f.floatStride)
+			{
+				return false;
+			}
+			sv.srcStride = (uint32_t)stride;
+			sv.dstStride = f.packedStride;
+			sv.elementCount = pOut->vertexCount;
+		}
+	}
+
+	// submesh ranges in the decoded streams.
+	size_t positionSize = pOut->streams[kRMeshStreamPosition].GetPackedSize();
+	size_t indexSize = pOut->streams[kRMeshStreamIndex].GetPackedSize();
+	for (auto&& submesh : pOut->submeshes)
+	{
+		if ((size_t)(submesh.vertexOffset + submesh.vertexCount) * RMesh::kPositionStride > positionSize
+			|| (size_t)(submesh.indexOffset + submesh.indexCount) * RMesh::kIndexStride > indexSize
+			|| submesh.materialIndex < 0 || submesh.materialIndex >= (int)pOut->materials.size())
+		{
+			return false;
+		}
+		submesh.positionOffsetBytes = submesh.vertexOffset * RMesh::kPositionStride;
+		submesh.normalOffsetBytes = submesh.vertexOffset * RMesh::kNormalStride;
+		submesh.tangentOffsetBytes = submesh.vertexOffset * RMesh::kTangentStride;
+		submesh.texcoordOffsetBytes = submesh.vertexOffset * RMesh::kTexcoordStride;
+		submesh.indexOffsetBytes = submesh.indexOffset * RMesh::kIndexStride;
+		submesh.indexFormat = kRMeshIndex32;
+	}
+
+	return true;
+}
+
+void DecodeRMeshStreams(const RMeshView& view, uint8_t* const pDst[kRMeshStreamMax], uint32_t threadCount)
+{
+	// chunks of converted elements or copied bytes.
+	struct Chunk
+	{
+		int		stream;
+		size_t	begin;
+		size_t	end;
+	};
+	std::vector<Chunk> chunks;
+	for (int s = 0; s < kRMeshStreamMax; s++)
+	{
+		auto&& sv = view.streams[s];
+		size_t count = sv.IsConverted() ? sv.elementCount : sv.size;
+		size_t step = sv.IsConverted() ? kDecodeChunkVertices : kDecodeChunkBytes;
+		for (size_t begin = 0; begin < count; begin += step)
+		{
+			chunks.push_back({ s, begin, std::min(count, begin + step) });
+		}
+	}
+
+	threadCount = (threadCount == 0) ? GetDefaultThreadCount() : threadCount;
+	std::atomic<size_t> next(0);
+	ParallelChunks(chunks.size(), GetChunkCount(chunks.size(), threadCount, 1), [&](size_t, size_t, uint32_t)
+	{
+		for (size_t i = next++; i < chunks.size(); i = next++)
+		{
+			auto&& c = chunks[i];
+			DecodeRange(view, c.stream, pDst[c.stream], c.begin, c.end);
+		}
+	});
+}
+
+bool ReadRMesh(const uint8_t* pData, size_t size, RMesh* pOut, uint32_t threadCount)
+{
+	RMeshView view;
+	if (!ParseRMeshView(pData, size, &view))
+	{
+		return false;
+	}
+
+	pOut->materials = std::move(view.materials);
+	pOut->submeshes = std::move(view.submeshes);
+	pOut->bounding = view.bounding;
+	pOut->positionScale = view.positionScale;
+	pOut->positionOffset = view.positionOffset;
+
+	uint8_t* pDst[kRMeshStreamMax];
+	for (int s = 0; s < kRMeshStreamMax; s++)
+	{
+		auto stream = GetStream(pOut, s);
+		stream->resize(view.streams[s].GetPackedSize());
+		pDst[s] = stream->data();
+	}
+	DecodeRMeshStreams(view, pDst, threadCount);
+	CompactRMeshIndices(pOut);
+	return true;
+}
+
+size_t CompactRMeshIndices(RMesh* pMesh)
+{
+	// fewer than 65536 vertices keeps every index below 0xffff, the strip cut value of 16 bit index buffers.
+	const uint32_t kMaxVertexCount16 = 0x10000;
+
+	std::vector<uint8_t> compact;
+	compact.reserve(pMesh->index.size());
+	for (auto&& submesh : pMesh->submeshes)
+	{
+		const uint8_t* pSrc = pMesh->index.data() + submesh.indexOffsetBytes;
+		uint32_t stride = (submesh.indexFormat == kRMeshIndex16) ? RMesh::kIndex16Stride : RMesh::kIndexStride;
+		std::vector<uint32_t> indices(submesh.indexCount);
+		uint32_t maxIndex = 0;
+		for (uint32_t i = 0; i < submesh.indexCount; i++)
+		{
+			if (stride == RMesh::kIndex16Stride)
+			{
+				uint16_t v;
+				memcpy(&v, pSrc + i * stride, sizeof(v));
+				indices[i] = v;
+			}
+			else
+			{
+				memcpy(&indices[i], pSrc + i * stride, sizeof(uint32_t));
+			}
+			maxIndex = std::max(maxIndex, indices[i]);
+		}
+
+		// every submesh starts 4 byte aligned and 16 bit ranges are padded to 4 bytes,
+		// so that the Load2() of GetTriangleIndices2byte() stays inside the range.
+		submesh.indexOffsetBytes = (uint32_t)compact.size();
+		if (submesh.vertexCount < kMaxVertexCount16 && maxIndex < submesh.vertexCount)
+		{
+			submesh.indexFormat = kRMeshIndex16;
+			for (auto v : indices)
+			{
+				uint16_t v16 = (uint16_t)v;
+				compact.insert(compact.end(), (const uint8_t*)&v16, (const uint8_t*)&v16 + sizeof(v16));
+			}
+			compact.resize((compact.size() + 3) & ~(size_t)3, 0);
+		}
+		else
+		{
+			submesh.indexFormat = kRMeshIndex32;
+			compact.insert(compact.end(), (const uint8_t*)indices.data(), (const uint8_t*)(indices.data() + indices.size()));
+		}
+	}
+
+	size_t saved = (pMesh->index.size() > compact.size()) ? pMesh->index.size() - compact.size() : 0;
+	pMesh->index.swap(compact);
+	return saved;
+}
+
+bool LoadRMesh(const std::string& filePath, RMesh* pOut, uint32_t threadCount)
+{
+	MappedFile file;
+	if (!file.Open(filePath))
+	{
+		printf("Error: failed to open mesh file. (%s)\n", filePath.c_str());
+		return false;
+	}
+
+	if (!ReadRMesh(file.GetData(), file.GetSize(), pOut, threadCount))
+	{
+		printf("Error: invalid mesh file. (%s)\n", filePath.c_str());
+		return false;
+	}
+	pOut->filePath = filePath;
+	return true;
+}
+
+bool EncodeRMesh(const RMesh& mesh, std::vector<uint8_t>* pOut)
+{
+	pOut->clear();
+	ArchiveWriter ar(pOut);
+
+	ar.WriteSize(mesh.materials.size());
+	for (auto&& mat : mesh.materials)
+	{
+		ar.WriteString(mat.name);
+		ar.WriteSize(mat.textureNames.size());
+		for (auto&& tex : mat.textureNames)
+		{
+			ar.WriteString(tex);
+		}
+		ar.Write(mat.baseColor, sizeof(mat.baseColor));
+		ar.Write(mat.emissiveColor, sizeof(mat.emissiveColor));
+		ar.Write(mat.roughness);
+		ar.Write(mat.metallic);
+		ar.Write<uint8_t>(mat.isOpaque ? 1 : 0);
+	}
+
+	// the file stores 32 bit indices at indexOffset, whatever the in-memory format is.
+	size_t indexCount = 0;
+	ar.WriteSize(mesh.submeshes.size());
+	for (auto&& submesh : mesh.submeshes)
+	{
+		ar.Write<int32_t>(submesh.materialIndex);
+		ar.Write(submesh.vertexOffset);
+		ar.Write(submesh.vertexCount);
+		ar.Write(submesh.indexOffset);
+		ar.Write(submesh.indexCount);
+		ar.Write(submesh.meshletPrimitiveOffset);
+		ar.Write(submesh.meshletPrimitiveCount);
+		ar.Write(submesh.meshletVertexIndexOffset);
+		ar.Write(submesh.meshletVertexIndexCount);
+		ar.WriteSize(submesh.meshlets.size());
+		ar.Write(submesh.meshlets.data(), submesh.meshlets.size() * sizeof(RMeshMeshlet));
+		WriteBounding(ar, submesh.bounding);
+		indexCount = std::max(indexCount, (size_t)submesh.indexOffset + submesh.indexCount);
+	}
+	WriteBounding(ar, mesh.bounding);
+
+	std::vector<uint32_t> indices(indexCount, 0);
+	for (auto&& submesh : mesh.submeshes)
+	{
+		if (submesh.indexCount % 3 != 0)
+		{
+			printf("Error: submesh index count is not a multiple of 3.\n");
+			return false;
+		}
+		for (uint32_t t = 0; t < submesh.indexCount / 3; t++)
+		{
+			mesh.GetTriangle(submesh, t, &indices[submesh.indexOffset + t * 3]);
+		}
+	}
+
+	// vertex streams are written packed, ParseRMeshView() tells the layouts apart by their stride.
+	ar.WriteBytes(mesh.position.data(), mesh.position.size());
+	ar.WriteBytes(mesh.normal.data(), mesh.normal.size());
+	ar.WriteBytes(mesh.tangent.data(), mesh.tangent.size());
+	ar.WriteBytes(mesh.texcoord.data(), mesh.texcoord.size());
+	ar.WriteBytes(indices.data(), indices.size() * sizeof(uint32_t));
+	ar.WriteBytes(mesh.meshletPackedPrimitive.data(), mesh.meshletPackedPrimitive.size());
+	ar.WriteBytes(mesh.meshletVertexIndex.data(), mesh.meshletVertexIndex.size());
+	return true;
+}
+
+bool WriteRMesh(const std::string& filePath, const RMesh& mesh)
+{
+	std::vector<uint8_t> data;
+	if (!EncodeRMesh(mesh, &data))
+	{
+		return false;
+	}
+	FILE* fp = fopen(filePath.c_str(), "wb");
+	if (!fp)
+	{
+		printf("Error: failed to open output file. (%s)\n", filePath.c_str());
+		return false;
+	}
+	bool bSuccess = fwrite(data.data(), 1, data.size(), fp) == data.size();
+	fclose(fp);
+	if (!bSuccess)
+	{
+		printf("Error: failed to write mesh file. (%s)\n", filePath.c_str());
+	}
+	return bSuccess;
+}
+
+Vec3 RMesh::GetPosition(const RMeshSubmesh& submesh, uint32_t vertexIndex) const
+{
+	return GetVertexPosition(position.data(), submesh.positionOffsetBytes, vertexIndex) * positionScale + positionOffset;
+}
+
+void RMesh::GetTriangle(const RMeshSubmesh& submesh, uint32_t triIndex, uint32_t outIndices[3]) const
+{
+	GetVertexIndices(index.data(), submesh.indexOffsetBytes, submesh.indexFormat, triIndex, outIndices);
+}
+
+void GetVertexIndices16(const uint8_t* pBuffer, uint32_t startOffset, uint32_t triIndex, uint32_t outIndices[3])
+{
+	// GetTriangleIndices2byte().
+	uint32_t offset = startOffset + triIndex * 2 * 3;
+	uint32_t alignedOffset = offset & ~0x3;
+	uint32_t i0 = LoadU32(pBuffer, alignedOffset);
+	uint32_t i1 = LoadU32(pBuffer, alignedOffset + 4);
+	if (alignedOffset == offset)
+	{
+		outIndices[0] = i0 & 0xffff;
+		outIndices[1] = (i0 >> 16) & 0xffff;
+		outIndices[2] = i1 & 0xffff;
+	}
+	else
+	{
+		outIndices[0] = (i0 >> 16) & 0xffff;
+		outIndices[1] = i1 & 0xffff;
+		outIndices[2] = (i1 >> 16) & 0xffff;
+	}
+}
+
+void GetVertexIndices32(const uint8_t* pBuffer, uint32_t startOffset, uint32_t triIndex, uint32_t outIndices[3])
+{
+	uint32_t address = startOffset + triIndex * 3 * 4;
+	outIndices[0] = LoadU32(pBuffer, address + 0);
+	outIndices[1] = LoadU32(pBuffer, address + 4);
+	outIndices[2] = LoadU32(pBuffer, address + 8);
+}
+
+void GetVertexIndices(const uint8_t* pBuffer, uint32_t startOffset, uint32_t indexFormat, uint32_t triIndex, uint32_t outIndices[3])
+{
+	if (indexFormat == kRMeshIndex16)
+	{
+		GetVertexIndices16(pBuffer, startOffset, triIndex, outIndices);
+	}
+	else
+	{
+		GetVertexIndices32(pBuffer, startOffset, triIndex, outIndices);
+	}
+}
+
+Vec3 GetVertexPosition(const uint8_t* pBuffer, uint32_t startOffset, uint32_t index)
+{
+	const float kScale = 1.0f / 32767.0f;
+	uint32_t address = startOffset + index * 8;
+	uint32_t x = LoadU32(pBuffer, address);
+	uint32_t y = LoadU32(pBuffer, address + 4);
+	return Vec3(
+		SNormToFloat((int16_t)(x & 0xffff), kScale),
+		SNormToFloat((int16_t)(x >> 16), kScale),
+		SNormToFloat((int16_t)(y & 0xffff), kScale));
+}
+
+Vec3 GetVertexNormal(const uint8_t* pBuffer, uint32_t startOffset, uint32_t index)
+{
+	return GetVertexTangent(pBuffer, startOffset, index).xyz();
+}
+
+Vec4 GetVertexTangent(const uint8_t* pBuffer, uint32_t startOffset, uint32_t index)
+{
+	// SNorm8ToFloat32_Vector().
+	const float kScale = 1.0f / 127.0f;
+	uint32_t v = LoadU32(pBuffer, startOffset + index * 4);
+	return Vec4(
+		SNormToFloat((int8_t)(v & 0xff), kScale),
+		SNormToFloat((int8_t)((v >> 8) & 0xff), kScale),
+		SNormToFloat((int8_t)((v >> 16) & 0xff), kScale),
+		SNormToFloat((int8_t)((v >> 24) & 0xff), kScale));
+}
+
+Vec2 GetVertexTexcoord(const uint8_t* pBuffer, uint32_t startOffset, uint32_t index)
+{
+	uint32_t v = LoadU32(pBuffer, startOffset + index * 4);
+	return Vec2(HalfToFloat((uint16_t)(v & 0xffff)), HalfToFloat((uint16_t)(v >> 16)));
+}
+
+//	EOF
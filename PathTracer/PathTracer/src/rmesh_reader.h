@@ -0,0 +1,209 @@
+#pragma once
+
+#include "cpu_math.h"
+
+#include <string>
+#include <vector>
+
+
+// texture slots of RMeshMaterial::textureNames.
+enum RMeshTextureSlot
+{
+	kRMeshTexBaseColor = 0,
+	kRMeshTexNormal = 1,
+	kRMeshTexORM = 2,
+};
+
+// index formats of a submesh.
+enum RMeshIndexFormat
+{
+	kRMeshIndex32 = 0,
+	kRMeshIndex16 = 1,
+};
+
+struct RMeshBounding
+{
+	float	sphereCenter[3];
+	float	sphereRadius;
+	float	boxMin[3];
+	float	boxMax[3];
+
+	Aabb GetBox() const { return Aabb(Vec3(boxMin[0], boxMin[1], boxMin[2]), Vec3(boxMax[0], boxMax[1], boxMax[2])); }
+};
+
+struct RMeshMaterial
+{
+	std::string					name;
+	std::vector<std::string>	textureNames;
+	float						baseColor[4];
+	float						emissiveColor[3];
+	float						roughness;
+	float						metallic;
+	bool						isOpaque;
+};
+
+struct RMeshMeshlet
+{
+	uint32_t	indexOffset;
+	uint32_t	indexCount;
+	uint32_t	primitiveOffset;
+	uint32_t	primitiveCount;
+	uint32_t	vertexIndexOffset;
+	uint32_t	vertexIndexCount;
+	float		boundingSphere[4];
+	float		boxMin[3];
+	float		boxMax[3];
+	float		coneApex[3];
+	float		coneAxisAndCutoff[4];
+};
+
+struct RMeshSubmesh
+{
+	int							materialIndex;
+	uint32_t					vertexOffset;
+	uint32_t					vertexCount;
+	uint32_t					indexOffset;
+	uint32_t					indexCount;
+	uint32_t					meshletPrimitiveOffset;
+	uint32_t					meshletPrimitiveCount;
+	uint32_t					meshletVertexIndexOffset;
+	uint32_t					meshletVertexIndexCount;
+	std::vector<RMeshMeshlet>	meshlets;
+	RMeshBounding				bounding;
+
+	// byte offsets into the packed streams.
+	// same meaning as ResourceItemMesh::Submesh::xxxOffsetBytes.
+	uint32_t					positionOffsetBytes;
+	uint32_t					normalOffsetBytes;
+	uint32_t					tangentOffsetBytes;
+	uint32_t					texcoordOffsetBytes;
+	uint32_t					indexOffsetBytes;
+	uint32_t					indexFormat;		// RMeshIndexFormat.
+};
+
+// .rmesh contents in the layout vertex_factory.hlsli reads.
+//   position : snorm16 x4, relative to the mesh bounding box
+//   normal   : snorm8 x4
+//   tangent  : snorm8 x4
+//   texcoord : half x2
+//   index    : u16 or u32 per submesh, see RMeshSubmesh::indexFormat
+// streams exported as raw floats are packed on load.
+struct RMesh
+{
+	std::string						filePath;
+	std::vector<RMeshMaterial>		materials;
+	std::vector<RMeshSubmesh>		submeshes;
+	RMeshBounding					bounding;
+
+	std::vector<uint8_t>			position;
+	std::vector<uint8_t>			normal;
+	std::vector<uint8_t>			tangent;
+	std::vector<uint8_t>			texcoord;
+	std::vector<uint8_t>			index;
+	std::vector<uint8_t>			meshletPackedPrimitive;
+	std::vector<uint8_t>			meshletVertexIndex;
+
+	// object position = snorm position * positionScale + positionOffset.
+	Vec3							positionScale;
+	Vec3							positionOffset;
+
+	uint32_t GetTotalVertexCount() const { return (uint32_t)(position.size() / kPositionStride); }
+	uint32_t GetTotalTriangleCount() const
+	{
+		uint32_t ret = 0;
+		for (auto&& submesh : submeshes)
+		{
+			ret += submesh.indexCount / 3;
+		}
+		return ret;
+	}
+
+	// object space position of a vertex, decoded like GetVertexPosition().
+	Vec3 GetPosition(const RMeshSubmesh& submesh, uint32_t vertexIndex) const;
+	// vertex indices of a triangle, decoded like GetVertexIndices().
+	void GetTriangle(const RMeshSubmesh& submesh, uint32_t triIndex, uint32_t outIndices[3]) const;
+
+	static const uint32_t kPositionStride = 8;
+	static const uint32_t kNormalStride = 4;
+	static const uint32_t kTangentStride = 4;
+	static const uint32_t kTexcoordStride = 4;
+	static const uint32_t kIndexStride = 4;
+	static const uint32_t kIndex16Stride = 2;
+};
+
+// streams of a .rmesh in file order.
+enum RMeshStream
+{
+	kRMeshStreamPosition,
+	kRMeshStreamNormal,
+	kRMeshStreamTangent,
+	kRMeshStreamTexcoord,
+	kRMeshStreamIndex,
+	kRMeshStreamMeshletPrimitive,
+	kRMeshStreamMeshletVertexIndex,
+
+	kRMeshStreamMax
+};
+
+// bytes of one stream in the source data.
+struct RMeshStreamView
+{
+	const uint8_t*	pData = nullptr;
+	size_t			size = 0;
+	uint32_t		srcStride = 1;		// bytes per element in the file.
+	uint32_t		dstStride = 1;		// bytes per element in RMesh.
+	size_t			elementCount = 0;	// elements to convert when the strides differ.
+
+	bool IsConverted() const { return srcStride != dstStride; }
+	size_t GetPackedSize() const { return IsConverted() ? elementCount * dstStride : size; }
+};
+
+// header, material and submesh tables of a .rmesh.
+// streams point into the source data, which has to outlive the view.
+struct RMeshView
+{
+	std::vector<RMeshMaterial>		materials;
+	std::vector<RMeshSubmesh>		submeshes;
+	RMeshBounding					bounding;
+	Vec3							positionScale;
+	Vec3							positionOffset;
+	uint32_t						vertexCount = 0;
+	RMeshStreamView					streams[kRMeshStreamMax];
+
+	size_t GetPackedSize() const;
+};
+
+// parses and validates the tables without copying the streams.
+bool ParseRMeshView(const uint8_t* pData, size_t size, RMeshView* pOut);
+// decodes every stream into pDst[stream], which has streams[stream].GetPackedSize() bytes.
+// streams are split into chunks that run on up to threadCount threads, 0 uses all hardware threads.
+void DecodeRMeshStreams(const RMeshView& view, uint8_t* const pDst[kRMeshStreamMax], uint32_t threadCount);
+
+// stores the indices of every submesh with fewer than 65536 vertices in 16 bit, returns the saved bytes.
+// ReadRMesh() and LoadRMesh() call this after decoding.
+// only the cpu meshes are compacted, sl12 uploads the 32 bit stream of the file to the gpu.
+size_t CompactRMeshIndices(RMesh* pMesh);
+
+bool ReadRMesh(const uint8_t* pData, size_t size, RMesh* pOut, uint32_t threadCount = 1);
+// the file is memory mapped and decoded straight into pOut.
+// CpuScene and the headless tools load through this, the app's gpu meshes go through sl12's resource loader.
+bool LoadRMesh(const std::string& filePath, RMesh* pOut, uint32_t threadCount = 0);
+
+// serializes a mesh back into the .rmesh layout ReadRMesh() reads, with packed vertex streams and 32 bit indices.
+// materials, submeshes and meshlets are written as they are.
+bool EncodeRMesh(const RMesh& mesh, std::vector<uint8_t>* pOut);
+bool WriteRMesh(const std::string& filePath, const RMesh& mesh);
+
+// c++ mirrors of vertex_factory.hlsli.
+// pBuffer is the start of the byte address buffer.
+void GetVertexIndices16(const uint8_t* pBuffer, uint32_t startOffset, uint32_t triIndex, uint32_t outIndices[3]);
+void GetVertexIndices32(const uint8_t* pBuffer, uint32_t startOffset, uint32_t triIndex, uint32_t outIndices[3]);
+Vec3 GetVertexPosition(const uint8_t* pBuffer, uint32_t startOffset, uint32_t index);
+Vec3 GetVertexNormal(const uint8_t* pBuffer, uint32_t startOffset, uint32_t index);
+Vec4 GetVertexTangent(const uint8_t* pBuffer, uint32_t startOffset, uint32_t index);
+Vec2 GetVertexTexcoord(const uint8_t* pBuffer, uint32_t startOffset, uint32_t index);
+// GetVertexIndices16() or GetVertexIndices32() by RMeshIndexFormat.
+// the gpu index buffer is uploaded by sl12 and stays 32 bit, so the shaders have no counterpart.
+void GetVertexIndices(const uint8_t* pBuffer, uint32_t startOffset, uint32_t indexFormat, uint32_t triIndex, uint32_t outIndices[3]);
+
+//	EOF
@@ -0,0 +1,453 @@
+#include "rmesh_reorder.h"
+
+#include "cpu_lbvh.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+
+namespace
+{
+	static const uint32_t kInvalidIndex = 0xffffffff;
+
+	// streams of the cache line keys, in the upper bits so that lines of different streams never match.
+	enum LineStream
+	{
+		kLineIndex,
+		kLinePosition,
+		kLineNormal,
+		kLineTexcoord,
+	};
+
+	inline uint64_t MakeLineKey(LineStream stream, uint64_t address)
+	{
+		return ((uint64_t)stream << 56) | (address / kCacheLineSize);
+	}
+
+	// a run of triangles that stays together, the meshlet it came from or kInvalidIndex.
+	struct Cluster
+	{
+		uint32_t	first;		// into SubmeshPlan::clusterTris.
+		uint32_t	count;
+		uint32_t	meshlet;
+		uint32_t	code;
+	};
+
+	// new order of one submesh, computed before anything is written.
+	struct SubmeshPlan
+	{
+		std::vector<uint32_t>	indices;		// source indices, 3 per triangle.
+		std::vector<uint32_t>	clusterTris;
+		std::vector<Cluster>	clusters;
+		std::vector<uint32_t>	triOrder;		// source triangle of each new triangle.
+		std::vector<uint32_t>	vertexRemap;	// new index of each source vertex.
+		bool					bMeshletClusters = false;
+	};
+
+	uint32_t LoadU32(const std::vector<uint8_t>& stream, size_t index)
+	{
+		uint32_t ret;
+		memcpy(&ret, stream.data() + index * sizeof(uint32_t), sizeof(ret));
+		return ret;
+	}
+
+	void StoreU32(std::vector<uint8_t>& stream, size_t index, uint32_t v)
+	{
+		memcpy(stream.data() + index * sizeof(uint32_t), &v, sizeof(v));
+	}
+
+	// meshlets cover the index range of the submesh in order, one primitive per triangle.
+	// meshlet offsets are relative to the submesh ranges.
+	bool HasContiguousMeshlets(const RMesh& mesh, const RMeshSubmesh& submesh)
+	{
+		if (submesh.meshlets.empty()
+			|| (size_t)(submesh.meshletPrimitiveOffset + submesh.meshletPrimitiveCount) * sizeof(uint32_t) > mesh.meshletPackedPrimitive.size()
+			|| (size_t)(submesh.meshletVertexIndexOffset + submesh.meshletVertexIndexCount) * sizeof(uint32_t) > mesh.meshletVertexIndex.size())
+		{
+			return false;
+		}
+		uint32_t indexOffset = 0, primitiveCount = 0, vertexIndexCount = 0;
+		for (auto&& meshlet : submesh.meshlets)
+		{
+			if (meshlet.indexOffset != indexOffset || meshlet.indexCount != meshlet.primitiveCount * 3
+				|| meshlet.primitiveOffset + meshlet.primitiveCount > submesh.meshletPrimitiveCount
+				|| meshlet.vertexIndexOffset + meshlet.vertexIndexCount > submesh.meshletVertexIndexCount)
+			{
+				return false;
+			}
+			indexOffset += meshlet.indexCount;
+			primitiveCount += meshlet.primitiveCount;
+			vertexIndexCount += meshlet.vertexIndexCount;
+		}
+		return indexOffset == submesh.indexCount
+			&& primitiveCount == submesh.meshletPrimitiveCount
+			&& vertexIndexCount == submesh.meshletVertexIndexCount;
+	}
+
+	// triangles of a cluster in the leaf order of a sah bvh over them, so that neighbours share index lines.
+	void SortByLeafOrder(const std::vector<Aabb>& triBounds, uint32_t* pTris, uint32_t count)
+	{
+		if (count <= 2)
+		{
+			return;
+		}
+		std::vector<Aabb> primBounds(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			primBounds[i] = triBounds[pTris[i]];
+		}
+		BvhBuildSettings settings;
+		settings.threadCount = 1;
+		Bvh bvh;
+		bvh.BuildSAH(primBounds, settings);
+		std::vector<uint32_t> sorted(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			sorted[i] = pTris[bvh.GetPrimIndices()[i]];
+		}
+		std::copy(sorted.begin(), sorted.end(), pTris);
+	}
+
+	bool PlanSubmesh(const RMesh& mesh, const RMeshSubmesh& submesh, const RMeshReorderSettings& settings, SubmeshPlan* pPlan)
+	{
+		uint32_t triCount = submesh.indexCount / 3;
+		pPlan->indices.resize((size_t)triCount * 3);
+		for (uint32_t t = 0; t < triCount; t++)
+		{
+			mesh.GetTriangle(submesh, t, &pPlan->indices[t * 3]);
+		}
+		for (auto v : pPlan->indices)
+		{
+			if (v >= submesh.vertexCount)
+			{
+				printf("Error: vertex index out of the submesh range.\n");
+				return false;
+			}
+		}
+
+		// triangle bounds, morton codes are taken in the submesh bounds.
+		std::vector<Aabb> triBounds(triCount);
+		Aabb bounds;
+		for (uint32_t t = 0; t < triCount; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				triBounds[t].Grow(mesh.GetPosition(submesh, pPlan->indices[t * 3 + c]));
+			}
+			bounds.Grow(triBounds[t]);
+		}
+		Vec3 extent = bounds.Extent();
+		Vec3 invExtent(
+			(extent.x > 0.0f) ? 1.0f / extent.x : 0.0f,
+			(extent.y > 0.0f) ? 1.0f / extent.y : 0.0f,
+			(extent.z > 0.0f) ? 1.0f / extent.z : 0.0f);
+
+		// clusters, meshlets keep the triangles the mesh shader path groups together.
+		pPlan->bMeshletClusters = HasContiguousMeshlets(mesh, submesh);
+		pPlan->clusterTris.resize(triCount);
+		for (uint32_t t = 0; t < triCount; t++)
+		{
+			pPlan->clusterTris[t] = t;
+		}
+		if (pPlan->bMeshletClusters)
+		{
+			for (uint32_t m = 0; m < (uint32_t)submesh.meshlets.size(); m++)
+			{
+				auto&& meshlet = submesh.meshlets[m];
+				pPlan->clusters.push_back({ meshlet.indexOffset / 3, meshlet.indexCount / 3, m, 0 });
+			}
+		}
+		else
+		{
+			std::vector<uint32_t> codes(triCount);
+			for (uint32_t t = 0; t < triCount; t++)
+			{
+				codes[t] = Morton3D((triBounds[t].Center() - bounds.bmin) * invExtent);
+			}
+			std::stable_sort(pPlan->clusterTris.begin(), pPlan->clusterTris.end(), [&](uint32_t a, uint32_t b) { return codes[a] < codes[b]; });
+			uint32_t clusterSize = std::max(settings.clusterTriangles, 1u);
+			for (uint32_t first = 0; first < triCount; first += clusterSize)
+			{
+				pPlan->clusters.push_back({ first, std::min(clusterSize, triCount - first), kInvalidIndex, 0 });
+			}
+		}
+
+		// clusters along the morton curve, triangles of a cluster in leaf order.
+		for (auto&& cluster : pPlan->clusters)
+		{
+			Aabb cb;
+			for (uint32_t i = 0; i < cluster.count; i++)
+			{
+				cb.Grow(triBounds[pPlan->clusterTris[cluster.first + i]]);
+			}
+			cluster.code = (cluster.count > 0) ? Morton3D((cb.Center() - bounds.bmin) * invExtent) : 0;
+			SortByLeafOrder(triBounds, pPlan->clusterTris.data() + cluster.first, cluster.count);
+		}
+		std::stable_sort(pPlan->clusters.begin(), pPlan->clusters.end(), [](const Cluster& a, const Cluster& b) { return a.code < b.code; });
+
+		pPlan->triOrder.clear();
+		pPlan->triOrder.reserve(triCount);
+		for (auto&& cluster : pPlan->clusters)
+		{
+			pPlan->triOrder.insert(pPlan->triOrder.end(), pPlan->clusterTris.begin() + cluster.first, pPlan->clusterTris.begin() + cluster.first + cluster.count);
+		}
+
+		// vertices in first-use order of the new triangle order, unreferenced ones go last.
+		pPlan->vertexRemap.resize(submesh.vertexCount);
+		if (settings.vertexOrder == kRMeshVertexOrderSource)
+		{
+			for (uint32_t v = 0; v < submesh.vertexCount; v++)
+			{
+				pPlan->vertexRemap[v] = v;
+			}
+			return true;
+		}
+		std::fill(pPlan->vertexRemap.begin(), pPlan->vertexRemap.end(), kInvalidIndex);
+		uint32_t next = 0;
+		for (auto t : pPlan->triOrder)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t& remap = pPlan->vertexRemap[pPlan->indices[t * 3 + c]];
+				remap = (remap == kInvalidIndex) ? next++ : remap;
+			}
+		}
+		for (auto&& remap : pPlan->vertexRemap)
+		{
+			remap = (remap == kInvalidIndex) ? next++ : remap;
+		}
+		return true;
+	}
+
+	void PermuteVertices(std::vector<uint8_t>& stream, uint32_t stride, const RMeshSubmesh& submesh, const std::vector<uint32_t>& remap)
+	{
+		size_t begin = (size_t)submesh.vertexOffset * stride;
+		if (begin + (size_t)submesh.vertexCount * stride > stream.size())
+		{
+			return;
+		}
+		std::vector<uint8_t> source(stream.begin() + begin, stream.begin() + begin + (size_t)submesh.vertexCount * stride);
+		for (uint32_t v = 0; v < submesh.vertexCount; v++)
+		{
+			memcpy(stream.data() + begin + (size_t)remap[v] * stride, source.data() + (size_t)v * stride, stride);
+		}
+	}
+
+	// meshlets follow the cluster order, their primitives and vertex indices are repacked in that order.
+	void ReorderMeshlets(RMesh* pMesh, RMeshSubmesh* pSubmesh, const SubmeshPlan& plan)
+	{
+		std::vector<RMeshMeshlet> meshlets;
+		meshlets.reserve(pSubmesh->meshlets.size());
+		std::vector<uint32_t> primitives, vertexIndices;
+		primitives.reserve(pSubmesh->meshletPrimitiveCount);
+		vertexIndices.reserve(pSubmesh->meshletVertexIndexCount);
+		for (auto&& cluster : plan.clusters)
+		{
+			RMeshMeshlet meshlet = pSubmesh->meshlets[cluster.meshlet];
+			uint32_t indexOffset = (uint32_t)primitives.size() * 3;
+			uint32_t primitiveOffset = (uint32_t)primitives.size();
+			uint32_t vertexIndexOffset = (uint32_t)vertexIndices.size();
+			for (uint32_t i = 0; i < meshlet.primitiveCount; i++)
+			{
+				uint32_t primitive = plan.clusterTris[cluster.first + i] - meshlet.indexOffset / 3;
+				primitives.push_back(LoadU32(pMesh->meshletPackedPrimitive, pSubmesh->meshletPrimitiveOffset + meshlet.primitiveOffset + primitive));
+			}
+			for (uint32_t i = 0; i < meshlet.vertexIndexCount; i++)
+			{
+				vertexIndices.push_back(plan.vertexRemap[LoadU32(pMesh->meshletVertexIndex, pSubmesh->meshletVertexIndexOffset + meshlet.vertexIndexOffset + i)]);
+			}
+			meshlet.indexOffset = indexOffset;
+			meshlet.primitiveOffset = primitiveOffset;
+			meshlet.vertexIndexOffset = vertexIndexOffset;
+			meshlets.push_back(meshlet);
+		}
+		for (size_t i = 0; i < primitives.size(); i++)
+		{
+			StoreU32(pMesh->meshletPackedPrimitive, pSubmesh->meshletPrimitiveOffset + i, primitives[i]);
+		}
+		for (size_t i = 0; i < vertexIndices.size(); i++)
+		{
+			StoreU32(pMesh->meshletVertexIndex, pSubmesh->meshletVertexIndexOffset + i, vertexIndices[i]);
+		}
+		pSubmesh->meshlets.swap(meshlets);
+	}
+
+	// meshlets that do not follow the index buffer keep their ranges, only their vertex indices are renumbered.
+	void RemapMeshletVertexIndices(RMesh* pMesh, const RMeshSubmesh& submesh, const std::vector<uint32_t>& remap)
+	{
+		if ((size_t)(submesh.meshletVertexIndexOffset + submesh.meshletVertexIndexCount) * sizeof(uint32_t) > pMesh->meshletVertexIndex.size())
+		{
+			return;
+		}
+		for (uint32_t i = 0; i < submesh.meshletVertexIndexCount; i++)
+		{
+			uint32_t v = LoadU32(pMesh->meshletVertexIndex, submesh.meshletVertexIndexOffset + i);
+			if (v < remap.size())
+			{
+				StoreU32(pMesh->meshletVertexIndex, submesh.meshletVertexIndexOffset + i, remap[v]);
+			}
+		}
+	}
+}
+
+bool ReorderRMesh(RMesh* pMesh, const RMeshReorderSettings& settings, std::vector<uint32_t>* pTriangleOrder)
+{
+	// vertex ranges are permuted in place, so submeshes must not share vertices.
+	std::vector<std::pair<uint32_t, uint32_t>> ranges;
+	for (auto&& submesh : pMesh->submeshes)
+	{
+		ranges.push_back({ submesh.vertexOffset, submesh.vertexOffset + submesh.vertexCount });
+	}
+	std::sort(ranges.begin(), ranges.end());
+	for (size_t i = 1; i < ranges.size(); i++)
+	{
+		if (ranges[i].first < ranges[i - 1].second)
+		{
+			printf("Error: submeshes share vertices, the mesh cannot be reordered.\n");
+			return false;
+		}
+	}
+
+	std::vector<SubmeshPlan> plans(pMesh->submeshes.size());
+	for (size_t s = 0; s < plans.size(); s++)
+	{
+		if (!PlanSubmesh(*pMesh, pMesh->submeshes[s], settings, &plans[s]))
+		{
+			return false;
+		}
+	}
+
+	// every submesh is planned, nothing has been written yet.
+	size_t indexCount = 0;
+	for (auto&& submesh : pMesh->submeshes)
+	{
+		indexCount = std::max(indexCount, (size_t)submesh.indexOffset + submesh.indexCount);
+	}
+	std::vector<uint8_t> indices(indexCount * RMesh::kIndexStride, 0);
+	if (pTriangleOrder)
+	{
+		pTriangleOrder->clear();
+	}
+	uint32_t triBase = 0;
+	for (size_t s = 0; s < plans.size(); s++)
+	{
+		auto&& submesh = pMesh->submeshes[s];
+		auto&& plan = plans[s];
+		PermuteVertices(pMesh->position, RMesh::kPositionStride, submesh, plan.vertexRemap);
+		PermuteVertices(pMesh->normal, RMesh::kNormalStride, submesh, plan.vertexRemap);
+		PermuteVertices(pMesh->tangent, RMesh::kTangentStride, submesh, plan.vertexRemap);
+		PermuteVertices(pMesh->texcoord, RMesh::kTexcoordStride, submesh, plan.vertexRemap);
+
+		for (size_t t = 0; t < plan.triOrder.size(); t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				StoreU32(indices, submesh.indexOffset + t * 3 + c, plan.vertexRemap[plan.indices[plan.triOrder[t] * 3 + c]]);
+			}
+			if (pTriangleOrder)
+			{
+				pTriangleOrder->push_back(triBase + plan.triOrder[t]);
+			}
+		}
+		triBase += (uint32_t)plan.triOrder.size();
+		submesh.indexOffsetBytes = submesh.indexOffset * RMesh::kIndexStride;
+		submesh.indexFormat = kRMeshIndex32;
+
+		if (plan.bMeshletClusters)
+		{
+			ReorderMeshlets(pMesh, &submesh, plan);
+		}
+		else
+		{
+			RemapMeshletVertexIndices(pMesh, submesh, plan.vertexRemap);
+		}
+	}
+	pMesh->index.swap(indices);
+	CompactRMeshIndices(pMesh);
+	return true;
+}
+
+RMeshLocalityStats MeasureRMeshLocality(const RMesh& mesh, const BvhBuildSettings& settings)
+{
+	struct TriangleRef
+	{
+		uint32_t	submeshIndex;
+		uint32_t	triIndex;
+	};
+	std::vector<TriangleRef> refs;
+	std::vector<Aabb> primBounds;
+	refs.reserve(mesh.GetTotalTriangleCount());
+	primBounds.reserve(mesh.GetTotalTriangleCount());
+	for (uint32_t s = 0; s < (uint32_t)mesh.submeshes.size(); s++)
+	{
+		auto&& submesh = mesh.submeshes[s];
+		for (uint32_t t = 0; t < submesh.indexCount / 3; t++)
+		{
+			uint32_t idx[3];
+			mesh.GetTriangle(submesh, t, idx);
+			Aabb b;
+			for (int c = 0; c < 3; c++)
+			{
+				b.Grow(mesh.GetPosition(submesh, idx[c]));
+			}
+			refs.push_back({ s, t });
+			primBounds.push_back(b);
+		}
+	}
+
+	RMeshLocalityStats ret;
+	ret.triangleCount = (uint32_t)refs.size();
+	if (refs.empty())
+	{
+		return ret;
+	}
+	Bvh bvh;
+	bvh.BuildSAH(primBounds, settings);
+
+	uint64_t lineCounts[kLineTexcoord + 1] = {};
+	std::vector<uint64_t> keys;
+	for (auto&& node : bvh.GetNodes())
+	{
+		if (!node.IsLeaf())
+		{
+			continue;
+		}
+		keys.clear();
+		for (uint32_t i = 0; i < node.primCount; i++)
+		{
+			auto&& ref = refs[bvh.GetPrimIndices()[node.leftFirst + i]];
+			auto&& submesh = mesh.submeshes[ref.submeshIndex];
+			uint32_t stride = (submesh.indexFormat == kRMeshIndex16) ? RMesh::kIndex16Stride : RMesh::kIndexStride;
+			uint64_t indexBegin = submesh.indexOffsetBytes + (uint64_t)ref.triIndex * 3 * stride;
+			for (uint64_t line = indexBegin / kCacheLineSize; line <= (indexBegin + 3 * stride - 1) / kCacheLineSize; line++)
+			{
+				keys.push_back(MakeLineKey(kLineIndex, line * kCacheLineSize));
+			}
+
+			uint32_t idx[3];
+			mesh.GetTriangle(submesh, ref.triIndex, idx);
+			for (int c = 0; c < 3; c++)
+			{
+				keys.push_back(MakeLineKey(kLinePosition, submesh.positionOffsetBytes + (uint64_t)idx[c] * RMesh::kPositionStride));
+				keys.push_back(MakeLineKey(kLineNormal, submesh.normalOffsetBytes + (uint64_t)idx[c] * RMesh::kNormalStride));
+				keys.push_back(MakeLineKey(kLineTexcoord, submesh.texcoordOffsetBytes + (uint64_t)idx[c] * RMesh::kTexcoordStride));
+			}
+		}
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		for (auto key : keys)
+		{
+			lineCounts[key >> 56]++;
+		}
+		ret.leafCount++;
+	}
+
+	double invLeafCount = 1.0 / ret.leafCount;
+	ret.indexLines = lineCounts[kLineIndex] * invLeafCount;
+	ret.positionLines = lineCounts[kLinePosition] * invLeafCount;
+	ret.attributeLines = (lineCounts[kLineNormal] + lineCounts[kLineTexcoord]) * invLeafCount;
+	return ret;
+}
+
+//	EOF
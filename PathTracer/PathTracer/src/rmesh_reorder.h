@@ -0,0 +1,52 @@
+#pragma once
+
+#include "cpu_bvh.h"
+#include "rmesh_reader.h"
+
+#include <vector>
+
+
+// vertex numbering of a reordered submesh.
+enum RMeshVertexOrder
+{
+	kRMeshVertexOrderFirstUse,		// first use in the new triangle order.
+	kRMeshVertexOrderSource,		// unchanged, for meshes the exporter already optimized for vertex fetch.
+};
+
+struct RMeshReorderSettings
+{
+	uint32_t			clusterTriangles = 64;		// triangles per cluster of submeshes without usable meshlets.
+	RMeshVertexOrder	vertexOrder = kRMeshVertexOrderFirstUse;
+};
+
+// average distinct cache lines touched by the triangles of one bvh leaf.
+// every stream is assumed to start on a cache line.
+struct RMeshLocalityStats
+{
+	uint32_t	leafCount = 0;
+	uint32_t	triangleCount = 0;
+	double		indexLines = 0.0;
+	double		positionLines = 0.0;
+	double		attributeLines = 0.0;		// normal + texcoord.
+
+	double GetTotalLines() const { return indexLines + positionLines + attributeLines; }
+};
+
+// offline locality pass over every submesh.
+//   1. triangles are grouped into clusters, the meshlets when they cover the index range in order,
+//      otherwise morton ordered runs of clusterTriangles.
+//   2. clusters are sorted by the morton code of their center in the submesh bounds.
+//   3. triangles of a cluster follow the leaf order of a sah bvh over the cluster.
+//   4. vertices are renumbered in first-use order of the new triangle order, unreferenced ones go last,
+//      or keep their numbering with kRMeshVertexOrderSource.
+//      first-use follows the cluster order, not the leaves of the bvh, so it touches more lines per leaf
+//      than a source order the exporter already optimized. the -reorder tool measures both and keeps the better one.
+// vertex streams, indices, meshlet tables and meshlet vertex indices are rewritten, geometry is unchanged.
+// pTriangleOrder receives the source triangle of each new triangle, both in submesh order over the whole mesh.
+bool ReorderRMesh(RMesh* pMesh, const RMeshReorderSettings& settings = RMeshReorderSettings(), std::vector<uint32_t>* pTriangleOrder = nullptr);
+
+// builds a sah bvh over every triangle of the mesh, the same one CpuMesh builds,
+// and counts the cache lines of the index and vertex fetches of each leaf.
+RMeshLocalityStats MeasureRMeshLocality(const RMesh& mesh, const BvhBuildSettings& settings = BvhBuildSettings());
+
+//	EOF
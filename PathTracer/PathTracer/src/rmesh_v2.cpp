@@ -0,0 +1,630 @@
+#include "rmesh_v2.h"
+
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <cstring>
+
+
+namespace
+{
+	size_t AlignUp(size_t v, size_t alignment)
+	{
+		return (v + alignment - 1) / alignment * alignment;
+	}
+
+	// little endian byte writer of the material table.
+	class ByteWriter
+	{
+	public:
+		void Write(const void* p, size_t size)
+		{
+			const uint8_t* src = (const uint8_t*)p;
+			data_.insert(data_.end(), src, src + size);
+		}
+
+		template <typename T>
+		void Write(const T& v)
+		{
+			Write(&v, sizeof(v));
+		}
+
+		void WriteString(const std::string& s)
+		{
+			Write((uint32_t)s.size());
+			Write(s.data(), s.size());
+		}
+
+		std::vector<uint8_t>& GetData() { return data_; }
+
+	private:
+		std::vector<uint8_t>	data_;
+	};	// class ByteWriter
+
+	class ByteReader
+	{
+	public:
+		ByteReader(const uint8_t* pData, size_t size)
+			: pData_(pData), size_(size)
+		{}
+
+		bool IsError() const { return bError_; }
+
+		void Read(void* pDst, size_t size)
+		{
+			if (bError_ || size > size_ - pos_)
+			{
+				bError_ = true;
+				memset(pDst, 0, size);
+				return;
+			}
+			memcpy(pDst, pData_ + pos_, size);
+			pos_ += size;
+		}
+
+		template <typename T>
+		T Read()
+		{
+			T ret;
+			Read(&ret, sizeof(ret));
+			return ret;
+		}
+
+		std::string ReadString()
+		{
+			uint32_t len = Read<uint32_t>();
+			if (bError_ || len > size_ - pos_)
+			{
+				bError_ = true;
+				return std::string();
+			}
+			std::string ret((const char*)pData_ + pos_, len);
+			pos_ += len;
+			return ret;
+		}
+
+	private:
+		const uint8_t*	pData_;
+		size_t			size_;
+		size_t			pos_ = 0;
+		bool			bError_ = false;
+	};	// class ByteReader
+
+	// chunks in file order, either borrowed from the source mesh or owned.
+	struct PendingChunk
+	{
+		uint32_t				type;
+		uint32_t				index;
+		const uint8_t*			pData;
+		size_t					size;
+		std::vector<uint8_t>	owned;
+	};
+
+	void AddChunk(std::vector<PendingChunk>& chunks, uint32_t type, uint32_t index, const void* pData, size_t size)
+	{
+		chunks.push_back({ type, index, (const uint8_t*)pData, size, std::vector<uint8_t>() });
+	}
+
+	void AddChunk(std::vector<PendingChunk>& chunks, uint32_t type, uint32_t index, std::vector<uint8_t>&& data)
+	{
+		chunks.push_back({ type, index, nullptr, data.size(), std::move(data) });
+	}
+
+	void StoreAabb(const Aabb& b, float boxMin[3], float boxMax[3])
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			boxMin[i] = b.bmin[i];
+			boxMax[i] = b.bmax[i];
+		}
+	}
+
+	Aabb LoadAabb(const float boxMin[3], const float boxMax[3])
+	{
+		return Aabb(Vec3(boxMin[0], boxMin[1], boxMin[2]), Vec3(boxMax[0], boxMax[1], boxMax[2]));
+	}
+
+	// triangle bounds in the same order and with the same arithmetic as CpuMesh::BuildBvh().
+	void GatherTriangleBounds(const RMesh& mesh, uint32_t submeshBegin, uint32_t submeshEnd, const BvhBuildSettings& settings, std::vector<Aabb>* pBounds, std::vector<Vec3>* pVertices)
+	{
+		pBounds->clear();
+		pVertices->clear();
+		for (uint32_t s = submeshBegin; s < submeshEnd; s++)
+		{
+			auto&& submesh = mesh.submeshes[s];
+			for (uint32_t t = 0; t < submesh.indexCount / 3; t++)
+			{
+				uint32_t idx[3];
+				mesh.GetTriangle(submesh, t, idx);
+				Vec3 p0 = mesh.GetPosition(submesh, idx[0]);
+				Vec3 e1 = mesh.GetPosition(submesh, idx[1]) - p0;
+				Vec3 e2 = mesh.GetPosition(submesh, idx[2]) - p0;
+				Vec3 v[3] = { p0, p0 + e1, p0 + e2 };
+				Aabb b;
+				b.Grow(v[0]);
+				b.Grow(v[1]);
+				b.Grow(v[2]);
+				pBounds->push_back(b);
+				if (settings.bSpatialSplits)
+				{
+					pVertices->insert(pVertices->end(), v, v + 3);
+				}
+			}
+		}
+	}
+
+	std::vector<uint8_t> BuildBvhChunk(const RMesh& mesh, uint32_t submeshBegin, uint32_t submeshEnd, const BvhBuildSettings& settings)
+	{
+		std::vector<Aabb> primBounds;
+		std::vector<Vec3> triVertices;
+		GatherTriangleBounds(mesh, submeshBegin, submeshEnd, settings, &primBounds, &triVertices);
+		Bvh bvh;
+		bvh.BuildSAH(primBounds, settings, triVertices.empty() ? nullptr : &triVertices);
+
+		RMeshV2BvhHeader header = {};
+		header.nodeCount = (uint32_t)bvh.GetNodes().size();
+		header.primIndexCount = (uint32_t)bvh.GetPrimIndices().size();
+		header.triangleCount = (uint32_t)primBounds.size();
+		header.maxLeafSize = settings.maxLeafSize;
+		header.binCount = settings.binCount;
+		header.bSpatialSplits = settings.bSpatialSplits ? 1 : 0;
+
+		ByteWriter writer;
+		writer.Write(header);
+		writer.Write(bvh.GetNodes().data(), bvh.GetNodes().size() * sizeof(BvhNode));
+		writer.Write(bvh.GetPrimIndices().data(), bvh.GetPrimIndices().size() * sizeof(uint32_t));
+		return std::move(writer.GetData());
+	}
+
+	bool ReadMaterials(const uint8_t* pData, size_t size, std::vector<RMeshMaterial>* pOut)
+	{
+		ByteReader reader(pData, size);
+		uint32_t count = reader.Read<uint32_t>();
+		if (count > size)
+		{
+			return false;
+		}
+		pOut->resize(count);
+		for (auto&& mat : *pOut)
+		{
+			mat.name = reader.ReadString();
+			uint32_t texCount = reader.Read<uint32_t>();
+			if (reader.IsError() || texCount > size)
+			{
+				return false;
+			}
+			mat.textureNames.resize(texCount);
+			for (auto&& tex : mat.textureNames)
+			{
+				tex = reader.ReadString();
+			}
+			reader.Read(mat.baseColor, sizeof(mat.baseColor));
+			reader.Read(mat.emissiveColor, sizeof(mat.emissiveColor));
+			mat.roughness = reader.Read<float>();
+			mat.metallic = reader.Read<float>();
+			mat.isOpaque = reader.Read<uint32_t>() != 0;
+			if (reader.IsError())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool ReadBvh(const uint8_t* pData, size_t size, RMeshBvhData* pOut)
+	{
+		if (size < sizeof(RMeshV2BvhHeader))
+		{
+			return false;
+		}
+		memcpy(&pOut->header, pData, sizeof(pOut->header));
+		auto&& h = pOut->header;
+		size_t nodeBytes = (size_t)h.nodeCount * sizeof(BvhNode);
+		size_t primBytes = (size_t)h.primIndexCount * sizeof(uint32_t);
+		if (sizeof(h) + nodeBytes + primBytes != size)
+		{
+			return false;
+		}
+		pOut->nodes.resize(h.nodeCount);
+		pOut->primIndices.resize(h.primIndexCount);
+		memcpy(pOut->nodes.data(), pData + sizeof(h), nodeBytes);
+		memcpy(pOut->primIndices.data(), pData + sizeof(h) + nodeBytes, primBytes);
+
+		// references out of range would be read by the traversal.
+		for (auto&& node : pOut->nodes)
+		{
+			uint64_t end = (uint64_t)node.leftFirst + (node.IsLeaf() ? node.primCount : 2);
+			if (end > (node.IsLeaf() ? h.primIndexCount : h.nodeCount))
+			{
+				return false;
+			}
+		}
+		for (auto prim : pOut->primIndices)
+		{
+			if (prim >= h.triangleCount)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+const RMeshBvhData* RMeshAccel::FindBvh(uint32_t submeshIndex) const
+{
+	for (auto&& bvh : bvhs)
+	{
+		if (bvh.submeshIndex == submeshIndex)
+		{
+			return &bvh;
+		}
+	}
+	return nullptr;
+}
+
+const RMeshV2Chunk* RMeshV2File::FindChunk(uint32_t type, uint32_t index) const
+{
+	for (auto&& chunk : chunks)
+	{
+		if (chunk.type == type && chunk.index == index)
+		{
+			return &chunk;
+		}
+	}
+	return nullptr;
+}
+
+bool IsRMeshV2(const uint8_t* pData, size_t size)
+{
+	uint32_t magic;
+	if (size < sizeof(magic))
+	{
+		return false;
+	}
+	memcpy(&magic, pData, sizeof(magic));
+	return magic == kRMeshV2Magic;
+}
+
+bool ParseRMeshV2(const uint8_t* pData, size_t size, RMeshV2File* pOut)
+{
+	if (!IsRMeshV2(pData, size) || size < sizeof(RMeshV2Header))
+	{
+		return false;
+	}
+	memcpy(&pOut->header, pData, sizeof(pOut->header));
+	auto&& header = pOut->header;
+	if (header.version != kRMeshV2Version)
+	{
+		printf("Error: unsupported rmesh version. (%u)\n", header.version);
+		return false;
+	}
+	size_t tableBytes = (size_t)header.chunkCount * sizeof(RMeshV2Chunk);
+	if (tableBytes > size - sizeof(header))
+	{
+		return false;
+	}
+	pOut->pData = pData;
+	pOut->size = size;
+	pOut->chunks.resize(header.chunkCount);
+	memcpy(pOut->chunks.data(), pData + sizeof(header), tableBytes);
+	for (auto&& chunk : pOut->chunks)
+	{
+		if (chunk.type >= kRMeshV2ChunkMax || chunk.offset % kRMeshV2ChunkAlignment != 0
+			|| chunk.offset > size || chunk.size > size - chunk.offset)
+		{
+			return false;
+		}
+	}
+	return pOut->FindChunk(kRMeshV2ChunkMaterials) && pOut->FindChunk(kRMeshV2ChunkSubmeshes) && pOut->FindChunk(kRMeshV2ChunkMeshlets);
+}
+
+bool ReadRMeshV2(const RMeshV2File& file, RMesh* pOut, RMeshAccel* pAccel, uint32_t threadCount)
+{
+	auto&& header = file.header;
+	auto pMaterials = file.FindChunk(kRMeshV2ChunkMaterials);
+	if (!ReadMaterials(file.GetChunkData(*pMaterials), (size_t)pMaterials->size, &pOut->materials))
+	{
+		return false;
+	}
+
+	// streams are already packed, the copy runs through the chunked stream decoder.
+	RMeshView view;
+	for (int s = 0; s < kRMeshStreamMax; s++)
+	{
+		auto pChunk = file.FindChunk(kRMeshV2ChunkStream, (uint32_t)s);
+		if (pChunk)
+		{
+			view.streams[s].pData = file.GetChunkData(*pChunk);
+			view.streams[s].size = (size_t)pChunk->size;
+		}
+	}
+	if (view.streams[kRMeshStreamPosition].size != (size_t)header.vertexCount * RMesh::kPositionStride)
+	{
+		return false;
+	}
+
+	auto pSubmeshes = file.FindChunk(kRMeshV2ChunkSubmeshes);
+	auto pMeshlets = file.FindChunk(kRMeshV2ChunkMeshlets);
+	if (pSubmeshes->size % sizeof(RMeshV2Submesh) != 0 || pMeshlets->size % sizeof(RMeshMeshlet) != 0)
+	{
+		return false;
+	}
+	size_t submeshCount = (size_t)pSubmeshes->size / sizeof(RMeshV2Submesh);
+	size_t meshletCount = (size_t)pMeshlets->size / sizeof(RMeshMeshlet);
+	const uint8_t* pMeshletData = file.GetChunkData(*pMeshlets);
+	pOut->submeshes.resize(submeshCount);
+	if (pAccel)
+	{
+		pAccel->submeshBounds.resize(submeshCount);
+	}
+	for (size_t i = 0; i < submeshCount; i++)
+	{
+		RMeshV2Submesh src;
+		memcpy(&src, file.GetChunkData(*pSubmeshes) + i * sizeof(src), sizeof(src));
+		if ((size_t)src.meshletOffset + src.meshletCount > meshletCount
+			|| (size_t)(src.vertexOffset + src.vertexCount) * RMesh::kPositionStride > view.streams[kRMeshStreamPosition].size
+			|| src.indexFormat > kRMeshIndex16 || src.indexOffsetBytes % 4 != 0
+			|| src.indexOffsetBytes + (size_t)src.indexCount * ((src.indexFormat == kRMeshIndex16) ? RMesh::kIndex16Stride : RMesh::kIndexStride) > view.streams[kRMeshStreamIndex].size
+			|| src.materialIndex < 0 || src.materialIndex >= (int)pOut->materials.size())
+		{
+			return false;
+		}
+
+		auto&& dst = pOut->submeshes[i];
+		dst.materialIndex = src.materialIndex;
+		dst.vertexOffset = src.vertexOffset;
+		dst.vertexCount = src.vertexCount;
+		dst.indexOffset = src.indexOffset;
+		dst.indexCount = src.indexCount;
+		dst.meshletPrimitiveOffset = src.meshletPrimitiveOffset;
+		dst.meshletPrimitiveCount = src.meshletPrimitiveCount;
+		dst.meshletVertexIndexOffset = src.meshletVertexIndexOffset;
+		dst.meshletVertexIndexCount = src.meshletVertexIndexCount;
+		dst.meshlets.resize(src.meshletCount);
+		memcpy(dst.meshlets.data(), pMeshletData + (size_t)src.meshletOffset * sizeof(RMeshMeshlet), src.meshletCount * sizeof(RMeshMeshlet));
+		dst.bounding = src.bounding;
+		dst.positionOffsetBytes = src.vertexOffset * RMesh::kPositionStride;
+		dst.normalOffsetBytes = src.vertexOffset * RMesh::kNormalStride;
+		dst.tangentOffsetBytes = src.vertexOffset * RMesh::kTangentStride;
+		dst.texcoordOffsetBytes = src.vertexOffset * RMesh::kTexcoordStride;
+		dst.indexOffsetBytes = src.indexOffsetBytes;
+		dst.indexFormat = src.indexFormat;
+		if (pAccel)
+		{
+			pAccel->submeshBounds[i] = LoadAabb(src.boxMin, src.boxMax);
+		}
+	}
+
+	pOut->bounding = header.bounding;
+	pOut->positionScale = Vec3(header.positionScale[0], header.positionScale[1], header.positionScale[2]);
+	pOut->positionOffset = Vec3(header.positionOffset[0], header.positionOffset[1], header.positionOffset[2]);
+
+	uint8_t* pDst[kRMeshStreamMax];
+	std::vector<uint8_t>* streams[] = {
+		&pOut->position, &pOut->normal, &pOut->tangent, &pOut->texcoord,
+		&pOut->index, &pOut->meshletPackedPrimitive, &pOut->meshletVertexIndex,
+	};
+	for (int s = 0; s < kRMeshStreamMax; s++)
+	{
+		streams[s]->resize(view.streams[s].size);
+		pDst[s] = streams[s]->data();
+	}
+	DecodeRMeshStreams(view, pDst, threadCount);
+
+	if (pAccel)
+	{
+		pAccel->bounds = LoadAabb(header.boxMin, header.boxMax);
+		pAccel->bvhs.clear();
+		for (auto&& chunk : file.chunks)
+		{
+			if (chunk.type != kRMeshV2ChunkBvh)
+			{
+				continue;
+			}
+			RMeshBvhData bvh;
+			bvh.submeshIndex = chunk.index;
+			if ((chunk.index != kRMeshV2WholeMesh && chunk.index >= submeshCount)
+				|| !ReadBvh(file.GetChunkData(chunk), (size_t)chunk.size, &bvh))
+			{
+				return false;
+			}
+			pAccel->bvhs.push_back(std::move(bvh));
+		}
+	}
+	return true;
+}
+
+void ComputeRMeshBounds(const RMesh& mesh, RMeshAccel* pOut)
+{
+	pOut->bounds = Aabb();
+	pOut->submeshBounds.assign(mesh.submeshes.size(), Aabb());
+	for (size_t s = 0; s < mesh.submeshes.size(); s++)
+	{
+		auto&& submesh = mesh.submeshes[s];
+		auto&& b = pOut->submeshBounds[s];
+		for (uint32_t t = 0; t < submesh.indexCount / 3; t++)
+		{
+			uint32_t idx[3];
+			mesh.GetTriangle(submesh, t, idx);
+			b.Grow(mesh.GetPosition(submesh, idx[0]));
+			b.Grow(mesh.GetPosition(submesh, idx[1]));
+			b.Grow(mesh.GetPosition(submesh, idx[2]));
+		}
+		pOut->bounds.Grow(b);
+	}
+}
+
+bool ConvertRMeshToV2(const RMesh& mesh, const RMeshV2Settings& settings, std::vector<uint8_t>* pOut)
+{
+	RMeshAccel accel;
+	ComputeRMeshBounds(mesh, &accel);
+
+	std::vector<PendingChunk> chunks;
+
+	// tables.
+	{
+		ByteWriter writer;
+		writer.Write((uint32_t)mesh.materials.size());
+		for (auto&& mat : mesh.materials)
+		{
+			writer.WriteString(mat.name);
+			writer.Write((uint32_t)mat.textureNames.size());
+			for (auto&& tex : mat.textureNames)
+			{
+				writer.WriteString(tex);
+			}
+			writer.Write(mat.baseColor, sizeof(mat.baseColor));
+			writer.Write(mat.emissiveColor, sizeof(mat.emissiveColor));
+			writer.Write(mat.roughness);
+			writer.Write(mat.metallic);
+			writer.Write((uint32_t)(mat.isOpaque ? 1 : 0));
+		}
+		AddChunk(chunks, kRMeshV2ChunkMaterials, 0, std::move(writer.GetData()));
+	}
+	{
+		ByteWriter submeshes, meshlets;
+		uint32_t meshletOffset = 0;
+		for (size_t s = 0; s < mesh.submeshes.size(); s++)
+		{
+			auto&& src = mesh.submeshes[s];
+			RMeshV2Submesh dst = {};
+			dst.materialIndex = src.materialIndex;
+			dst.vertexOffset = src.vertexOffset;
+			dst.vertexCount = src.vertexCount;
+			dst.indexOffset = src.indexOffset;
+			dst.indexCount = src.indexCount;
+			dst.meshletPrimitiveOffset = src.meshletPrimitiveOffset;
+			dst.meshletPrimitiveCount = src.meshletPrimitiveCount;
+			dst.meshletVertexIndexOffset = src.meshletVertexIndexOffset;
+			dst.meshletVertexIndexCount = src.meshletVertexIndexCount;
+			dst.meshletOffset = meshletOffset;
+			dst.meshletCount = (uint32_t)src.meshlets.size();
+			dst.indexOffsetBytes = src.indexOffsetBytes;
+			dst.indexFormat = src.indexFormat;
+			dst.bounding = src.bounding;
+			StoreAabb(accel.submeshBounds[s], dst.boxMin, dst.boxMax);
+			submeshes.Write(dst);
+			meshlets.Write(src.meshlets.data(), src.meshlets.size() * sizeof(RMeshMeshlet));
+			meshletOffset += dst.meshletCount;
+		}
+		AddChunk(chunks, kRMeshV2ChunkSubmeshes, 0, std::move(submeshes.GetData()));
+		AddChunk(chunks, kRMeshV2ChunkMeshlets, 0, std::move(meshlets.GetData()));
+	}
+
+	// streams, borrowed from the mesh.
+	const std::vector<uint8_t>* streams[] = {
+		&mesh.position, &mesh.normal, &mesh.tangent, &mesh.texcoord,
+		&mesh.index, &mesh.meshletPackedPrimitive, &mesh.meshletVertexIndex,
+	};
+	for (int s = 0; s < kRMeshStreamMax; s++)
+	{
+		AddChunk(chunks, kRMeshV2ChunkStream, (uint32_t)s, streams[s]->data(), streams[s]->size());
+	}
+
+	// acceleration data.
+	uint32_t submeshCount = (uint32_t)mesh.submeshes.size();
+	if (settings.bMeshBvh)
+	{
+		AddChunk(chunks, kRMeshV2ChunkBvh, kRMeshV2WholeMesh, BuildBvhChunk(mesh, 0, submeshCount, settings.bvh));
+	}
+	if (settings.bSubmeshBvh)
+	{
+		for (uint32_t s = 0; s < submeshCount; s++)
+		{
+			AddChunk(chunks, kRMeshV2ChunkBvh, s, BuildBvhChunk(mesh, s, s + 1, settings.bvh));
+		}
+	}
+
+	// layout.
+	RMeshV2Header header = {};
+	header.magic = kRMeshV2Magic;
+	header.version = kRMeshV2Version;
+	header.chunkCount = (uint32_t)chunks.size();
+	header.vertexCount = mesh.GetTotalVertexCount();
+	header.bounding = mesh.bounding;
+	for (int i = 0; i < 3; i++)
+	{
+		header.positionScale[i] = mesh.positionScale[i];
+		header.positionOffset[i] = mesh.positionOffset[i];
+	}
+	StoreAabb(accel.bounds, header.boxMin, header.boxMax);
+
+	std::vector<RMeshV2Chunk> table(chunks.size());
+	size_t offset = sizeof(header) + table.size() * sizeof(RMeshV2Chunk);
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		offset = AlignUp(offset, kRMeshV2ChunkAlignment);
+		table[i] = { chunks[i].type, chunks[i].index, (uint64_t)offset, (uint64_t)chunks[i].size };
+		offset += chunks[i].size;
+	}
+
+	pOut->assign(offset, 0);
+	memcpy(pOut->data(), &header, sizeof(header));
+	memcpy(pOut->data() + sizeof(header), table.data(), table.size() * sizeof(RMeshV2Chunk));
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		auto&& chunk = chunks[i];
+		const uint8_t* pSrc = chunk.owned.empty() ? chunk.pData : chunk.owned.data();
+		if (chunk.size > 0)
+		{
+			memcpy(pOut->data() + table[i].offset, pSrc, chunk.size);
+		}
+	}
+	return true;
+}
+
+bool WriteRMeshV2(const std::string& filePath, const RMesh& mesh, const RMeshV2Settings& settings)
+{
+	std::vector<uint8_t> data;
+	if (!ConvertRMeshToV2(mesh, settings, &data))
+	{
+		return false;
+	}
+	FILE* fp = fopen(filePath.c_str(), "wb");
+	if (!fp)
+	{
+		printf("Error: failed to open output file. (%s)\n", filePath.c_str());
+		return false;
+	}
+	bool bSuccess = fwrite(data.data(), 1, data.size(), fp) == data.size();
+	fclose(fp);
+	if (!bSuccess)
+	{
+		printf("Error: failed to write mesh file. (%s)\n", filePath.c_str());
+	}
+	return bSuccess;
+}
+
+bool LoadRMeshAny(const std::string& filePath, RMesh* pOut, RMeshAccel* pAccel, uint32_t threadCount)
+{
+	MappedFile file;
+	if (!file.Open(filePath))
+	{
+		printf("Error: failed to open mesh file. (%s)\n", filePath.c_str());
+		return false;
+	}
+
+	bool bSuccess;
+	if (IsRMeshV2(file.GetData(), file.GetSize()))
+	{
+		RMeshV2File v2;
+		bSuccess = ParseRMeshV2(file.GetData(), file.GetSize(), &v2) && ReadRMeshV2(v2, pOut, pAccel, threadCount);
+	}
+	else
+	{
+		bSuccess = ReadRMesh(file.GetData(), file.GetSize(), pOut, threadCount);
+		if (pAccel)
+		{
+			*pAccel = RMeshAccel();
+		}
+	}
+	if (!bSuccess)
+	{
+		printf("Error: invalid mesh file. (%s)\n", filePath.c_str());
+		return false;
+	}
+	pOut->filePath = filePath;
+	return true;
+}
+
+//	EOF
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "cpu_bvh.h"
+#include "rmesh_reader.h"
+
+#include <string>
+#include <vector>
+
+
+// .rmesh v2, a versioned container of independently loadable chunks.
+//   RMeshV2Header
+//   RMeshV2Chunk[chunkCount]
+//   chunks, each one starts at a kRMeshV2ChunkAlignment aligned offset.
+// streams are stored in the packed layout of RMesh, so loading is a copy from the mapped file.
+// per-submesh bounds and prebuilt bvhs are stored next to the streams, nothing is rebuilt on load.
+static const uint32_t kRMeshV2Magic = 0x32564d52;		// 'RMV2'
+static const uint32_t kRMeshV2Version = 2;
+static const uint32_t kRMeshV2ChunkAlignment = 4096;	// page size, so that a chunk can be mapped on its own.
+static const uint32_t kRMeshV2WholeMesh = 0xffffffff;	// chunk index of data over every submesh.
+
+enum RMeshV2ChunkType
+{
+	kRMeshV2ChunkMaterials,		// material table, length prefixed strings.
+	kRMeshV2ChunkSubmeshes,		// RMeshV2Submesh[].
+	kRMeshV2ChunkMeshlets,		// RMeshMeshlet[] of every submesh.
+	kRMeshV2ChunkStream,		// index is RMeshStream.
+	kRMeshV2ChunkBvh,			// index is the submesh, or kRMeshV2WholeMesh.
+
+	kRMeshV2ChunkMax
+};
+
+struct RMeshV2Header
+{
+	uint32_t		magic;
+	uint32_t		version;
+	uint32_t		chunkCount;
+	uint32_t		vertexCount;
+	RMeshBounding	bounding;
+	float			positionScale[3];
+	float			positionOffset[3];
+	float			boxMin[3];			// tight bounds of the packed positions.
+	float			boxMax[3];
+};
+
+struct RMeshV2Chunk
+{
+	uint32_t	type;
+	uint32_t	index;
+	uint64_t	offset;
+	uint64_t	size;
+};
+
+struct RMeshV2Submesh
+{
+	int32_t			materialIndex;
+	uint32_t		vertexOffset;
+	uint32_t		vertexCount;
+	uint32_t		indexOffset;
+	uint32_t		indexCount;
+	uint32_t		meshletPrimitiveOffset;
+	uint32_t		meshletPrimitiveCount;
+	uint32_t		meshletVertexIndexOffset;
+	uint32_t		meshletVertexIndexCount;
+	uint32_t		meshletOffset;		// into the meshlet chunk.
+	uint32_t		meshletCount;
+	uint32_t		indexOffsetBytes;	// into the index stream.
+	uint32_t		indexFormat;		// RMeshIndexFormat.
+	RMeshBounding	bounding;
+	float			boxMin[3];			// tight bounds of the packed positions.
+	float			boxMax[3];
+};
+
+// head of a bvh chunk, followed by BvhNode[nodeCount] and uint32_t[primIndexCount].
+struct RMeshV2BvhHeader
+{
+	uint32_t	nodeCount;
+	uint32_t	primIndexCount;
+	uint32_t	triangleCount;
+	uint32_t	maxLeafSize;
+	uint32_t	binCount;
+	uint32_t	bSpatialSplits;
+	uint32_t	reserved[2];
+};
+
+// prebuilt bvh of a submesh or of the whole mesh.
+// primitives are triangle indices in the submesh, or in submesh order over the whole mesh.
+struct RMeshBvhData
+{
+	uint32_t				submeshIndex = kRMeshV2WholeMesh;
+	RMeshV2BvhHeader		header = {};
+	std::vector<BvhNode>	nodes;
+	std::vector<uint32_t>	primIndices;
+};
+
+// acceleration data stored next to the streams.
+struct RMeshAccel
+{
+	Aabb						bounds;
+	std::vector<Aabb>			submeshBounds;
+	std::vector<RMeshBvhData>	bvhs;
+
+	const RMeshBvhData* FindBvh(uint32_t submeshIndex) const;
+};
+
+struct RMeshV2Settings
+{
+	bool				bMeshBvh = true;		// bvh over every submesh, the one CpuMesh uses.
+	bool				bSubmeshBvh = false;	// one bvh per submesh.
+	BvhBuildSettings	bvh;
+};
+
+// chunk table of a v2 file, chunks point into the source data.
+struct RMeshV2File
+{
+	const uint8_t*				pData = nullptr;
+	size_t						size = 0;
+	RMeshV2Header				header = {};
+	std::vector<RMeshV2Chunk>	chunks;
+
+	const RMeshV2Chunk* FindChunk(uint32_t type, uint32_t index = 0) const;
+	const uint8_t* GetChunkData(const RMeshV2Chunk& chunk) const { return pData + chunk.offset; }
+};
+
+bool IsRMeshV2(const uint8_t* pData, size_t size);
+// validates the header and the chunk table, no chunk is touched.
+bool ParseRMeshV2(const uint8_t* pData, size_t size, RMeshV2File* pOut);
+// copies the chunks into pOut, pAccel receives the bounds and bvhs when not null.
+bool ReadRMeshV2(const RMeshV2File& file, RMesh* pOut, RMeshAccel* pAccel, uint32_t threadCount = 1);
+
+// tight bounds of the packed positions, the same ones CpuMesh computes.
+void ComputeRMeshBounds(const RMesh& mesh, RMeshAccel* pOut);
+// converts a loaded mesh to the v2 layout.
+bool ConvertRMeshToV2(const RMesh& mesh, const RMeshV2Settings& settings, std::vector<uint8_t>* pOut);
+bool WriteRMeshV2(const std::string& filePath, const RMesh& mesh, const RMeshV2Settings& settings = RMeshV2Settings());
+
+// loads either version, pAccel is left empty for v1 files.
+bool LoadRMeshAny(const std::string& filePath, RMesh* pOut, RMeshAccel* pAccel, uint32_t threadCount = 0);
+
+//	EOF
@@ -7,6 +7,10 @@
 #include "sl12/resource_texture.h"
 #include "sl12/command_queue.h"
 
+#include "cpu_material_fold.h"
+#include "init_stages.h"
+#include "path_tracer_permutation.h"
+
 #define NOMINMAX
 #include <windowsx.h>
 #include <memory>
@@ -14,6 +18,7 @@
 
 #define USE_IN_CPP
 #include "../shaders/cbuffer.hlsli"
+#include "../shaders/progressive.hlsli"
 
 #define ENABLE_DYNAMIC_RESOURCE 0
 
@@ -24,20 +29,37 @@ namespace
 	static const char* kResourceDir = "resources";
 	static const char* kShaderDir = "PathTracer/shaders";
 	static const char* kShaderIncludeDir = "../SampleLib12/SampleLib12/shaders/include";
+	static const char* kShaderCacheDir = "temp/shader_cache";
+	// part of every shader cache key, change it when the dxc of SampleLib12 is updated.
+	static const char* kShaderCompilerId = "sl12::ShaderManager dxc";
 
 	static const sl12::u32 kShadowMapSize = 1024;
 
 	static const int kRTMaterialTableCount = 1;
 
 	static sl12::RenderGraphTargetDesc gRTResultDesc;
-	void SetGBufferDesc(sl12::u32 width, sl12::u32 height)
+	static sl12::RenderGraphTargetDesc gRTAlbedoDesc;
+	static sl12::RenderGraphTargetDesc gRTNormalDesc;
+	void SetGBufferDesc(sl12::u32 width, sl12::u32 height, AovLayout layout)
 	{
 		gRTResultDesc.name = "RT";
 		gRTResultDesc.type = sl12::RenderGraphTargetType::Buffer;
-		gRTResultDesc.width = width * height * sizeof(float) * 3;
+		gRTResultDesc.width = GetAovBufferSize(layout, AovImage::Color, width, height);
 		gRTResultDesc.usage = sl12::ResourceUsage::ShaderResource | sl12::ResourceUsage::UnorderedAccess;
 		gRTResultDesc.srvDescs.push_back(sl12::RenderGraphSRVDesc(0, 0, 0));
 		gRTResultDesc.uavDescs.push_back(sl12::RenderGraphUAVDesc(0, 0, 0));
+
+		// the half layout packs normal into the albedo target, its normal desc has no size.
+		gRTAlbedoDesc = gRTResultDesc;
+		gRTAlbedoDesc.width = GetAovBufferSize(layout, AovImage::Albedo, width, height);
+		gRTNormalDesc = gRTResultDesc;
+		gRTNormalDesc.width = GetAovBufferSize(layout, AovImage::Normal, width, height);
+	}
+
+	template <typename Material>
+	MaterialFold ClassifyResourceMaterial(const Material& material)
+	{
+		return ClassifyMaterial(material.baseColorTex.IsValid(), material.ormTex.IsValid(), material.isOpaque);
 	}
 
 	enum ShaderName
@@ -55,11 +77,23 @@ namespace
 		"material.lib.hlsl",				"main",
 		"pathtracer.lib.hlsl",				"main",
 	};
+	// pathtracer.lib.hlsl of each kPathTracerPermutations follows the named shaders.
+	static const int kShaderSlotCount = ShaderName::MAX + kPathTracerPermutationCount;
+	inline int GetPathTracerPermutationSlot(int permutation)
+	{
+		return ShaderName::MAX + permutation;
+	}
+
+	static const DenoiseQuality kDenoiseQualities[] = {
+		DenoiseQuality::Default,
+		DenoiseQuality::Balanced,
+		DenoiseQuality::High,
+	};
 
 	static const sl12::RaytracingDescriptorCount kRTDescriptorCountGlobal = {
 		3,	// cbv
 		0,	// srv
-		3,	// uav
+		4,	// uav
 		0,	// sampler
 	};
 	static const sl12::RaytracingDescriptorCount kRTDescriptorCountLocal = {
@@ -69,21 +103,31 @@ namespace
 		1,	// sampler
 	};
 
-	static const sl12::u32 kGlobalIndexCount = 6;
+	static const sl12::u32 kGlobalIndexCount = 7;
 	static const sl12::u32 kLocalIndexCount = 6;
 
 	static LPCWSTR kMaterialCHS = L"MaterialCHS";
 	static LPCWSTR kMaterialAHS = L"MaterialAHS";
 	static LPCWSTR kMaterialOpacityHG = L"MaterialOpacityHG";
 	static LPCWSTR kMaterialMaskedHG = L"MaterialMaskedHG";
+	static LPCWSTR kMaterialConstantCHS = L"MaterialConstantCHS";
+	static LPCWSTR kMaterialConstantHG = L"MaterialConstantHG";
 	static LPCWSTR kPathTracerRGS = L"PathTracerRGS";
 	static LPCWSTR kPathTracerMS = L"PathTracerMS";
+
+	// kPathTracerRGS of a permutation library, renamed to "PathTracerRGS_s1_d4" in the pipeline.
+	std::wstring GetPathTracerPermutationExport(int permutation)
+	{
+		auto&& p = kPathTracerPermutations[permutation];
+		return std::wstring(kPathTracerRGS) + L"_s" + std::to_wstring(p.sampleCount) + L"_d" + std::to_wstring(p.depthMax);
+	}
 }
 
-SampleApplication::SampleApplication(HINSTANCE hInstance, int nCmdShow, int screenWidth, int screenHeight, sl12::ColorSpaceType csType, const std::string& homeDir, int meshType)
+SampleApplication::SampleApplication(HINSTANCE hInstance, int nCmdShow, int screenWidth, int screenHeight, sl12::ColorSpaceType csType, const std::string& homeDir, int meshType, AovLayout aovLayout)
 	: Application(hInstance, nCmdShow, screenWidth, screenHeight, csType)
 	, displayWidth_(screenWidth), displayHeight_(screenHeight)
 	, meshType_(meshType)
+	, aovLayout_(aovLayout)
 {
 	std::filesystem::path p(homeDir);
 	p = std::filesystem::absolute(p);
@@ -99,6 +143,22 @@ bool SampleApplication::Initialize()
 	{
 		return false;
 	}
+
+	// running mean of the progressive mode, it keeps full precision with every aov layout.
+	{
+		accumBuffer_ = sl12::MakeUnique<sl12::Buffer>(&device_);
+		accumUAV_ = sl12::MakeUnique<sl12::UnorderedAccessView>(&device_);
+		sl12::BufferDesc desc{};
+		desc.heap = sl12::BufferHeap::Default;
+		desc.size = (size_t)displayWidth_ * displayHeight_ * ACCUM_STRIDE;
+		desc.usage = sl12::ResourceUsage::UnorderedAccess;
+		desc.initialState = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		if (!accumBuffer_->Initialize(&device_, desc) || !accumUAV_->Initialize(&device_, &accumBuffer_, 0, 0, 0, 0))
+		{
+			sl12::ConsolePrint("Error: failed to init accumulation buffer.");
+			return false;
+		}
+	}
 	
 	// initialize mesh manager.
 	const size_t kVertexBufferSize = 512 * 1024 * 1024;		// 512MB
@@ -124,20 +184,61 @@ bool SampleApplication::Initialize()
 	}
 
 	// compile shaders.
+	// binaries of unchanged sources load from the cache, the misses compile in parallel on the shader manager threads.
 	const std::string shaderBaseDir = sl12::JoinPath(homeDir_, kShaderDir);
-	std::vector<sl12::ShaderDefine> shaderDefines;
-	shaderDefines.push_back(sl12::ShaderDefine("ENABLE_DYNAMIC_RESOURCE", ENABLE_DYNAMIC_RESOURCE ? "1" : "0"));
-	for (int i = 0; i < ShaderName::MAX; i++)
-	{
-		const char* file = kShaderFileAndEntry[i * 2 + 0];
-		const char* entry = kShaderFileAndEntry[i * 2 + 1];
-		auto handle = shaderMan_->CompileFromFile(
-			sl12::JoinPath(shaderBaseDir, file),
-			entry, sl12::GetShaderTypeFromFileName(file), 6, 6, nullptr, &shaderDefines);
-		hShaders_.push_back(handle);
+	// the path tracer permutations add their loop counts to the defines.
+	// the sl12 defines point into shaderDescs, which stays alive until the compiles are done.
+	std::vector<ShaderCompileDesc> shaderDescs(kShaderSlotCount);
+	std::vector<std::vector<sl12::ShaderDefine>> shaderDefines(kShaderSlotCount);
+	shaderCache_.Initialize(sl12::JoinPath(homeDir_, kShaderCacheDir));
+	std::vector<ShaderCacheKey> shaderKeys(kShaderSlotCount);
+	std::vector<bool> shaderMisses(kShaderSlotCount, false);
+	hShaders_.resize(kShaderSlotCount);
+	cachedShaders_.resize(kShaderSlotCount);
+	for (int i = 0; i < kShaderSlotCount; i++)
+	{
+		int name = (i < ShaderName::MAX) ? i : ShaderName::PathTracerLib;
+		const char* file = kShaderFileAndEntry[name * 2 + 0];
+		const char* entry = kShaderFileAndEntry[name * 2 + 1];
+		auto&& desc = shaderDescs[i];
+		desc.filePath = sl12::JoinPath(shaderBaseDir, file);
+		desc.entryPoint = entry;
+		desc.target = GetShaderTarget(file);
+		desc.defines.push_back(std::make_pair("ENABLE_DYNAMIC_RESOURCE", ENABLE_DYNAMIC_RESOURCE ? "1" : "0"));
+		if (name == ShaderName::PathTracerLib || name == ShaderName::TonemapP)
+		{
+			desc.defines.push_back(std::make_pair("AOV_LAYOUT", std::to_string((int)aovLayout_)));
+		}
+		if (i >= ShaderName::MAX)
+		{
+			auto&& permutation = kPathTracerPermutations[i - ShaderName::MAX];
+			desc.defines.push_back(std::make_pair("PT_SAMPLE_COUNT", std::to_string(permutation.sampleCount)));
+			desc.defines.push_back(std::make_pair("PT_DEPTH_MAX", std::to_string(permutation.depthMax)));
+		}
+		for (auto&& define : desc.defines)
+		{
+			shaderDefines[i].push_back(sl12::ShaderDefine(define.first.c_str(), define.second.c_str()));
+		}
+		bool bKeyed = MakeShaderCacheKey(desc, shaderIncludeDirs, kShaderCompilerId, &shaderKeys[i]);
+		std::vector<uint8_t> binary;
+		if (bKeyed && shaderCache_.Load(shaderKeys[i], &binary))
+		{
+			std::unique_ptr<sl12::Shader> shader(new sl12::Shader());
+			if (shader->Initialize(&device_, sl12::GetShaderTypeFromFileName(file), binary.data(), binary.size()))
+			{
+				cachedShaders_[i] = std::move(shader);
+				continue;
+			}
+		}
+		hShaders_[i] = shaderMan_->CompileFromFile(
+			desc.filePath,
+			entry, sl12::GetShaderTypeFromFileName(file), 6, 6, nullptr, &shaderDefines[i]);
+		shaderMisses[i] = bKeyed;
 	}
 	
 	// load request.
+	// meshes are read and uploaded by sl12's resource loader on its own thread, it has no hook for streams decoded outside.
+	// the mapped LoadRMesh() therefore serves the cpu scene of the headless runner and its tools only.
 	if (meshType_ == 0)
 	{
 		hSuzanneMesh_ = resLoader_->LoadRequest<sl12::ResourceItemMesh>("mesh/hp_suzanne/hp_suzanne.rmesh");
@@ -172,7 +273,7 @@ bool SampleApplication::Initialize()
 	sceneRoot_ = sl12::MakeUnique<sl12::SceneRoot>(nullptr);
 
 	// get GBuffer target descs.
-	SetGBufferDesc(displayWidth_, displayHeight_);
+	SetGBufferDesc(displayWidth_, displayHeight_, aovLayout_);
 	
 	// create sampler.
 	{
@@ -187,120 +288,148 @@ bool SampleApplication::Initialize()
 		linearSampler_->Initialize(&device_, desc);
 	}
 	
-	// init utility command list.
-	auto utilCmdList = sl12::MakeUnique<sl12::CommandList>(&device_);
-	utilCmdList->Initialize(&device_, &device_.GetGraphicsQueue());
-	utilCmdList->Reset();
+	// the remaining stages run as tasks, each one waits only for what it reads (see init_stages.h).
+	// shaders and resources keep loading on their own threads while the independent stages run.
+	// the stages create objects on the d3d12 device, which is free threaded.
+	std::function<bool()> stageFuncs[(int)InitStage::Count];
+	stageFuncs[(int)InitStage::Gui] = [this]()
+	{
+		// init utility command list.
+		auto utilCmdList = sl12::MakeUnique<sl12::CommandList>(&device_);
+		utilCmdList->Initialize(&device_, &device_.GetGraphicsQueue());
+		utilCmdList->Reset();
+
+		// init GUI.
+		gui_ = sl12::MakeUnique<sl12::Gui>(nullptr);
+		if (!gui_->Initialize(&device_, device_.GetSwapchain().GetTexture(0)->GetResourceDesc().Format))
+		{
+			sl12::ConsolePrint("Error: failed to init GUI.");
+			return false;
+		}
+		if (!gui_->CreateFontImage(&device_, &utilCmdList))
+		{
+			sl12::ConsolePrint("Error: failed to create GUI font.");
+			return false;
+		}
 
-	// init GUI.
-	gui_ = sl12::MakeUnique<sl12::Gui>(nullptr);
-	if (!gui_->Initialize(&device_, device_.GetSwapchain().GetTexture(0)->GetResourceDesc().Format))
-	{
-		sl12::ConsolePrint("Error: failed to init GUI.");
-		return false;
-	}
-	if (!gui_->CreateFontImage(&device_, &utilCmdList))
-	{
-		sl12::ConsolePrint("Error: failed to create GUI font.");
-		return false;
-	}
+		// create dummy texture.
+		if (!device_.CreateDummyTextures(&utilCmdList))
+		{
+			return false;
+		}
 
-	// create dummy texture.
-	if (!device_.CreateDummyTextures(&utilCmdList))
+		// execute utility commands.
+		utilCmdList->Close();
+		utilCmdList->Execute();
+		device_.WaitDrawDone();
+		return true;
+	};
+	stageFuncs[(int)InitStage::Timestamps] = [this]()
 	{
-		return false;
-	}
-
-	// execute utility commands.
-	utilCmdList->Close();
-	utilCmdList->Execute();
-	device_.WaitDrawDone();
+		for (auto&& t : timestamps_)
+		{
+			t.Initialize(&device_, 16);
+		}
+		return true;
+	};
 
 	// wait compile and load.
-	while (shaderMan_->IsCompiling() || resLoader_->IsLoading())
-	{
-		std::this_thread::sleep_for(std::chrono::milliseconds(1));
-	}
-	
-	// create scene meshes.
-	if (meshType_ == 0)
+	stageFuncs[(int)InitStage::WaitShaders] = [this, &shaderKeys, &shaderMisses]()
 	{
-		static const int kMeshWidth = 32;
-		static const float kMeshInter = 100.0f;
-		static const float kMeshOrigin = -(kMeshWidth - 1) * kMeshInter * 0.5f;
-		std::random_device seed_gen;
-		std::mt19937 rnd(seed_gen());
-		auto RandRange = [&rnd](float minV, float maxV)
+		while (shaderMan_->IsCompiling())
 		{
-			sl12::u32 val = rnd();
-			float v0_1 = (float)val / (float)0xffffffff;
-			return minV + (maxV - minV) * v0_1;
-		};
-		for (int x = 0; x < kMeshWidth; x++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		// misses are stored for the next launch.
+		for (int i = 0; i < kShaderSlotCount; i++)
 		{
-			for (int y = 0; y < kMeshWidth; y++)
+			auto pShader = shaderMisses[i] ? hShaders_[i].GetShader() : nullptr;
+			if (pShader)
 			{
-				auto mesh = std::make_shared<sl12::SceneMesh>(&device_, hSuzanneMesh_.GetItem<sl12::ResourceItemMesh>());
-				DirectX::XMFLOAT3 pos(kMeshOrigin + x * kMeshInter, RandRange(-100.0f, 100.0f), kMeshOrigin + y * kMeshInter);
-				DirectX::XMFLOAT4X4 mat;
-				DirectX::XMMATRIX m = DirectX::XMMatrixRotationRollPitchYaw(RandRange(-DirectX::XM_PI, DirectX::XM_PI), RandRange(-DirectX::XM_PI, DirectX::XM_PI), RandRange(-DirectX::XM_PI, DirectX::XM_PI))
-										* DirectX::XMMatrixTranslation(pos.x, pos.y, pos.z);
-				DirectX::XMStoreFloat4x4(&mat, m);
-				mesh->SetMtxLocalToWorld(mat);
-
-				sceneMeshes_.push_back(mesh);
+				shaderCache_.Store(shaderKeys[i], pShader->GetData(), pShader->GetSize());
 			}
 		}
-	}
-	else
+		return true;
+	};
+	stageFuncs[(int)InitStage::WaitResources] = [this]()
 	{
-		// sponza
+		while (resLoader_->IsLoading())
 		{
-			auto mesh = std::make_shared<sl12::SceneMesh>(&device_, hSponzaMesh_.GetItem<sl12::ResourceItemMesh>());
-			DirectX::XMFLOAT3 pos(0.0f, -300.0f, 100.0f);
-			DirectX::XMFLOAT3 scl(0.02f, 0.02f, 0.02f);
-			DirectX::XMFLOAT4X4 mat;
-			DirectX::XMMATRIX m = DirectX::XMMatrixScaling(scl.x, scl.y, scl.z)
-									* DirectX::XMMatrixTranslation(pos.x, pos.y, pos.z);
-			DirectX::XMStoreFloat4x4(&mat, m);
-			mesh->SetMtxLocalToWorld(mat);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	};
 
-			sceneMeshes_.push_back(mesh);
+	// transforms of the scene meshes do not need the meshes.
+	std::vector<DirectX::XMFLOAT4X4> meshTransforms;
+	stageFuncs[(int)InitStage::SceneTransforms] = [this, &meshTransforms]()
+	{
+		if (meshType_ == 0)
+		{
+			static const int kMeshWidth = 32;
+			static const float kMeshInter = 100.0f;
+			static const float kMeshOrigin = -(kMeshWidth - 1) * kMeshInter * 0.5f;
+			std::random_device seed_gen;
+			std::mt19937 rnd(seed_gen());
+			auto RandRange = [&rnd](float minV, float maxV)
+			{
+				sl12::u32 val = rnd();
+				float v0_1 = (float)val / (float)0xffffffff;
+				return minV + (maxV - minV) * v0_1;
+			};
+			for (int x = 0; x < kMeshWidth; x++)
+			{
+				for (int y = 0; y < kMeshWidth; y++)
+				{
+					DirectX::XMFLOAT3 pos(kMeshOrigin + x * kMeshInter, RandRange(-100.0f, 100.0f), kMeshOrigin + y * kMeshInter);
+					DirectX::XMFLOAT4X4 mat;
+					DirectX::XMMATRIX m = DirectX::XMMatrixRotationRollPitchYaw(RandRange(-DirectX::XM_PI, DirectX::XM_PI), RandRange(-DirectX::XM_PI, DirectX::XM_PI), RandRange(-DirectX::XM_PI, DirectX::XM_PI))
+											* DirectX::XMMatrixTranslation(pos.x, pos.y, pos.z);
+					DirectX::XMStoreFloat4x4(&mat, m);
+					meshTransforms.push_back(mat);
+				}
+			}
 		}
-		// title
+		else
 		{
-			auto mesh = std::make_shared<sl12::SceneMesh>(&device_, hTitleMesh_.GetItem<sl12::ResourceItemMesh>());
-			DirectX::XMFLOAT3 pos(400.0f, 1000.0f, 40.0f);
-			DirectX::XMFLOAT3 scl(2.5f, 2.5f, 2.5f);
-			DirectX::XMFLOAT3 rot(0.0f, DirectX::XMConvertToRadians(90.0f), 0.0f);
-			DirectX::XMFLOAT4X4 mat;
-			DirectX::XMMATRIX m = DirectX::XMMatrixScaling(scl.x, scl.y, scl.z)
-									* DirectX::XMMatrixRotationY(DirectX::XMConvertToRadians(90.0f))
-									* DirectX::XMMatrixTranslation(pos.x, pos.y, pos.z);
-			DirectX::XMStoreFloat4x4(&mat, m);
-			mesh->SetMtxLocalToWorld(mat);
-
-			sceneMeshes_.push_back(mesh);
+			// sponza
+			{
+				DirectX::XMFLOAT3 pos(0.0f, -300.0f, 100.0f);
+				DirectX::XMFLOAT3 scl(0.02f, 0.02f, 0.02f);
+				DirectX::XMFLOAT4X4 mat;
+				DirectX::XMMATRIX m = DirectX::XMMatrixScaling(scl.x, scl.y, scl.z)
+										* DirectX::XMMatrixTranslation(pos.x, pos.y, pos.z);
+				DirectX::XMStoreFloat4x4(&mat, m);
+				meshTransforms.push_back(mat);
+			}
+			// title
+			{
+				DirectX::XMFLOAT3 pos(400.0f, 1000.0f, 40.0f);
+				DirectX::XMFLOAT3 scl(2.5f, 2.5f, 2.5f);
+				DirectX::XMFLOAT4X4 mat;
+				DirectX::XMMATRIX m = DirectX::XMMatrixScaling(scl.x, scl.y, scl.z)
+										* DirectX::XMMatrixRotationY(DirectX::XMConvertToRadians(90.0f))
+										* DirectX::XMMatrixTranslation(pos.x, pos.y, pos.z);
+				DirectX::XMStoreFloat4x4(&mat, m);
+				meshTransforms.push_back(mat);
+			}
 		}
-	}
-	ComputeSceneAABB();
+		return true;
+	};
 
-	// attach meshes to root.
-	for (auto&& m : sceneMeshes_)
-	{
-		sceneRoot_->AttachNode(m);
-	}
-	
 	// init root signature and pipeline state.
-	rsVsPs_ = sl12::MakeUnique<sl12::RootSignature>(&device_);
-	rsTonemapDR_ = sl12::MakeUnique<sl12::RootSignature>(&device_);
-	psoTonemap_ = sl12::MakeUnique<sl12::GraphicsPipelineState>(&device_);
-	rsVsPs_->Initialize(&device_, hShaders_[ShaderName::FullscreenVV].GetShader(), hShaders_[ShaderName::TonemapP].GetShader(), nullptr, nullptr, nullptr);
+	stageFuncs[(int)InitStage::TonemapPso] = [this]()
 	{
+		rsVsPs_ = sl12::MakeUnique<sl12::RootSignature>(&device_);
+		rsTonemapDR_ = sl12::MakeUnique<sl12::RootSignature>(&device_);
+		psoTonemap_ = sl12::MakeUnique<sl12::GraphicsPipelineState>(&device_);
+		rsVsPs_->Initialize(&device_, GetShader(ShaderName::FullscreenVV), GetShader(ShaderName::TonemapP), nullptr, nullptr, nullptr);
+
 		sl12::GraphicsPipelineStateDesc desc{};
 		desc.pRootSignature = &rsVsPs_;
-		desc.pVS = hShaders_[ShaderName::FullscreenVV].GetShader();
-		desc.pPS = hShaders_[ShaderName::TonemapP].GetShader();
+		desc.pVS = GetShader(ShaderName::FullscreenVV);
+		desc.pPS = GetShader(ShaderName::TonemapP);
 
 		desc.blend.sampleMask = UINT_MAX;
 		desc.blend.rtDesc[0].isBlendEnable = false;
@@ -336,16 +465,61 @@ bool SampleApplication::Initialize()
 			return false;
 		}
 #endif
-	}
-	
-	if (!CreateRaytracingPipeline())
+		return true;
+	};
+
+	stageFuncs[(int)InitStage::RaytracingPipeline] = [this]()
 	{
-		return false;
-	}
+		return CreateRaytracingPipeline();
+	};
+
+	// create scene meshes.
+	stageFuncs[(int)InitStage::SceneMeshes] = [this, &meshTransforms]()
+	{
+		std::vector<const sl12::ResourceItemMesh*> meshItems;
+		if (meshType_ == 0)
+		{
+			meshItems.assign(meshTransforms.size(), hSuzanneMesh_.GetItem<sl12::ResourceItemMesh>());
+		}
+		else
+		{
+			meshItems = { hSponzaMesh_.GetItem<sl12::ResourceItemMesh>(), hTitleMesh_.GetItem<sl12::ResourceItemMesh>() };
+		}
+		for (size_t i = 0; i < meshItems.size(); i++)
+		{
+			auto mesh = std::make_shared<sl12::SceneMesh>(&device_, meshItems[i]);
+			mesh->SetMtxLocalToWorld(meshTransforms[i]);
+			sceneMeshes_.push_back(mesh);
+		}
+		ComputeSceneAABB();
+
+		// instances for the top level update.
+		for (auto&& m : sceneMeshes_)
+		{
+			auto&& box = m->GetParentResource()->GetBoundingInfo().box;
+			Aabb localBounds(Vec3(box.aabbMin.x, box.aabbMin.y, box.aabbMin.z), Vec3(box.aabbMax.x, box.aabbMax.y, box.aabbMax.z));
+			sceneUpdate_.AddInstance(localBounds, m->GetMtxLocalToWorld());
+		}
 
-	for (auto&& t : timestamps_)
+		// attach meshes to root.
+		for (auto&& m : sceneMeshes_)
+		{
+			sceneRoot_->AttachNode(m);
+		}
+		return true;
+	};
+
+	TaskScheduler scheduler;
+	scheduler.Initialize();
+	AddInitStages(&scheduler, stageFuncs);
+	bool bInitSucceeded = scheduler.Run();
+	initTrace_ = scheduler.GetTrace();
+	scheduler.Destroy();
+	sl12::ConsolePrint("init tasks: wall %.2f ms, busy %.2f ms, critical path %.2f ms, %u threads\n",
+		initTrace_.wallMs, initTrace_.GetBusyMs(), initTrace_.GetCriticalPathMs(), initTrace_.workerCount);
+	if (!bInitSucceeded)
 	{
-		t.Initialize(&device_, 16);
+		return false;
 	}
 
 	cameraPos_ = DirectX::XMFLOAT3(1000.0f, 1000.0f, 0.0f);
@@ -373,15 +547,28 @@ void SampleApplication::Finalize()
 	rsRTGlobal_.Reset();
 	rsRTLocal_.Reset();
 	rsCs_.Reset();
+	accumUAV_.Reset();
+	accumBuffer_.Reset();
 	rsVsPs_.Reset();
+	if (pBvhScene_)
+	{
+		device_.KillObject(pBvhScene_);
+		pBvhScene_ = nullptr;
+	}
 	bvhMan_.Reset();
 	renderGraph_.Reset();
 	cbvMan_.Reset();
 	mainCmdList_.Reset();
+	cachedShaders_.clear();
 	shaderMan_.Reset();
 	resLoader_.Reset();
 }
 
+sl12::Shader* SampleApplication::GetShader(int index)
+{
+	return cachedShaders_[index] ? cachedShaders_[index].get() : hShaders_[index].GetShader();
+}
+
 bool SampleApplication::Execute()
 {
 	const int kSwapchainBufferOffset = 1;
@@ -389,6 +576,7 @@ bool SampleApplication::Execute()
 	auto prevFrameIndex = (device_.GetSwapchain().GetFrameIndex() + sl12::Swapchain::kMaxBuffer - 2) % sl12::Swapchain::kMaxBuffer;
 	auto pCmdList = &mainCmdList_->Reset();
 	auto* pTimestamp = timestamps_ + timestampIndex_;
+	auto denoiseSlot = (sl12::u32)(frameIndex_ % kDenoiseSlotCount);
 
 	sl12::CpuTimer now = sl12::CpuTimer::CurrentTime();
 	sl12::CpuTimer delta = now - currCpuTime_;
@@ -404,10 +592,42 @@ bool SampleApplication::Execute()
 		// path trace settings.
 		if (ImGui::CollapsingHeader("Path Trace", ImGuiTreeNodeFlags_DefaultOpen))
 		{
-			ImGui::Checkbox("Denoise", &bDenoiseEnable_);
+			if (denoiser_.IsValid())
+			{
+				ImGui::Checkbox("Denoise", &bDenoiseEnable_);
+				const char* qualityNames[ARRAYSIZE(kDenoiseQualities)];
+				for (int i = 0; i < ARRAYSIZE(kDenoiseQualities); i++)
+				{
+					qualityNames[i] = GetDenoiseQualityName(kDenoiseQualities[i]);
+				}
+				ImGui::Combo("Denoise Quality", &denoiseQuality_, qualityNames, ARRAYSIZE(qualityNames));
+				ImGui::Checkbox("Prefilter Aux", &bDenoisePrefilterAux_);
+				auto denoiseStats = asyncDenoiser_.GetStats();
+				ImGui::Text("Denoiser : %s%s, %zu filters", GetDenoiserDeviceTypeName(denoiser_.GetDeviceType()), bSharedDenoiseBuffers_ ? " (shared)" : "", denoiseStats.filterCount);
+				ImGui::Text("Denoise : %.2f ms, wait %.2f ms, %llu frames late", denoiseStats.denoiseMs, denoiseStats.waitMs, (unsigned long long)denoiseStats.latencyFrames);
+				auto traffic = GetAovFrameTraffic(aovLayout_, displayWidth_, displayHeight_, bDenoiseEnable_, bDenoiseEnable_ && bSharedDenoiseBuffers_);
+				ImGui::Text("AOV : %s, %.1f MB per frame (copy %.1f MB)", GetAovLayoutName(aovLayout_),
+					(double)traffic.GetTotal() / (1024.0 * 1024.0), (double)(traffic.copyRead + traffic.copyWrite) / (1024.0 * 1024.0));
+				if (bDenoisePrefilterAux_)
+				{
+					ImGui::Text("Prefilter : %u run, %u reused, %.2f ms saved per reuse", denoiseStats.prefilterCount, denoiseStats.prefilterSkipCount, denoiseStats.prefilterMs);
+				}
+			}
+			else
+			{
+				ImGui::Text("Denoiser : not available");
+			}
 			ImGui::SliderInt("Sample Count", &ptSampleCount_, 1, 16);
 			ImGui::SliderInt("Depth Max", &ptDepthMax_, 1, 16);
+			ImGui::Text("Raygen : %s", (FindPathTracerPermutation(ptSampleCount_, ptDepthMax_) >= 0) ? "fixed loops" : "generic");
+			ImGui::Checkbox("Progressive", &bProgressive_);
+			if (bProgressive_)
+			{
+				ImGui::Text("Accumulated : %u frames, %llu spp, %llu resets", progressive_.GetFrameCount(),
+					(unsigned long long)progressive_.GetSampleCount(), (unsigned long long)progressive_.GetResetCount());
+			}
 		}
+		ptPermutation_ = FindPathTracerPermutation(ptSampleCount_, ptDepthMax_);
 
 		// light settings.
 		if (ImGui::CollapsingHeader("Light", ImGuiTreeNodeFlags_DefaultOpen))
@@ -420,6 +640,32 @@ bool SampleApplication::Execute()
 			ImGui::ColorEdit3("Directional Color", directionalColor_);
 			ImGui::SliderFloat("Directional Intensity", &directionalIntensity_, 0.0f, 10.0f);
 		}
+
+		// scene update counters.
+		if (ImGui::CollapsingHeader("Scene Update"))
+		{
+			auto&& c = sceneUpdate_.GetCounters();
+			ImGui::Text("No-op : %llu", (unsigned long long)c.noopCount);
+			ImGui::Text("Refit : %llu", (unsigned long long)c.refitCount);
+			ImGui::Text("Rebuild : %llu", (unsigned long long)c.rebuildCount);
+			ImGui::Text("Dirty Instances : %llu", (unsigned long long)c.dirtyInstances);
+		}
+		if (ImGui::CollapsingHeader("Material Registry"))
+		{
+			auto&& c = materialRegistry_.GetCounters();
+			ImGui::Text("View Descriptors : %u / %llu", materialRegistry_.GetDescriptorCount(MaterialDescriptorHeap::View), (unsigned long long)c.requestedDescriptors[(int)MaterialDescriptorHeap::View]);
+			ImGui::Text("Sampler Descriptors : %u / %llu", materialRegistry_.GetDescriptorCount(MaterialDescriptorHeap::Sampler), (unsigned long long)c.requestedDescriptors[(int)MaterialDescriptorHeap::Sampler]);
+			ImGui::Text("Records : %u / %llu", materialRegistry_.GetRecordCount(), (unsigned long long)c.requestedRecords);
+		}
+		if (ImGui::CollapsingHeader("Tasks"))
+		{
+			auto&& trace = initTrace_;
+			ImGui::Text("Init : %.3f ms (busy %.3f ms, critical path %.3f ms, stolen %u)", trace.wallMs, trace.GetBusyMs(), trace.GetCriticalPathMs(), trace.stolenCount);
+			for (auto&& e : trace.events)
+			{
+				ImGui::Text("  [%u] %s : %.3f ms", e.workerIndex, e.name.c_str(), e.endMs - e.beginMs);
+			}
+		}
 	}
 	ImGui::Render();
 
@@ -437,75 +683,35 @@ bool SampleApplication::Execute()
 
 	// gather mesh render commands.
 	sl12::RenderCommandsList meshRenderCmds;
-	{
-		sceneRoot_->GatherRenderCommands(&cbvMan_, meshRenderCmds);
-	}
+	sceneRoot_->GatherRenderCommands(&cbvMan_, meshRenderCmds);
 
 	// add ray tracing geometries.
+	// BuildGeometry() compacts a new blas once its size is read back, after the gpu finished the frame that built it.
+	// the command list ring guarantees that kBufferCount frames later, the top level is rebuilt until then.
+	bool bBlasCompacting = false;
 	for (auto&& cmd : meshRenderCmds)
 	{
 		if (cmd->GetType() == sl12::RenderCommandType::Mesh)
 		{
-			bvhMan_->AddGeometry(static_cast<sl12::MeshRenderCommand*>(cmd.get()));
+			auto mcmd = static_cast<sl12::MeshRenderCommand*>(cmd.get());
+			bvhMan_->AddGeometry(mcmd);
+			auto it = blasBuildFrames_.emplace(mcmd->GetParentMesh()->GetParentResource(), frameIndex_).first;
+			bBlasCompacting = bBlasCompacting || (frameIndex_ <= it->second + kBufferCount);
 		}
 	}
 
-	// build ray tracing assets.
-	sl12::BvhScene* pBvhScene = nullptr;
+	// only moved instances are marked dirty, the previous tlas is kept if nothing moved.
+	for (size_t i = 0; i < sceneMeshes_.size(); i++)
 	{
-		// build BVH.
-		bvhMan_->BuildGeometry(pCmdList);
-		sl12::RenderCommandsTempList tmpRenderCmds;
-		pBvhScene = bvhMan_->BuildScene(pCmdList, meshRenderCmds, kRTMaterialTableCount, tmpRenderCmds);
-		bvhMan_->CopyCompactionInfoOnGraphicsQueue(pCmdList);
-
-		// create ray tracing shader table.
-#if !ENABLE_DYNAMIC_RESOURCE
-		bool bCreateRTShaderTableSuccess = CreateRayTracingShaderTable(pCmdList, tmpRenderCmds);
-		assert(bCreateRTShaderTableSuccess);
-#else
-		bool bCreateRTShaderTableDRSuccess = CreateRayTracingShaderTableDR(pCmdList, tmpRenderCmds);
-		assert(bCreateRTShaderTableDRSuccess);
-#endif
+		sceneUpdate_.SetMtxLocalToWorld((sl12::u32)i, sceneMeshes_[i]->GetMtxLocalToWorld());
 	}
+	SceneUpdateType sceneUpdateType = sceneUpdate_.Update();
 
-	// create targets.
-	sl12::RenderGraphTargetID rtResultID, rtAlbedoID, rtNormalID;
-	rtResultID = renderGraph_->AddTarget(gRTResultDesc);
-	rtAlbedoID = renderGraph_->AddTarget(gRTResultDesc);
-	rtNormalID = renderGraph_->AddTarget(gRTResultDesc);
-
-	// create render passes.
-	{
-		std::vector<sl12::RenderPass> passes;
-		std::vector<sl12::RenderGraphTargetID> histories;
-		std::vector<sl12::RenderGraphTargetID> returns;
-
-		// path tracing.
-		sl12::RenderPass ptPass{};
-		ptPass.output.push_back(rtResultID);
-		ptPass.output.push_back(rtAlbedoID);
-		ptPass.output.push_back(rtNormalID);
-		ptPass.outputStates.push_back(D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		ptPass.outputStates.push_back(D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		ptPass.outputStates.push_back(D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		passes.push_back(ptPass);
-		
-		// tonemap pass.
-		sl12::RenderPass tonemapPass{};
-		tonemapPass.input.push_back(rtResultID);
-		tonemapPass.input.push_back(rtAlbedoID);
-		tonemapPass.input.push_back(rtNormalID);
-		tonemapPass.inputStates.push_back(D3D12_RESOURCE_STATE_GENERIC_READ);
-		tonemapPass.inputStates.push_back(D3D12_RESOURCE_STATE_GENERIC_READ);
-		tonemapPass.inputStates.push_back(D3D12_RESOURCE_STATE_GENERIC_READ);
-		passes.push_back(tonemapPass);
+	SceneCB cbScene;
+	LightCB cbLight;
+	PathTraceCB cbPT;
 
-		renderGraph_->CreateRenderPasses(&device_, passes, histories, returns);
-	}
-
-	// create scene constant buffer.
-	sl12::CbvHandle hSceneCB, hLightCB, hPathTraceCB;
+	// scene constant buffer.
 	{
 		DirectX::XMFLOAT3 upVec(0.0f, 1.0f, 0.0f);
 		float Zn = 0.1f;
@@ -519,7 +725,6 @@ bool SampleApplication::Execute()
 		auto mtxViewToWorld = DirectX::XMMatrixInverse(nullptr, mtxWorldToView);
 		auto mtxClipToView = DirectX::XMMatrixInverse(nullptr, mtxViewToClip);
 
-		SceneCB cbScene;
 		DirectX::XMStoreFloat4x4(&cbScene.mtxWorldToProj, mtxWorldToClip);
 		DirectX::XMStoreFloat4x4(&cbScene.mtxWorldToView, mtxWorldToView);
 		DirectX::XMStoreFloat4x4(&cbScene.mtxViewToProj, mtxViewToClip);
@@ -550,15 +755,13 @@ bool SampleApplication::Execute()
 		cbScene.nearFar.x = Zn;
 		cbScene.nearFar.y = 0.0f;
 
-		hSceneCB = cbvMan_->GetTemporal(&cbScene, sizeof(cbScene));
-
 		mtxPrevWorldToView_ = mtxWorldToView;
 		mtxPrevWorldToClip_ = mtxWorldToClip;
 		mtxPrevViewToClip_ = mtxViewToClip;
 	}
+
+	// light constant buffer.
 	{
-		LightCB cbLight;
-		
 		memcpy(&cbLight.ambientSky, skyColor_, sizeof(cbLight.ambientSky));
 		memcpy(&cbLight.ambientGround, groundColor_, sizeof(cbLight.ambientGround));
 		cbLight.ambientIntensity = ambientIntensity_;
@@ -572,17 +775,114 @@ bool SampleApplication::Execute()
 		cbLight.directionalColor.x = directionalColor_[0] * directionalIntensity_;
 		cbLight.directionalColor.y = directionalColor_[1] * directionalIntensity_;
 		cbLight.directionalColor.z = directionalColor_[2] * directionalIntensity_;
-
-		hLightCB = cbvMan_->GetTemporal(&cbLight, sizeof(cbLight));
 	}
-	{
-		PathTraceCB cbPT;
 
+	// path trace constant buffer.
+	{
 		cbPT.sampleCount = ptSampleCount_;
 		cbPT.depthMax = ptDepthMax_;
+	}
+
+	bool bBuildScene = (sceneUpdateType != SceneUpdateType::None) || (pBvhScene_ == nullptr) || bBlasCompacting;
 
-		hPathTraceCB = cbvMan_->GetTemporal(&cbPT, sizeof(cbPT));
+	// albedo and normal come from the first hit, only the camera and the instances change them.
+	if (bBuildScene || memcmp(&cbScene.mtxProjToWorld, &denoiseAuxProjToWorld_, sizeof(denoiseAuxProjToWorld_)) != 0)
+	{
+		denoiseAuxProjToWorld_ = cbScene.mtxProjToWorld;
+		denoiseAuxVersion_++;
+	}
+	denoiseSlotAuxVersion_[denoiseSlot] = denoiseAuxVersion_;
+
+	// the running mean restarts when a constant buffer input or an instance changes.
+	if (sceneUpdateType != SceneUpdateType::None)
+	{
+		progressive_.Invalidate();
 	}
+	progressive_.Update(cbScene, cbLight, &cbPT, bProgressive_);
+
+	// build ray tracing assets.
+	{
+		// build BVH.
+		bvhMan_->BuildGeometry(pCmdList);
+		if (bBuildScene)
+		{
+			// BvhManager has no top level update, refits are also built from scratch on the gpu.
+			sl12::RenderCommandsTempList tmpRenderCmds;
+			sl12::BvhScene* pNewScene = bvhMan_->BuildScene(pCmdList, meshRenderCmds, kRTMaterialTableCount, tmpRenderCmds);
+			if (pBvhScene_)
+			{
+				device_.KillObject(pBvhScene_);
+			}
+			pBvhScene_ = pNewScene;
+
+			// create ray tracing shader table.
+#if !ENABLE_DYNAMIC_RESOURCE
+			bool bCreateRTShaderTableSuccess = CreateRayTracingShaderTable(pCmdList, tmpRenderCmds);
+			assert(bCreateRTShaderTableSuccess);
+#else
+			bool bCreateRTShaderTableDRSuccess = CreateRayTracingShaderTableDR(pCmdList, tmpRenderCmds);
+			assert(bCreateRTShaderTableDRSuccess);
+#endif
+		}
+		bvhMan_->CopyCompactionInfoOnGraphicsQueue(pCmdList);
+	}
+	sl12::BvhScene* pBvhScene = pBvhScene_;
+
+	// the result of frame N - 2 is shown only if that frame was denoised, the raw output stays on screen until then.
+	bool bShowDenoise = bDenoiseEnable_ && bDenoiseSlotResult_[denoiseSlot];
+	bDenoiseSlotInput_[denoiseSlot] = bDenoiseEnable_;
+
+	// create targets.
+	// a shared denoise device takes the path tracer output in its own buffers, no targets and no copy.
+	// the raw output needs the targets, so the first frames copy like a readback device does.
+	bool bDirectDenoiseWrite = bShowDenoise && bSharedDenoiseBuffers_;
+	std::vector<sl12::RenderGraphTargetID> ptTargets;
+	sl12::RenderGraphTargetID rtResultID, rtAlbedoID, rtNormalID;
+	if (!bDirectDenoiseWrite)
+	{
+		rtResultID = renderGraph_->AddTarget(gRTResultDesc);
+		rtAlbedoID = renderGraph_->AddTarget(gRTAlbedoDesc);
+		rtNormalID = rtAlbedoID;
+		ptTargets.push_back(rtResultID);
+		ptTargets.push_back(rtAlbedoID);
+		if (gRTNormalDesc.width > 0)
+		{
+			rtNormalID = renderGraph_->AddTarget(gRTNormalDesc);
+			ptTargets.push_back(rtNormalID);
+		}
+	}
+
+	// create render passes.
+	{
+		std::vector<sl12::RenderPass> passes;
+		std::vector<sl12::RenderGraphTargetID> histories;
+		std::vector<sl12::RenderGraphTargetID> returns;
+
+		// path tracing.
+		sl12::RenderPass ptPass{};
+		for (auto&& id : ptTargets)
+		{
+			ptPass.output.push_back(id);
+			ptPass.outputStates.push_back(D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}
+		passes.push_back(ptPass);
+		
+		// tonemap pass.
+		sl12::RenderPass tonemapPass{};
+		for (auto&& id : ptTargets)
+		{
+			tonemapPass.input.push_back(id);
+			tonemapPass.inputStates.push_back(D3D12_RESOURCE_STATE_GENERIC_READ);
+		}
+		passes.push_back(tonemapPass);
+
+		renderGraph_->CreateRenderPasses(&device_, passes, histories, returns);
+	}
+
+	// temporal constant buffers.
+	sl12::CbvHandle hSceneCB = cbvMan_->GetTemporal(&cbScene, sizeof(cbScene));
+	sl12::CbvHandle hLightCB = cbvMan_->GetTemporal(&cbLight, sizeof(cbLight));
+	sl12::CbvHandle hPathTraceCB = cbvMan_->GetTemporal(&cbPT, sizeof(cbPT));
 
 	// clear swapchain.
 	auto&& swapchain = device_.GetSwapchain();
@@ -607,9 +907,20 @@ bool SampleApplication::Execute()
 		descSet.SetCsCbv(0, hSceneCB.GetCBV()->GetDescInfo().cpuHandle);
 		descSet.SetCsCbv(1, hLightCB.GetCBV()->GetDescInfo().cpuHandle);
 		descSet.SetCsCbv(2, hPathTraceCB.GetCBV()->GetDescInfo().cpuHandle);
-		descSet.SetCsUav(0, renderGraph_->GetTarget(rtResultID)->uavs[0]->GetDescInfo().cpuHandle);
-		descSet.SetCsUav(1, renderGraph_->GetTarget(rtAlbedoID)->uavs[0]->GetDescInfo().cpuHandle);
-		descSet.SetCsUav(2, renderGraph_->GetTarget(rtNormalID)->uavs[0]->GetDescInfo().cpuHandle);
+		if (bDirectDenoiseWrite)
+		{
+			auto&& normalUAV = normalUAV_[denoiseSlot].IsValid() ? normalUAV_[denoiseSlot] : albedoUAV_[denoiseSlot];
+			descSet.SetCsUav(0, noisyUAV_[denoiseSlot]->GetDescInfo().cpuHandle);
+			descSet.SetCsUav(1, albedoUAV_[denoiseSlot]->GetDescInfo().cpuHandle);
+			descSet.SetCsUav(2, normalUAV->GetDescInfo().cpuHandle);
+		}
+		else
+		{
+			descSet.SetCsUav(0, renderGraph_->GetTarget(rtResultID)->uavs[0]->GetDescInfo().cpuHandle);
+			descSet.SetCsUav(1, renderGraph_->GetTarget(rtAlbedoID)->uavs[0]->GetDescInfo().cpuHandle);
+			descSet.SetCsUav(2, renderGraph_->GetTarget(rtNormalID)->uavs[0]->GetDescInfo().cpuHandle);
+		}
+		descSet.SetCsUav(3, accumUAV_->GetDescInfo().cpuHandle);
 
 		// コピーしつつコマンドリストに積む
 		D3D12_GPU_VIRTUAL_ADDRESS as_address[] = {
@@ -619,14 +930,14 @@ bool SampleApplication::Execute()
 
 		// レイトレースを実行
 		D3D12_DISPATCH_RAYS_DESC desc{};
-		desc.HitGroupTable.StartAddress = MaterialHGTable_->GetResourceDep()->GetGPUVirtualAddress();
-		desc.HitGroupTable.SizeInBytes = MaterialHGTable_->GetBufferDesc().size;
+		desc.HitGroupTable.StartAddress = MaterialHGTables_[materialHGIndex_].buffer->GetResourceDep()->GetGPUVirtualAddress();
+		desc.HitGroupTable.SizeInBytes = materialHGTableBytes_;
 		desc.HitGroupTable.StrideInBytes = bvhShaderRecordSize_;
 		desc.MissShaderTable.StartAddress = PathTracerMSTable_->GetResourceDep()->GetGPUVirtualAddress();
 		desc.MissShaderTable.SizeInBytes = PathTracerMSTable_->GetBufferDesc().size;
 		desc.MissShaderTable.StrideInBytes = bvhShaderRecordSize_;
-		desc.RayGenerationShaderRecord.StartAddress = PathTracerRGSTable_->GetResourceDep()->GetGPUVirtualAddress();
-		desc.RayGenerationShaderRecord.SizeInBytes = PathTracerRGSTable_->GetBufferDesc().size;
+		desc.RayGenerationShaderRecord.StartAddress = PathTracerRGSTable_->GetResourceDep()->GetGPUVirtualAddress() + PathTracerRGSStride_ * (ptPermutation_ + 1);
+		desc.RayGenerationShaderRecord.SizeInBytes = bvhShaderRecordSize_;
 		desc.Width = displayWidth_;
 		desc.Height = displayHeight_;
 		desc.Depth = 1;
@@ -649,15 +960,27 @@ bool SampleApplication::Execute()
 			uint rtResult;
 			uint rtAlbedo;
 			uint rtNormal;
+			uint rtAccum;
 		};
 		std::vector<sl12::u32> globalIndices;
-		globalIndices.resize(6);
+		globalIndices.resize(kGlobalIndexCount);
 		globalIndices[0] = hSceneCB.GetCBV()->GetDynamicDescInfo().index;
 		globalIndices[1] = hLightCB.GetCBV()->GetDynamicDescInfo().index;
 		globalIndices[2] = hPathTraceCB.GetCBV()->GetDynamicDescInfo().index;
-		globalIndices[3] = renderGraph_->GetTarget(rtResultID)->uavs[0]->GetDynamicDescInfo().index;
-		globalIndices[4] = renderGraph_->GetTarget(rtAlbedoID)->uavs[0]->GetDynamicDescInfo().index;
-		globalIndices[5] = renderGraph_->GetTarget(rtNormalID)->uavs[0]->GetDynamicDescInfo().index;
+		if (bDirectDenoiseWrite)
+		{
+			auto&& normalUAV = normalUAV_[denoiseSlot].IsValid() ? normalUAV_[denoiseSlot] : albedoUAV_[denoiseSlot];
+			globalIndices[3] = noisyUAV_[denoiseSlot]->GetDynamicDescInfo().index;
+			globalIndices[4] = albedoUAV_[denoiseSlot]->GetDynamicDescInfo().index;
+			globalIndices[5] = normalUAV->GetDynamicDescInfo().index;
+		}
+		else
+		{
+			globalIndices[3] = renderGraph_->GetTarget(rtResultID)->uavs[0]->GetDynamicDescInfo().index;
+			globalIndices[4] = renderGraph_->GetTarget(rtAlbedoID)->uavs[0]->GetDynamicDescInfo().index;
+			globalIndices[5] = renderGraph_->GetTarget(rtNormalID)->uavs[0]->GetDynamicDescInfo().index;
+		}
+		globalIndices[6] = accumUAV_->GetDynamicDescInfo().index;
 
 		// load to command list.
 		D3D12_GPU_VIRTUAL_ADDRESS as_address[] = {
@@ -667,14 +990,14 @@ bool SampleApplication::Execute()
 
 		// レイトレースを実行
 		D3D12_DISPATCH_RAYS_DESC desc{};
-		desc.HitGroupTable.StartAddress = MaterialHGTable_->GetResourceDep()->GetGPUVirtualAddress();
-		desc.HitGroupTable.SizeInBytes = MaterialHGTable_->GetBufferDesc().size;
+		desc.HitGroupTable.StartAddress = MaterialHGTables_[materialHGIndex_].buffer->GetResourceDep()->GetGPUVirtualAddress();
+		desc.HitGroupTable.SizeInBytes = materialHGTableBytes_;
 		desc.HitGroupTable.StrideInBytes = bvhShaderRecordSize_;
 		desc.MissShaderTable.StartAddress = PathTracerMSTable_->GetResourceDep()->GetGPUVirtualAddress();
 		desc.MissShaderTable.SizeInBytes = PathTracerMSTable_->GetBufferDesc().size;
 		desc.MissShaderTable.StrideInBytes = bvhShaderRecordSize_;
-		desc.RayGenerationShaderRecord.StartAddress = PathTracerRGSTable_->GetResourceDep()->GetGPUVirtualAddress();
-		desc.RayGenerationShaderRecord.SizeInBytes = PathTracerRGSTable_->GetBufferDesc().size;
+		desc.RayGenerationShaderRecord.StartAddress = PathTracerRGSTable_->GetResourceDep()->GetGPUVirtualAddress() + PathTracerRGSStride_ * (ptPermutation_ + 1);
+		desc.RayGenerationShaderRecord.SizeInBytes = bvhShaderRecordSize_;
 		desc.Width = displayWidth_;
 		desc.Height = displayHeight_;
 		desc.Depth = 1;
@@ -695,11 +1018,14 @@ bool SampleApplication::Execute()
 		// output barrier.
 		renderGraph_->BarrierOutputsAll(pCmdList);
 
-		// copy path tracing result.
-		CopyNoisyResource(pCmdList,
-			&renderGraph_->GetTarget(rtResultID)->buffer,
-			&renderGraph_->GetTarget(rtAlbedoID)->buffer,
-			&renderGraph_->GetTarget(rtNormalID)->buffer);
+		// copy path tracing result, the readback buffers of a cpu device only.
+		if (bDenoiseEnable_ && !bDirectDenoiseWrite)
+		{
+			CopyNoisyResource(pCmdList, denoiseSlot,
+				&renderGraph_->GetTarget(rtResultID)->buffer,
+				&renderGraph_->GetTarget(rtAlbedoID)->buffer,
+				&renderGraph_->GetTarget(rtNormalID)->buffer);
+		}
 
 		// set render targets.
 		auto&& rtv = swapchain.GetCurrentRenderTargetView(kSwapchainBufferOffset)->GetDescInfo().cpuHandle;
@@ -730,9 +1056,9 @@ bool SampleApplication::Execute()
 		sl12::DescriptorSet descSet;
 		descSet.Reset();
 		descSet.SetPsCbv(0, hSceneCB.GetCBV()->GetDescInfo().cpuHandle);
-		if (bDenoiseEnable_)
+		if (bShowDenoise)
 		{
-			descSet.SetPsSrv(0, denoiseResultSRV_->GetDescInfo().cpuHandle);
+			descSet.SetPsSrv(0, denoiseResultSRV_[denoiseSlot]->GetDescInfo().cpuHandle);
 		}
 		else
 		{
@@ -745,7 +1071,7 @@ bool SampleApplication::Execute()
 		resIndices.resize(1);
 		resIndices[0].resize(2);
 		resIndices[0][0] = hSceneCB.GetCBV()->GetDynamicDescInfo().index;
-		resIndices[0][1] = bDenoiseEnable_ ? denoiseResultSRV_->GetDynamicDescInfo().index : renderGraph_->GetTarget(rtResultID)->bufferSrvs[0]->GetDynamicDescInfo().index;
+		resIndices[0][1] = bShowDenoise ? denoiseResultSRV_[denoiseSlot]->GetDynamicDescInfo().index : renderGraph_->GetTarget(rtResultID)->bufferSrvs[0]->GetDynamicDescInfo().index;
 
 		pCmdList->SetGraphicsRootSignatureAndDynamicResource(&rsTonemapDR_, resIndices);
 #endif
@@ -776,12 +1102,18 @@ bool SampleApplication::Execute()
 	// present swapchain.
 	device_.Present(1);
 
-	// kill TLAS.
-	device_.KillObject(pBvhScene);
-
-	// execute oidn denoise.
-	if (bDenoiseEnable_)
-		ExecuteDenoise();
+	// this frame overwrites the slot of frame N - 2, its denoise has to be done.
+	// frame N - 1 is on the gpu no more, it denoises while this frame renders.
+	if (!asyncDenoiser_.Wait(denoiseSlot, frameIndex_))
+	{
+		sl12::ConsolePrint("Error: failed to denoise.\n");
+	}
+	// a slot written while denoise was disabled holds no inputs.
+	bDenoiseSlotResult_[1 - denoiseSlot] = bDenoiseEnable_ && frameIndex_ > 0 && bDenoiseSlotInput_[1 - denoiseSlot];
+	if (bDenoiseSlotResult_[1 - denoiseSlot])
+	{
+		SubmitDenoise(1 - denoiseSlot, frameIndex_ - 1);
+	}
 	
 	// execute current frame render.
 	mainCmdList_->Execute();
@@ -955,16 +1287,18 @@ bool SampleApplication::CreateRaytracingPipeline()
 		sl12::DxrPipelineStateDesc dxrDesc;
 
 		// export shader from library.
-		auto shader = hShaders_[MaterialLib].GetShader();
+		auto shader = GetShader(MaterialLib);
 		D3D12_EXPORT_DESC libExport[] = {
 			{ kMaterialCHS,	nullptr, D3D12_EXPORT_FLAG_NONE },
 			{ kMaterialAHS,	nullptr, D3D12_EXPORT_FLAG_NONE },
+			{ kMaterialConstantCHS,	nullptr, D3D12_EXPORT_FLAG_NONE },
 		};
 		dxrDesc.AddDxilLibrary(shader->GetData(), shader->GetSize(), libExport, ARRAYSIZE(libExport));
 
 		// hit group.
 		dxrDesc.AddHitGroup(kMaterialOpacityHG, true, nullptr, kMaterialCHS, nullptr);
 		dxrDesc.AddHitGroup(kMaterialMaskedHG, true, kMaterialAHS, kMaterialCHS, nullptr);
+		dxrDesc.AddHitGroup(kMaterialConstantHG, true, nullptr, kMaterialConstantCHS, nullptr);
 
 		// payload size and intersection attr size.
 		dxrDesc.AddShaderConfig(kPayloadSize, sizeof(float) * 2);
@@ -990,13 +1324,24 @@ bool SampleApplication::CreateRaytracingPipeline()
 		sl12::DxrPipelineStateDesc dxrDesc;
 
 		// export shader from library.
-		auto shader = hShaders_[PathTracerLib].GetShader();
+		auto shader = GetShader(PathTracerLib);
 		D3D12_EXPORT_DESC libExport[] = {
 			{ kPathTracerRGS,	nullptr, D3D12_EXPORT_FLAG_NONE },
 			{ kPathTracerMS,	nullptr, D3D12_EXPORT_FLAG_NONE },
 		};
 		dxrDesc.AddDxilLibrary(shader->GetData(), shader->GetSize(), libExport, ARRAYSIZE(libExport));
 
+		// only the raygen of each permutation library, PathTracerMS comes from the generic one.
+		std::vector<std::wstring> permutationNames(kPathTracerPermutationCount);
+		std::vector<D3D12_EXPORT_DESC> permutationExports(kPathTracerPermutationCount);
+		for (int i = 0; i < kPathTracerPermutationCount; i++)
+		{
+			auto permutationShader = GetShader(GetPathTracerPermutationSlot(i));
+			permutationNames[i] = GetPathTracerPermutationExport(i);
+			permutationExports[i] = { permutationNames[i].c_str(), kPathTracerRGS, D3D12_EXPORT_FLAG_NONE };
+			dxrDesc.AddDxilLibrary(permutationShader->GetData(), permutationShader->GetSize(), &permutationExports[i], 1);
+		}
+
 		// payload size and intersection attr size.
 		dxrDesc.AddShaderConfig(kPayloadSize, sizeof(float) * 2);
 
@@ -1040,26 +1385,65 @@ bool SampleApplication::CreateRaytracingPipeline()
 	return true;
 }
 
-bool SampleApplication::CreateRayTracingShaderTable(sl12::CommandList* pCmdList, sl12::RenderCommandsTempList& tcmds)
+bool SampleApplication::CreatePathTracerRGSTable()
 {
-	// already created.
-	if (MaterialHGTable_.IsValid())
+	// raygen records only hold the identifier, each one starts at a table alignment for DispatchRays.
+	std::vector<void*> rgs_identifiers;
 	{
-		return true;
+		ID3D12StateObjectProperties* prop;
+		psoRayTracing_->GetPSO()->QueryInterface(IID_PPV_ARGS(&prop));
+		rgs_identifiers.push_back(prop->GetShaderIdentifier(kPathTracerRGS));
+		for (int i = 0; i < kPathTracerPermutationCount; i++)
+		{
+			rgs_identifiers.push_back(prop->GetShaderIdentifier(GetPathTracerPermutationExport(i).c_str()));
+		}
+		prop->Release();
+	}
+
+	UINT align = D3D12_RAYTRACING_SHADER_TABLE_ALIGNMENT;
+	PathTracerRGSStride_ = ((bvhShaderRecordSize_ + align - 1) / align) * align;
+	PathTracerRGSTable_ = sl12::MakeUnique<sl12::Buffer>(&device_);
+	sl12::BufferDesc desc{};
+	desc.heap = sl12::BufferHeap::Dynamic;
+	desc.size = PathTracerRGSStride_ * rgs_identifiers.size();
+	desc.usage = sl12::ResourceUsage::ShaderResource;
+	desc.initialState = D3D12_RESOURCE_STATE_GENERIC_READ;
+	if (!PathTracerRGSTable_->Initialize(&device_, desc))
+	{
+		return false;
+	}
+
+	auto p = (char*)PathTracerRGSTable_->Map();
+	memset(p, 0, desc.size);
+	for (size_t i = 0; i < rgs_identifiers.size(); i++)
+	{
+		memcpy(p + PathTracerRGSStride_ * i, rgs_identifiers[i], D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
 	}
+	PathTracerRGSTable_->Unmap();
+
+	return true;
+}
 
-	// count materials and create submesh vertex/index offset.
-	sl12::u32 totalMaterialCount = 0;
+bool SampleApplication::CreateRayTracingShaderTable(sl12::CommandList* pCmdList, sl12::RenderCommandsTempList& tcmds)
+{
+	// count unique materials and create submesh vertex/index offset.
+	// instances of the same resource with the same materials share one local descriptor table per submesh.
+	HitGroupTableLayout hgLayout;
 	for (auto&& cmd : tcmds)
 	{
 		if (cmd->GetType() == sl12::RenderCommandType::Mesh)
 		{
 			// count materials.
 			auto mcmd = static_cast<sl12::MeshRenderCommand*>(cmd);
-			totalMaterialCount += (sl12::u32)mcmd->GetSubmeshCommands().size();
+			auto res = mcmd->GetParentMesh()->GetParentResource();
+			std::vector<sl12::u32> materialIndices;
+			for (auto&& submesh : res->GetSubmeshes())
+			{
+				materialIndices.push_back((sl12::u32)submesh.materialIndex);
+			}
+			hgLayout.AddInstance((uint64_t)(uintptr_t)res, materialIndices.data(), (sl12::u32)materialIndices.size());
 
 			// create offset cbv.
-			auto res = mcmd->GetParentMesh()->GetParentResource();
 			if (OffsetCBVs_.find(res) == OffsetCBVs_.end())
 			{
 				//MeshShapeOffset offsets;
@@ -1076,6 +1460,9 @@ bool SampleApplication::CreateRayTracingShaderTable(sl12::CommandList* pCmdList,
 					cb.tangent = (UINT)(res->GetTangentHandle().offset + submesh.tangentOffsetBytes);
 					cb.texcoord = (UINT)(res->GetTexcoordHandle().offset + submesh.texcoordOffsetBytes);
 					cb.index = (UINT)(res->GetIndexHandle().offset + submesh.indexOffsetBytes);
+					auto fold = ClassifyResourceMaterial(res->GetMaterials()[submesh.materialIndex]);
+					cb.constBaseColor = fold.packedBaseColor;
+					cb.constORM = fold.packedORM;
 					
 					auto h = cbvMan_->GetResident(sizeof(cb));
 					cbvMan_->RequestResidentCopy(h, &cb, sizeof(cb));
@@ -1087,30 +1474,37 @@ bool SampleApplication::CreateRayTracingShaderTable(sl12::CommandList* pCmdList,
 	}
 	cbvMan_->ExecuteCopy(pCmdList);
 
-	// initialize descriptor manager.
-	rtDescMan_ = sl12::MakeUnique<sl12::RaytracingDescriptorManager>(&device_);
-	if (!rtDescMan_->Initialize(&device_,
-		1,		// Render Count
-		1,		// AS Count
-		kRTDescriptorCountGlobal,
-		kRTDescriptorCountLocal,
-		totalMaterialCount))
+	// nothing to patch while every hit group slot refers to the same record.
 	{
-		return false;
+		std::vector<HitGroupRecordKey> slotKeys;
+		for (sl12::u32 i = 0; i < hgLayout.GetInstanceCount(); i++)
+		{
+			for (sl12::u32 s = 0; s < hgLayout.GetInstanceSubmeshCount(i); s++)
+			{
+				slotKeys.push_back(hgLayout.GetRecord(hgLayout.GetInstanceRecordOffset(i) + s));
+			}
+		}
+		if (MaterialHGTables_[materialHGIndex_].buffer.IsValid() && slotKeys == hgSlotKeys_)
+		{
+			return true;
+		}
+		hgSlotKeys_.swap(slotKeys);
 	}
 
-	// create local shader resource table.
-	struct LocalTable
+	// register descriptor ranges of the new records.
+	// records with the same SubmeshOffsetCB, textures or sampler share one range in the local heap.
+	// the registry is kept, a range keeps its slot and an unchanged record keeps its bytes.
+	// the app never unloads a mesh, so the source descriptors of the keys stay alive.
+	struct PendingTable
 	{
-		D3D12_GPU_DESCRIPTOR_HANDLE	cbv;
-		D3D12_GPU_DESCRIPTOR_HANDLE	srv;
-		D3D12_GPU_DESCRIPTOR_HANDLE	sampler;
+		D3D12_CPU_DESCRIPTOR_HANDLE	cbv[1];
+		D3D12_CPU_DESCRIPTOR_HANDLE	srv[4];
+		D3D12_CPU_DESCRIPTOR_HANDLE	sampler[1];
+		sl12::u32					slots[3];
+		bool						bCreated[3];
 	};
-	std::vector<LocalTable> material_table;
-	std::vector<bool> opaque_table;
-	auto view_desc_size = rtDescMan_->GetViewDescSize();
-	auto sampler_desc_size = rtDescMan_->GetSamplerDescSize();
-	auto local_handle_start = rtDescMan_->IncrementLocalHandleStart();
+	std::vector<PendingTable> pending_table;
+	std::vector<sl12::u32> hitgroup_table;
 	auto FillMeshTable = [&](sl12::MeshRenderCommand* cmd)
 	{
 		auto pSceneMesh = cmd->GetParentMesh();
@@ -1133,57 +1527,112 @@ bool SampleApplication::CreateRayTracingShaderTable(sl12::CommandList* pCmdList,
 				orm_srv = &pTexORM->GetTextureView();
 			}
 
-			opaque_table.push_back(material.isOpaque);
-
-			LocalTable table;
-
-			// CBV
-			D3D12_CPU_DESCRIPTOR_HANDLE cbv[] = {
-				OffsetCBVs_[pMeshItem][i].GetCBV()->GetDescInfo().cpuHandle,
-			};
-			sl12::u32 cbv_cnt = ARRAYSIZE(cbv);
-			device_.GetDeviceDep()->CopyDescriptors(
-				1, &local_handle_start.viewCpuHandle, &cbv_cnt,
-				cbv_cnt, cbv, nullptr, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-			table.cbv = local_handle_start.viewGpuHandle;
-			local_handle_start.viewCpuHandle.ptr += view_desc_size * cbv_cnt;
-			local_handle_start.viewGpuHandle.ptr += view_desc_size * cbv_cnt;
-
-			// SRV
-			D3D12_CPU_DESCRIPTOR_HANDLE srv[] = {
-				meshMan_->GetIndexBufferSRV()->GetDescInfo().cpuHandle,
-				meshMan_->GetVertexBufferSRV()->GetDescInfo().cpuHandle,
-				bc_srv->GetDescInfo().cpuHandle,
-				orm_srv->GetDescInfo().cpuHandle,
-			};
-			sl12::u32 srv_cnt = ARRAYSIZE(srv);
-			device_.GetDeviceDep()->CopyDescriptors(
-				1, &local_handle_start.viewCpuHandle, &srv_cnt,
-				srv_cnt, srv, nullptr, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-			table.srv = local_handle_start.viewGpuHandle;
-			local_handle_start.viewCpuHandle.ptr += view_desc_size * srv_cnt;
-			local_handle_start.viewGpuHandle.ptr += view_desc_size * srv_cnt;
+			hitgroup_table.push_back(GetMaterialHitGroup(ClassifyResourceMaterial(material), material.isOpaque));
 
+			PendingTable table;
+			table.cbv[0] = OffsetCBVs_[pMeshItem][i].GetCBV()->GetDescInfo().cpuHandle;
+			table.srv[0] = meshMan_->GetIndexBufferSRV()->GetDescInfo().cpuHandle;
+			table.srv[1] = meshMan_->GetVertexBufferSRV()->GetDescInfo().cpuHandle;
+			table.srv[2] = bc_srv->GetDescInfo().cpuHandle;
+			table.srv[3] = orm_srv->GetDescInfo().cpuHandle;
 			// Samplerは1つ
-			D3D12_CPU_DESCRIPTOR_HANDLE sampler[] = {
-				linearSampler_->GetDescInfo().cpuHandle,
-			};
-			sl12::u32 sampler_cnt = ARRAYSIZE(sampler);
-			device_.GetDeviceDep()->CopyDescriptors(
-				1, &local_handle_start.samplerCpuHandle, &sampler_cnt,
-				sampler_cnt, sampler, nullptr, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
-			table.sampler = local_handle_start.samplerGpuHandle;
-			local_handle_start.samplerCpuHandle.ptr += sampler_desc_size * sampler_cnt;
-			local_handle_start.samplerGpuHandle.ptr += sampler_desc_size * sampler_cnt;
-
-			material_table.push_back(table);
+			table.sampler[0] = linearSampler_->GetDescInfo().cpuHandle;
+
+			// source cpu handles are the keys of the ranges.
+			uint64_t cbv_keys[] = { table.cbv[0].ptr };
+			uint64_t srv_keys[] = { table.srv[0].ptr, table.srv[1].ptr, table.srv[2].ptr, table.srv[3].ptr };
+			uint64_t sampler_keys[] = { table.sampler[0].ptr };
+			table.slots[0] = materialRegistry_.RegisterRange(MaterialDescriptorHeap::View, cbv_keys, ARRAYSIZE(cbv_keys), &table.bCreated[0]);
+			table.slots[1] = materialRegistry_.RegisterRange(MaterialDescriptorHeap::View, srv_keys, ARRAYSIZE(srv_keys), &table.bCreated[1]);
+			table.slots[2] = materialRegistry_.RegisterRange(MaterialDescriptorHeap::Sampler, sampler_keys, ARRAYSIZE(sampler_keys), &table.bCreated[2]);
+			pending_table.push_back(table);
 		}
 	};
+	sl12::u32 instanceIndex = 0;
 	for (auto&& cmd : tcmds)
 	{
 		if (cmd->GetType() == sl12::RenderCommandType::Mesh)
 		{
-			FillMeshTable(static_cast<sl12::MeshRenderCommand*>(cmd));
+			// records of a new resource are appended in instance order.
+			if (hgLayout.GetInstanceRecordOffset(instanceIndex) == (sl12::u32)pending_table.size())
+			{
+				FillMeshTable(static_cast<sl12::MeshRenderCommand*>(cmd));
+			}
+			instanceIndex++;
+		}
+	}
+
+	// initialize descriptor manager.
+	// the local heap is sized in kRTDescriptorCountLocal units, enough for the shared ranges only.
+	// it is created again with headroom only when the ranges outgrow it, then every range is copied.
+	sl12::u32 localViewCount = kRTDescriptorCountLocal.cbv + kRTDescriptorCountLocal.srv + kRTDescriptorCountLocal.uav;
+	sl12::u32 localTableCount = (materialRegistry_.GetDescriptorCount(MaterialDescriptorHeap::View) + localViewCount - 1) / localViewCount;
+	localTableCount = std::max(localTableCount, materialRegistry_.GetDescriptorCount(MaterialDescriptorHeap::Sampler));
+	localTableCount = std::max(localTableCount, 1u);
+	bool bCopyAll = !rtDescMan_.IsValid() || localTableCount > rtLocalTableCapacity_;
+	if (bCopyAll)
+	{
+		rtLocalTableCapacity_ = localTableCount * 2;
+		rtDescMan_ = sl12::MakeUnique<sl12::RaytracingDescriptorManager>(&device_);
+		if (!rtDescMan_->Initialize(&device_,
+			1,		// Render Count
+			1,		// AS Count
+			kRTDescriptorCountGlobal,
+			kRTDescriptorCountLocal,
+			rtLocalTableCapacity_))
+		{
+			return false;
+		}
+		auto local_handle_start = rtDescMan_->IncrementLocalHandleStart();
+		rtLocalViewCpu_ = local_handle_start.viewCpuHandle;
+		rtLocalViewGpu_ = local_handle_start.viewGpuHandle;
+		rtLocalSamplerCpu_ = local_handle_start.samplerCpuHandle;
+		rtLocalSamplerGpu_ = local_handle_start.samplerGpuHandle;
+	}
+
+	// create local shader resource table.
+	// each new range is copied once, shared ranges are only referenced.
+	struct LocalTable
+	{
+		D3D12_GPU_DESCRIPTOR_HANDLE	cbv;
+		D3D12_GPU_DESCRIPTOR_HANDLE	srv;
+		D3D12_GPU_DESCRIPTOR_HANDLE	sampler;
+	};
+	std::vector<LocalTable> material_table;
+	auto view_desc_size = rtDescMan_->GetViewDescSize();
+	auto sampler_desc_size = rtDescMan_->GetSamplerDescSize();
+	auto CopyRange = [&](const D3D12_CPU_DESCRIPTOR_HANDLE* src, sl12::u32 count, sl12::u32 slot, bool bCreated, bool bSampler)
+	{
+		auto cpu = bSampler ? rtLocalSamplerCpu_ : rtLocalViewCpu_;
+		auto gpu = bSampler ? rtLocalSamplerGpu_ : rtLocalViewGpu_;
+		auto desc_size = bSampler ? sampler_desc_size : view_desc_size;
+		cpu.ptr += desc_size * slot;
+		gpu.ptr += desc_size * slot;
+		if (bCreated || bCopyAll)
+		{
+			device_.GetDeviceDep()->CopyDescriptors(
+				1, &cpu, &count,
+				count, src, nullptr, bSampler ? D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER : D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		}
+		return gpu;
+	};
+	for (auto&& p : pending_table)
+	{
+		LocalTable table;
+		table.cbv = CopyRange(p.cbv, ARRAYSIZE(p.cbv), p.slots[0], p.bCreated[0], false);
+		table.srv = CopyRange(p.srv, ARRAYSIZE(p.srv), p.slots[1], p.bCreated[1], false);
+		table.sampler = CopyRange(p.sampler, ARRAYSIZE(p.sampler), p.slots[2], p.bCreated[2], true);
+		material_table.push_back(table);
+	}
+
+	// BuildScene assigns one hit group slot to each submesh of each instance in command order,
+	// so the bound table keeps one record per slot, each one pointing at the shared descriptor table.
+	std::vector<sl12::u32> slot_records;
+	for (sl12::u32 i = 0; i < hgLayout.GetInstanceCount(); i++)
+	{
+		for (sl12::u32 s = 0; s < hgLayout.GetInstanceSubmeshCount(i); s++)
+		{
+			slot_records.push_back(hgLayout.GetInstanceRecordOffset(i) + s);
 		}
 	}
 
@@ -1205,7 +1654,7 @@ bool SampleApplication::CreateRayTracingShaderTable(sl12::CommandList* pCmdList,
 	{
 		buffer = sl12::MakeUnique<sl12::Buffer>(&device_);
 
-		materialCount = (materialCount < 0) ? (int)material_table.size() : materialCount;
+		materialCount = (materialCount < 0) ? (int)slot_records.size() : materialCount;
 		sl12::BufferDesc desc{};
 		desc.heap = sl12::BufferHeap::Dynamic;
 		desc.size = shaderRecordSize * tableCountPerMaterial * materialCount;
@@ -1226,7 +1675,7 @@ bool SampleApplication::CreateRayTracingShaderTable(sl12::CommandList* pCmdList,
 				memcpy(p, shaderIds[i * tableCountPerMaterial + id], shaderIdentifierSize);
 				p += descHandleOffset;
 
-				memcpy(p, &material_table[i], sizeof(LocalTable));
+				memcpy(p, &material_table[slot_records[i]], sizeof(LocalTable));
 
 				p = start + shaderRecordSize;
 			}
@@ -1237,36 +1686,36 @@ bool SampleApplication::CreateRayTracingShaderTable(sl12::CommandList* pCmdList,
 	};
 	// material shader table.
 	{
-		void* hg_identifier[4];
+		void* hg_identifier[kMaterialHitGroupMax];
 		{
 			ID3D12StateObjectProperties* prop;
 			psoRayTracing_->GetPSO()->QueryInterface(IID_PPV_ARGS(&prop));
-			hg_identifier[0] = prop->GetShaderIdentifier(kMaterialOpacityHG);
-			hg_identifier[1] = prop->GetShaderIdentifier(kMaterialMaskedHG);
+			hg_identifier[kMaterialHitGroupOpaque] = prop->GetShaderIdentifier(kMaterialOpacityHG);
+			hg_identifier[kMaterialHitGroupMasked] = prop->GetShaderIdentifier(kMaterialMaskedHG);
+			hg_identifier[kMaterialHitGroupConstant] = prop->GetShaderIdentifier(kMaterialConstantHG);
 			prop->Release();
 		}
 		std::vector<void*> hg_table;
-		for (auto v : opaque_table)
+		for (auto r : slot_records)
 		{
-			hg_table.push_back(v ? hg_identifier[0] : hg_identifier[1]);
+			hg_table.push_back(hg_identifier[hitgroup_table[r]]);
 		}
-		if (!GenShaderTable(hg_table.data(), kRTMaterialTableCount, MaterialHGTable_, -1))
+		if (!UpdateMaterialHGTable(hg_table.data(), material_table.data(), sizeof(LocalTable), slot_records))
 		{
 			return false;
 		}
 	}
 	// for PathTracer.
+	if (!PathTracerRGSTable_.IsValid())
 	{
-		void* rgs_identifier;
 		void* ms_identifier;
 		{
 			ID3D12StateObjectProperties* prop;
 			psoRayTracing_->GetPSO()->QueryInterface(IID_PPV_ARGS(&prop));
-			rgs_identifier = prop->GetShaderIdentifier(kPathTracerRGS);
 			ms_identifier = prop->GetShaderIdentifier(kPathTracerMS);
 			prop->Release();
 		}
-		if (!GenShaderTable(&rgs_identifier, 1, PathTracerRGSTable_, 1))
+		if (!CreatePathTracerRGSTable())
 		{
 			return false;
 		}
@@ -1281,24 +1730,24 @@ bool SampleApplication::CreateRayTracingShaderTable(sl12::CommandList* pCmdList,
 
 bool SampleApplication::CreateRayTracingShaderTableDR(sl12::CommandList* pCmdList, sl12::RenderCommandsTempList& tcmds)
 {
-	// already created.
-	if (MaterialHGTable_.IsValid())
-	{
-		return true;
-	}
-
-	// count materials and create submesh vertex/index offset.
-	sl12::u32 totalMaterialCount = 0;
+	// count unique materials and create submesh vertex/index offset.
+	// instances of the same resource with the same materials share one local descriptor table per submesh.
+	HitGroupTableLayout hgLayout;
 	for (auto&& cmd : tcmds)
 	{
 		if (cmd->GetType() == sl12::RenderCommandType::Mesh)
 		{
 			// count materials.
 			auto mcmd = static_cast<sl12::MeshRenderCommand*>(cmd);
-			totalMaterialCount += (sl12::u32)mcmd->GetSubmeshCommands().size();
+			auto res = mcmd->GetParentMesh()->GetParentResource();
+			std::vector<sl12::u32> materialIndices;
+			for (auto&& submesh : res->GetSubmeshes())
+			{
+				materialIndices.push_back((sl12::u32)submesh.materialIndex);
+			}
+			hgLayout.AddInstance((uint64_t)(uintptr_t)res, materialIndices.data(), (sl12::u32)materialIndices.size());
 
 			// create offset cbv.
-			auto res = mcmd->GetParentMesh()->GetParentResource();
 			if (OffsetCBVs_.find(res) == OffsetCBVs_.end())
 			{
 				OffsetCBVs_[res].resize(res->GetSubmeshes().size());
@@ -1313,6 +1762,9 @@ bool SampleApplication::CreateRayTracingShaderTableDR(sl12::CommandList* pCmdLis
 					cb.tangent = (UINT)(res->GetTangentHandle().offset + submesh.tangentOffsetBytes);
 					cb.texcoord = (UINT)(res->GetTexcoordHandle().offset + submesh.texcoordOffsetBytes);
 					cb.index = (UINT)(res->GetIndexHandle().offset + submesh.indexOffsetBytes);
+					auto fold = ClassifyResourceMaterial(res->GetMaterials()[submesh.materialIndex]);
+					cb.constBaseColor = fold.packedBaseColor;
+					cb.constORM = fold.packedORM;
 					
 					auto h = cbvMan_->GetResident(sizeof(cb));
 					cbvMan_->RequestResidentCopy(h, &cb, sizeof(cb));
@@ -1323,6 +1775,24 @@ bool SampleApplication::CreateRayTracingShaderTableDR(sl12::CommandList* pCmdLis
 		}
 	}
 	cbvMan_->ExecuteCopy(pCmdList);
+	sl12::u32 totalMaterialCount = hgLayout.GetRecordCount();
+
+	// nothing to patch while every hit group slot refers to the same record.
+	{
+		std::vector<HitGroupRecordKey> slotKeys;
+		for (sl12::u32 i = 0; i < hgLayout.GetInstanceCount(); i++)
+		{
+			for (sl12::u32 s = 0; s < hgLayout.GetInstanceSubmeshCount(i); s++)
+			{
+				slotKeys.push_back(hgLayout.GetRecord(hgLayout.GetInstanceRecordOffset(i) + s));
+			}
+		}
+		if (MaterialHGTables_[materialHGIndex_].buffer.IsValid() && slotKeys == hgSlotKeys_)
+		{
+			return true;
+		}
+		hgSlotKeys_.swap(slotKeys);
+	}
 
 	// create local shader resource table.
 	struct LocalIndex
@@ -1334,8 +1804,10 @@ bool SampleApplication::CreateRayTracingShaderTableDR(sl12::CommandList* pCmdLis
 		uint texORM;
 		uint texBaseColor_s;
 	};
-	std::vector<LocalIndex> material_table;
-	std::vector<bool> opaque_table;
+	static_assert(sizeof(LocalIndex) == sizeof(MaterialIndexRecord), "LocalIndex and MaterialIndexRecord must have the same layout.");
+	// records with the same bindless indices and hit group are shared, record_remap maps hgLayout records to them.
+	std::vector<sl12::u32> record_remap;
+	materialRegistry_.Clear();
 	auto FillMeshTable = [&](sl12::MeshRenderCommand* cmd)
 	{
 		auto pSceneMesh = cmd->GetParentMesh();
@@ -1358,24 +1830,40 @@ bool SampleApplication::CreateRayTracingShaderTableDR(sl12::CommandList* pCmdLis
 				orm_srv = &pTexORM->GetTextureView();
 			}
 
-			opaque_table.push_back(material.isOpaque);
-
-			LocalIndex localIndex;
+			MaterialIndexRecord localIndex;
 			localIndex.cbSubmesh = OffsetCBVs_[pMeshItem][i].GetCBV()->GetDynamicDescInfo().index;
-			localIndex.Indices = meshMan_->GetIndexBufferSRV()->GetDynamicDescInfo().index;
-			localIndex.Vertices = meshMan_->GetVertexBufferSRV()->GetDynamicDescInfo().index;
+			localIndex.indices = meshMan_->GetIndexBufferSRV()->GetDynamicDescInfo().index;
+			localIndex.vertices = meshMan_->GetVertexBufferSRV()->GetDynamicDescInfo().index;
 			localIndex.texBaseColor = bc_srv->GetDynamicDescInfo().index;
 			localIndex.texORM = orm_srv->GetDynamicDescInfo().index;
-			localIndex.texBaseColor_s = linearSampler_->GetDynamicDescInfo().index;
-			
-			material_table.push_back(localIndex);
+			localIndex.texBaseColorSampler = linearSampler_->GetDynamicDescInfo().index;
+
+			sl12::u32 hitGroup = GetMaterialHitGroup(ClassifyResourceMaterial(material), material.isOpaque);
+			record_remap.push_back(materialRegistry_.RegisterMaterial(localIndex, hitGroup));
 		}
 	};
+	sl12::u32 instanceIndex = 0;
 	for (auto&& cmd : tcmds)
 	{
 		if (cmd->GetType() == sl12::RenderCommandType::Mesh)
 		{
-			FillMeshTable(static_cast<sl12::MeshRenderCommand*>(cmd));
+			// records of a new resource are appended in instance order.
+			if (hgLayout.GetInstanceRecordOffset(instanceIndex) == (sl12::u32)record_remap.size())
+			{
+				FillMeshTable(static_cast<sl12::MeshRenderCommand*>(cmd));
+			}
+			instanceIndex++;
+		}
+	}
+
+	// BuildScene assigns one hit group slot to each submesh of each instance in command order,
+	// so the bound table keeps one record per slot, each one pointing at the shared descriptor table.
+	std::vector<sl12::u32> slot_records;
+	for (sl12::u32 i = 0; i < hgLayout.GetInstanceCount(); i++)
+	{
+		for (sl12::u32 s = 0; s < hgLayout.GetInstanceSubmeshCount(i); s++)
+		{
+			slot_records.push_back(record_remap[hgLayout.GetInstanceRecordOffset(i) + s]);
 		}
 	}
 
@@ -1397,7 +1885,7 @@ bool SampleApplication::CreateRayTracingShaderTableDR(sl12::CommandList* pCmdLis
 	{
 		buffer = sl12::MakeUnique<sl12::Buffer>(&device_);
 
-		materialCount = (materialCount < 0) ? (int)material_table.size() : materialCount;
+		materialCount = (materialCount < 0) ? (int)slot_records.size() : materialCount;
 		sl12::BufferDesc desc{};
 		desc.heap = sl12::BufferHeap::Dynamic;
 		desc.size = shaderRecordSize * tableCountPerMaterial * materialCount;
@@ -1418,7 +1906,7 @@ bool SampleApplication::CreateRayTracingShaderTableDR(sl12::CommandList* pCmdLis
 				memcpy(p, shaderIds[i * tableCountPerMaterial + id], shaderIdentifierSize);
 				p += descHandleOffset;
 
-				memcpy(p, &material_table[i], sizeof(LocalIndex));
+				memcpy(p, &materialRegistry_.GetRecord(slot_records[i]), sizeof(LocalIndex));
 
 				p = start + shaderRecordSize;
 			}
@@ -1429,36 +1917,36 @@ bool SampleApplication::CreateRayTracingShaderTableDR(sl12::CommandList* pCmdLis
 	};
 	// material shader table.
 	{
-		void* hg_identifier[4];
+		void* hg_identifier[kMaterialHitGroupMax];
 		{
 			ID3D12StateObjectProperties* prop;
 			psoRayTracing_->GetPSO()->QueryInterface(IID_PPV_ARGS(&prop));
-			hg_identifier[0] = prop->GetShaderIdentifier(kMaterialOpacityHG);
-			hg_identifier[1] = prop->GetShaderIdentifier(kMaterialMaskedHG);
+			hg_identifier[kMaterialHitGroupOpaque] = prop->GetShaderIdentifier(kMaterialOpacityHG);
+			hg_identifier[kMaterialHitGroupMasked] = prop->GetShaderIdentifier(kMaterialMaskedHG);
+			hg_identifier[kMaterialHitGroupConstant] = prop->GetShaderIdentifier(kMaterialConstantHG);
 			prop->Release();
 		}
 		std::vector<void*> hg_table;
-		for (auto v : opaque_table)
+		for (auto r : slot_records)
 		{
-			hg_table.push_back(v ? hg_identifier[0] : hg_identifier[1]);
+			hg_table.push_back(hg_identifier[materialRegistry_.GetRecordHitGroup(r)]);
 		}
-		if (!GenShaderTable(hg_table.data(), kRTMaterialTableCount, MaterialHGTable_, -1))
+		if (!UpdateMaterialHGTable(hg_table.data(), materialRegistry_.GetRecords().data(), sizeof(LocalIndex), slot_records))
 		{
 			return false;
 		}
 	}
 	// for PathTracer.
+	if (!PathTracerRGSTable_.IsValid())
 	{
-		void* rgs_identifier;
 		void* ms_identifier;
 		{
 			ID3D12StateObjectProperties* prop;
 			psoRayTracing_->GetPSO()->QueryInterface(IID_PPV_ARGS(&prop));
-			rgs_identifier = prop->GetShaderIdentifier(kPathTracerRGS);
 			ms_identifier = prop->GetShaderIdentifier(kPathTracerMS);
 			prop->Release();
 		}
-		if (!GenShaderTable(&rgs_identifier, 1, PathTracerRGSTable_, 1))
+		if (!CreatePathTracerRGSTable())
 		{
 			return false;
 		}
@@ -1471,152 +1959,298 @@ bool SampleApplication::CreateRayTracingShaderTableDR(sl12::CommandList* pCmdLis
 	return true;
 }
 
-bool SampleApplication::InitializeOIDN()
+bool SampleApplication::UpdateMaterialHGTable(void* const* shaderIds, const void* pLocalTables, sl12::u32 localTableSize, const std::vector<sl12::u32>& slotRecords)
 {
-	int nDevices = oidn::getNumPhysicalDevices();
-	for (int i = 0; i < nDevices; i++)
+	// same layout as the other tables, descHandleOffset and bvhShaderRecordSize_.
+	if (materialHGShadow_.GetRecordSize() != GetShaderRecordSize(localTableSize))
+	{
+		materialHGShadow_.Initialize(localTableSize, (sl12::u32)slotRecords.size() * kRTMaterialTableCount);
+	}
+	assert(materialHGShadow_.GetRecordSize() == bvhShaderRecordSize_);
+
+	// records are patched in place, unchanged records are skipped.
+	materialHGShadow_.Resize((sl12::u32)slotRecords.size() * kRTMaterialTableCount);
+	for (sl12::u32 i = 0; i < (sl12::u32)slotRecords.size(); i++)
 	{
-		oidn::PhysicalDeviceRef pd(i);
-		if (pd.get<oidn::DeviceType>("type") == oidn::DeviceType::CUDA)
+		for (sl12::u32 id = 0; id < kRTMaterialTableCount; id++)
 		{
-			oidnPhysicalDevice_ = pd;
-			break;
+			sl12::u32 slot = i * kRTMaterialTableCount + id;
+			materialHGShadow_.WriteRecord(slot, shaderIds[slot], (const char*)pLocalTables + slotRecords[i] * localTableSize, localTableSize);
 		}
 	}
+	sl12::u32 dirtyBegin = 0, dirtyEnd = 0;
+	bool bDirty = materialHGShadow_.GetDirtyRange(&dirtyBegin, &dirtyEnd);
+	materialHGShadow_.ClearDirty();
+	if (MaterialHGTables_[materialHGIndex_].buffer.IsValid() && !bDirty)
+	{
+		return true;
+	}
 
-	if (!oidnPhysicalDevice_)
+	// every table of the ring misses this patch, the next one catches up and is bound.
+	// it was last bound kMaterialHGTableCount updates ago, no frame in flight reads it.
+	if (bDirty)
 	{
-		return false;
+		for (auto&& table : MaterialHGTables_)
+		{
+			table.pendingBegin = (table.pendingBegin < table.pendingEnd) ? std::min(table.pendingBegin, dirtyBegin) : dirtyBegin;
+			table.pendingEnd = std::max(table.pendingEnd, dirtyEnd);
+		}
 	}
-	
-	oidnDevice_ = oidn::newDevice(oidn::DeviceType::CUDA);//oidnPhysicalDevice_.newDevice();
-	// oidnDevice_.set("verbose", 4);
-	oidnDevice_.commit();
+	materialHGIndex_ = (materialHGIndex_ + 1) % kMaterialHGTableCount;
+	auto&& table = MaterialHGTables_[materialHGIndex_];
+	sl12::u32 recordSize = materialHGShadow_.GetRecordSize();
+	size_t capacityBytes = (size_t)std::max(materialHGShadow_.GetCapacity(), 1u) * recordSize;
+	if (!table.buffer.IsValid() || table.buffer->GetBufferDesc().size < capacityBytes)
+	{
+		// the table grows with the capacity of the shadow, not with every new slot.
+		table.buffer = sl12::MakeUnique<sl12::Buffer>(&device_);
+		sl12::BufferDesc desc{};
+		desc.heap = sl12::BufferHeap::Dynamic;
+		desc.size = capacityBytes;
+		desc.usage = sl12::ResourceUsage::ShaderResource;
+		desc.initialState = D3D12_RESOURCE_STATE_GENERIC_READ;
+		if (!table.buffer->Initialize(&device_, desc))
+		{
+			return false;
+		}
+		table.bPendingAll = true;
+	}
+	sl12::u32 begin = table.bPendingAll ? 0 : table.pendingBegin;
+	sl12::u32 end = table.bPendingAll ? materialHGShadow_.GetSlotCount() : std::min(table.pendingEnd, materialHGShadow_.GetSlotCount());
+	if (begin < end)
+	{
+		auto p = (char*)table.buffer->Map();
+		memcpy(p + (size_t)begin * recordSize, materialHGShadow_.GetRecord(begin), (size_t)(end - begin) * recordSize);
+		table.buffer->Unmap();
+	}
+	table.pendingBegin = table.pendingEnd = 0;
+	table.bPendingAll = false;
+	materialHGTableBytes_ = std::max<sl12::u64>(materialHGShadow_.GetTableBytes(), recordSize);
+
+	return true;
+}
 
-	auto memTypes = oidnDevice_.get<int>("externalMemoryTypes");
-	if (!(memTypes & (int)oidn::ExternalMemoryTypeFlag::OpaqueWin32))
+bool SampleApplication::InitializeOIDN()
+{
+	// cuda first, the cpu device when there is no cuda device or it can not import d3d12 memory.
+	// without any device the app runs without denoise.
+	if (!denoiser_.Initialize(DenoiserDeviceType::CUDA))
 	{
-		return false;
+		sl12::ConsolePrint("Warning: no oidn device, denoise is disabled.\n");
+		bDenoiseEnable_ = false;
+		return true;
 	}
+	bSharedDenoiseBuffers_ = denoiser_.GetDeviceType() == DenoiserDeviceType::CUDA
+		&& (denoiser_.GetDevice().get<int>("externalMemoryTypes") & (int)oidn::ExternalMemoryTypeFlag::OpaqueWin32);
+	if (denoiser_.GetDeviceType() == DenoiserDeviceType::CUDA && !bSharedDenoiseBuffers_)
+	{
+		if (!denoiser_.Initialize(DenoiserDeviceType::CPU))
+		{
+			sl12::ConsolePrint("Warning: no oidn cpu device, denoise is disabled.\n");
+			bDenoiseEnable_ = false;
+			return true;
+		}
+	}
+	sl12::ConsolePrint("oidn device: %s\n", GetDenoiserDeviceTypeName(denoiser_.GetDeviceType()));
 
 	// create buffer.
-	noisySource_ = sl12::MakeUnique<sl12::Buffer>(&device_);
-	albedoSource_ = sl12::MakeUnique<sl12::Buffer>(&device_);
-	normalSource_ = sl12::MakeUnique<sl12::Buffer>(&device_);
-	denoiseResult_ = sl12::MakeUnique<sl12::Buffer>(&device_);
-	denoiseResultSRV_ = sl12::MakeUnique<sl12::BufferView>(&device_);
-	{
+	// the path tracer writes the shared buffers of a cuda device, the cpu device reads back copies.
+	// the half layout keeps normal in the albedo buffer, there is no normal buffer.
+	bool bNormalBuffer = GetAovBufferSize(aovLayout_, AovImage::Normal, displayWidth_, displayHeight_) > 0;
+	for (sl12::u32 slot = 0; slot < kDenoiseSlotCount; slot++)
+	{
+		noisySource_[slot] = sl12::MakeUnique<sl12::Buffer>(&device_);
+		albedoSource_[slot] = sl12::MakeUnique<sl12::Buffer>(&device_);
+		if (bNormalBuffer)
+		{
+			normalSource_[slot] = sl12::MakeUnique<sl12::Buffer>(&device_);
+		}
+		denoiseResult_[slot] = sl12::MakeUnique<sl12::Buffer>(&device_);
+		denoiseResultSRV_[slot] = sl12::MakeUnique<sl12::BufferView>(&device_);
+
 		sl12::BufferDesc desc{};
 		desc.heap = sl12::BufferHeap::Default;
-		desc.size = displayWidth_ * displayHeight_ * sizeof(float) * 3;
-		desc.usage = sl12::ResourceUsage::ShaderResource;
+		desc.usage = sl12::ResourceUsage::ShaderResource | sl12::ResourceUsage::UnorderedAccess;
 		desc.initialState = D3D12_RESOURCE_STATE_COMMON;
 		desc.deviceShared = true;
-		if (!noisySource_->Initialize(&device_, desc))
+		if (!bSharedDenoiseBuffers_)
+		{
+			// the copies are read back, the result is uploaded and read by the tonemap from the upload heap.
+			desc.heap = sl12::BufferHeap::ReadBack;
+			desc.usage = sl12::ResourceUsage::ShaderResource;
+			desc.initialState = D3D12_RESOURCE_STATE_COPY_DEST;
+			desc.deviceShared = false;
+		}
+		desc.size = GetAovBufferSize(aovLayout_, AovImage::Color, displayWidth_, displayHeight_);
+		if (!noisySource_[slot]->Initialize(&device_, desc))
 		{
 			return false;
 		}
-		if (!albedoSource_->Initialize(&device_, desc))
+		desc.size = GetAovBufferSize(aovLayout_, AovImage::Albedo, displayWidth_, displayHeight_);
+		if (!albedoSource_[slot]->Initialize(&device_, desc))
 		{
 			return false;
 		}
-		if (!normalSource_->Initialize(&device_, desc))
+		desc.size = GetAovBufferSize(aovLayout_, AovImage::Normal, displayWidth_, displayHeight_);
+		if (bNormalBuffer && !normalSource_[slot]->Initialize(&device_, desc))
 		{
 			return false;
 		}
-		if (!denoiseResult_->Initialize(&device_, desc))
+		if (!bSharedDenoiseBuffers_)
+		{
+			desc.heap = sl12::BufferHeap::Dynamic;
+			desc.initialState = D3D12_RESOURCE_STATE_GENERIC_READ;
+		}
+		desc.size = GetAovBufferSize(aovLayout_, AovImage::Color, displayWidth_, displayHeight_);
+		if (!denoiseResult_[slot]->Initialize(&device_, desc))
 		{
 			return false;
 		}
 
-		if (!denoiseResultSRV_->Initialize(&device_, &denoiseResult_, 0, 0, 0))
+		if (!denoiseResultSRV_[slot]->Initialize(&device_, &denoiseResult_[slot], 0, 0, 0))
 		{
 			return false;
 		}
+
+		// shared buffers start and decay to the common state, the path tracer writes them through implicit promotion.
+		if (bSharedDenoiseBuffers_)
+		{
+			noisyUAV_[slot] = sl12::MakeUnique<sl12::UnorderedAccessView>(&device_);
+			albedoUAV_[slot] = sl12::MakeUnique<sl12::UnorderedAccessView>(&device_);
+			if (!noisyUAV_[slot]->Initialize(&device_, &noisySource_[slot], 0, 0, 0, 0)
+				|| !albedoUAV_[slot]->Initialize(&device_, &albedoSource_[slot], 0, 0, 0, 0))
+			{
+				return false;
+			}
+			if (bNormalBuffer)
+			{
+				normalUAV_[slot] = sl12::MakeUnique<sl12::UnorderedAccessView>(&device_);
+				if (!normalUAV_[slot]->Initialize(&device_, &normalSource_[slot], 0, 0, 0, 0))
+				{
+					return false;
+				}
+			}
+		}
 	}
 
 	// create oidn buffer.
-	HANDLE hNoisy, hAlbedo, hNormal, hDenoise;
-	HRESULT hr;
+	auto&& oidnDevice = denoiser_.GetDevice();
 	const char* errorMsg;
-	hr = device_.GetDeviceDep()->CreateSharedHandle(noisySource_->GetResourceDep(), nullptr, GENERIC_ALL, nullptr, &hNoisy);
-	hr = device_.GetDeviceDep()->CreateSharedHandle(albedoSource_->GetResourceDep(), nullptr, GENERIC_ALL, nullptr, &hAlbedo);
-	hr = device_.GetDeviceDep()->CreateSharedHandle(normalSource_->GetResourceDep(), nullptr, GENERIC_ALL, nullptr, &hNormal);
-	hr = device_.GetDeviceDep()->CreateSharedHandle(denoiseResult_->GetResourceDep(), nullptr, GENERIC_ALL, nullptr, &hDenoise);
-
-	oidnNoisySource_ = oidnDevice_.newBuffer(oidn::ExternalMemoryTypeFlag::OpaqueWin32, hNoisy, nullptr, noisySource_->GetBufferDesc().size);
-	if (oidnDevice_.getError(errorMsg) != oidn::Error::None)
-	{
-		sl12::ConsolePrint("%s\n", errorMsg);
-		return false;
-	}
-	oidnAlbedoSource_ = oidnDevice_.newBuffer(oidn::ExternalMemoryTypeFlag::OpaqueWin32, hAlbedo, nullptr, albedoSource_->GetBufferDesc().size);
-	if (oidnDevice_.getError(errorMsg) != oidn::Error::None)
-	{
-		sl12::ConsolePrint("%s\n", errorMsg);
-		return false;
-	}
-	oidnNormalSource_ = oidnDevice_.newBuffer(oidn::ExternalMemoryTypeFlag::OpaqueWin32, hNormal, nullptr, normalSource_->GetBufferDesc().size);
-	if (oidnDevice_.getError(errorMsg) != oidn::Error::None)
+	for (sl12::u32 slot = 0; slot < kDenoiseSlotCount; slot++)
 	{
-		sl12::ConsolePrint("%s\n", errorMsg);
-		return false;
-	}
-	oidnDenoiseResult_ = oidnDevice_.newBuffer(oidn::ExternalMemoryTypeFlag::OpaqueWin32, hDenoise, nullptr, denoiseResult_->GetBufferDesc().size);
-	if (oidnDevice_.getError(errorMsg) != oidn::Error::None)
-	{
-		sl12::ConsolePrint("%s\n", errorMsg);
-		return false;
+		if (!bSharedDenoiseBuffers_)
+		{
+			// the buffers stay mapped, the cpu device works on them in place.
+			oidnNoisySource_[slot] = oidnDevice.newBuffer(noisySource_[slot]->Map(), noisySource_[slot]->GetBufferDesc().size);
+			oidnAlbedoSource_[slot] = oidnDevice.newBuffer(albedoSource_[slot]->Map(), albedoSource_[slot]->GetBufferDesc().size);
+			oidnNormalSource_[slot] = bNormalBuffer ? oidnDevice.newBuffer(normalSource_[slot]->Map(), normalSource_[slot]->GetBufferDesc().size) : oidnAlbedoSource_[slot];
+			oidnDenoiseResult_[slot] = oidnDevice.newBuffer(denoiseResult_[slot]->Map(), denoiseResult_[slot]->GetBufferDesc().size);
+			if (oidnDevice.getError(errorMsg) != oidn::Error::None)
+			{
+				sl12::ConsolePrint("%s\n", errorMsg);
+				return false;
+			}
+			continue;
+		}
+
+		sl12::Buffer* pBuffers[] = { &noisySource_[slot], &albedoSource_[slot], bNormalBuffer ? &normalSource_[slot] : nullptr, &denoiseResult_[slot] };
+		oidn::BufferRef* pOidnBuffers[] = { &oidnNoisySource_[slot], &oidnAlbedoSource_[slot], &oidnNormalSource_[slot], &oidnDenoiseResult_[slot] };
+		for (int i = 0; i < ARRAYSIZE(pBuffers); i++)
+		{
+			if (!pBuffers[i])
+			{
+				*pOidnBuffers[i] = oidnAlbedoSource_[slot];
+				continue;
+			}
+			HANDLE hShared;
+			HRESULT hr = device_.GetDeviceDep()->CreateSharedHandle(pBuffers[i]->GetResourceDep(), nullptr, GENERIC_ALL, nullptr, &hShared);
+			if (FAILED(hr))
+			{
+				sl12::ConsolePrint("Error: failed to share a denoise buffer.\n");
+				return false;
+			}
+			*pOidnBuffers[i] = oidnDevice.newBuffer(oidn::ExternalMemoryTypeFlag::OpaqueWin32, hShared, nullptr, pBuffers[i]->GetBufferDesc().size);
+			CloseHandle(hShared);
+			if (oidnDevice.getError(errorMsg) != oidn::Error::None)
+			{
+				sl12::ConsolePrint("%s\n", errorMsg);
+				return false;
+			}
+		}
 	}
 
-	CloseHandle(hNoisy);
-	CloseHandle(hAlbedo);
-	CloseHandle(hNormal);
-	CloseHandle(hDenoise);
+	// the denoise of a frame runs on a worker thread while the next frame renders.
+	asyncDenoiser_.Initialize(&denoiser_);
 
 	return true;
 }
 
 void SampleApplication::DestroyOIDN()
 {
-	oidnNoisySource_ = oidn::BufferRef();
-	oidnAlbedoSource_ = oidn::BufferRef();
-	oidnNormalSource_ = oidn::BufferRef();
-	oidnDenoiseResult_ = oidn::BufferRef();
-	oidnDevice_ = oidn::DeviceRef();
-	oidnPhysicalDevice_ = oidn::PhysicalDeviceRef();
-
-	denoiseResultSRV_.Reset();
-	denoiseResult_.Reset();
-	normalSource_.Reset();
-	albedoSource_.Reset();
-	noisySource_.Reset();
-}
+	// the worker finishes its jobs before the images go away.
+	asyncDenoiser_.Destroy();
+	for (sl12::u32 slot = 0; slot < kDenoiseSlotCount; slot++)
+	{
+		oidnNoisySource_[slot] = oidn::BufferRef();
+		oidnAlbedoSource_[slot] = oidn::BufferRef();
+		oidnNormalSource_[slot] = oidn::BufferRef();
+		oidnDenoiseResult_[slot] = oidn::BufferRef();
+	}
+	denoiser_.Destroy();
+	for (sl12::u32 slot = 0; slot < kDenoiseSlotCount; slot++)
+	{
+		if (!bSharedDenoiseBuffers_)
+		{
+			for (auto pBuffer : { &noisySource_[slot], &albedoSource_[slot], &normalSource_[slot], &denoiseResult_[slot] })
+			{
+				if (pBuffer->IsValid())
+				{
+					(*pBuffer)->Unmap();
+				}
+			}
+		}
 
-void SampleApplication::CopyNoisyResource(sl12::CommandList* pCmdList, sl12::Buffer* pNoisySrc, sl12::Buffer* pAlbedoSrc, sl12::Buffer* pNormalSrc)
-{
-	pCmdList->GetLatestCommandList()->CopyResource(noisySource_->GetResourceDep(), pNoisySrc->GetResourceDep());
-	pCmdList->GetLatestCommandList()->CopyResource(albedoSource_->GetResourceDep(), pAlbedoSrc->GetResourceDep());
-	pCmdList->GetLatestCommandList()->CopyResource(normalSource_->GetResourceDep(), pNormalSrc->GetResourceDep());
+		normalUAV_[slot].Reset();
+		albedoUAV_[slot].Reset();
+		noisyUAV_[slot].Reset();
+		denoiseResultSRV_[slot].Reset();
+		denoiseResult_[slot].Reset();
+		normalSource_[slot].Reset();
+		albedoSource_[slot].Reset();
+		noisySource_[slot].Reset();
+	}
 }
 
-void SampleApplication::ExecuteDenoise()
+void SampleApplication::CopyNoisyResource(sl12::CommandList* pCmdList, sl12::u32 slot, sl12::Buffer* pNoisySrc, sl12::Buffer* pAlbedoSrc, sl12::Buffer* pNormalSrc)
 {
-	oidn::FilterRef filter = oidnDevice_.newFilter("RT");
-	filter.setImage("color", oidnNoisySource_, oidn::Format::Float3, displayWidth_, displayHeight_);
-	filter.setImage("albedo", oidnAlbedoSource_, oidn::Format::Float3, displayWidth_, displayHeight_);
-	filter.setImage("normal", oidnNormalSource_, oidn::Format::Float3, displayWidth_, displayHeight_);
-	filter.setImage("output", oidnDenoiseResult_, oidn::Format::Float3, displayWidth_, displayHeight_);
-	filter.set("hdr", true);
-	filter.set("cleanAux", true);
-	filter.commit();
-
-	filter.execute();
-	const char* errorMsg;
-	if (oidnDevice_.getError(errorMsg) != oidn::Error::None)
+	pCmdList->GetLatestCommandList()->CopyResource(noisySource_[slot]->GetResourceDep(), pNoisySrc->GetResourceDep());
+	pCmdList->GetLatestCommandList()->CopyResource(albedoSource_[slot]->GetResourceDep(), pAlbedoSrc->GetResourceDep());
+	if (normalSource_[slot].IsValid())
 	{
-		sl12::ConsolePrint("%s\n", errorMsg);
+		pCmdList->GetLatestCommandList()->CopyResource(normalSource_[slot]->GetResourceDep(), pNormalSrc->GetResourceDep());
 	}
 }
 
+void SampleApplication::SubmitDenoise(sl12::u32 slot, sl12::u64 frameIndex)
+{
+	// the filter of this key is created and committed once, later frames only execute it.
+	DenoiseFilterKey key;
+	key.width = (uint32_t)displayWidth_;
+	key.height = (uint32_t)displayHeight_;
+	key.quality = kDenoiseQualities[denoiseQuality_];
+	key.bHdr = true;
+	// raw aux images are noisy, only prefiltered ones are clean.
+	key.bCleanAux = bDenoisePrefilterAux_;
+	key.bPrefilterAux = bDenoisePrefilterAux_;
+	key.layout = aovLayout_;
+
+	DenoiseImages images;
+	images.color = oidnNoisySource_[slot];
+	images.albedo = oidnAlbedoSource_[slot];
+	images.normal = oidnNormalSource_[slot];
+	images.output = oidnDenoiseResult_[slot];
+	images.auxVersion = denoiseSlotAuxVersion_[slot];
+	asyncDenoiser_.Submit(slot, key, images, frameIndex);
+}
+
 //	EOF
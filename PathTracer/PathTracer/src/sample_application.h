@@ -18,7 +18,15 @@
 #include "sl12/scene_mesh.h"
 #include "sl12/timestamp.h"
 
-#include "OpenImageDenoise/oidn.hpp"
+#include "aov_layout.h"
+#include "denoiser.h"
+#include "progressive_accumulator.h"
+
+#include "cpu_material_registry.h"
+#include "cpu_scene_update.h"
+#include "cpu_shader_table.h"
+#include "cpu_task.h"
+#include "shader_cache.h"
 
 
 class SampleApplication
@@ -35,7 +43,7 @@ class SampleApplication
 	typedef std::vector<sl12::CbvHandle> MeshShapeOffset;
 
 public:
-	SampleApplication(HINSTANCE hInstance, int nCmdShow, int screenWidth, int screenHeight, sl12::ColorSpaceType csType, const std::string& homeDir, int meshType);
+	SampleApplication(HINSTANCE hInstance, int nCmdShow, int screenWidth, int screenHeight, sl12::ColorSpaceType csType, const std::string& homeDir, int meshType, AovLayout aovLayout);
 	virtual ~SampleApplication();
 
 	// virtual
@@ -49,14 +57,19 @@ private:
 
 	void ComputeSceneAABB();
 
+	// the shader loaded from the cache, or the one compiled by shaderMan_.
+	sl12::Shader* GetShader(int index);
+
 	bool CreateRaytracingPipeline();
 	bool CreateRayTracingShaderTable(sl12::CommandList* pCmdList, sl12::RenderCommandsTempList& tcmds);
 	bool CreateRayTracingShaderTableDR(sl12::CommandList* pCmdList, sl12::RenderCommandsTempList& tcmds);
+	bool CreatePathTracerRGSTable();
+	bool UpdateMaterialHGTable(void* const* shaderIds, const void* pLocalTables, sl12::u32 localTableSize, const std::vector<sl12::u32>& slotRecords);
 
 	bool InitializeOIDN();
 	void DestroyOIDN();
-	void CopyNoisyResource(sl12::CommandList* pCmdList, sl12::Buffer* pNoisySrc, sl12::Buffer* pAlbedoSrc, sl12::Buffer* pNormalSrc);
-	void ExecuteDenoise();
+	void CopyNoisyResource(sl12::CommandList* pCmdList, sl12::u32 slot, sl12::Buffer* pNoisySrc, sl12::Buffer* pAlbedoSrc, sl12::Buffer* pNormalSrc);
+	void SubmitDenoise(sl12::u32 slot, sl12::u64 frameIndex);
 
 private:
 	static const int kBufferCount = sl12::Swapchain::kMaxBuffer;
@@ -150,6 +163,8 @@ private:
 
 	// shaders.
 	std::vector<sl12::ShaderHandle>	hShaders_;
+	std::vector<std::unique_ptr<sl12::Shader>>	cachedShaders_;		// cache hits, hShaders_ of the same index is empty.
+	ShaderCache						shaderCache_;
 
 	// history.
 	DirectX::XMMATRIX		mtxPrevWorldToView_, mtxPrevViewToClip_, mtxPrevWorldToClip_;
@@ -158,10 +173,31 @@ private:
 	DirectX::XMFLOAT3		sceneAABBMax_, sceneAABBMin_;
 
 	// ray tracing.
-	UniqueHandle<sl12::RaytracingDescriptorManager>	rtDescMan_;
-	UniqueHandle<sl12::Buffer>	PathTracerRGSTable_;
+	SceneUpdateTracker		sceneUpdate_;
+	sl12::BvhScene*			pBvhScene_ = nullptr;		// kept alive while no instance moves and no blas is compacting.
+	std::map<const sl12::ResourceItemMesh*, sl12::u64>	blasBuildFrames_;	// frame each bottom level structure was first built.
+	UniqueHandle<sl12::RaytracingDescriptorManager>	rtDescMan_;		// kept while its local heap holds every range of materialRegistry_.
+	sl12::u32					rtLocalTableCapacity_ = 0;
+	D3D12_CPU_DESCRIPTOR_HANDLE	rtLocalViewCpu_, rtLocalSamplerCpu_;
+	D3D12_GPU_DESCRIPTOR_HANDLE	rtLocalViewGpu_, rtLocalSamplerGpu_;
+	UniqueHandle<sl12::Buffer>	PathTracerRGSTable_;		// the generic raygen, then one record per path tracer permutation.
+	sl12::u32					PathTracerRGSStride_ = 0;
 	UniqueHandle<sl12::Buffer>	PathTracerMSTable_;
-	UniqueHandle<sl12::Buffer>	MaterialHGTable_;
+	// a ring of hit group tables, frames in flight keep reading the previous ones.
+	// a table only receives the slots patched since it was last bound.
+	struct MaterialHGTable
+	{
+		UniqueHandle<sl12::Buffer>	buffer;
+		sl12::u32					pendingBegin = 0, pendingEnd = 0;
+		bool						bPendingAll = true;
+	};
+	static const sl12::u32		kMaterialHGTableCount = kBufferCount;
+	MaterialHGTable				MaterialHGTables_[kMaterialHGTableCount];
+	sl12::u32					materialHGIndex_ = 0;		// the bound table.
+	sl12::u64					materialHGTableBytes_ = 0;
+	ShaderTableManager			materialHGShadow_;		// cpu copy of the hit group table.
+	std::vector<HitGroupRecordKey>	hgSlotKeys_;		// record of each hit group slot.
+	BindlessMaterialRegistry	materialRegistry_;		// shared descriptor ranges and records of the material tables.
 	sl12::u32	bvhShaderRecordSize_;
 	std::map<const sl12::ResourceItemMesh*, MeshShapeOffset>	OffsetCBVs_;
 
@@ -169,6 +205,9 @@ private:
 	sl12::u32				timestampIndex_ = 0;
 	sl12::CpuTimer			currCpuTime_;
 
+	// timings of the init tasks of Initialize().
+	TaskTrace				initTrace_;
+
 	// camera parameters.
 	DirectX::XMFLOAT3		cameraPos_;
 	DirectX::XMFLOAT3		cameraDir_;
@@ -187,22 +226,42 @@ private:
 	bool					bDenoiseEnable_ = true;
 	int						ptSampleCount_ = 1;
 	int						ptDepthMax_ = 4;
+	int						ptPermutation_ = -1;		// raygen of this frame, -1 for the generic one.
+	bool					bProgressive_ = false;		// a still camera keeps accumulating frames into accumBuffer_.
+	ProgressiveAccumulator	progressive_;
+	UniqueHandle<sl12::Buffer>				accumBuffer_;
+	UniqueHandle<sl12::UnorderedAccessView>	accumUAV_;
 
 	// OIDN.
-	oidn::PhysicalDeviceRef			oidnPhysicalDevice_;
-	oidn::DeviceRef					oidnDevice_;
-	UniqueHandle<sl12::Buffer>		noisySource_;
-	UniqueHandle<sl12::Buffer>		albedoSource_;
-	UniqueHandle<sl12::Buffer>		normalSource_;
-	UniqueHandle<sl12::Buffer>		denoiseResult_;
-	UniqueHandle<sl12::BufferView>	denoiseResultSRV_;
-	oidn::BufferRef					oidnNoisySource_;
-	oidn::BufferRef					oidnAlbedoSource_;
-	oidn::BufferRef					oidnNormalSource_;
-	oidn::BufferRef					oidnDenoiseResult_;
+	// a cuda device shares the d3d12 buffers, other devices denoise mapped readback copies.
+	// frame N copies into slot N % 2 and shows the result of frame N - 2, while frame N - 1 denoises in the other slot.
+	static const sl12::u32 kDenoiseSlotCount = AsyncDenoiser::kSlotCount;
+	Denoiser						denoiser_;
+	AsyncDenoiser					asyncDenoiser_;
+	bool							bSharedDenoiseBuffers_ = false;
+	int								denoiseQuality_ = 0;		// index into kDenoiseQualities.
+	bool							bDenoisePrefilterAux_ = true;
+	sl12::u64						denoiseAuxVersion_ = 0;		// counts changes of the camera and the instances.
+	sl12::u64						denoiseSlotAuxVersion_[kDenoiseSlotCount] = {};
+	bool							bDenoiseSlotInput_[kDenoiseSlotCount] = {};		// the frame that wrote the slot had denoise enabled.
+	bool							bDenoiseSlotResult_[kDenoiseSlotCount] = {};	// the slot denoises its last frame, the tonemap can show it.
+	DirectX::XMFLOAT4X4				denoiseAuxProjToWorld_ = {};
+	UniqueHandle<sl12::Buffer>		noisySource_[kDenoiseSlotCount];
+	UniqueHandle<sl12::Buffer>		albedoSource_[kDenoiseSlotCount];
+	UniqueHandle<sl12::Buffer>		normalSource_[kDenoiseSlotCount];
+	UniqueHandle<sl12::Buffer>		denoiseResult_[kDenoiseSlotCount];
+	UniqueHandle<sl12::BufferView>	denoiseResultSRV_[kDenoiseSlotCount];
+	UniqueHandle<sl12::UnorderedAccessView>	noisyUAV_[kDenoiseSlotCount];		// shared buffers only, the path tracer writes them.
+	UniqueHandle<sl12::UnorderedAccessView>	albedoUAV_[kDenoiseSlotCount];
+	UniqueHandle<sl12::UnorderedAccessView>	normalUAV_[kDenoiseSlotCount];
+	oidn::BufferRef					oidnNoisySource_[kDenoiseSlotCount];
+	oidn::BufferRef					oidnAlbedoSource_[kDenoiseSlotCount];
+	oidn::BufferRef					oidnNormalSource_[kDenoiseSlotCount];
+	oidn::BufferRef					oidnDenoiseResult_[kDenoiseSlotCount];
 
 	int	displayWidth_, displayHeight_;
 	int meshType_;
+	AovLayout	aovLayout_;
 	sl12::u64	frameIndex_ = 0;
 };	// class SampleApplication
 
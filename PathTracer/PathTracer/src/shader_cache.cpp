@@ -0,0 +1,453 @@
+#include "shader_cache.h"
+#include "cpu_task.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <set>
+#include <thread>
+
+#if defined(_WIN32)
+#	define popen _popen
+#	define pclose _pclose
+#endif
+
+
+namespace
+{
+	// two 64 bit lanes, fnv-1a and a rotate multiply, mixed at the end.
+	class KeyHasher
+	{
+	public:
+		void Add(const void* pData, size_t size)
+		{
+			auto p = static_cast<const uint8_t*>(pData);
+			for (size_t i = 0; i < size; i++)
+			{
+				h0_ = (h0_ ^ p[i]) * 0x100000001b3ull;
+				h1_ = (h1_ ^ p[i]);
+				h1_ = ((h1_ << 5) | (h1_ >> 59)) * 0x9e3779b97f4a7c15ull;
+			}
+		}
+
+		// length prefixed, so that "ab" + "c" and "a" + "bc" differ.
+		void AddString(const std::string& s)
+		{
+			uint64_t size = s.size();
+			Add(&size, sizeof(size));
+			Add(s.data(), s.size());
+		}
+
+		void Finish(uint64_t* pHash)
+		{
+			pHash[0] = Mix(h0_ ^ h1_);
+			pHash[1] = Mix(h1_ + 0x9e3779b97f4a7c15ull * h0_);
+		}
+
+	private:
+		static uint64_t Mix(uint64_t x)
+		{
+			x ^= x >> 33;
+			x *= 0xff51afd7ed558ccdull;
+			x ^= x >> 33;
+			x *= 0xc4ceb9fe1a85ec53ull;
+			x ^= x >> 33;
+			return x;
+		}
+
+	private:
+		uint64_t	h0_ = 0xcbf29ce484222325ull;
+		uint64_t	h1_ = 0x84222325cbf29ce4ull;
+	};
+
+	bool ReadFile(const std::string& filePath, std::string* pData)
+	{
+		FILE* fp = fopen(filePath.c_str(), "rb");
+		if (!fp)
+		{
+			return false;
+		}
+		fseek(fp, 0, SEEK_END);
+		long size = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		pData->resize(size > 0 ? (size_t)size : 0);
+		bool bRead = pData->empty() || fread(&(*pData)[0], 1, pData->size(), fp) == pData->size();
+		fclose(fp);
+		return bRead;
+	}
+
+	struct IncludeDirective
+	{
+		std::string	name;
+		bool		bQuoted;
+	};
+
+	// #include "name" and #include <name> at the start of a line.
+	std::vector<IncludeDirective> FindIncludes(const std::string& source)
+	{
+		std::vector<IncludeDirective> ret;
+		size_t pos = 0;
+		while (pos < source.size())
+		{
+			size_t lineEnd = source.find('\n', pos);
+			if (lineEnd == std::string::npos)
+			{
+				lineEnd = source.size();
+			}
+			size_t p = source.find_first_not_of(" \t", pos);
+			if (p < lineEnd && source[p] == '#')
+			{
+				p = source.find_first_not_of(" \t", p + 1);
+				if (p < lineEnd && source.compare(p, 7, "include") == 0)
+				{
+					p = source.find_first_not_of(" \t", p + 7);
+					if (p < lineEnd && (source[p] == '"' || source[p] == '<'))
+					{
+						char close = (source[p] == '"') ? '"' : '>';
+						size_t end = source.find(close, p + 1);
+						if (end < lineEnd)
+						{
+							ret.push_back({ source.substr(p + 1, end - p - 1), close == '"' });
+						}
+					}
+				}
+			}
+			pos = lineEnd + 1;
+		}
+		return ret;
+	}
+
+	bool HashFile(const std::filesystem::path& filePath, const std::string& name, const std::vector<std::string>& includeDirs,
+		std::set<std::string>* pVisited, KeyHasher* pHasher, ShaderCacheKey* pKey)
+	{
+		std::string resolved = filePath.lexically_normal().string();
+		if (!pVisited->insert(resolved).second)
+		{
+			return true;
+		}
+		std::string source;
+		if (!ReadFile(resolved, &source))
+		{
+			printf("Error: failed to read shader file. (%s)\n", resolved.c_str());
+			return false;
+		}
+		// the name as written in the source, the location of the checkout does not change the key.
+		pHasher->AddString(name);
+		pHasher->AddString(source);
+		pKey->files.push_back(resolved);
+
+		std::error_code ec;
+		for (auto&& inc : FindIncludes(source))
+		{
+			std::filesystem::path found;
+			if (inc.bQuoted && std::filesystem::exists(filePath.parent_path() / inc.name, ec))
+			{
+				found = filePath.parent_path() / inc.name;
+			}
+			for (size_t i = 0; i < includeDirs.size() && found.empty(); i++)
+			{
+				if (std::filesystem::exists(std::filesystem::path(includeDirs[i]) / inc.name, ec))
+				{
+					found = std::filesystem::path(includeDirs[i]) / inc.name;
+				}
+			}
+			if (found.empty())
+			{
+				printf("Error: shader include not found. (%s in %s)\n", inc.name.c_str(), resolved.c_str());
+				return false;
+			}
+			if (!HashFile(found, inc.name, includeDirs, pVisited, pHasher, pKey))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::string QuoteArg(const std::string& arg)
+	{
+		return "\"" + arg + "\"";
+	}
+}
+
+
+std::string ShaderCacheKey::ToString() const
+{
+	char text[33];
+	snprintf(text, sizeof(text), "%016llx%016llx", (unsigned long long)hash[0], (unsigned long long)hash[1]);
+	return text;
+}
+
+std::string GetShaderTarget(const std::string& filePath, int majorVersion, int minorVersion)
+{
+	static const char* kSuffixes[][2] = {
+		{".vv.",	"vs"},
+		{".p.",		"ps"},
+		{".g.",		"gs"},
+		{".d.",		"ds"},
+		{".h.",		"hs"},
+		{".c.",		"cs"},
+		{".lib.",	"lib"},
+		{".m.",		"ms"},
+		{".a.",		"as"},
+	};
+	std::string name = std::filesystem::path(filePath).filename().string();
+	for (auto&& s : kSuffixes)
+	{
+		if (name.find(s[0]) != std::string::npos)
+		{
+			return std::string(s[1]) + "_" + std::to_string(majorVersion) + "_" + std::to_string(minorVersion);
+		}
+	}
+	return std::string();
+}
+
+bool MakeShaderCacheKey(const ShaderCompileDesc& desc, const std::vector<std::string>& includeDirs, const std::string& compilerId, ShaderCacheKey* pKey)
+{
+	*pKey = ShaderCacheKey();
+	KeyHasher hasher;
+	hasher.AddString(compilerId);
+	hasher.AddString(desc.target);
+	hasher.AddString(desc.entryPoint);
+	for (auto&& d : desc.defines)
+	{
+		hasher.AddString(d.first);
+		hasher.AddString(d.second);
+	}
+
+	std::set<std::string> visited;
+	std::filesystem::path sourcePath(desc.filePath);
+	if (!HashFile(sourcePath, sourcePath.filename().string(), includeDirs, &visited, &hasher, pKey))
+	{
+		return false;
+	}
+	hasher.Finish(pKey->hash);
+	return true;
+}
+
+
+bool ShaderCache::Initialize(const std::string& cacheDir)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(cacheDir, ec);
+	if (ec)
+	{
+		printf("Error: failed to create shader cache directory. (%s)\n", cacheDir.c_str());
+		return false;
+	}
+	cacheDir_ = cacheDir;
+	return true;
+}
+
+std::string ShaderCache::GetFilePath(const ShaderCacheKey& key) const
+{
+	return (std::filesystem::path(cacheDir_) / (key.ToString() + ".dxil")).string();
+}
+
+bool ShaderCache::Load(const ShaderCacheKey& key, std::vector<uint8_t>* pBinary) const
+{
+	if (cacheDir_.empty())
+	{
+		return false;
+	}
+	std::string data;
+	if (!ReadFile(GetFilePath(key), &data) || data.empty())
+	{
+		return false;
+	}
+	pBinary->assign(data.begin(), data.end());
+	return true;
+}
+
+bool ShaderCache::Store(const ShaderCacheKey& key, const void* pData, size_t size) const
+{
+	if (cacheDir_.empty())
+	{
+		return false;
+	}
+	std::string filePath = GetFilePath(key);
+	std::string tempPath = filePath + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	FILE* fp = fopen(tempPath.c_str(), "wb");
+	if (!fp)
+	{
+		printf("Error: failed to open shader cache file. (%s)\n", tempPath.c_str());
+		return false;
+	}
+	bool bWritten = fwrite(pData, 1, size, fp) == size;
+	fclose(fp);
+
+	std::error_code ec;
+	if (bWritten)
+	{
+		std::filesystem::rename(tempPath, filePath, ec);
+	}
+	if (!bWritten || ec)
+	{
+		std::filesystem::remove(tempPath, ec);
+		printf("Error: failed to write shader cache file. (%s)\n", filePath.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+bool CompileShadersCached(const std::vector<ShaderCompileDesc>& descs, const std::vector<std::string>& includeDirs, const std::string& compilerId,
+	const ShaderCache& cache, const ShaderCompileFunc& compile, TaskScheduler* pScheduler,
+	std::vector<std::vector<uint8_t>>* pBinaries, ShaderCacheStats* pStats)
+{
+	TaskScheduler localScheduler;
+	if (!pScheduler)
+	{
+		localScheduler.Initialize();
+		pScheduler = &localScheduler;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::atomic<uint32_t> hitCount(0), missCount(0), uncachedCount(0), failedCount(0);
+	pBinaries->assign(descs.size(), std::vector<uint8_t>());
+	for (size_t i = 0; i < descs.size(); i++)
+	{
+		const ShaderCompileDesc* pDesc = &descs[i];
+		std::vector<uint8_t>* pBinary = &(*pBinaries)[i];
+		pScheduler->AddTask("shader " + std::filesystem::path(pDesc->filePath).filename().string(), [&, pDesc, pBinary]()
+		{
+			auto&& desc = *pDesc;
+			auto&& binary = *pBinary;
+			ShaderCacheKey key;
+			bool bKeyed = MakeShaderCacheKey(desc, includeDirs, compilerId, &key);
+			if (bKeyed && cache.Load(key, &binary))
+			{
+				hitCount++;
+				return true;
+			}
+			if (!compile(desc, &binary))
+			{
+				printf("Error: failed to compile shader. (%s)\n", desc.filePath.c_str());
+				failedCount++;
+				return false;
+			}
+			if (bKeyed)
+			{
+				cache.Store(key, binary.data(), binary.size());
+				missCount++;
+			}
+			else
+			{
+				uncachedCount++;
+			}
+			return true;
+		});
+	}
+	bool bSucceeded = pScheduler->Run();
+
+	if (pStats)
+	{
+		pStats->hitCount = hitCount;
+		pStats->missCount = missCount;
+		pStats->uncachedCount = uncachedCount;
+		pStats->failedCount = failedCount;
+		pStats->elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	return bSucceeded;
+}
+
+
+std::string FindDxc()
+{
+	std::error_code ec;
+	const char* pEnv = getenv("DXC");
+	if (pEnv && std::filesystem::exists(pEnv, ec))
+	{
+		return pEnv;
+	}
+#if defined(_WIN32)
+	const char kSeparator = ';';
+	const char* kNames[] = { "dxc.exe" };
+#else
+	const char kSeparator = ':';
+	const char* kNames[] = { "dxc" };
+#endif
+	const char* pPath = getenv("PATH");
+	std::string path = pPath ? pPath : "";
+	size_t pos = 0;
+	while (pos <= path.size())
+	{
+		size_t end = path.find(kSeparator, pos);
+		if (end == std::string::npos)
+		{
+			end = path.size();
+		}
+		std::string dir = path.substr(pos, end - pos);
+		for (auto name : kNames)
+		{
+			if (!dir.empty() && std::filesystem::exists(std::filesystem::path(dir) / name, ec))
+			{
+				return (std::filesystem::path(dir) / name).string();
+			}
+		}
+		pos = end + 1;
+	}
+	return std::string();
+}
+
+std::string GetDxcCompilerId(const std::string& dxcPath)
+{
+	FILE* pipe = popen((QuoteArg(dxcPath) + " --version").c_str(), "r");
+	if (!pipe)
+	{
+		return std::string();
+	}
+	std::string version;
+	char buffer[256];
+	while (fgets(buffer, sizeof(buffer), pipe))
+	{
+		version += buffer;
+	}
+	if (pclose(pipe) != 0 || version.empty())
+	{
+		return std::string();
+	}
+	while (!version.empty() && (version.back() == '\n' || version.back() == '\r'))
+	{
+		version.pop_back();
+	}
+	return "dxc " + version;
+}
+
+bool CompileShaderDxc(const std::string& dxcPath, const ShaderCompileDesc& desc, const std::vector<std::string>& includeDirs, std::vector<uint8_t>* pBinary)
+{
+	std::string outPath = (std::filesystem::temp_directory_path() / ("shader_" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".dxil")).string();
+	std::string cmd = QuoteArg(dxcPath) + " -T " + desc.target + " -E " + desc.entryPoint;
+	for (auto&& d : desc.defines)
+	{
+		cmd += " -D " + QuoteArg(d.first + "=" + d.second);
+	}
+	for (auto&& dir : includeDirs)
+	{
+		cmd += " -I " + QuoteArg(dir);
+	}
+	cmd += " -Fo " + QuoteArg(outPath) + " " + QuoteArg(desc.filePath);
+#if defined(_WIN32)
+	// cmd.exe strips the outer quotes of the whole line.
+	cmd = "\"" + cmd + "\"";
+#endif
+	if (std::system(cmd.c_str()) != 0)
+	{
+		return false;
+	}
+
+	std::string data;
+	bool bRead = ReadFile(outPath, &data) && !data.empty();
+	std::error_code ec;
+	std::filesystem::remove(outPath, ec);
+	if (!bRead)
+	{
+		return false;
+	}
+	pBinary->assign(data.begin(), data.end());
+	return true;
+}
+
+//	EOF
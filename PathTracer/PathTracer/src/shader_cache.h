@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+class TaskScheduler;
+
+struct ShaderCompileDesc
+{
+	std::string		filePath;
+	std::string		entryPoint = "main";
+	std::string		target;			// "vs_6_6", "lib_6_6", ...
+	std::vector<std::pair<std::string, std::string>>	defines;
+};
+
+// hash of everything a compiled shader depends on.
+struct ShaderCacheKey
+{
+	uint64_t					hash[2] = { 0, 0 };
+	std::vector<std::string>	files;			// the source and its transitive includes, resolved.
+
+	std::string ToString() const;
+};
+
+// target profile from the file name convention of sl12::GetShaderTypeFromFileName(), "a.vv.hlsl" -> "vs_6_6".
+// returns an empty string for unknown names.
+std::string GetShaderTarget(const std::string& filePath, int majorVersion = 6, int minorVersion = 6);
+
+// hashes the source, every file it includes, the defines, the entry point, the target and compilerId.
+//   quoted includes are searched next to the including file first, then in includeDirs.
+//   includes inside inactive #if blocks are hashed too, a few extra files only cost a false miss.
+// fails if any include is missing, a key without it could hit a stale binary.
+bool MakeShaderCacheKey(const ShaderCompileDesc& desc, const std::vector<std::string>& includeDirs, const std::string& compilerId, ShaderCacheKey* pKey);
+
+// compiled binaries in one directory, one file per key.
+class ShaderCache
+{
+public:
+	bool Initialize(const std::string& cacheDir);
+
+	bool Load(const ShaderCacheKey& key, std::vector<uint8_t>* pBinary) const;
+	// written to a temporary file first, so that a reader never sees a partial binary.
+	bool Store(const ShaderCacheKey& key, const void* pData, size_t size) const;
+
+	std::string GetFilePath(const ShaderCacheKey& key) const;
+	const std::string& GetDirectory() const { return cacheDir_; }
+
+private:
+	std::string		cacheDir_;
+};	// class ShaderCache
+
+typedef std::function<bool(const ShaderCompileDesc& desc, std::vector<uint8_t>* pBinary)> ShaderCompileFunc;
+
+struct ShaderCacheStats
+{
+	uint32_t	hitCount = 0;
+	uint32_t	missCount = 0;		// compiled and stored.
+	uint32_t	uncachedCount = 0;	// no key, compiled only.
+	uint32_t	failedCount = 0;
+	double		elapsedMs = 0.0;
+};
+
+// binaries of all descs, misses compile in parallel as tasks of pScheduler and are stored in the cache.
+// returns false if any shader failed to compile.
+bool CompileShadersCached(const std::vector<ShaderCompileDesc>& descs, const std::vector<std::string>& includeDirs, const std::string& compilerId,
+	const ShaderCache& cache, const ShaderCompileFunc& compile, TaskScheduler* pScheduler,
+	std::vector<std::vector<uint8_t>>* pBinaries, ShaderCacheStats* pStats = nullptr);
+
+// dxc executable from the DXC environment variable or the PATH, empty if not found.
+std::string FindDxc();
+// "dxc <version>" for MakeShaderCacheKey(), empty if dxc can not be run.
+std::string GetDxcCompilerId(const std::string& dxcPath);
+// compiles one shader with the dxc executable into a DXIL container.
+bool CompileShaderDxc(const std::string& dxcPath, const ShaderCompileDesc& desc, const std::vector<std::string>& includeDirs, std::vector<uint8_t>* pBinary);
+
+//	EOF